@@ -0,0 +1,98 @@
+/*
+ * ESC/POS - Comandi stampante CSN-A2 costruiti a compile-time
+ *
+ * Ogni comando è un array di byte constexpr: le parti fisse di un'etichetta
+ * si concatenano con + e finiscono in flash già pronte, a runtime si
+ * scrivono solo i campi variabili.
+ *
+ *   constexpr auto kTitolo = escpos::bold(true) + escpos::text("CIAO") + escpos::crlf();
+ *   escpos::emit(printerSerial, kTitolo);
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace escpos {
+
+constexpr uint8_t ESC = 0x1B;
+constexpr uint8_t GS  = 0x1D;
+constexpr uint8_t LF  = 0x0A;
+constexpr uint8_t CR  = 0x0D;
+
+// Sequenza di N byte nota a compile-time
+template <size_t N>
+struct Bytes {
+  uint8_t data[N];
+  static constexpr size_t size = N;
+};
+
+// Concatenazione: a + b
+template <size_t N, size_t M>
+constexpr Bytes<N + M> operator+(const Bytes<N>& a, const Bytes<M>& b) {
+  Bytes<N + M> r{};
+  for (size_t i = 0; i < N; i++) r.data[i] = a.data[i];
+  for (size_t i = 0; i < M; i++) r.data[N + i] = b.data[i];
+  return r;
+}
+
+// Testo letterale (senza terminatore)
+template <size_t N>
+constexpr Bytes<N - 1> text(const char (&s)[N]) {
+  static_assert(N > 1, "testo vuoto");
+  Bytes<N - 1> r{};
+  for (size_t i = 0; i < N - 1; i++) r.data[i] = (uint8_t)s[i];
+  return r;
+}
+
+// ===== COMANDI =====
+constexpr Bytes<2> reset()              { return {{ESC, '@'}}; }            // ESC @
+constexpr Bytes<3> bold(bool on)        { return {{ESC, 'E', on}}; }        // ESC E n
+constexpr Bytes<3> reverse(bool on)     { return {{GS, 'B', on}}; }         // GS B n
+constexpr Bytes<3> condensed(bool on)   { return {{ESC, 'M', on}}; }        // ESC M n (0 = normale)
+constexpr Bytes<3> feedDots(uint8_t n)  { return {{ESC, 'J', n}}; }         // ESC J n (avanza n/8 mm)
+constexpr Bytes<1> lf()                 { return {{LF}}; }
+constexpr Bytes<2> crlf()               { return {{CR, LF}}; }              // come Print::println()
+
+// ESC 7 n1 n2 n3: densità/riscaldamento
+constexpr Bytes<5> heating(uint8_t dots, uint8_t time, uint8_t interval) {
+  return {{ESC, '7', dots, time, interval}};
+}
+
+// Confronto con una sequenza attesa (per static_assert)
+template <size_t N, size_t M>
+constexpr bool equals(const Bytes<N>& a, const uint8_t (&expected)[M]) {
+  if (N != M) return false;
+  for (size_t i = 0; i < N; i++) {
+    if (a.data[i] != expected[i]) return false;
+  }
+  return true;
+}
+
+// Scrive la sequenza in un solo colpo su qualsiasi Print/Stream
+template <typename Out, size_t N>
+inline size_t emit(Out& out, const Bytes<N>& b) {
+  return out.write(b.data, N);
+}
+
+// ===== VERIFICA A COMPILE-TIME =====
+// Byte identici alle triplette scritte a mano nelle versioni precedenti
+namespace check {
+constexpr uint8_t kReset[]     = {0x1B, '@'};
+constexpr uint8_t kBoldOn[]    = {0x1B, 'E', 1};
+constexpr uint8_t kReverseOn[] = {0x1D, 'B', 1};
+constexpr uint8_t kFontNorm[]  = {0x1B, 'M', 0};
+constexpr uint8_t kFeed16[]    = {0x1B, 'J', 16};
+constexpr uint8_t kDensity[]   = {0x1B, 0x37, 11, 120, 40};
+constexpr uint8_t kCat[]       = {0x1B, 'E', 0, 'O', 'K', '\r', '\n'};
+static_assert(equals(reset(), kReset), "ESC @");
+static_assert(equals(bold(true), kBoldOn), "ESC E 1");
+static_assert(equals(reverse(true), kReverseOn), "GS B 1");
+static_assert(equals(condensed(false), kFontNorm), "ESC M 0");
+static_assert(equals(feedDots(16), kFeed16), "ESC J 16");
+static_assert(equals(heating(11, 120, 40), kDensity), "ESC 7");
+static_assert(equals(bold(false) + text("OK") + crlf(), kCat), "concatenazione");
+}  // namespace check
+
+}  // namespace escpos
@@ -0,0 +1,125 @@
+/*
+ * LZSS - Compressione a blocchi per i file su SD
+ *
+ * Ogni blocco (al più kBlock byte in chiaro) si comprime da solo: la
+ * finestra riparte a ogni blocco, quindi per leggere dal mezzo di un file
+ * basta decomprimere il blocco che contiene l'offset. Per decomprimere
+ * serve solo il buffer di uscita del blocco.
+ *
+ * Formato: un byte di flag ogni 8 elementi (bit a 1 = letterale, dal bit
+ * meno significativo), letterale = 1 byte, riferimento = 2 byte con
+ * distanza su 12 bit (1..4095) e lunghezza su 4 bit (3..18).
+ *
+ *   lzss::Workspace* w = (lzss::Workspace*)malloc(sizeof(lzss::Workspace));
+ *   size_t n = lzss::compress(raw, rawLen, out, *w);
+ *   lzss::decompress([&] { return nextByte(); }, raw, rawLen);
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace lzss {
+
+constexpr size_t kBlock = 4096;
+constexpr int kMinMatch = 3;
+constexpr int kMaxMatch = 18;
+constexpr int kMaxChain = 32;  // Candidati provati per posizione
+constexpr size_t kMaxOut = kBlock + (kBlock + 7) / 8;  // Solo letterali
+
+// Catene di hash per la compressione (16 KB, solo in scrittura)
+struct Workspace {
+  uint16_t head[4096];
+  uint16_t prev[kBlock];
+};
+
+inline uint16_t hash3(const uint8_t* p) {
+  return ((p[0] << 4) ^ (p[1] << 2) ^ p[2]) & 4095;
+}
+
+// Comprime in (n <= kBlock) in out (almeno kMaxOut byte); ritorna i byte scritti
+inline size_t compress(const uint8_t* in, size_t n, uint8_t* out, Workspace& w) {
+  for (int i = 0; i < 4096; i++) w.head[i] = 0xFFFF;
+
+  size_t o = 0;
+  size_t flagPos = 0;
+  int bit = 0;
+  size_t i = 0;
+  while (i < n) {
+    if (bit == 0) {
+      flagPos = o;
+      out[o++] = 0;
+    }
+
+    int bestLen = 0;
+    int bestDist = 0;
+    if (i + kMinMatch <= n) {
+      int maxLen = n - i < (size_t)kMaxMatch ? (int)(n - i) : kMaxMatch;
+      int chain = kMaxChain;
+      for (uint16_t j = w.head[hash3(in + i)]; j != 0xFFFF && chain-- > 0; j = w.prev[j]) {
+        int len = 0;
+        while (len < maxLen && in[j + len] == in[i + len]) len++;
+        if (len > bestLen) {
+          bestLen = len;
+          bestDist = i - j;
+          if (len == maxLen) break;
+        }
+      }
+    }
+
+    size_t step;
+    if (bestLen >= kMinMatch) {
+      out[o++] = bestDist & 0xFF;
+      out[o++] = ((bestDist >> 4) & 0xF0) | (bestLen - kMinMatch);
+      step = bestLen;
+    } else {
+      out[flagPos] |= 1 << bit;
+      out[o++] = in[i];
+      step = 1;
+    }
+    bit = (bit + 1) & 7;
+
+    // Posizioni coperte in testa alle catene (distanza sempre < kBlock)
+    for (size_t end = i + step; i < end; i++) {
+      if (i + kMinMatch > n) continue;
+      uint16_t h = hash3(in + i);
+      w.prev[i] = w.head[h];
+      w.head[h] = i;
+    }
+  }
+  return o;
+}
+
+// Decomprime un blocco: next() dà il byte compresso successivo (-1 a fine
+// dati), cap = byte in chiaro attesi. Ritorna i byte scritti (meno di cap
+// se i dati sono troncati o non validi)
+template <typename Next>
+size_t decompress(Next next, uint8_t* out, size_t cap) {
+  size_t o = 0;
+  while (o < cap) {
+    int flags = next();
+    if (flags < 0) break;
+    for (int bit = 0; bit < 8 && o < cap; bit++) {
+      if (flags & (1 << bit)) {
+        int c = next();
+        if (c < 0) return o;
+        out[o++] = c;
+        continue;
+      }
+      int b0 = next();
+      int b1 = next();
+      if (b0 < 0 || b1 < 0) return o;
+      size_t dist = b0 | ((b1 & 0xF0) << 4);
+      int len = (b1 & 0x0F) + kMinMatch;
+      if (dist == 0 || dist > o) return o;
+      while (len-- > 0 && o < cap) {
+        out[o] = out[o - dist];
+        o++;
+      }
+    }
+  }
+  return o;
+}
+
+}  // namespace lzss
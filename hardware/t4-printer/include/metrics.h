@@ -0,0 +1,142 @@
+/*
+ * METRICS - Contatori, valori istantanei e istogrammi di latenza
+ *
+ * Memoria fissa, nessuna allocazione e nessun mutex: lock-free, atomico
+ * campo per campo (ogni aggiornamento è un'operazione atomica su 32 bit),
+ * quindi si può registrare da qualsiasi task su entrambi i core. Una
+ * lettura fatta mentre si registra può essere momentaneamente incoerente
+ * (count già contato e bucket no, o viceversa): i totali tornano a
+ * registrazioni ferme. Gli istogrammi hanno un bucket per potenza di 2
+ * (in microsecondi): i percentili sono il limite superiore del bucket.
+ *
+ *   metrics::Histogram pollRtt;
+ *   pollRtt.record(micros() - t0);
+ *   const metrics::Entry kAll[] = {{"poll.rtt", &pollRtt}};
+ *   metrics::print(Serial, kAll, 1);
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+namespace metrics {
+
+constexpr int kBuckets = 32;  // Bucket b: [2^b, 2^(b+1)) us, il bucket 0 comprende lo 0
+
+struct Counter {
+  std::atomic<uint32_t> value{0};
+
+  void add(uint32_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+  uint32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+struct Gauge {
+  std::atomic<int32_t> value{0};
+
+  void set(int32_t v) { value.store(v, std::memory_order_relaxed); }
+  int32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Massimo atomico (CAS finché il valore salvato è più piccolo)
+inline void storeMax(std::atomic<uint32_t>& a, uint32_t v) {
+  uint32_t cur = a.load(std::memory_order_relaxed);
+  while (v > cur && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+  }
+}
+
+struct Histogram {
+  std::atomic<uint32_t> buckets[kBuckets] = {};
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> maxUs{0};
+
+  static int bucketOf(uint32_t us) { return us < 2 ? 0 : 31 - __builtin_clz(us); }
+
+  void record(uint32_t us) {
+    buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    storeMax(maxUs, us);
+  }
+
+  // Limite superiore (us) del bucket che contiene il pct-esimo percentile,
+  // mai oltre il massimo visto
+  uint32_t percentile(int pct) const {
+    uint32_t n = count.load(std::memory_order_relaxed);
+    uint32_t top = maxUs.load(std::memory_order_relaxed);
+    if (n == 0) return 0;
+    uint32_t target = (uint32_t)(((uint64_t)n * pct + 99) / 100);
+    uint32_t seen = 0;
+    for (int b = 0; b < kBuckets; b++) {
+      seen += buckets[b].load(std::memory_order_relaxed);
+      if (seen >= target) {
+        uint32_t bound = b == 31 ? UINT32_MAX : (2u << b) - 1;
+        return bound < top ? bound : top;
+      }
+    }
+    return top;
+  }
+};
+
+// ===== REGISTRO =====
+enum Kind : uint8_t { COUNTER, GAUGE, HISTOGRAM };
+
+struct Entry {
+  const char* name;
+  Kind kind;
+  const void* metric;
+
+  Entry(const char* n, const Counter* c) : name(n), kind(COUNTER), metric(c) {}
+  Entry(const char* n, const Gauge* g) : name(n), kind(GAUGE), metric(g) {}
+  Entry(const char* n, const Histogram* h) : name(n), kind(HISTOGRAM), metric(h) {}
+};
+
+// Durata compatta: "850us", "12ms", "3.4s"
+template <typename Out>
+void printUs(Out& out, uint32_t us) {
+  if (us < 1000) {
+    out.print((unsigned long)us);
+    out.print("us");
+  } else if (us < 10000000) {
+    out.print((unsigned long)(us / 1000));
+    out.print("ms");
+  } else {
+    out.print(us / 1000000.0, 1);
+    out.print("s");
+  }
+}
+
+// Una riga per metrica (due per gli istogrammi), larghezza <= 32 caratteri
+template <typename Out>
+void print(Out& out, const Entry* entries, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    const Entry& e = entries[i];
+    out.print(e.name);
+    out.print(": ");
+    if (e.kind == COUNTER) {
+      out.println((unsigned long)static_cast<const Counter*>(e.metric)->get());
+    } else if (e.kind == GAUGE) {
+      out.println((long)static_cast<const Gauge*>(e.metric)->get());
+    } else {
+      const Histogram& h = *static_cast<const Histogram*>(e.metric);
+      uint32_t cnt = h.count.load(std::memory_order_relaxed);
+      out.print((unsigned long)cnt);
+      if (cnt == 0) {
+        out.println();
+        continue;
+      }
+      out.print(" max ");
+      printUs(out, h.maxUs.load(std::memory_order_relaxed));
+      out.println();
+      out.print("  p50<");
+      printUs(out, h.percentile(50));
+      out.print(" p90<");
+      printUs(out, h.percentile(90));
+      out.print(" p99<");
+      printUs(out, h.percentile(99));
+      out.println();
+    }
+  }
+}
+
+}  // namespace metrics
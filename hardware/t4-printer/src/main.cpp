@@ -8,6 +8,7 @@
 #include <Arduino.h>
 #include <TFT_eSPI.h>
 #include <SD.h>
+#include <LittleFS.h>
 #include <SPI.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
@@ -16,6 +17,20 @@
 #include <DNSServer.h>
 #include <math.h>
 #include <Update.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+#include <rom/crc.h>
+#include <algorithm>
+#include <atomic>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+#include <soc/soc_memory_layout.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+#include "escpos.h"
+#include "lzss.h"
+#include "metrics.h"
 
 // Versione firmware corrente
 #define FIRMWARE_VERSION "1.6.9"
@@ -99,10 +114,8 @@ struct Scheda {
   bool ddt;             // DDT presente (colonna F)
 };
 
-// Array schede (ultime 50)
+// Schede in lista (ultime 50): snapshot pubblicati da parseCSV, vedi SchedeRef
 #define MAX_SCHEDE 50
-Scheda schede[MAX_SCHEDE];
-int numSchede = 0;
 
 // UI state (landscape 320x240, pulsanti a destra)
 int selectedIndex = 0;
@@ -113,14 +126,70 @@ int scrollOffset = 0;
 #define HEADER_HEIGHT 30        // Altezza header in alto
 #define SCROLLBAR_WIDTH 5       // Larghezza scrollbar a sinistra
 
+// Ridisegno incrementale lista: hash del contenuto di ogni riga a schermo
+uint32_t listRowHash[VISIBLE_ROWS];
+uint32_t listBarHash = 0;
+bool listValid = false;          // false = area lista da ripulire e ridisegnare tutta
+volatile bool listStale = false; // Ridisegno saltato a schermo spento
+uint32_t listPixels = 0;         // Pixel inviati dall'ultimo reset (x2 = byte SPI)
+int listLastScroll = -1;         // scrollOffset dell'ultimo disegno
+uint32_t listScrollSteps = 0;
+uint32_t listScrollLastPx = 0;   // Pixel scritti dall'ultimo scorrimento
+uint32_t listScrollMaxPx = 0;
+
+// Tempi di frame per tipo di schermata (sprite + DMA)
+enum UiScreen : uint8_t { UI_LIST, UI_MESSAGE, UI_MANUAL, UI_SCREENS };
+struct UiFrameStats {
+  uint32_t frames;
+  uint32_t lastUs;  // Composizione + invio dell'ultimo frame
+  uint32_t maxUs;
+  uint64_t totUs;
+  uint64_t spiUs;   // Di cui in attesa dell'SPI (DMA o scrittura diretta)
+};
+UiFrameStats uiStats[UI_SCREENS];
+bool uiSprites = false;  // false = disegno diretto (niente PSRAM/DMA)
+SemaphoreHandle_t uiMutex = NULL;  // Task display (o schermata OTA in esclusiva)
+uint32_t uiPosted = 0;     // Richieste di ridisegno ricevute
+uint32_t uiCoalesced = 0;  // Richieste assorbite da una già in attesa
+uint32_t uiRendered = 0;   // Passate del task display
+volatile uint32_t uiMsgSeq = 0;  // Incrementato a ogni messaggio non vuoto
+
 // Long press timing
-unsigned long btnUpPressed = 0;
-unsigned long btnDownPressed = 0;
-unsigned long lastPageSkip = 0;
-#define LONG_PRESS_MS 1500
+#define LONG_PRESS_MS 1500      // SU/GIU: salto di 10, ripetuto ogni LONG_PRESS_MS
+#define DEBOUNCE_MS 25          // Livello stabile prima di accettare un fronte
+#define LOOP_IDLE_MS 100        // Attesa massima del loop senza eventi pulsanti
+
+// Statistiche input (interrupt -> loop)
+struct InputStats {
+  uint32_t events;     // Pressioni consegnate al loop
+  uint32_t lastLatUs;  // Primo fronte -> evento gestito dal loop
+  uint32_t maxLatUs;
+  uint32_t bounces;    // Fronti scartati dal debounce (rimbalzi, glitch GPIO39)
+  uint32_t dropped;    // Fronti/eventi persi per coda piena (sotto inputStatsMux)
+};
+InputStats inputStats = {0, 0, 0, 0, 0};
+portMUX_TYPE inputStatsMux = portMUX_INITIALIZER_UNLOCKED;  // dropped: ISR e button task
+
+// Durata di un giro del loop (escluse le attese di eventi)
+uint32_t loopLastUs = 0;
+uint32_t loopMaxUs = 0;
+
+// Risparmio energetico a schermo spento (modem sleep + DFS, vedi RISPARMIO ENERGETICO)
+#define POWER_IDLE_LOOP_MS 1000  // Attesa loop a schermo spento: i pulsanti svegliano comunque
+volatile bool powerIdle = false;
+struct PowerStats {
+  uint64_t activeUs;     // Schermo acceso
+  uint64_t idleUs;       // Schermo spento (al lavoro + in attesa)
+  uint64_t idleAwakeUs;  // Di cui a lavorare (poll, stampa)
+  uint32_t idleEntries;
+  uint64_t lastChangeUs;
+};
+PowerStats powerStats = {0, 0, 0, 0, 0};
+bool powerDfs = false;  // CPU a 80MHz a schermo spento (CONFIG_PM_ENABLE)
 
 // Stati
 bool sdOK = false;
+bool flashOK = false;  // LittleFS sulla flash interna
 bool wifiOK = false;
 String csvData = "";
 
@@ -147,10 +216,58 @@ unsigned long lastWifiRetry = 0;
 volatile bool wifiError = false;  // Errore temporaneo (polling fallito)
 volatile bool showWifiStatus = false;  // Flag per aggiornare UI
 
-// Print history (schede già stampate)
-#define MAX_HISTORY 200
-char printHistory[MAX_HISTORY][12];  // Array di numeri scheda (es: "26/0021")
-int historyCount = 0;
+// Print history (schede già stampate): un bit per numero, per anno
+#define PRINTED_YEARS 100
+#define PRINTED_BITS_BYTES (10000 / 8)  // Progressivi 0000-9999
+#define PRINTED_RECENT 200              // Ultime stampate, in ordine
+uint8_t* printedBits[PRINTED_YEARS];    // NULL = nessuna scheda stampata quell'anno
+int32_t printedRecent[PRINTED_RECENT];  // Ring di id (packNumero)
+int printedRecentHead = 0;              // Prossima posizione da scrivere
+int printedRecentCount = 0;
+int historyCount = 0;                   // Schede nel set
+#define PRINTED_ODD_MAX 16                // Numeri fuori formato ricordati (solo RAM)
+char printedOdd[PRINTED_ODD_MAX][sizeof(Scheda::numero)];
+int printedOddCount = 0;                // Aggiunti in tutto: oltre il massimo ring
+
+// Cache etichette pre-renderizzate (PSRAM + spill su SD)
+#define LABEL_CACHE_JOBS 64
+
+// Latenza richiesta di stampa -> primo byte alla stampante
+volatile uint32_t printTriggerUs = 0;  // 0 = nessuna richiesta in attesa
+struct PrintLatency {
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint32_t count;
+};
+PrintLatency printLatency[3];  // [0] = renderizzata al momento, [1] = da cache, [2] = OK in modalità manuale
+volatile bool printTriggerManual = false;  // Richiesta in attesa dall'OK finale manuale
+
+// Metriche (vedi metrics.h): aggiornate senza lock da tutti i task
+enum HttpClass { HTTP_2XX, HTTP_3XX, HTTP_4XX, HTTP_5XX, HTTP_ERR, HTTP_CLASSES };
+metrics::Histogram mPollRtt;      // Richiesta pollPrinter -> risposta letta
+metrics::Histogram mJsonParse;    // deserializeJson delle risposte API
+metrics::Histogram mCsvParse;     // parseCSV completo
+metrics::Histogram mSdOp;         // Operazioni SD (dall'accodamento alla fine)
+metrics::Histogram mLabelPrint;   // Invio di un'etichetta alla stampante
+metrics::Histogram mPollPaper;    // Richiesta di poll -> primo byte alla stampante
+metrics::Counter mHttp[HTTP_CLASSES];
+metrics::Gauge mHeapFree;
+metrics::Gauge mHeapMin;          // Minimo storico dall'avvio
+metrics::Gauge mPsramMin;
+metrics::Gauge mLogCalls;         // Chiamate di log accodate
+metrics::Gauge mLogAvgCycles;     // Costo medio di una chiamata (cicli CPU)
+metrics::Gauge mLogMaxCycles;
+metrics::Gauge mLogDropped;       // Record persi a ring pieno
+volatile uint32_t pollPaperUs = 0;  // Inizio del poll che ha trovato la scheda (0 = nessuno)
+
+// Coda di stampa (task dedicato alla stampante)
+#define PRINT_QUEUE_LEN 6
+#define PAUSE_NORMAL_SEC 8    // Pausa tra etichette della stessa scheda
+#define PAUSE_REMOTE_SEC 3    // Ristampe da comando remoto (PRINT:)
+#define BATCH_STEP_MS 500     // Ogni quanto il polling riprova ad accodare un batch PRINT:
+QueueHandle_t printQueue = NULL;
+TaskHandle_t printTaskHandle = NULL;
+volatile bool printBusy = false;  // Task di stampa al lavoro su un job
 
 // Screen sleep
 unsigned long lastButtonActivity = 0;
@@ -160,130 +277,686 @@ bool printFromSleep = false;  // Flag: stampa partita con schermo spento
 
 // Modalità inserimento manuale numero scheda
 bool manualInputMode = false;
+bool manualSearch = false;  // Sotto-modalità: ricerca per cliente
 char manualNumero[8] = "26/0001";  // Formato AA/NNNN
 int manualCursorPos = 0;  // Posizione cursore (0-6, salta pos 2 che è /)
 #define MANUAL_LONG_PRESS_MS 2000
 #define MANUAL_TIMEOUT_MS 20000  // 20 secondi timeout inattività
 unsigned long lastManualActivity = 0;
 
+// Da dove arriva la scheda all'OK finale in modalità manuale
+enum ManualSource : uint8_t {
+  MANUAL_FROM_RAM, MANUAL_FROM_PREFETCH, MANUAL_FROM_ARCHIVE, MANUAL_FROM_INDEX, MANUAL_FROM_SCAN
+};
+uint32_t manualSource[5] = {0, 0, 0, 0, 0};
+
 // Forward declarations
 void showMessage(const char* msg, uint16_t color);
 void drawList();
 void printEtichetta(Scheda& s, int attrezzoIdx, int totAttrezzi);
 void drawHeader();
+void invalidateList();
+void drawScreen();
+void drawManualInput();
+void renderManualInput();
+void renderSearchInput();
+void exitManualInputMode();
+void powerEnterIdle();
+void powerExitIdle();
+uint32_t powerEstimateMa();
+const char* powerModeName();
 void drawButtons();
 void tryPrintManualScheda();
 bool performOTAUpdate();
 void printStatusReport();
 void executeRemoteCommand(const char* cmd);
-
-// ===== DEBUG PRINT (Serial + Stampante) =====
+void appendTrunc(char* dst, size_t cap, const char* src, int maxChars);
+uint32_t fnv1a(uint32_t h, const char* str);
+int listRowCount();
+void labelCacheRefresh();
+void jobDirRequestRebuild();
+void historyCompact();
+void syncSaveSeen(int id);
+void syncUpdateSeen();
+void syncSaveTimestamp(unsigned long ts);
+void syncSaveGeneration();
+void markPrintTrigger(bool manual = false);
+bool printFromCache(const char* numero);
+int labelCacheUsed();
+bool enqueuePrint(const Scheda& s, uint8_t pauseSec, TickType_t wait, uint16_t batchId);
+bool enqueueCachedPrint(const char* numero, uint32_t hash, uint8_t pauseSec, TickType_t wait);
+bool enqueueStatusReport(TickType_t wait);
+bool enqueueMetricsReport(TickType_t wait);
+void printBatch(const char* spec);
+bool printBatchStep();
+void metricsHttp(int httpCode);
+void logSdWrite(const char* text, bool eol);
+
+// ===== LOG (livelli e sottosistemi a compile-time, ring in PSRAM) =====
+// debugPrint/debugPrintln (INFO), errorPrint/errorPrintln (ERROR) e
+// tracePrint/tracePrintln (DEBUG) sono macro: se il livello o il
+// sottosistema della sezione (LOG_SUB) sono esclusi a compile-time, la
+// chiamata e i suoi argomenti spariscono dal binario.
+// Una chiamata abilitata non aspetta seriale né stampante: accoda un record
+// compatto nel ring (un letterale in flash è solo il puntatore) e LogTask,
+// a priorità minima, lo scrive su seriale, carta (debugPrintMode) e SD
+// (LOG_TO_SD). Prima di logInit si scrive diretto come una volta.
+//
+//   -DLOG_LEVEL=LOG_LEVEL_ERROR                    solo errori
+//   -DLOG_SUBSYSTEMS="(LOG_SUB_ALL & ~LOG_SUB_UI)" tutto tranne la UI
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_SUB_SYS   0x01  // Avvio, loop, energia, metriche
+#define LOG_SUB_NET   0x02  // OTA, WiFi, portale
+#define LOG_SUB_STORE 0x04  // SD, flash, storico
+#define LOG_SUB_CSV   0x08  // CSV, archivio, indice
+#define LOG_SUB_POLL  0x10  // Polling, sync, comandi remoti
+#define LOG_SUB_UI    0x20  // Display, pulsanti, inserimento manuale, ricerca
+#define LOG_SUB_PRINT 0x40  // Etichette, cache, spool, coda di stampa
+#define LOG_SUB_ALL   0x7F
+#ifndef LOG_SUBSYSTEMS
+#define LOG_SUBSYSTEMS LOG_SUB_ALL
+#endif
+
+// Copia dei log su SD (/log.txt, ruotato in /log.old)
+#ifndef LOG_TO_SD
+#define LOG_TO_SD 0
+#endif
+
+#define LOG_SUB LOG_SUB_SYS  // Ogni sezione lo ridefinisce
+
+#define LOG_ON(level) ((level) <= LOG_LEVEL && (LOG_SUB & LOG_SUBSYSTEMS) != 0)
+#define LOG_AT(level, ...) do { if (LOG_ON(level)) logPut(__VA_ARGS__); } while (0)
+#define LOG_LN_AT(level, ...) do { if (LOG_ON(level)) logPutLn(__VA_ARGS__); } while (0)
+
+#define errorPrint(...)   LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define errorPrintln(...) LOG_LN_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define debugPrint(...)   LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define debugPrintln(...) LOG_LN_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define tracePrint(...)   LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define tracePrintln(...) LOG_LN_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
 
 // Flag per sopprimere log JSON durante parsing
 bool suppressJsonLogs = false;
 
-// Stampa su seriale + carta (se debugPrintMode attivo)
-void debugPrint(const char* msg) {
-  Serial.print(msg);
+// Record: un byte di tipo (LR_EOL = a capo dopo il valore) + dati
+enum LogRec : uint8_t {
+  LR_NONE,  // Nessun dato (solo a capo)
+  LR_LIT,   // Puntatore a stringa in flash
+  LR_STR,   // Lunghezza (1 byte) + caratteri
+  LR_INT,   // int32
+  LR_UINT,  // uint32
+  LR_IP,    // IPv4 (4 byte)
+  LR_EOL = 0x80
+};
+
+#define LOG_RING_SIZE 32768      // Potenza di 2, PSRAM
+#define LOG_RING_SIZE_DRAM 4096  // Senza PSRAM: più piccolo, in RAM interna
+#define LOG_STR_MAX 255          // Stringhe copiate più lunghe: troncate
+
+uint8_t* logRing = NULL;
+uint32_t logRingMask = 0;  // Dimensione del ring - 1
+uint32_t logHead = 0;  // Prossimo byte da scrivere (sotto logMux)
+uint32_t logTail = 0;  // Prossimo byte da leggere (sotto logMux)
+portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+TaskHandle_t logTaskHandle = NULL;
+bool logPaperLine = false;  // Riga su carta aperta (condensato attivo)
+
+// Costo di ogni chiamata (cicli CPU, accodamento + notifica)
+struct LogStats {
+  uint32_t calls;
+  uint32_t dropped;  // Ring pieno: record scartati
+  uint32_t maxCycles;
+  uint64_t cycles;
+};
+LogStats logStats;
+
+// Destinazioni: seriale, carta se debugPrintMode, SD se LOG_TO_SD
+void logSink(const char* text, bool eol) {
+  Serial.print(text);
+  if (eol) Serial.println();
+
   if (debugPrintMode) {
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);
-    printerSerial.print(msg);
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);
+    if (!logPaperLine) {
+      escpos::emit(printerSerial, escpos::condensed(true));
+      logPaperLine = true;
+    }
+    printerSerial.print(text);
+    if (eol) {
+      printerSerial.println();
+      escpos::emit(printerSerial, escpos::condensed(false));
+      logPaperLine = false;
+    }
   }
+
+#if LOG_TO_SD
+  logSdWrite(text, eol);
+#endif
 }
 
-void debugPrint(const String& msg) {
-  debugPrint(msg.c_str());
+// Testo di un valore numerico (buf di almeno 16 byte)
+const char* logFormat(uint8_t type, const uint8_t* data, char* buf) {
+  uint32_t v;
+  memcpy(&v, data, 4);
+  switch (type) {
+    case LR_INT: sprintf(buf, "%ld", (long)(int32_t)v); break;
+    case LR_UINT: sprintf(buf, "%lu", (unsigned long)v); break;
+    case LR_IP: sprintf(buf, "%u.%u.%u.%u", data[0], data[1], data[2], data[3]); break;
+    default: buf[0] = '\0';
+  }
+  return buf;
 }
 
-void debugPrint(int val) {
-  Serial.print(val);
-  if (debugPrintMode) {
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);
-    printerSerial.print(val);
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);
+// Accoda un record; senza ring (prima di logInit) scrive subito
+void logWrite(uint8_t tag, const void* data, size_t len) {
+  uint8_t type = tag & ~LR_EOL;
+  if (!logRing) {
+    char buf[16];
+    const char* text = type == LR_STR ? (const char*)data
+                     : type == LR_NONE ? "" : logFormat(type, (const uint8_t*)data, buf);
+    logSink(text, tag & LR_EOL);
+    return;
   }
+
+  uint32_t t0 = ESP.getCycleCount();
+  const uint8_t* p = (const uint8_t*)data;
+  size_t need = 1 + len + (type == LR_STR ? 1 : 0);
+  portENTER_CRITICAL(&logMux);
+  bool fits = logHead - logTail + need <= logRingMask + 1;
+  if (fits) {
+    logRing[logHead++ & logRingMask] = tag;
+    if (type == LR_STR) logRing[logHead++ & logRingMask] = len;
+    for (size_t i = 0; i < len; i++) logRing[logHead++ & logRingMask] = p[i];
+  }
+  portEXIT_CRITICAL(&logMux);
+  if ((tag & LR_EOL) && logTaskHandle) xTaskNotifyGive(logTaskHandle);
+  uint32_t cycles = ESP.getCycleCount() - t0;
+
+  portENTER_CRITICAL(&logMux);
+  logStats.calls++;
+  if (!fits) logStats.dropped++;
+  logStats.cycles += cycles;
+  if (cycles > logStats.maxCycles) logStats.maxCycles = cycles;
+  portEXIT_CRITICAL(&logMux);
 }
 
-void debugPrint(unsigned long val) {
-  Serial.print(val);
-  if (debugPrintMode) {
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);
-    printerSerial.print(val);
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);
+void logPut(const char* msg, uint8_t eol = 0) {
+  if (!logRing) {
+    logWrite(LR_STR | eol, msg, strlen(msg));
+  } else if (esp_ptr_in_drom(msg)) {
+    logWrite(LR_LIT | eol, &msg, sizeof(msg));  // Letterale: resta in flash
+  } else {
+    logWrite(LR_STR | eol, msg, strnlen(msg, LOG_STR_MAX));
   }
 }
 
-void debugPrint(size_t val) {
-  Serial.print((unsigned long)val);
-  if (debugPrintMode) {
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);
-    printerSerial.print((unsigned long)val);
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);
+void logPut(const String& msg, uint8_t eol = 0) {
+  logPut(msg.c_str(), eol);
+}
+
+void logPut(int val, uint8_t eol = 0) {
+  int32_t v = val;
+  logWrite(LR_INT | eol, &v, 4);
+}
+
+void logPut(unsigned long val, uint8_t eol = 0) {
+  uint32_t v = val;
+  logWrite(LR_UINT | eol, &v, 4);
+}
+
+void logPut(size_t val, uint8_t eol = 0) {
+  uint32_t v = val;
+  logWrite(LR_UINT | eol, &v, 4);
+}
+
+void logPut(IPAddress ip, uint8_t eol = 0) {
+  uint8_t v[4] = {ip[0], ip[1], ip[2], ip[3]};
+  logWrite(LR_IP | eol, v, 4);
+}
+
+template <typename T>
+void logPutLn(const T& val) {
+  logPut(val, LR_EOL);
+}
+
+void logPutLn() {
+  logWrite(LR_NONE | LR_EOL, NULL, 0);
+}
+
+// Copia len byte del ring a partire da pos
+void logRead(uint32_t pos, uint8_t* dst, size_t len) {
+  for (size_t i = 0; i < len; i++) dst[i] = logRing[(pos + i) & logRingMask];
+}
+
+// Scrive tutti i record accodati (solo LogTask: logSink e il buffer della
+// SD non hanno lock, dopo logInit li usa solo lui)
+void logDrain() {
+  static uint32_t reportedDrops = 0;
+  for (;;) {
+    portENTER_CRITICAL(&logMux);
+    uint32_t head = logHead;
+    uint32_t tail = logTail;
+    uint32_t dropped = logStats.dropped;
+    portEXIT_CRITICAL(&logMux);
+    if (tail == head) break;
+
+    uint8_t tag;
+    logRead(tail++, &tag, 1);
+    uint8_t type = tag & ~LR_EOL;
+    char text[LOG_STR_MAX + 1];
+    const char* out = "";
+    if (type == LR_LIT) {
+      logRead(tail, (uint8_t*)&out, sizeof(out));
+      tail += sizeof(out);
+    } else if (type == LR_STR) {
+      uint8_t n;
+      logRead(tail++, &n, 1);
+      logRead(tail, (uint8_t*)text, n);
+      text[n] = '\0';
+      tail += n;
+      out = text;
+    } else if (type != LR_NONE) {
+      uint8_t v[4];
+      logRead(tail, v, 4);
+      tail += 4;
+      out = logFormat(type, v, text);
+    }
+
+    // Spazio libero prima della scrittura lenta
+    portENTER_CRITICAL(&logMux);
+    logTail = tail;
+    portEXIT_CRITICAL(&logMux);
+
+    logSink(out, tag & LR_EOL);
+
+    if ((tag & LR_EOL) && dropped != reportedDrops) {
+      sprintf(text, "[LOG] %lu record persi (ring pieno)", (unsigned long)(dropped - reportedDrops));
+      reportedDrops = dropped;
+      logSink(text, true);
+    }
   }
 }
 
-void debugPrintln(const char* msg) {
-  Serial.println(msg);
-  if (debugPrintMode) {
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);
-    printerSerial.println(msg);
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);
+void logTask(void* parameter) {
+  for (;;) {
+    // Sveglia a ogni riga completa
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    // Su carta non si scrive in mezzo a un'etichetta
+    while (debugPrintMode && printBusy) vTaskDelay(100 / portTICK_PERIOD_MS);
+    logDrain();
   }
 }
 
-void debugPrintln(const String& msg) {
-  debugPrintln(msg.c_str());
+// Aspetta che il ring sia scritto (prima di un riavvio)
+void logFlush(uint32_t timeoutMs = 1000) {
+  if (!logTaskHandle) return;
+  xTaskNotifyGive(logTaskHandle);
+  unsigned long start = millis();
+  while (millis() - start < timeoutMs) {
+    portENTER_CRITICAL(&logMux);
+    bool empty = logHead == logTail;
+    portEXIT_CRITICAL(&logMux);
+    if (empty) break;
+    delay(10);
+  }
+  Serial.flush();
 }
 
-void debugPrintln(int val) {
-  Serial.println(val);
-  if (debugPrintMode) {
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);
-    printerSerial.println(val);
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);
+void logInit() {
+  uint32_t size = LOG_RING_SIZE;
+  uint8_t* ring = (uint8_t*)ps_malloc(size);
+  if (!ring) {
+    // Mai log sincroni da più task: si contenderebbero il buffer della SD
+    size = LOG_RING_SIZE_DRAM;
+    ring = (uint8_t*)malloc(size);
+    if (!ring) return;
+    debugPrintln("[LOG] PSRAM non disponibile, ring da 4 KB in RAM interna");
   }
+  logRingMask = size - 1;
+  logRing = ring;
+
+  xTaskCreatePinnedToCore(
+    logTask,            // Funzione
+    "LogTask",          // Nome
+    3072,               // Stack size
+    NULL,               // Parametri
+    0,                  // Priorità (solo quando il core è libero)
+    &logTaskHandle,     // Handle
+    0                   // Core 0
+  );
 }
 
-void debugPrintln(unsigned long val) {
-  Serial.println(val);
-  if (debugPrintMode) {
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);
-    printerSerial.println(val);
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);
+// ===== STORAGE (task unico per la SD) =====
+// La SD sta su un bus SPI condiviso e la libreria non regge accessi da più
+// task insieme: ogni operazione su SD passa da qui e gira sul task storage,
+// una alla volta. storageRun esegue un blocco sul task e aspetta la fine;
+// storageAppend accoda dati da aggiungere a un file senza aspettare, e le
+// append consecutive sullo stesso file diventano una sola scrittura.
+// Prima dell'avvio del task (e dal task stesso) i blocchi girano diretti.
+// Un blocco eseguito qui non deve prendere mutex che il chiamante tiene
+// mentre aspetta: si bloccherebbero a vicenda.
+#undef LOG_SUB
+#define LOG_SUB LOG_SUB_STORE
+enum StorageKind : uint8_t {
+  ST_CONFIG, ST_CSV, ST_INDEX, ST_HISTORY, ST_SPOOL, ST_CACHE, ST_ARCHIVE, ST_LOG, ST_KINDS
+};
+const char* const kStorageKindName[ST_KINDS] = {
+  "config", "csv", "indice", "storico", "spool", "cache", "archivio", "log"
+};
+
+#define STORAGE_QUEUE_LEN 8
+#define STORAGE_APPEND_MAX 192   // Byte di dati per richiesta di append
+#define STORAGE_BATCH_MAX 1024   // Append unite in una sola scrittura
+
+enum StorageOp : uint8_t { ST_OP_CALL, ST_OP_APPEND };
+
+struct StorageReq {
+  uint8_t op;
+  uint8_t kind;
+  uint16_t len;             // APPEND: byte in data
+  uint32_t enqUs;           // micros() all'accodamento
+  void (*fn)(void*);        // CALL: blocco da eseguire
+  void* ctx;
+  SemaphoreHandle_t done;   // CALL: rilasciato a fine blocco
+  const char* path;         // APPEND: costante, confrontata per indirizzo
+  uint8_t data[STORAGE_APPEND_MAX];
+};
+
+// Latenza per tipo: dall'accodamento alla fine dell'operazione
+struct StorageStats {
+  uint32_t ops;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+};
+
+QueueHandle_t storageQueue = NULL;
+TaskHandle_t storageTaskHandle = NULL;
+SemaphoreHandle_t storageAppendLock = NULL;  // Pezzi di una stessa append consecutivi in coda
+StorageStats storageStats[ST_KINDS];
+std::atomic<uint32_t> storageAppends{0};  // Richieste di append ricevute (da più task)
+uint32_t storageWrites = 0;    // Scritture effettive su SD
+uint32_t storageAppendErrors = 0;
+
+// Append in attesa di scrittura (solo task storage)
+const char* storageBatchPath = NULL;
+uint8_t storageBatchKind = 0;
+uint32_t storageBatchEnqUs = 0;   // Accodamento della prima append del lotto
+size_t storageBatchLen = 0;
+uint8_t storageBatch[STORAGE_BATCH_MAX];
+
+void storageRecord(uint8_t kind, uint32_t us) {
+  StorageStats& st = storageStats[kind];
+  st.ops++;
+  st.lastUs = us;
+  st.totalUs += us;
+  if (us > st.maxUs) st.maxUs = us;
+  mSdOp.record(us);
+}
+
+bool storageAppendNow(const char* path, const uint8_t* data, size_t len) {
+  File f = SD.open(path, FILE_APPEND);
+  if (!f) return false;
+  bool ok = f.write(data, len) == len;
+  f.close();
+  return ok;
+}
+
+void storageFlushBatch() {
+  if (storageBatchLen == 0) return;
+  if (!storageAppendNow(storageBatchPath, storageBatch, storageBatchLen)) {
+    storageAppendErrors++;
   }
+  storageWrites++;
+  storageRecord(storageBatchKind, micros() - storageBatchEnqUs);
+  storageBatchLen = 0;
+  storageBatchPath = NULL;
 }
 
-void debugPrintln(size_t val) {
-  Serial.println((unsigned long)val);
-  if (debugPrintMode) {
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);
-    printerSerial.println((unsigned long)val);
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);
+void storageTask(void* parameter) {
+  StorageReq req;
+  for (;;) {
+    // Con append in attesa non si dorme: appena la coda è vuota si scrive
+    if (xQueueReceive(storageQueue, &req, storageBatchLen ? 0 : portMAX_DELAY) != pdTRUE) {
+      storageFlushBatch();
+      continue;
+    }
+
+    if (req.op == ST_OP_APPEND) {
+      if (storageBatchLen > 0 &&
+          (req.path != storageBatchPath || storageBatchLen + req.len > STORAGE_BATCH_MAX)) {
+        storageFlushBatch();
+      }
+      if (storageBatchLen == 0) {
+        storageBatchPath = req.path;
+        storageBatchKind = req.kind;
+        storageBatchEnqUs = req.enqUs;
+      }
+      memcpy(storageBatch + storageBatchLen, req.data, req.len);
+      storageBatchLen += req.len;
+      continue;
+    }
+
+    // Le append accodate prima di una chiamata vanno su SD prima di lei
+    storageFlushBatch();
+    req.fn(req.ctx);
+    storageRecord(req.kind, micros() - req.enqUs);
+    xSemaphoreGive(req.done);
   }
 }
 
-void debugPrintln() {
-  Serial.println();
-  if (debugPrintMode) {
-    printerSerial.println();
+// Esegue fn(ctx) sul task storage e aspetta che finisca
+void storageCall(uint8_t kind, void (*fn)(void*), void* ctx) {
+  if (storageQueue == NULL || xTaskGetCurrentTaskHandle() == storageTaskHandle) {
+    uint32_t t0 = micros();
+    fn(ctx);
+    storageRecord(kind, micros() - t0);
+    return;
   }
+
+  StaticSemaphore_t doneBuf;
+  StorageReq req;
+  req.op = ST_OP_CALL;
+  req.kind = kind;
+  req.len = 0;
+  req.enqUs = micros();
+  req.fn = fn;
+  req.ctx = ctx;
+  req.done = xSemaphoreCreateBinaryStatic(&doneBuf);
+  req.path = NULL;
+  xQueueSend(storageQueue, &req, portMAX_DELAY);
+  xSemaphoreTake(req.done, portMAX_DELAY);
+  vSemaphoreDelete(req.done);
 }
 
-// Per IPAddress
-void debugPrintln(IPAddress ip) {
-  Serial.println(ip);
-  if (debugPrintMode) {
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);
-    printerSerial.println(ip);
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);
+// Come storageCall, con una lambda: storageRun(ST_CSV, [&] { ... });
+template <typename F>
+void storageRun(uint8_t kind, F fn) {
+  storageCall(kind, [](void* ctx) { (*static_cast<F*>(ctx))(); }, &fn);
+}
+
+// Accoda dati da aggiungere in fondo a path (stringa costante) senza
+// aspettare la scrittura. L'ordine rispetto alle altre richieste è FIFO.
+void storageAppend(uint8_t kind, const char* path, const uint8_t* data, size_t len) {
+  storageAppends++;
+  if (storageQueue == NULL || xTaskGetCurrentTaskHandle() == storageTaskHandle) {
+    if (!storageAppendNow(path, data, len)) storageAppendErrors++;
+    storageWrites++;
+    return;
+  }
+
+  StorageReq req;
+  req.op = ST_OP_APPEND;
+  req.kind = kind;
+  req.fn = NULL;
+  req.ctx = NULL;
+  req.done = NULL;
+  req.path = path;
+  // Oltre STORAGE_APPEND_MAX l'append va in più richieste: senza lock
+  // quelle di un altro task sullo stesso file finirebbero in mezzo
+  xSemaphoreTake(storageAppendLock, portMAX_DELAY);
+  while (len > 0) {
+    size_t n = min(len, (size_t)STORAGE_APPEND_MAX);
+    req.len = n;
+    req.enqUs = micros();
+    memcpy(req.data, data, n);
+    xQueueSend(storageQueue, &req, portMAX_DELAY);
+    data += n;
+    len -= n;
+  }
+  xSemaphoreGive(storageAppendLock);
+}
+
+// Lettura a blocchi da un File aperto, sul task storage
+template <typename T>
+int storageRead(uint8_t kind, T& f, uint8_t* buf, size_t len) {
+  int n = 0;
+  storageRun(kind, [&] { n = f.read(buf, len); });
+  return n;
+}
+
+// Avvia il task storage (chiamare subito dopo SD.begin)
+void storageInit() {
+  storageAppendLock = xSemaphoreCreateMutex();
+  storageQueue = xQueueCreate(STORAGE_QUEUE_LEN, sizeof(StorageReq));
+  xTaskCreatePinnedToCore(
+    storageTask,        // Funzione
+    "StorageTask",      // Nome
+    6144,               // Stack size
+    NULL,               // Parametri
+    2,                  // Priorità (sopra polling e indice: chi aspetta la SD non resta in coda)
+    &storageTaskHandle, // Handle
+    0                   // Core 0
+  );
+}
+
+#if LOG_TO_SD
+// Log su SD: righe accodate come append (LogTask), /log.txt ruota in
+// /log.old oltre LOG_SD_MAX
+#define LOG_SD_PATH "/log.txt"
+#define LOG_SD_OLD "/log.old"
+#define LOG_SD_MAX (256 * 1024)
+uint8_t logSdLine[STORAGE_APPEND_MAX];
+size_t logSdLen = 0;
+int32_t logSdBytes = -1;  // Dimensione di /log.txt (-1 = non ancora letta)
+
+void logSdFlush() {
+  if (logSdBytes < 0) {
+    storageRun(ST_LOG, [] {
+      File f = SD.open(LOG_SD_PATH, FILE_READ);
+      logSdBytes = f ? f.size() : 0;
+      if (f) f.close();
+    });
+  }
+  storageAppend(ST_LOG, LOG_SD_PATH, logSdLine, logSdLen);
+  logSdBytes += logSdLen;
+  logSdLen = 0;
+  if (logSdBytes > LOG_SD_MAX) {
+    storageRun(ST_LOG, [] {
+      SD.remove(LOG_SD_OLD);
+      SD.rename(LOG_SD_PATH, LOG_SD_OLD);
+    });
+    logSdBytes = 0;
+  }
+}
+
+void logSdWrite(const char* text, bool eol) {
+  if (!sdOK || !storageQueue) return;  // Solo a task storage avviato
+  for (; *text; text++) {
+    if (logSdLen == sizeof(logSdLine)) logSdFlush();
+    logSdLine[logSdLen++] = *text;
+  }
+  if (eol) {
+    if (logSdLen == sizeof(logSdLine)) logSdFlush();
+    logSdLine[logSdLen++] = '\n';
+    logSdFlush();
+  }
+}
+#endif
+
+// ===== FLASH INTERNA (LittleFS) =====
+// I file piccoli e letti spesso (config WiFi, journal dello storico) hanno
+// una copia nella partizione "spiffs" della flash interna, montata come
+// LittleFS: si leggono prima da lì e ogni scrittura va su entrambe le
+// copie. Senza SD, o con una SD lenta, la protezione dalle doppie stampe
+// resta attiva. CSV, indice, spool e cache etichette restano solo su SD.
+// LittleFS ha un suo lock e non passa dal task storage.
+
+// Stesso file letto dalle due copie (misurato all'avvio, in STATUS)
+struct FlashBench {
+  uint32_t bytes;
+  uint32_t flashUs;
+  uint32_t sdUs;
+};
+FlashBench flashBench = {0, 0, 0};
+
+void flashInit() {
+  flashOK = LittleFS.begin(true);  // Formatta al primo avvio
+  if (!flashOK) {
+    errorPrintln("[FAIL] Flash LittleFS");
+    return;
+  }
+  debugPrint("[OK] Flash LittleFS: ");
+  debugPrint((int)(LittleFS.usedBytes() / 1024));
+  debugPrint("/");
+  debugPrint((int)(LittleFS.totalBytes() / 1024));
+  debugPrintln(" KB");
+}
+
+// Tempo per leggere i primi 4 KB di path dalla flash e dalla SD
+void flashBenchRun(const char* path) {
+  static uint8_t buf[512];
+  auto readHead = [](File& f) {
+    uint32_t n = 0;
+    int got;
+    while (n < 4096 && (got = f.read(buf, sizeof(buf))) > 0) n += got;
+    return n;
+  };
+  if (flashOK) {
+    uint32_t t0 = micros();
+    File f = LittleFS.open(path, FILE_READ);
+    if (f) {
+      flashBench.bytes = readHead(f);
+      f.close();
+    }
+    flashBench.flashUs = micros() - t0;
+  }
+  if (sdOK) {
+    storageRun(ST_HISTORY, [&] {
+      uint32_t t0 = micros();
+      File f = SD.open(path, FILE_READ);
+      if (f) {
+        readHead(f);
+        f.close();
+      }
+      flashBench.sdUs = micros() - t0;
+    });
   }
 }
 
 // ===== OTA UPDATE =====
+#undef LOG_SUB
+#define LOG_SUB LOG_SUB_NET
+
+bool runOTAUpdate();
 
-// Esegue aggiornamento OTA da GitHub
+// Esegue aggiornamento OTA da GitHub con lo schermo in esclusiva
+// (il task display resta fermo finché la schermata OTA è visibile)
 bool performOTAUpdate() {
+  if (uiMutex) xSemaphoreTakeRecursive(uiMutex, portMAX_DELAY);
+  bool ok = runOTAUpdate();
+  if (uiMutex) xSemaphoreGiveRecursive(uiMutex);
+  if (!ok) drawScreen();  // Ripristina la UI sopra la schermata OTA
+  return ok;
+}
+
+bool runOTAUpdate() {
   debugPrintln("[OTA] Avvio aggiornamento firmware...");
   debugPrint("[OTA] URL: ");
   debugPrintln(OTA_URL);
@@ -317,6 +990,7 @@ bool performOTAUpdate() {
   http.setTimeout(30000);  // 30 secondi
 
   int httpCode = http.GET();
+  metricsHttp(httpCode);
   int contentLength = http.getSize();
 
   debugPrint("[OTA] HTTP code: ");
@@ -325,7 +999,7 @@ bool performOTAUpdate() {
   debugPrintln(contentLength);
 
   if (httpCode != HTTP_CODE_OK) {
-    debugPrintln("[OTA] Download fallito");
+    errorPrintln("[OTA] Download fallito");
     tft.setTextColor(TFT_RED, TFT_BLACK);
     tft.setCursor(10, 170);
     tft.println("Download fallito!");
@@ -375,7 +1049,7 @@ bool performOTAUpdate() {
       size_t bytesWritten = Update.write(buff, bytesRead);
 
       if (bytesWritten != bytesRead) {
-        debugPrintln("[OTA] Errore scrittura");
+        errorPrintln("[OTA] Errore scrittura");
         Update.abort();
         http.end();
         tft.setTextColor(TFT_RED, TFT_BLACK);
@@ -422,13 +1096,14 @@ bool performOTAUpdate() {
       tft.println("Riavvio in 3 secondi...");
 
       delay(3000);
+      logFlush();
       ESP.restart();
       return true;  // Non raggiunto
     }
   }
 
-  debugPrint("[OTA] Errore finale: ");
-  debugPrintln(Update.getError());
+  errorPrint("[OTA] Errore finale: ");
+  errorPrintln(Update.getError());
   tft.setTextColor(TFT_RED, TFT_BLACK);
   tft.setCursor(10, 170);
   tft.println("Errore aggiornamento!");
@@ -438,21 +1113,10 @@ bool performOTAUpdate() {
 
 // ===== WIFI CONFIG MANAGEMENT =====
 
-// Carica reti WiFi da SD
-void loadWifiConfig() {
-  numSavedNetworks = 0;
-
-  if (!sdOK) {
-    debugPrintln("[WIFI] SD non disponibile, uso default");
-    return;
-  }
-
-  File f = SD.open("/wifi_config.txt", FILE_READ);
-  if (!f) {
-    debugPrintln("[WIFI] Config non trovata, uso default");
-    return;
-  }
+#define WIFI_CONFIG_PATH "/wifi_config.txt"
 
+// Legge le reti "ssid|password" da un file aperto
+void wifiConfigParse(File& f) {
   while (f.available() && numSavedNetworks < MAX_WIFI_NETWORKS) {
     String line = f.readStringUntil('\n');
     line.trim();
@@ -472,29 +1136,73 @@ void loadWifiConfig() {
       numSavedNetworks++;
     }
   }
+}
+
+bool wifiConfigWrite(fs::FS& fs) {
+  File f = fs.open(WIFI_CONFIG_PATH, FILE_WRITE);
+  if (!f) return false;
+  for (int i = 0; i < numSavedNetworks; i++) {
+    f.print(savedNetworks[i].ssid);
+    f.print("|");
+    f.println(savedNetworks[i].pass);
+  }
   f.close();
+  return true;
+}
+
+// Carica reti WiFi: prima dalla flash interna, poi da SD
+void loadWifiConfig() {
+  numSavedNetworks = 0;
+
+  if (!sdOK && !flashOK) {
+    debugPrintln("[WIFI] SD e flash non disponibili, uso default");
+    return;
+  }
+
+  bool found = false;
+  if (flashOK) {
+    File f = LittleFS.open(WIFI_CONFIG_PATH, FILE_READ);
+    if (f) {
+      found = true;
+      wifiConfigParse(f);
+      f.close();
+    }
+  }
+  if (!found && sdOK) {
+    storageRun(ST_CONFIG, [&] {
+      File f = SD.open(WIFI_CONFIG_PATH, FILE_READ);
+      if (!f) return;
+      found = true;
+      wifiConfigParse(f);
+      f.close();
+    });
+    // Flash appena formattata: copia della config su SD
+    if (found && flashOK) wifiConfigWrite(LittleFS);
+  }
+  if (!found) {
+    debugPrintln("[WIFI] Config non trovata, uso default");
+    return;
+  }
 
   debugPrint("[WIFI] Caricate ");
   debugPrint(numSavedNetworks);
   debugPrintln(" reti");
 }
 
-// Salva reti WiFi su SD
+// Salva reti WiFi su flash e SD
 void saveWifiConfig() {
-  if (!sdOK) return;
+  if (!sdOK && !flashOK) return;
 
-  File f = SD.open("/wifi_config.txt", FILE_WRITE);
-  if (!f) {
-    debugPrintln("[WIFI] Errore scrittura config");
-    return;
+  bool ok = flashOK && wifiConfigWrite(LittleFS);
+  if (sdOK) {
+    bool sdWritten = false;
+    storageRun(ST_CONFIG, [&] { sdWritten = wifiConfigWrite(SD); });
+    ok = ok || sdWritten;
   }
-
-  for (int i = 0; i < numSavedNetworks; i++) {
-    f.print(savedNetworks[i].ssid);
-    f.print("|");
-    f.println(savedNetworks[i].pass);
+  if (!ok) {
+    errorPrintln("[WIFI] Errore scrittura config");
+    return;
   }
-  f.close();
 
   debugPrintln("[WIFI] Config salvata");
 }
@@ -569,7 +1277,7 @@ bool tryConnectToNetwork(int index) {
     return true;
   }
 
-  debugPrintln("\n[WIFI] Fallito");
+  errorPrintln("\n[WIFI] Fallito");
   return false;
 }
 
@@ -789,6 +1497,7 @@ void handleSave() {
 
   // Riavvia dopo 2 secondi
   delay(2000);
+  logFlush();
   ESP.restart();
 }
 
@@ -862,6 +1571,8 @@ void startConfigMode() {
 }
 
 // ===== PARSING CSV =====
+#undef LOG_SUB
+#define LOG_SUB LOG_SUB_CSV
 String getCSVField(const String& line, int fieldIndex) {
   int start = 0;
   int fieldCount = 0;
@@ -894,12 +1605,12 @@ void parseAttrezziJSON(String json, Scheda& s) {
 
   // Debug (soppresso durante parsing massivo CSV)
   if (!suppressJsonLogs) {
-    debugPrint("[JSON] Input: ");
-    debugPrintln(json.substring(0, min((int)json.length(), 80)));
+    tracePrint("[JSON] Input: ");
+    tracePrintln(json.substring(0, min((int)json.length(), 80)));
   }
 
   if (json.length() < 3) {
-    if (!suppressJsonLogs) debugPrintln("[JSON] Troppo corto");
+    if (!suppressJsonLogs) tracePrintln("[JSON] Troppo corto");
     return;
   }
 
@@ -913,7 +1624,7 @@ void parseAttrezziJSON(String json, Scheda& s) {
 
   if (!json.startsWith("[")) {
     // Non è un JSON array, tratta come testo semplice
-    if (!suppressJsonLogs) debugPrintln("[JSON] Non e' un array, uso come testo");
+    if (!suppressJsonLogs) tracePrintln("[JSON] Non e' un array, uso come testo");
     strncpy(s.attrezzi[0].marca, json.c_str(), sizeof(s.attrezzi[0].marca) - 1);
     s.attrezzi[0].dotazione[0] = '\0';
     s.attrezzi[0].note[0] = '\0';
@@ -927,8 +1638,8 @@ void parseAttrezziJSON(String json, Scheda& s) {
 
   if (error) {
     if (!suppressJsonLogs) {
-      debugPrint("[JSON] Parse error: ");
-      debugPrintln(error.c_str());
+      errorPrint("[JSON] Parse error: ");
+      errorPrintln(error.c_str());
     }
     // Fallback: mostra raw
     strncpy(s.attrezzi[0].marca, json.c_str(), sizeof(s.attrezzi[0].marca) - 1);
@@ -938,9 +1649,9 @@ void parseAttrezziJSON(String json, Scheda& s) {
 
   JsonArray arr = doc.as<JsonArray>();
   if (!suppressJsonLogs) {
-    debugPrint("[JSON] Trovati ");
-    debugPrint((int)arr.size());
-    debugPrintln(" attrezzi");
+    tracePrint("[JSON] Trovati ");
+    tracePrint((int)arr.size());
+    tracePrintln(" attrezzi");
   }
 
   for (JsonObject obj : arr) {
@@ -956,18 +1667,141 @@ void parseAttrezziJSON(String json, Scheda& s) {
     strncpy(a.note, note, sizeof(a.note) - 1);
 
     if (!suppressJsonLogs) {
-      debugPrint("[JSON] Attrezzo ");
-      debugPrint(s.numAttrezzi);
-      debugPrint(": ");
-      debugPrintln(a.marca);
+      tracePrint("[JSON] Attrezzo ");
+      tracePrint(s.numAttrezzi);
+      tracePrint(": ");
+      tracePrintln(a.marca);
     }
 
     s.numAttrezzi++;
   }
 }
 
+// Riempie una Scheda da una riga CSV
+void parseSchedaLine(const String& line, Scheda& s) {
+  memset(&s, 0, sizeof(Scheda));
+
+  // Campi CSV: Numero,Data consegna,Cliente,Indirizzo,Telefono,DDT,Attrezzi(JSON),Completato,Data completamento
+  //            0      1             2       3         4        5   6              7          8
+  strncpy(s.numero, getCSVField(line, 0).c_str(), sizeof(s.numero) - 1);
+  strncpy(s.data, getCSVField(line, 1).c_str(), sizeof(s.data) - 1);
+  strncpy(s.cliente, getCSVField(line, 2).c_str(), sizeof(s.cliente) - 1);
+  strncpy(s.indirizzo, getCSVField(line, 3).c_str(), sizeof(s.indirizzo) - 1);
+  strncpy(s.telefono, getCSVField(line, 4).c_str(), sizeof(s.telefono) - 1);
+
+  // Campo 5 = DDT (boolean)
+  String ddtField = getCSVField(line, 5);
+  s.ddt = (ddtField.equalsIgnoreCase("true") || ddtField == "1");
+
+  // Campo 6 = Attrezzi (JSON array)
+  String attrezziJson = getCSVField(line, 6);
+  parseAttrezziJSON(attrezziJson, s);
+
+  // Campo 7 = Completato
+  String comp = getCSVField(line, 7);
+  s.completato = (comp.equalsIgnoreCase("true") || comp == "1");
+}
+
+// ===== SNAPSHOT SCHEDE =====
+// parseCSV gira su pollTask (core 0), la lista la leggono loop e UI (core 1).
+// Il parse riempie un buffer libero e lo pubblica scambiando un puntatore
+// atomico: chi legge prende un riferimento (SchedeRef) e vede sempre una
+// lista intera, anche se nel frattempo ne arriva una nuova. Un buffer torna
+// riutilizzabile quando l'ultimo lettore lo rilascia.
+struct SchedeSnapshot {
+  Scheda* items;
+  int count;
+  uint32_t gen;
+  std::atomic<int> refs;  // Lettori, +1 finché pubblicato o in scrittura
+};
+
+#define SCHEDE_BUFFERS 2
+SchedeSnapshot schedeBuffers[SCHEDE_BUFFERS];
+SchedeSnapshot schedeEmpty;  // Lista vuota fino al primo parse (mai liberata)
+std::atomic<SchedeSnapshot*> schedePublished(&schedeEmpty);
+uint32_t schedeClaimWaits = 0;  // Parse in attesa di un buffer libero
+
+void schedeInit() {
+  schedeEmpty.refs = 1;
+  size_t bytes = sizeof(Scheda) * MAX_SCHEDE * SCHEDE_BUFFERS;
+  Scheda* p = (Scheda*)ps_malloc(bytes);
+  if (!p) p = (Scheda*)malloc(bytes);
+  if (!p) {
+    debugPrintln("[CSV] Memoria insufficiente per la lista schede");
+    return;
+  }
+  for (int b = 0; b < SCHEDE_BUFFERS; b++) {
+    schedeBuffers[b].items = p + b * MAX_SCHEDE;
+    schedeBuffers[b].count = 0;
+    schedeBuffers[b].refs = 0;
+  }
+}
+
+// Riferimento alla lista pubblicata. Se tra la lettura del puntatore e
+// l'incremento è stata pubblicata una lista nuova, il buffer letto potrebbe
+// essere già in riscrittura: si rilascia e si riprova
+SchedeSnapshot* schedeAcquire() {
+  while (true) {
+    SchedeSnapshot* s = schedePublished.load(std::memory_order_acquire);
+    s->refs.fetch_add(1, std::memory_order_acquire);
+    if (s == schedePublished.load(std::memory_order_acquire)) return s;
+    s->refs.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+void schedeRelease(SchedeSnapshot* s) {
+  s->refs.fetch_sub(1, std::memory_order_release);
+}
+
+// Buffer libero (nessun lettore, non pubblicato) per il prossimo parse.
+// I lettori tengono il riferimento per pochi ms: si attende un tick e si
+// riprova. NULL se i buffer non sono stati allocati
+SchedeSnapshot* schedeClaim() {
+  while (true) {
+    bool any = false;
+    for (int b = 0; b < SCHEDE_BUFFERS; b++) {
+      SchedeSnapshot* s = &schedeBuffers[b];
+      if (!s->items) continue;
+      any = true;
+      int expected = 0;
+      if (s->refs.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+        return s;
+      }
+    }
+    if (!any) return NULL;
+    schedeClaimWaits++;
+    vTaskDelay(1);
+  }
+}
+
+// Pubblica il buffer riempito; il riferimento del parse passa alla lista
+// pubblicata e quello della lista precedente si rilascia
+void schedePublish(SchedeSnapshot* s) {
+  s->gen = schedePublished.load(std::memory_order_relaxed)->gen + 1;
+  SchedeSnapshot* old = schedePublished.exchange(s, std::memory_order_acq_rel);
+  if (old != &schedeEmpty) schedeRelease(old);
+}
+
+// Vista in sola lettura della lista corrente, valida finché l'oggetto vive.
+// Tenerla solo per il tempo della scansione, non durante attese lunghe
+struct SchedeRef {
+  SchedeSnapshot* snap;
+  SchedeRef() : snap(schedeAcquire()) {}
+  ~SchedeRef() { schedeRelease(snap); }
+  SchedeRef(const SchedeRef&) = delete;
+  SchedeRef& operator=(const SchedeRef&) = delete;
+
+  int count() const { return snap->count; }
+  uint32_t gen() const { return snap->gen; }
+  const Scheda& operator[](int i) const { return snap->items[i]; }
+};
+
 void parseCSV(const String& csv) {
-  numSchede = 0;
+  SchedeSnapshot* snap = schedeClaim();
+  if (!snap) return;
+  uint32_t parseStartUs = micros();
+  Scheda* schede = snap->items;
+  int numSchede = 0;
   int lineStart = 0;
   bool firstLine = true;
 
@@ -1004,29 +1838,7 @@ void parseCSV(const String& csv) {
         }
 
         if (line.length() > 0) {
-          Scheda& s = schede[numSchede];
-          memset(&s, 0, sizeof(Scheda));
-
-          // Campi CSV: Numero,Data consegna,Cliente,Indirizzo,Telefono,DDT,Attrezzi(JSON),Completato,Data completamento
-          //            0      1             2       3         4        5   6              7          8
-          strncpy(s.numero, getCSVField(line, 0).c_str(), sizeof(s.numero) - 1);
-          strncpy(s.data, getCSVField(line, 1).c_str(), sizeof(s.data) - 1);
-          strncpy(s.cliente, getCSVField(line, 2).c_str(), sizeof(s.cliente) - 1);
-          strncpy(s.indirizzo, getCSVField(line, 3).c_str(), sizeof(s.indirizzo) - 1);
-          strncpy(s.telefono, getCSVField(line, 4).c_str(), sizeof(s.telefono) - 1);
-
-          // Campo 5 = DDT (boolean)
-          String ddtField = getCSVField(line, 5);
-          s.ddt = (ddtField.equalsIgnoreCase("true") || ddtField == "1");
-
-          // Campo 6 = Attrezzi (JSON array)
-          String attrezziJson = getCSVField(line, 6);
-          parseAttrezziJSON(attrezziJson, s);
-
-          // Campo 7 = Completato
-          String comp = getCSVField(line, 7);
-          s.completato = (comp.equalsIgnoreCase("true") || comp == "1");
-
+          parseSchedaLine(line, schede[numSchede]);
           numSchede++;
         }
       }
@@ -1062,14 +1874,41 @@ void parseCSV(const String& csv) {
   // Riattiva log JSON
   suppressJsonLogs = false;
 
+  snap->count = numSchede;
+  schedePublish(snap);
+  mCsvParse.record(micros() - parseStartUs);
+
   debugPrint("[CSV] Parsed ");
   debugPrint(numSchede);
   debugPrintln(" schede (ordinate per anno/prog decrescente)");
+
+  // Pre-renderizza le etichette delle schede in lista
+  labelCacheRefresh();
+
+  // Il CSV su SD è cambiato: indice di tutte le schede da rifare
+  jobDirRequestRebuild();
+}
+
+// ===== NUMERO SCHEDA =====
+
+// "26/0021" -> 260021 (anno * 10000 + progressivo), -1 se non valido
+int packNumero(const char* numero) {
+  int anno = 0, prog = 0;
+  char extra;
+  if (sscanf(numero, "%d/%d%c", &anno, &prog, &extra) != 2) return -1;
+  if (anno < 0 || anno > 99 || prog < 0 || prog > 9999) return -1;
+  return anno * 10000 + prog;
+}
+
+// 260021 -> "26/0021"
+void unpackNumero(int id, char* out, size_t cap) {
+  snprintf(out, cap, "%02d/%04d", id / 10000, id % 10000);
 }
 
 // Verifica se una scheda esiste nella lista corrente
 bool isSchedaInList(const char* numero) {
-  for (int i = 0; i < numSchede; i++) {
+  SchedeRef schede;
+  for (int i = 0; i < schede.count(); i++) {
     if (strcmp(schede[i].numero, numero) == 0) {
       return true;
     }
@@ -1077,1517 +1916,5285 @@ bool isSchedaInList(const char* numero) {
   return false;
 }
 
-// ===== PRINT HISTORY =====
+// ===== ARCHIVIO CSV SU SD =====
+
+// Con CSV_COMPRESSED=1 il CSV scaricato va su SD come /riparazioni.csz:
+// blocchi da lzss::kBlock byte compressi uno per uno, con la tabella degli
+// offset in testa. Chi legge vede sempre il CSV in chiaro (CsvSource): un
+// seek decomprime solo il blocco che contiene l'offset, e gli offset di
+// indice e archivio restano quelli del CSV in chiaro.
+#ifndef CSV_COMPRESSED
+#define CSV_COMPRESSED 0
+#endif
+#define CSV_PATH "/riparazioni.csv"
+#define CSV_Z_PATH "/riparazioni.csz"
+#define CSV_Z_MAGIC 0x5A534352  // "RCSZ"
+#define CSV_Z_VERSION 1
+
+struct CsvZHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t blockSize;
+  uint32_t rawSize;  // Byte del CSV in chiaro
+  uint32_t blocks;
+  // Segue la tabella: blocks + 1 offset dall'inizio del file. Un blocco
+  // lungo quanto il suo contenuto in chiaro è salvato non compresso
+};
 
-// Carica history da SD
-void loadPrintHistory() {
-  historyCount = 0;
-  if (!sdOK) return;
+// Ultimo salvataggio e ultima lettura completa (STATUS)
+struct CsvStoreStats {
+  uint32_t rawBytes;
+  uint32_t storedBytes;
+  uint32_t saveMs;
+  uint32_t loadMs;
+};
+CsvStoreStats csvStoreStats = {0, 0, 0, 0};
+
+// Il CSV in chiaro, da /riparazioni.csv o da /riparazioni.csz: per i parser
+// si comporta come un File. Tocca la SD: i metodi vanno chiamati dentro
+// storageRun
+struct CsvSource {
+  File f;
+  bool z = false;
+  CsvZHeader h;
+  uint32_t* table = NULL;
+  uint8_t* block = NULL;  // Blocco decompresso
+  int32_t blockIdx = -1;
+  uint32_t blockLen = 0;
+  uint32_t pos = 0;       // Posizione nel CSV in chiaro
+
+  bool open() {
+#if CSV_COMPRESSED
+    f = SD.open(CSV_Z_PATH, FILE_READ);
+    if (f) {
+      if (f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == CSV_Z_MAGIC &&
+          h.version == CSV_Z_VERSION && h.blockSize == lzss::kBlock) {
+        size_t tableBytes = (h.blocks + 1) * sizeof(uint32_t);
+        table = (uint32_t*)malloc(tableBytes);
+        block = (uint8_t*)malloc(lzss::kBlock);
+        if (table && block && f.read((uint8_t*)table, tableBytes) == tableBytes) {
+          z = true;
+          pos = 0;
+          blockIdx = -1;
+          return true;
+        }
+      }
+      close();
+    }
+#endif
+    // Non compresso (o scritto da una versione senza CSV_COMPRESSED)
+    f = SD.open(CSV_PATH, FILE_READ);
+    return (bool)f;
+  }
+
+  void close() {
+    if (f) f.close();
+    free(table);
+    free(block);
+    table = NULL;
+    block = NULL;
+    z = false;
+  }
+
+  explicit operator bool() const { return (bool)f; }
+  uint32_t size() { return z ? h.rawSize : f.size(); }
+  uint32_t position() { return z ? pos : f.position(); }
+  int available() { return z ? h.rawSize - pos : f.available(); }
+
+  bool seek(uint32_t p) {
+    if (!z) return f.seek(p);
+    if (p > h.rawSize) return false;
+    pos = p;
+    return true;
+  }
 
-  File f = SD.open("/print_history.txt", FILE_READ);
-  if (!f) {
-    debugPrintln("[HISTORY] File non trovato, creo nuovo");
-    return;
+  // Decomprime il blocco idx in block
+  bool loadBlock(uint32_t idx) {
+    if ((int32_t)idx == blockIdx) return true;
+    blockIdx = -1;
+    uint32_t stored = table[idx + 1] - table[idx];
+    uint32_t raw = min((uint32_t)lzss::kBlock, (uint32_t)(h.rawSize - idx * lzss::kBlock));
+    if (!f.seek(table[idx])) return false;
+    if (stored == raw) {
+      if (f.read(block, raw) != raw) return false;
+    } else {
+      uint8_t in[256];
+      int inLen = 0, inPos = 0;
+      auto next = [&]() -> int {
+        if (inPos == inLen) {
+          if (stored == 0) return -1;
+          inLen = f.read(in, min((uint32_t)sizeof(in), stored));
+          if (inLen <= 0) return -1;
+          stored -= inLen;
+          inPos = 0;
+        }
+        return in[inPos++];
+      };
+      if (lzss::decompress(next, block, raw) != raw) return false;
+    }
+    blockIdx = idx;
+    blockLen = raw;
+    return true;
   }
 
-  while (f.available() && historyCount < MAX_HISTORY) {
-    String line = f.readStringUntil('\n');
-    line.trim();
-    if (line.length() > 0 && line.length() < 12) {
-      strncpy(printHistory[historyCount], line.c_str(), 11);
-      printHistory[historyCount][11] = '\0';
-      historyCount++;
+  int read(uint8_t* buf, size_t len) {
+    if (!z) return f.read(buf, len);
+    size_t n = 0;
+    while (n < len && pos < h.rawSize) {
+      if (!loadBlock(pos / lzss::kBlock)) break;
+      uint32_t off = pos % lzss::kBlock;
+      size_t chunk = min(len - n, (size_t)(blockLen - off));
+      memcpy(buf + n, block + off, chunk);
+      n += chunk;
+      pos += chunk;
+    }
+    return n;
+  }
+
+  String readStringUntil(char end) {
+    if (!z) return f.readStringUntil(end);
+    String s;
+    while (pos < h.rawSize && loadBlock(pos / lzss::kBlock)) {
+      uint32_t off = pos % lzss::kBlock;
+      const uint8_t* p = block + off;
+      const uint8_t* stop = (const uint8_t*)memchr(p, end, blockLen - off);
+      size_t chunk = stop ? stop - p : blockLen - off;
+      s.concat((const char*)p, chunk);
+      pos += chunk;
+      if (stop) {
+        pos++;  // Salta il terminatore
+        break;
+      }
     }
+    return s;
   }
-  f.close();
 
-  debugPrint("[HISTORY] Caricate ");
-  debugPrint(historyCount);
-  debugPrintln(" schede gia' stampate");
-}
+  String readString() {
+    if (!z) return f.readString();
+    String s;
+    s.reserve(h.rawSize - pos);
+    while (pos < h.rawSize && loadBlock(pos / lzss::kBlock)) {
+      uint32_t off = pos % lzss::kBlock;
+      s.concat((const char*)block + off, blockLen - off);
+      pos += blockLen - off;
+    }
+    return s;
+  }
+};
 
-// Salva history su SD
-void savePrintHistory() {
-  if (!sdOK) return;
+// Salva il CSV scaricato (compresso se CSV_COMPRESSED) e toglie la copia
+// nell'altro formato, che sarebbe vecchia
+bool csvSave(const String& data) {
+  uint32_t t0 = millis();
+  uint32_t stored = 0;
+  bool ok = false;
+#if CSV_COMPRESSED
+  // Compressione fuori dal task storage: su SD vanno solo i blocchi pronti
+  lzss::Workspace* w = (lzss::Workspace*)malloc(sizeof(lzss::Workspace));
+  uint8_t* out = (uint8_t*)malloc(lzss::kMaxOut);
+  CsvZHeader h = {CSV_Z_MAGIC, CSV_Z_VERSION, lzss::kBlock, data.length(),
+                  (uint32_t)((data.length() + lzss::kBlock - 1) / lzss::kBlock)};
+  size_t tableBytes = (h.blocks + 1) * sizeof(uint32_t);
+  uint32_t* table = (uint32_t*)malloc(tableBytes);
+  File f;
+  if (w && out && table) {
+    storageRun(ST_CSV, [&] {
+      f = SD.open(CSV_Z_PATH, FILE_WRITE);
+      // Header e tabella definitivi alla fine
+      ok = f && f.seek(sizeof(h) + tableBytes);
+    });
+  }
+  const uint8_t* raw = (const uint8_t*)data.c_str();
+  uint32_t offset = sizeof(h) + tableBytes;
+  for (uint32_t i = 0; ok && i < h.blocks; i++) {
+    size_t n = min((size_t)lzss::kBlock, (size_t)(h.rawSize - i * lzss::kBlock));
+    size_t zn = lzss::compress(raw + i * lzss::kBlock, n, out, *w);
+    const uint8_t* src = out;
+    if (zn >= n) {  // Incomprimibile: blocco in chiaro
+      src = raw + i * lzss::kBlock;
+      zn = n;
+    }
+    table[i] = offset;
+    offset += zn;
+    storageRun(ST_CSV, [&] { ok = f.write(src, zn) == zn; });
+  }
+  if (table) table[h.blocks] = offset;
+  storageRun(ST_CSV, [&] {
+    if (ok) {
+      ok = f.seek(0) && f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h) &&
+           f.write((const uint8_t*)table, tableBytes) == tableBytes;
+    }
+    if (f) f.close();
+    if (ok) SD.remove(CSV_PATH);
+  });
+  stored = offset;
+  free(w);
+  free(out);
+  free(table);
+#else
+  storageRun(ST_CSV, [&] {
+    File f = SD.open(CSV_PATH, FILE_WRITE);
+    if (!f) return;
+    ok = f.print(data) == data.length();
+    f.close();
+    if (SD.exists(CSV_Z_PATH)) SD.remove(CSV_Z_PATH);
+  });
+  stored = data.length();
+#endif
+  if (!ok) {
+    errorPrintln("[CSV] Errore salvataggio su SD");
+    return false;
+  }
+  csvStoreStats.rawBytes = data.length();
+  csvStoreStats.storedBytes = stored;
+  csvStoreStats.saveMs = millis() - t0;
+  return true;
+}
 
-  File f = SD.open("/print_history.txt", FILE_WRITE);
-  if (!f) {
-    debugPrintln("[HISTORY] Errore scrittura");
-    return;
+// Scansione sequenziale di /riparazioni.csv: ogni ricerca riparte da dove si
+// era fermata la precedente, quindi numeri crescenti costano un solo passaggio
+struct CsvCursor {
+  CsvSource f;
+  size_t dataStart = 0;  // Primo byte dopo l'header
+  int linesRead = 0;
+
+  bool open() {
+    if (!sdOK) return false;
+    bool ok = false;
+    storageRun(ST_CSV, [&] {
+      if (!f.open()) return;
+      f.readStringUntil('\n');  // Salta header
+      dataStart = f.position();
+      ok = true;
+    });
+    return ok;
+  }
+
+  // Cerca una scheda per numero, al più un giro completo del file
+  bool find(const char* numero, Scheda& out) {
+    bool found = false;
+    storageRun(ST_CSV, [&] { found = scan(numero, out); });
+    return found;
   }
 
-  for (int i = 0; i < historyCount; i++) {
-    f.println(printHistory[i]);
+  void close() {
+    storageRun(ST_CSV, [&] { f.close(); });
   }
-  f.close();
 
-  debugPrint("[HISTORY] Salvate ");
-  debugPrint(historyCount);
-  debugPrintln(" schede");
-}
+private:
+  bool scan(const char* numero, Scheda& out) {
+    size_t start = f.position();
+    bool wrapped = false;
+    for (;;) {
+      if (!f.available()) {
+        if (wrapped) return false;
+        f.seek(dataStart);
+        wrapped = true;
+      }
+      if (wrapped && f.position() >= start) return false;
 
-// Verifica se scheda è già stampata
-bool isAlreadyPrinted(const char* numero) {
-  for (int i = 0; i < historyCount; i++) {
-    if (strcmp(printHistory[i], numero) == 0) {
-      return true;
+      String line = f.readStringUntil('\n');
+      line.trim();
+      linesRead++;
+      if (line.length() == 0) continue;
+
+      // Confronta il primo campo prima di fare il parsing completo
+      if (getCSVField(line, 0).equals(numero)) {
+        parseSchedaLine(line, out);
+        return true;
+      }
     }
   }
-  return false;
+};
+
+// CSV intero da SD (avvio senza rete)
+bool loadCsvFromSd(String& out) {
+  bool ok = false;
+  uint32_t t0 = millis();
+  storageRun(ST_CSV, [&] {
+    CsvSource f;
+    if (!f.open()) return;
+    out = f.readString();
+    f.close();
+    ok = true;
+  });
+  if (ok) csvStoreStats.loadMs = millis() - t0;
+  return ok;
 }
 
-// Aggiunge scheda a history
-void addToHistory(const char* numero) {
-  if (historyCount >= MAX_HISTORY) {
-    // Rimuovi la più vecchia (shift array)
-    for (int i = 0; i < MAX_HISTORY - 1; i++) {
-      strcpy(printHistory[i], printHistory[i + 1]);
-    }
-    historyCount = MAX_HISTORY - 1;
-  }
-  strncpy(printHistory[historyCount], numero, 11);
-  printHistory[historyCount][11] = '\0';
-  historyCount++;
+// ===== ARCHIVIO PER ANNO (SD) =====
+// /archive/AA.bin: un file per anno della numerazione AA/NNNN, con record a
+// dimensione fissa. Il record di AA/NNNN sta a un offset che dipende solo
+// da NNNN, quindi una ricerca è un seek e una lettura, senza rileggere il
+// CSV come testo né fare il parsing del JSON. In testa al file c'è il CRC
+// della riga CSV di ogni slot: alla sincronizzazione si riscrivono solo le
+// schede cambiate, di norma solo nel file dell'anno in corso.
+// Non compresso, a differenza del CSV (CSV_COMPRESSED): in blocchi LZSS un
+// anno starebbe in circa un quinto, ma una ricerca leggerebbe e
+// decomprimerebbe un blocco da 4 KB invece di un record da 756 byte, e una
+// scheda cambiata riscriverebbe il blocco invece dello slot. Un anno pieno
+// sono 7,6 MB: sulla SD lo spazio non manca, i tempi di accesso sì.
+#define ARCHIVE_DIR "/archive"
+#define ARCHIVE_MAGIC 0x43524152  // "RARC"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_SLOTS 10000       // NNNN
+
+struct ArchiveHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recSize;
+  uint32_t year;
+  uint32_t slots;
+};
+
+struct ArchiveRecord {
+  uint32_t crc;  // CRC32 di s (0 = slot vuoto)
+  Scheda s;
+};
+
+#define ARCHIVE_SUMS_OFFSET sizeof(ArchiveHeader)
+#define ARCHIVE_DATA_OFFSET (sizeof(ArchiveHeader) + ARCHIVE_SLOTS * sizeof(uint32_t))
+
+// Partizione aperta in scrittura: una per volta, tenuta aperta finché le
+// righe restano dello stesso anno
+struct ArchivePart {
+  const char* dir;
+  int year;            // -1 = nessuna
+  File f;
+  uint32_t* sums;      // CRC delle righe CSV per slot (PSRAM, 40 KB)
+  ArchiveRecord* rec;  // Record in scrittura
+  bool dirty;          // sums da riportare su SD
+};
+
+ArchivePart archiveSync = {ARCHIVE_DIR, -1, File(), NULL, NULL, false};  // Solo task indice
+uint32_t archiveWritten = 0;   // Record scritti dall'avvio
+uint32_t archiveSkipped = 0;   // Righe invariate
+uint32_t archivePruned = 0;    // Slot svuotati: righe sparite dal CSV
+uint32_t archiveLookups = 0;
+uint32_t archiveLookupUs = 0;  // Ultima ricerca
+uint32_t archiveLookupMaxUs = 0;
+
+void archivePath(char* out, size_t cap, const char* dir, int year) {
+  snprintf(out, cap, "%s/%02d.bin", dir, year);
 }
 
-// Segna tutte le schede correnti come stampate (all'avvio)
-// SOVRASCRIVE la history con solo le schede attuali nel CSV
-void markAllAsPrinted() {
-  historyCount = 0;  // Reset history
-  for (int i = 0; i < numSchede; i++) {
-    addToHistory(schede[i].numero);
-  }
-  savePrintHistory();
-  debugPrint("[HISTORY] Reset history con ");
-  debugPrint(historyCount);
-  debugPrintln(" schede dal CSV");
+uint32_t archiveRecordOffset(int prog) {
+  return ARCHIVE_DATA_OFFSET + prog * sizeof(ArchiveRecord);
 }
 
-// ===== POLLING & AUTO-PRINT =====
+// Chiude la partizione aperta, salvando i CRC delle righe se cambiati
+void archiveClose(ArchivePart& p) {
+  if (p.year < 0) return;
+  storageRun(ST_ARCHIVE, [&] {
+    if (p.dirty && p.f.seek(ARCHIVE_SUMS_OFFSET)) {
+      p.f.write((const uint8_t*)p.sums, ARCHIVE_SLOTS * sizeof(uint32_t));
+    }
+    p.f.close();
+  });
+  p.year = -1;
+  p.dirty = false;
+}
 
-// Polling ottimizzato: singola chiamata che verifica timestamp E ritorna scheda
-// Ritorna: 0 = nessuna novità, 1 = stampata nuova scheda, -1 = errore
-int pollAndPrint() {
-  if (WiFi.status() != WL_CONNECTED) {
-    debugPrintln("[POLL] WiFi non connesso");
-    wifiError = true;
-    showWifiStatus = true;
-    return -1;
-  }
+// Apre (o crea vuota) la partizione di un anno e ne carica i CRC
+bool archiveOpen(ArchivePart& p, int year) {
+  if (p.year == year) return true;
+  archiveClose(p);
+  if (!p.sums) p.sums = (uint32_t*)ps_malloc(ARCHIVE_SLOTS * sizeof(uint32_t));
+  if (!p.rec) p.rec = (ArchiveRecord*)ps_malloc(sizeof(ArchiveRecord));
+  if (!p.sums || !p.rec) return false;
+
+  char path[32];
+  archivePath(path, sizeof(path), p.dir, year);
+  const size_t sumsBytes = ARCHIVE_SLOTS * sizeof(uint32_t);
+  bool ok = false;
+  storageRun(ST_ARCHIVE, [&] {
+    if (!SD.exists(p.dir)) SD.mkdir(p.dir);
+    p.f = SD.open(path, "r+");
+    ArchiveHeader h;
+    if (p.f && p.f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == ARCHIVE_MAGIC &&
+        h.version == ARCHIVE_VERSION && h.recSize == sizeof(ArchiveRecord) &&
+        h.year == (uint32_t)year && h.slots == ARCHIVE_SLOTS &&
+        p.f.read((uint8_t*)p.sums, sumsBytes) == sumsBytes) {
+      ok = true;
+      return;
+    }
+    // Nuova o illeggibile: si riparte da una partizione vuota
+    if (p.f) p.f.close();
+    p.f = SD.open(path, "w+");
+    if (!p.f) return;
+    h = {ARCHIVE_MAGIC, ARCHIVE_VERSION, sizeof(ArchiveRecord), (uint32_t)year, ARCHIVE_SLOTS};
+    memset(p.sums, 0, sumsBytes);
+    ok = p.f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h) &&
+         p.f.write((const uint8_t*)p.sums, sumsBytes) == sumsBytes;
+    if (!ok) p.f.close();
+  });
+  if (!ok) return false;
+  p.year = year;
+  p.dirty = false;
+  return true;
+}
 
-  HTTPClient http;
-  String url = String(API_URL) + "?action=pollPrinter&ts=" + String(lastKnownTimestamp);
-  http.begin(url);
-  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-  http.setTimeout(8000);  // 8 secondi (ridotto per velocità)
+// Riga CSV della scheda id con CRC lineSum: il record si riscrive solo se
+// la riga è cambiata. load(Scheda&) la costruisce, solo quando serve
+template <typename F>
+bool archivePut(ArchivePart& p, int id, uint32_t lineSum, F load) {
+  if (id < 0 || !archiveOpen(p, id / 10000)) return false;
+  int prog = id % 10000;
+  lineSum |= 1;  // 0 = slot vuoto
+  if (p.sums[prog] == lineSum) {
+    archiveSkipped++;
+    return true;
+  }
 
-  int httpCode = http.GET();
+  ArchiveRecord& r = *p.rec;
+  memset(&r, 0, sizeof(r));
+  if (!load(r.s)) return false;
+  r.crc = crc32_le(0, (const uint8_t*)&r.s, sizeof(Scheda)) | 1;
+  bool ok = false;
+  storageRun(ST_ARCHIVE, [&] {
+    ok = p.f.seek(archiveRecordOffset(prog)) &&
+         p.f.write((const uint8_t*)&r, sizeof(r)) == sizeof(r);
+  });
+  if (!ok) return false;
+  p.sums[prog] = lineSum;
+  p.dirty = true;
+  archiveWritten++;
+  return true;
+}
 
-  if (httpCode != HTTP_CODE_OK) {
-    debugPrint("[POLL] HTTP error: ");
-    debugPrintln(httpCode);
-    http.end();
-    wifiError = true;
-    showWifiStatus = true;
-    return -1;
+// Svuota gli slot pieni dell'anno per cui keep(prog) è false (righe
+// cancellate dal foglio o rinumerate): archiveFind non li trova più.
+// Anni senza file restano senza file
+template <typename F>
+void archivePrune(ArchivePart& p, int year, F keep) {
+  char path[32];
+  archivePath(path, sizeof(path), p.dir, year);
+  bool exists = false;
+  storageRun(ST_ARCHIVE, [&] { exists = SD.exists(path); });
+  if (!exists || !archiveOpen(p, year)) return;
+
+  const uint32_t empty = 0;
+  for (int prog = 0; prog < ARCHIVE_SLOTS; prog++) {
+    if (p.sums[prog] == 0 || keep(prog)) continue;
+    bool ok = false;
+    storageRun(ST_ARCHIVE, [&] {
+      ok = p.f.seek(archiveRecordOffset(prog)) &&
+           p.f.write((const uint8_t*)&empty, sizeof(empty)) == sizeof(empty);
+    });
+    if (!ok) return;
+    p.sums[prog] = 0;
+    p.dirty = true;
+    archivePruned++;
   }
+}
 
-  String response = http.getString();
-  http.end();
+// Record della scheda id (packNumero); false se assente o non valido
+bool archiveFind(int id, Scheda& out, const char* dir = ARCHIVE_DIR) {
+  if (!sdOK || id < 0) return false;
+  uint32_t t0 = micros();
+  char path[32];
+  archivePath(path, sizeof(path), dir, id / 10000);
+  uint32_t crc = 0;
+  bool ok = false;
+  storageRun(ST_ARCHIVE, [&] {
+    File f = SD.open(path, FILE_READ);
+    if (!f) return;
+    ok = f.seek(archiveRecordOffset(id % 10000)) &&
+         f.read((uint8_t*)&crc, sizeof(crc)) == sizeof(crc) &&
+         f.read((uint8_t*)&out, sizeof(Scheda)) == sizeof(Scheda);
+    f.close();
+  });
+  ok = ok && crc != 0 && crc == (crc32_le(0, (const uint8_t*)&out, sizeof(Scheda)) | 1) &&
+       packNumero(out.numero) == id;
+
+  archiveLookups++;
+  archiveLookupUs = micros() - t0;
+  if (archiveLookupUs > archiveLookupMaxUs) archiveLookupMaxUs = archiveLookupUs;
+  return ok;
+}
 
-  // Connessione OK
-  if (wifiError) {
-    wifiError = false;
-    showWifiStatus = true;
-    debugPrintln("[POLL] Connessione ripristinata");
+// ===== INDICE SCHEDE (PSRAM) =====
+// Tutte le schede di /riparazioni.csv, non solo le ultime 50: numero,
+// posizione della riga nel file e cliente, normalizzato per la ricerca e
+// com'è nel foglio per mostrarlo. Le voci sono ordinate per numero, byName
+// le ordina per cliente: la ricerca per prefisso è una coppia di ricerche
+// binarie. Lo ricostruisce un task a
+// bassa priorità dopo ogni parseCSV.
+#define JOB_DIR_MAX 16000
+#define JOB_KEY_LEN 20  // Caratteri del cliente indicizzati
+
+struct JobDirEntry {
+  int32_t id;        // packNumero
+  uint32_t offset;   // Inizio riga nel CSV
+  uint16_t len;      // Lunghezza riga (senza \n)
+  bool completato;
+  char key[JOB_KEY_LEN + 1];  // Cliente maiuscolo, senza accenti né punteggiatura (solo confronti)
+  char cliente[sizeof(Scheda::cliente)];  // Come Scheda::cliente: quello che si mostra
+};
+static_assert(sizeof(JobDirEntry) == 64, "record di /riparazioni.idx");
+
+struct JobDir {
+  JobDirEntry* entries;  // Ordinate per id
+  uint16_t* byName;      // Indici in entries ordinati per key (a parità, più recente prima)
+  int count;
+};
+
+JobDir jobDir = {NULL, NULL, 0};
+SemaphoreHandle_t jobDirMutex = NULL;
+TaskHandle_t jobDirTaskHandle = NULL;
+uint32_t jobDirGen = 0;       // Cambia a ogni ricostruzione
+uint32_t jobDirBuildMs = 0;
+uint32_t jobDirLookupUs = 0;  // Ultima ricerca per prefisso
+uint32_t jobDirLookupMaxUs = 0;
+
+// Prefetch della modalità manuale (vedi jobDirPrefetch)
+volatile int prefetchWantId = -1;
+int prefetchId = -1;      // Scheda in prefetchScheda (protetta da jobDirMutex)
+uint32_t prefetchGen = 0; // jobDirGen al momento della lettura: dopo una ricostruzione non vale più
+Scheda prefetchScheda;
+
+// Lettere accentate U+00C0-U+00FF (UTF-8 0xC3 0x80-0xBF) senza accento
+const char kLatin1Fold[] = "AAAAAAACEEEEIIIIDNOOOOO OUUUUY  AAAAAAACEEEEIIIIDNOOOOO OUUUUY Y";
+
+// Chiave di ricerca: maiuscole, accenti tolti, apostrofi e punti eliminati,
+// ogni altro separatore diventa un solo spazio
+void jobKeyFold(const char* src, char* out, size_t cap) {
+  size_t n = 0;
+  bool space = true;  // Niente spazi iniziali o doppi
+  for (const uint8_t* p = (const uint8_t*)src; *p && n + 1 < cap; p++) {
+    uint8_t c = *p;
+    if (c == 0xC3 && p[1] >= 0x80 && p[1] <= 0xBF) {
+      c = kLatin1Fold[*++p - 0x80];
+    }
+    if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+    if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+      out[n++] = c;
+      space = false;
+    } else if (c != '\'' && c != '.' && !space) {
+      out[n++] = ' ';
+      space = true;
+    }
   }
+  while (n > 0 && out[n - 1] == ' ') n--;
+  out[n] = '\0';
+}
 
-  // Parse JSON
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, response);
-  if (error) {
-    debugPrint("[POLL] JSON error: ");
-    debugPrintln(error.c_str());
-    return -1;
+// Come getCSVField ma su un buffer, senza String
+void csvFieldAt(const char* line, int fieldIndex, char* out, size_t cap) {
+  int fieldCount = 0;
+  bool inQuotes = false;
+  const char* start = line;
+  for (const char* p = line;; p++) {
+    char c = *p ? *p : ',';
+    if (c == '"') {
+      inQuotes = !inQuotes;
+    } else if (c == ',' && !inQuotes) {
+      if (fieldCount == fieldIndex) {
+        const char* end = p;
+        if (end - start >= 2 && *start == '"' && end[-1] == '"') {
+          start++;
+          end--;
+        }
+        while (start < end && isspace((uint8_t)*start)) start++;
+        while (end > start && isspace((uint8_t)end[-1])) end--;
+        size_t n = min((size_t)(end - start), cap - 1);
+        memcpy(out, start, n);
+        out[n] = '\0';
+        return;
+      }
+      fieldCount++;
+      start = p + 1;
+    }
+    if (!*p) break;
   }
+  out[0] = '\0';
+}
 
-  // Verifica se ts è un comando remoto (stringa) invece di un timestamp (numero)
-  JsonVariant tsVar = doc["ts"];
-  if (tsVar.is<const char*>()) {
-    const char* tsStr = tsVar.as<const char*>();
-    if (tsStr && strlen(tsStr) > 0) {
-      debugPrint("[POLL] Comando remoto: ");
-      debugPrintln(tsStr);
-      executeRemoteCommand(tsStr);
-      return 0;  // Comando eseguito, non è una nuova scheda
+// Lettura del CSV a blocchi: righe con posizione e lunghezza reali nel file
+struct CsvLineReader {
+  CsvSource& f;
+  uint8_t buf[512];
+  int pos = 0;
+  int fill = 0;
+  uint32_t base = 0;     // Offset nel file di buf[0]
+  uint32_t crc = 0;      // CRC32 dei byte letti finora (continua quello di partenza)
+  uint32_t lineCrc = 0;  // CRC32 dell'ultima riga intera, senza \r\n, anche se troncata in line
+
+  CsvLineReader(CsvSource& file) : f(file) {}
+
+  // Riga successiva in line (troncata a cap - 1), false a fine file
+  bool next(char* line, size_t cap, uint32_t& off, uint32_t& len) {
+    size_t n = 0;
+    bool any = false;
+    bool cr = false;  // '\r' in fondo al blocco: della riga solo se non segue '\n'
+    off = base + pos;
+    len = 0;
+    lineCrc = 0;
+    for (;;) {
+      if (pos >= fill) {
+        base += fill;
+        pos = 0;
+        fill = storageRead(ST_INDEX, f, buf, sizeof(buf));
+        if (fill <= 0) {
+          fill = 0;
+          break;
+        }
+        crc = crc32_le(crc, buf, fill);
+      }
+      // Fino al '\n' o alla fine del blocco
+      const uint8_t* nl = (const uint8_t*)memchr(buf + pos, '\n', fill - pos);
+      int end = nl ? nl - buf : fill;
+      int span = end - pos;
+      any = true;
+      len += span;
+      size_t copy = n + span < cap ? span : cap - 1 - n;
+      memcpy(line + n, buf + pos, copy);
+      n += copy;
+      if (span > 0) {
+        if (cr) lineCrc = crc32_le(lineCrc, (const uint8_t*)"\r", 1);
+        cr = buf[end - 1] == '\r';
+        lineCrc = crc32_le(lineCrc, buf + pos, span - (cr ? 1 : 0));
+      }
+      pos = nl ? end + 1 : end;
+      if (nl) break;
     }
+    if (n > 0 && line[n - 1] == '\r') n--;
+    line[n] = '\0';
+    return any;
   }
+};
 
-  // ts è un numero (timestamp) o vuoto/0
-  double tsDouble = tsVar.as<double>();
+// Rilegge dal CSV la riga di una voce dell'indice
+bool jobDirLoad(const JobDirEntry& e, Scheda& out) {
+  if (!sdOK) return false;
+  String line;
+  storageRun(ST_CSV, [&] {
+    CsvSource f;
+    if (!f.open()) return;
+    if (f.seek(e.offset)) line = f.readStringUntil('\n');
+    f.close();
+  });
+  line.trim();
+  char numero[12];
+  unpackNumero(e.id, numero, sizeof(numero));
+  if (!getCSVField(line, 0).equals(numero)) return false;  // Il CSV è cambiato sotto l'indice
+  suppressJsonLogs = true;
+  parseSchedaLine(line, out);
+  suppressJsonLogs = false;
+  return true;
+}
 
-  // Se ts è 0 o vuoto, tratta come "nessun cambiamento" e mantieni lastKnownTimestamp
-  if (tsDouble == 0) {
-    return 0;
-  }
+// Copia su SD (/riparazioni.idx): le stesse voci dell'indice in PSRAM, ordinate per numero, dopo un header
+// con dimensione e CRC32 del CSV che descrivono. All'avvio si carica senza
+// rileggere il CSV; dopo una sincronizzazione, se i primi csvSize byte del
+// nuovo CSV sono identici (stesso CRC) si leggono solo le righe aggiunte.
+// Finché l'indice in PSRAM non è pronto (avvio, prima ricostruzione) la
+// ricerca per numero usa il file direttamente (ricerca binaria: un seek da
+// 64 byte per passo). Lo scrive solo jobDirBuild, quindi con PSRAM: senza,
+// c'è solo se la SD viene da una scheda che l'ha già scritto, e può
+// descrivere un CSV più vecchio (jobDirLoad controlla il numero della riga).
+#define JOB_IDX_PATH "/riparazioni.idx"
+#define JOB_IDX_TMP "/riparazioni.idx.tmp"
+#define JOB_IDX_MAGIC 0x58444952  // "RIDX"
+#define JOB_IDX_VERSION 2  // 2: cliente da mostrare nel record
+
+struct JobIdxHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recSize;
+  uint32_t count;
+  uint32_t csvSize;  // Byte del CSV coperti dall'indice
+  uint32_t csvCrc;   // CRC32 di quei byte
+  uint32_t idxCrc;   // CRC32 dei record
+};
 
-  lastKnownTimestamp = (unsigned long)fmod(tsDouble, 1000000000.0);
+uint32_t jobIdxBytesWritten = 0;  // Dall'avvio
+uint32_t jobIdxIncremental = 0;   // Aggiornamenti senza rileggere tutto il CSV
+uint32_t jobIdxFull = 0;          // Ricostruzioni complete
 
-  // Nessuna novità
-  if (!doc["changed"].as<bool>()) {
-    return 0;
-  }
+// Header valido e coerente con la dimensione del file (la ricerca sul file
+// non ha il limite di JOB_DIR_MAX: quello vale solo per caricarlo in PSRAM)
+bool jobIdxReadHeader(File& f, JobIdxHeader& h) {
+  return f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == JOB_IDX_MAGIC &&
+         h.version == JOB_IDX_VERSION && h.recSize == sizeof(JobDirEntry) &&
+         f.size() == sizeof(h) + h.count * sizeof(JobDirEntry);
+}
 
-  debugPrintln("[POLL] Nuova scheda rilevata!");
+// Carica i record in entries (JOB_DIR_MAX posti); false se assente o corrotto
+bool jobIdxLoad(JobIdxHeader& h, JobDirEntry* entries) {
+  bool ok = false;
+  storageRun(ST_INDEX, [&] {
+    File f = SD.open(JOB_IDX_PATH, FILE_READ);
+    if (!f) return;
+    ok = jobIdxReadHeader(f, h) && h.count <= JOB_DIR_MAX &&
+         f.read((uint8_t*)entries, h.count * sizeof(JobDirEntry)) == h.count * sizeof(JobDirEntry);
+    f.close();
+  });
+  return ok && crc32_le(0, (uint8_t*)entries, h.count * sizeof(JobDirEntry)) == h.idxCrc;
+}
 
-  // Verifica che ci sia una riparazione
-  if (doc["riparazione"].isNull()) {
-    debugPrintln("[POLL] Riparazione null");
-    return 0;
-  }
+// Riscrive l'indice completo (file temporaneo + rename: mai un indice a metà)
+bool jobIdxWrite(const JobDirEntry* entries, int count, uint32_t csvSize, uint32_t csvCrc) {
+  size_t bytes = count * sizeof(JobDirEntry);
+  JobIdxHeader h = {JOB_IDX_MAGIC, JOB_IDX_VERSION, sizeof(JobDirEntry), (uint32_t)count,
+                    csvSize, csvCrc, crc32_le(0, (const uint8_t*)entries, bytes)};
+  bool ok = false;
+  storageRun(ST_INDEX, [&] {
+    File f = SD.open(JOB_IDX_TMP, FILE_WRITE);
+    if (!f) return;
+    ok = f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h) &&
+         f.write((const uint8_t*)entries, bytes) == bytes;
+    f.close();
+    if (ok) {
+      SD.remove(JOB_IDX_PATH);
+      ok = SD.rename(JOB_IDX_TMP, JOB_IDX_PATH);
+    }
+  });
+  if (ok) jobIdxBytesWritten += sizeof(h) + bytes;
+  return ok;
+}
 
-  JsonObject obj = doc["riparazione"].as<JsonObject>();
-  const char* numero = obj["Numero"] | "";
+// Solo righe nuove con numeri più alti: record in coda e header aggiornato
+bool jobIdxAppend(JobIdxHeader h, const JobDirEntry* entries, int count, uint32_t csvSize, uint32_t csvCrc) {
+  size_t bytes = (count - h.count) * sizeof(JobDirEntry);
+  const uint8_t* added = (const uint8_t*)(entries + h.count);
+  h.idxCrc = crc32_le(h.idxCrc, added, bytes);
+  h.count = count;
+  h.csvSize = csvSize;
+  h.csvCrc = csvCrc;
+  bool ok = false;
+  storageRun(ST_INDEX, [&] {
+    File f = SD.open(JOB_IDX_PATH, "r+");
+    if (!f) return;
+    ok = f.seek(f.size()) && f.write(added, bytes) == bytes && f.seek(0) &&
+         f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h);
+    f.close();
+  });
+  if (ok) jobIdxBytesWritten += bytes + sizeof(h);
+  return ok;
+}
 
-  // Controlla se già stampata
-  if (isAlreadyPrinted(numero)) {
-    debugPrint("[POLL] Scheda ");
-    debugPrint(numero);
-    debugPrintln(" gia' stampata");
-    return 0;
+// Ricerca per numero direttamente sul file (indice in PSRAM non pronto)
+bool jobIdxFindSd(int id, JobDirEntry& out) {
+  if (!sdOK) return false;
+  bool found = false;
+  storageRun(ST_INDEX, [&] {
+    File f = SD.open(JOB_IDX_PATH, FILE_READ);
+    if (!f) return;
+    JobIdxHeader h;
+    if (jobIdxReadHeader(f, h)) {
+      int a = 0, b = h.count;
+      while (a < b && !found) {
+        int m = (a + b) / 2;
+        if (!f.seek(sizeof(h) + m * sizeof(JobDirEntry)) ||
+            f.read((uint8_t*)&out, sizeof(out)) != sizeof(out)) break;
+        if (out.id == id) found = true;
+        else if (out.id < id) a = m + 1;
+        else b = m;
+      }
+    }
+    f.close();
+  });
+  return found;
+}
+
+// CRC32 dei primi len byte di f (un blocco per richiesta al task storage)
+bool crc32File(CsvSource& f, uint32_t len, uint32_t& crc) {
+  uint8_t buf[512];
+  crc = 0;
+  bool ok = false;
+  storageRun(ST_INDEX, [&] { ok = f.seek(0); });
+  if (!ok) return false;
+  while (len > 0) {
+    int n = storageRead(ST_INDEX, f, buf, min((uint32_t)sizeof(buf), len));
+    if (n <= 0) return false;
+    crc = crc32_le(crc, buf, n);
+    len -= n;
   }
+  return true;
+}
 
-  debugPrint("[POLL] Nuova scheda: ");
-  debugPrintln(numero);
-  showMessage("Nuova scheda!", TFT_CYAN);
+// Indice da SD se descrive ancora il CSV, altrimenti (o per le sole righe
+// aggiunte) scansione del CSV; poi scambio sotto mutex
+void jobDirBuild() {
+  if (!sdOK || !jobDirMutex) return;
+  unsigned long t0 = millis();
+
+  // File aperto e letto a blocchi tramite il task storage: tra un blocco e
+  // l'altro passano le richieste degli altri task
+  CsvSource f;
+  uint32_t csvSize = 0;
+  storageRun(ST_INDEX, [&] {
+    if (f.open()) csvSize = f.size();
+  });
+  if (!f) return;
+  JobDirEntry* entries = (JobDirEntry*)ps_malloc(sizeof(JobDirEntry) * JOB_DIR_MAX);
+  uint16_t* byName = (uint16_t*)ps_malloc(sizeof(uint16_t) * JOB_DIR_MAX);
+  if (!entries || !byName) {
+    free(entries);
+    free(byName);
+    storageRun(ST_INDEX, [&] { f.close(); });
+    debugPrintln("[INDICE] PSRAM non disponibile, ricerca disattivata e /riparazioni.idx non aggiornato");
+    return;
+  }
 
-  // Costruisci scheda per stampa
-  Scheda s;
-  memset(&s, 0, sizeof(Scheda));
+  // Righe già indicizzate: stesso prefisso del CSV => si riparte da lì
+  JobIdxHeader h;
+  int count = 0;
+  uint32_t from = 0;
+  uint32_t prefixCrc = 0;
+  // Senza archivio per anno (primo avvio con questa versione) si rilegge
+  // tutto il CSV per popolarlo
+  bool archiveMissing = false;
+  storageRun(ST_ARCHIVE, [&] { archiveMissing = !SD.exists(ARCHIVE_DIR); });
+  bool haveIdx = !archiveMissing && jobIdxLoad(h, entries);
+  if (haveIdx && h.csvSize <= csvSize && crc32File(f, h.csvSize, prefixCrc) && prefixCrc == h.csvCrc) {
+    count = h.count;
+    from = h.csvSize;
+  } else {
+    haveIdx = false;
+    prefixCrc = 0;
+  }
+
+  static char line[1536];  // Riga completa fino agli attrezzi: basta per Completato
+  char field[48];
+  CsvLineReader rd(f);
+  rd.base = from;
+  rd.crc = prefixCrc;
+  storageRun(ST_INDEX, [&] { f.seek(from); });
+  bool header = from == 0;
+  bool appendOnly = true;  // Numeri nuovi tutti dopo quelli già nell'indice
+  bool complete = false;   // Letto fino a fine file: false se fermo a JOB_DIR_MAX o errore SD
+  uint32_t off, len;
+  for (;;) {
+    if (!rd.next(line, sizeof(line), off, len)) {
+      complete = rd.base >= csvSize;  // Fine file vera, non un errore di lettura
+      break;
+    }
+    if (header) {
+      header = false;
+      continue;
+    }
+    csvFieldAt(line, 0, field, sizeof(field));
+    int id = packNumero(field);
+    if (id < 0) continue;
+    if (count == JOB_DIR_MAX) break;  // Una scheda oltre il limite: indice parziale
+
+    JobDirEntry& e = entries[count];
+    memset(&e, 0, sizeof(e));  // Anche il padding: finisce su SD
+    e.id = id;
+    e.offset = off;
+    e.len = len > 0xFFFF ? 0xFFFF : len;
+    csvFieldAt(line, 2, field, sizeof(field));
+    jobKeyFold(field, e.key, sizeof(e.key));
+    strncpy(e.cliente, field, sizeof(e.cliente) - 1);
+    csvFieldAt(line, 7, field, sizeof(field));
+    e.completato = strcasecmp(field, "true") == 0 || strcmp(field, "1") == 0;
+    if (count > 0 && id <= entries[count - 1].id) appendOnly = false;
+    count++;
+
+    // Archivio per anno: solo le righe cambiate diventano record. Il CRC è
+    // della riga intera: una modifica oltre il buffer conta lo stesso
+    archivePut(archiveSync, id, rd.lineCrc, [&](Scheda& s) {
+      if (len >= sizeof(line) - 1) return jobDirLoad(e, s);  // Troncata nel buffer: riletta intera
+      suppressJsonLogs = true;
+      parseSchedaLine(String(line), s);
+      suppressJsonLogs = false;
+      return true;
+    });
 
-  strncpy(s.numero, numero, sizeof(s.numero) - 1);
-  strncpy(s.data, obj["Data consegna"] | "", sizeof(s.data) - 1);
-  strncpy(s.cliente, obj["Cliente"] | "", sizeof(s.cliente) - 1);
-  strncpy(s.indirizzo, obj["Indirizzo"] | "", sizeof(s.indirizzo) - 1);
-  strncpy(s.telefono, obj["Telefono"] | "", sizeof(s.telefono) - 1);
-  s.ddt = obj["DDT"] | false;
+    if ((count & 255) == 0) vTaskDelay(1);  // Lascia passare gli altri task
+  }
+  storageRun(ST_INDEX, [&] { f.close(); });
 
-  // Parse attrezzi
-  JsonArray attrezzi = obj["Attrezzi"].as<JsonArray>();
-  s.numAttrezzi = 0;
-  for (JsonObject att : attrezzi) {
-    if (s.numAttrezzi >= 5) break;
-    Attrezzo& a = s.attrezzi[s.numAttrezzi];
-    strncpy(a.marca, att["marca"] | "", sizeof(a.marca) - 1);
-    strncpy(a.dotazione, att["dotazione"] | "", sizeof(a.dotazione) - 1);
-    strncpy(a.note, att["note"] | "", sizeof(a.note) - 1);
-    s.numAttrezzi++;
+  if (!appendOnly) {
+    std::sort(entries, entries + count,
+              [](const JobDirEntry& a, const JobDirEntry& b) { return a.id < b.id; });
   }
 
-  // Riaccendi schermo
-  if (!screenOn) {
-    screenOn = true;
-    digitalWrite(TFT_BL, HIGH);
-    delay(100);
+  // CSV riletto tutto fino in fondo (l'incrementale parte solo se le righe
+  // vecchie sono identiche): gli slot dell'archivio senza più una riga sono
+  // da svuotare. Con l'indice fermo a JOB_DIR_MAX o una lettura fallita le
+  // righe mancanti in entries ci sono ancora nel CSV: niente da svuotare
+  if (!haveIdx && complete) {
+    int k = 0;  // entries in ordine di id: un solo passaggio per tutti gli anni
+    for (int y = 0; y < 100; y++) {
+      archivePrune(archiveSync, y, [&](int prog) {
+        int id = y * 10000 + prog;
+        while (k < count && entries[k].id < id) k++;
+        return k < count && entries[k].id == id;
+      });
+    }
   }
+  archiveClose(archiveSync);
+  for (int i = 0; i < count; i++) byName[i] = i;
+  std::sort(byName, byName + count, [entries](uint16_t a, uint16_t b) {
+    int c = strcmp(entries[a].key, entries[b].key);
+    return c != 0 ? c < 0 : entries[a].id > entries[b].id;
+  });
+
+  // Su SD: niente da fare, record in coda, o riscrittura completa
+  if (!complete) {
+    debugPrintln("[INDICE] CSV letto solo in parte (oltre JOB_DIR_MAX o errore SD), indice su SD non aggiornato");
+  } else if (haveIdx && (uint32_t)count == h.count) {
+    if (csvSize != h.csvSize) jobIdxAppend(h, entries, count, csvSize, rd.crc);  // Solo righe vuote in più
+  } else if (haveIdx && appendOnly) {
+    if (jobIdxAppend(h, entries, count, csvSize, rd.crc)) jobIdxIncremental++;
+  } else if (jobIdxWrite(entries, count, csvSize, rd.crc)) {
+    jobIdxFull++;
+  }
+
+  xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+  JobDir old = jobDir;
+  jobDir.entries = entries;
+  jobDir.byName = byName;
+  jobDir.count = count;
+  jobDirGen++;
+  prefetchId = -1;  // Il CSV è cambiato: la scheda letta prima può essere vecchia
+  xSemaphoreGive(jobDirMutex);
+  free(old.entries);
+  free(old.byName);
+
+  jobDirBuildMs = millis() - t0;
+  debugPrint("[INDICE] Schede indicizzate: ");
+  debugPrint(count);
+  debugPrint(haveIdx ? " (da SD, nuove " : " (CSV completo, ");
+  debugPrint(haveIdx ? count - (int)h.count : count);
+  debugPrint(") in ");
+  debugPrint((unsigned long)jobDirBuildMs);
+  debugPrint(" ms, archivio: scritte ");
+  debugPrint((unsigned long)archiveWritten);
+  debugPrint(" invariate ");
+  debugPrint((unsigned long)archiveSkipped);
+  debugPrint(" svuotate ");
+  debugPrintln((unsigned long)archivePruned);
+}
 
-  // Stampa
-  int numEtichette = max(1, s.numAttrezzi);
-  debugPrint("[POLL] Stampo ");
-  debugPrint(numEtichette);
-  debugPrintln(" etichette");
+// Intervallo [lo, hi) di byName con chiave che inizia per prefix (mutex preso)
+void jobDirPrefixRange(const char* prefix, int& lo, int& hi) {
+  size_t plen = strlen(prefix);
+  int a = 0, b = jobDir.count;
+  while (a < b) {
+    int m = (a + b) / 2;
+    if (strncmp(jobDir.entries[jobDir.byName[m]].key, prefix, plen) < 0) a = m + 1;
+    else b = m;
+  }
+  lo = a;
+  b = jobDir.count;
+  while (a < b) {
+    int m = (a + b) / 2;
+    if (strncmp(jobDir.entries[jobDir.byName[m]].key, prefix, plen) <= 0) a = m + 1;
+    else b = m;
+  }
+  hi = a;
+}
 
-  for (int i = 0; i < numEtichette; i++) {
-    char msg[40];
-    sprintf(msg, "Stampa %s (%d/%d)", s.numero, i + 1, numEtichette);
-    showMessage(msg, TFT_CYAN);
-    printEtichetta(s, i, numEtichette);
+// Ricerca per prefisso cronometrata (mutex preso)
+int jobDirSearch(const char* prefix, int& lo) {
+  uint32_t t0 = micros();
+  int hi;
+  jobDirPrefixRange(prefix, lo, hi);
+  jobDirLookupUs = micros() - t0;
+  if (jobDirLookupUs > jobDirLookupMaxUs) jobDirLookupMaxUs = jobDirLookupUs;
+  return hi - lo;
+}
 
-    if (i < numEtichette - 1) {
-      for (int sec = 8; sec > 0; sec--) {
-        char countdown[32];
-        sprintf(countdown, "Prossima in %ds...", sec);
-        showMessage(countdown, TFT_CYAN);
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-      }
-    }
+// Voce con questo id, -1 se non c'è (mutex preso)
+int jobDirFind(int id) {
+  int a = 0, b = jobDir.count;
+  while (a < b) {
+    int m = (a + b) / 2;
+    if (jobDir.entries[m].id < id) a = m + 1;
+    else b = m;
   }
+  return (a < jobDir.count && jobDir.entries[a].id == id) ? a : -1;
+}
 
-  // Salva in history
-  addToHistory(s.numero);
-  savePrintHistory();
+// Prima voce con id >= id (mutex preso)
+int jobDirLowerBound(int id) {
+  int a = 0, b = jobDir.count;
+  while (a < b) {
+    int m = (a + b) / 2;
+    if (jobDir.entries[m].id < id) a = m + 1;
+    else b = m;
+  }
+  return a;
+}
 
-  // Salva numero per sync CSV
-  strncpy(lastFastPrintNumero, s.numero, sizeof(lastFastPrintNumero) - 1);
+// Prefetch della modalità manuale: la scheda del numero mostrato viene letta
+// dall'archivio (o dal CSV) mentre l'utente sceglie le cifre, l'OK finale la trova già pronta
 
-  showMessage("Stampato!", TFT_GREEN);
-  debugPrintln("[POLL] Stampa completata");
+// Prefetch ancora valido per id (jobDirMutex preso)
+bool prefetchValid(int id) {
+  return id >= 0 && id == prefetchId && prefetchGen == jobDirGen;
+}
 
-  return 1;
+void jobDirPrefetch() {
+  int id = prefetchWantId;
+  xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+  bool fresh = prefetchValid(id);
+  uint32_t gen = jobDirGen;
+  xSemaphoreGive(jobDirMutex);
+  if (id < 0 || fresh) return;
+
+  static Scheda s;
+  if (!archiveFind(id, s)) {
+    JobDirEntry e;
+    xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+    int idx = jobDirFind(id);
+    if (idx >= 0) e = jobDir.entries[idx];
+    xSemaphoreGive(jobDirMutex);
+    if (idx < 0 || !jobDirLoad(e, s)) return;
+  }
+  xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+  if (gen == jobDirGen) {  // Indice non ricostruito nel frattempo
+    prefetchScheda = s;
+    prefetchId = id;
+    prefetchGen = gen;
+  }
+  xSemaphoreGive(jobDirMutex);
 }
 
-// === FUNZIONI LEGACY (mantenute per compatibilità) ===
+#define JOBDIR_REBUILD  0x01
+#define JOBDIR_PREFETCH 0x02
+#define JOBDIR_HISTORY  0x04  // Compattazione del journal history (stesso task: lavoro SD a bassa priorità)
 
-// Fetch timestamp da API - ritorna 0 se errore
-unsigned long fetchLastUpdate() {
-  if (WiFi.status() != WL_CONNECTED) return 0;
+void jobDirTask(void* parameter) {
+  jobDirBuild();
+  for (;;) {
+    uint32_t bits = 0;
+    xTaskNotifyWait(0, 0xFFFFFFFF, &bits, portMAX_DELAY);
+    if (bits & JOBDIR_REBUILD) jobDirBuild();
+    if (bits & JOBDIR_PREFETCH) jobDirPrefetch();
+    if (bits & JOBDIR_HISTORY) historyCompact();
+  }
+}
 
-  HTTPClient http;
-  String url = String(API_URL) + "?action=getLastUpdate";
-  http.begin(url);
-  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-  http.setTimeout(8000);
+// CSV aggiornato su SD: ricostruisci l'indice in background
+void jobDirRequestRebuild() {
+  if (jobDirTaskHandle) xTaskNotify(jobDirTaskHandle, JOBDIR_REBUILD, eSetBits);
+}
 
-  int httpCode = http.GET();
-  unsigned long ts = 0;
+// Chiede in background la scheda con questo id (non bloccante)
+void jobDirRequestPrefetch(int id) {
+  if (id < 0 || id == prefetchWantId) return;
+  prefetchWantId = id;
+  if (jobDirTaskHandle) xTaskNotify(jobDirTaskHandle, JOBDIR_PREFETCH, eSetBits);
+}
 
-  if (httpCode == HTTP_CODE_OK) {
-    String response = http.getString();
-    JsonDocument doc;
-    if (!deserializeJson(doc, response)) {
-      double tsDouble = doc["ts"] | 0.0;
-      ts = (unsigned long)fmod(tsDouble, 1000000000.0);
-    }
-  }
+void jobDirInit() {
+  jobDirMutex = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(
+    jobDirTask,         // Funzione
+    "JobDirTask",       // Nome
+    6144,               // Stack size (buffer di lettura, parsing per l'archivio)
+    NULL,               // Parametri
+    0,                  // Priorità (solo quando il core è libero)
+    &jobDirTaskHandle,  // Handle
+    0                   // Core 0
+  );
+}
 
-  http.end();
-  return ts;
+// ===== PRINT HISTORY =====
+#undef LOG_SUB
+#define LOG_SUB LOG_SUB_STORE
+
+// Il set copre tutto l'archivio: test e inserimento sono un bit, senza
+// limite di 200 voci (le più vecchie non tornano "da stampare"). Un anno
+// occupa 1250 byte, allocati al primo numero di quell'anno. Il ring tiene
+// l'ordine delle ultime stampe per STATUS e per il salvataggio.
+// Tutto sotto historyMutex, anche il test: printedAdd alloca l'anno e
+// cambia i bit mentre UI e polling leggono da altri task.
+
+bool printedTest(int id) {
+  if (id < 0) return false;
+  const uint8_t* bits = printedBits[id / 10000];
+  int prog = id % 10000;
+  return bits && (bits[prog >> 3] & (1 << (prog & 7)));
 }
 
-// Fetch rapido ultima scheda (legacy, non più usata nel polling)
-bool fetchAndPrintLastScheda() {
-  if (WiFi.status() != WL_CONNECTED) return false;
+// false se già presente (o numero non valido)
+bool printedAdd(int id) {
+  if (id < 0) return false;
+  uint8_t*& bits = printedBits[id / 10000];
+  if (!bits) {
+    bits = (uint8_t*)calloc(PRINTED_BITS_BYTES, 1);
+    if (!bits) return false;
+  }
+  int prog = id % 10000;
+  uint8_t mask = 1 << (prog & 7);
+  if (bits[prog >> 3] & mask) return false;
+  bits[prog >> 3] |= mask;
+  historyCount++;
 
-  HTTPClient http;
-  String url = String(API_URL) + "?action=getRiparazioni&limit=1";
-  http.begin(url);
-  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-  http.setTimeout(8000);
+  printedRecent[printedRecentHead] = id;
+  printedRecentHead = (printedRecentHead + 1) % PRINTED_RECENT;
+  if (printedRecentCount < PRINTED_RECENT) printedRecentCount++;
+  return true;
+}
 
-  int httpCode = http.GET();
+// i-esima stampa più recente (0 = ultima)
+int printedRecentAt(int i) {
+  return printedRecent[(printedRecentHead - 1 - i + 2 * PRINTED_RECENT) % PRINTED_RECENT];
+}
 
-  if (httpCode != HTTP_CODE_OK) {
-    debugPrint("[FAST] HTTP error: ");
-    debugPrintln(httpCode);
-    http.end();
-    return false;
+void printedClear() {
+  for (int y = 0; y < PRINTED_YEARS; y++) {
+    free(printedBits[y]);
+    printedBits[y] = NULL;
   }
+  historyCount = 0;
+  printedRecentHead = 0;
+  printedRecentCount = 0;
+  printedOddCount = 0;
+}
 
-  String response = http.getString();
-  http.end();
+// Numeri che packNumero rifiuta (riga scritta a mano nel foglio): niente
+// bit né journal, ma senza memoria ogni sincronizzazione li ristamperebbe.
+// Restano in RAM: dopo un riavvio markAllAsPrinted/syncCatchUp li risegnano
+// con il resto della lista. Sotto historyMutex.
+bool printedOddTest(const char* numero) {
+  int n = min(printedOddCount, PRINTED_ODD_MAX);
+  for (int i = 0; i < n; i++) {
+    if (strcmp(printedOdd[i], numero) == 0) return true;
+  }
+  return false;
+}
 
-  debugPrint("[FAST] Response: ");
-  debugPrint(response.length());
-  debugPrintln(" bytes");
+// false se già presente
+bool printedOddAdd(const char* numero) {
+  if (printedOddTest(numero)) return false;
+  char* slot = printedOdd[printedOddCount++ % PRINTED_ODD_MAX];
+  strncpy(slot, numero, sizeof(printedOdd[0]) - 1);
+  slot[sizeof(printedOdd[0]) - 1] = '\0';
+  debugPrint("[HISTORY] Numero fuori formato, ricordato solo fino al riavvio: ");
+  debugPrintln(numero);
+  return true;
+}
 
-  // Parse JSON
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, response);
-  if (error) {
-    debugPrint("[FAST] JSON error: ");
-    debugPrintln(error.c_str());
-    return false;
+// Byte occupati dai bitset
+int printedBytes() {
+  int n = 0;
+  for (int y = 0; y < PRINTED_YEARS; y++) {
+    if (printedBits[y]) n += PRINTED_BITS_BYTES;
   }
+  return n;
+}
 
-  JsonArray arr = doc["riparazioni"].as<JsonArray>();
-  if (arr.size() == 0) {
-    debugPrintln("[FAST] Nessuna scheda trovata");
-    return false;
-  }
+// Su SD un journal binario append-only: ogni stampa aggiunge un record da
+// 12 byte chiuso da CRC32, invece di riscrivere tutto il file. All'avvio si
+// rigiocano i record fino al primo non valido (scrittura interrotta). Quando
+// il journal supera il doppio della dimensione compattata (un record per
+// scheda nel set, quindi cresce con lo storico), e comunque almeno
+// HISTORY_LOG_MAX, il task dell'indice lo compatta: il set, poi il ring
+// dalla più vecchia, scritti in un file nuovo e rinominati.
+// Lo stesso journal sta anche sulla flash interna: si legge da lì e ogni
+// scrittura va su entrambe le copie.
+#define HISTORY_LOG "/print_history.log"
+#define HISTORY_LOG_TMP "/print_history.tmp"
+#define HISTORY_TXT "/print_history.txt"  // Formato precedente (una riga per scheda)
+#define HISTORY_LOG_MAX (16 * 1024)   // Soglia minima di compattazione
+#define HISTORY_LOG_SLACK (4 * 1024)  // Margine oltre il doppio del compattato
+#define HISTORY_REC_MAGIC 0xA5
+#define HISTORY_REC_ADD 1
+#define HISTORY_PENDING 16
+
+struct HistoryRecord {
+  uint8_t magic;
+  uint8_t type;
+  uint16_t reserved;
+  int32_t id;
+  uint32_t crc;  // CRC32 dei primi 8 byte
+};
+static_assert(sizeof(HistoryRecord) == 12, "record journal history");
+
+SemaphoreHandle_t historyMutex = NULL;
+int32_t historyPending[HISTORY_PENDING];  // Aggiunte non ancora su SD
+int historyPendingCount = 0;
+uint32_t historyLogSize = 0;
+uint32_t historyCompactedSize = 0;  // Journal appena compattato (12 byte x set)
+uint32_t historyBytesWritten = 0;  // Dall'avvio, compattazioni escluse
+uint32_t historySaved = 0;         // Schede scritte nel journal dall'avvio
+uint32_t historyCompactions = 0;
+
+void historyRecord(HistoryRecord& r, int32_t id) {
+  r.magic = HISTORY_REC_MAGIC;
+  r.type = HISTORY_REC_ADD;
+  r.reserved = 0;
+  r.id = id;
+  r.crc = crc32_le(0, (const uint8_t*)&r, 8);
+}
 
-  // Prendi la prima (ultima inserita)
-  JsonObject obj = arr[0];
-  const char* numero = obj["Numero"] | "";
+bool historyRecordValid(const HistoryRecord& r) {
+  return r.magic == HISTORY_REC_MAGIC && r.type == HISTORY_REC_ADD &&
+         r.crc == crc32_le(0, (const uint8_t*)&r, 8);
+}
 
-  // Controlla se già stampata
-  if (isAlreadyPrinted(numero)) {
-    debugPrint("[FAST] Scheda ");
-    debugPrint(numero);
-    debugPrintln(" gia' stampata");
-    return false;
+// Scrive il set in f: in ordine di numero (senza il ring), poi il ring
+// dalla più vecchia. recent = ring ordinato per numero
+bool historyWriteSet(File& f, const int32_t* recent, uint32_t& size) {
+  static HistoryRecord buf[32];
+  int n = 0;
+  bool ok = true;
+  size = 0;
+  auto put = [&](int32_t id) {
+    historyRecord(buf[n++], id);
+    if (n == 32) {
+      ok = ok && f.write((const uint8_t*)buf, sizeof(buf)) == sizeof(buf);
+      size += sizeof(buf);
+      n = 0;
+    }
+  };
+
+  for (int y = 0; y < PRINTED_YEARS; y++) {
+    const uint8_t* bits = printedBits[y];
+    if (!bits) continue;
+    for (int prog = 0; prog < 10000; prog++) {
+      if (!(bits[prog >> 3] & (1 << (prog & 7)))) continue;
+      int id = y * 10000 + prog;
+      if (!std::binary_search(recent, recent + printedRecentCount, id)) put(id);
+    }
   }
+  for (int i = printedRecentCount - 1; i >= 0; i--) put(printedRecentAt(i));
+  if (n > 0) {
+    ok = ok && f.write((const uint8_t*)buf, n * sizeof(HistoryRecord)) == n * sizeof(HistoryRecord);
+    size += n * sizeof(HistoryRecord);
+  }
+  return ok;
+}
 
-  debugPrint("[FAST] Nuova scheda: ");
-  debugPrintln(numero);
-
-  // Costruisci scheda temporanea per stampa
-  Scheda s;
-  memset(&s, 0, sizeof(Scheda));
-
-  strncpy(s.numero, numero, sizeof(s.numero) - 1);
+// Journal nuovo su un filesystem: file temporaneo, poi rename
+bool historyRewrite(fs::FS& fs, const int32_t* recent, uint32_t& size) {
+  File f = fs.open(HISTORY_LOG_TMP, FILE_WRITE);
+  if (!f) return false;
+  bool ok = historyWriteSet(f, recent, size);
+  f.close();
+  if (ok) {
+    fs.remove(HISTORY_LOG);
+    ok = fs.rename(HISTORY_LOG_TMP, HISTORY_LOG);
+  }
+  return ok;
+}
 
-  const char* data = obj["Data consegna"] | "";
-  strncpy(s.data, data, sizeof(s.data) - 1);
+// Riscrive il journal con il solo stato attuale, su flash e SD (mutex preso)
+bool historyCompactLocked() {
+  static int32_t recent[PRINTED_RECENT];
+  for (int i = 0; i < printedRecentCount; i++) recent[i] = printedRecentAt(i);
+  std::sort(recent, recent + printedRecentCount);
+
+  // Su SD tramite il task storage: il mutex resta a chi chiama, il set non cambia
+  uint32_t size = 0;
+  bool flashDone = flashOK && historyRewrite(LittleFS, recent, size);
+  bool sdDone = false;
+  if (sdOK) storageRun(ST_HISTORY, [&] { sdDone = historyRewrite(SD, recent, size); });
+  if (!flashDone && !sdDone) {
+    errorPrintln("[HISTORY] Compattazione fallita");
+    return false;
+  }
+  historyLogSize = size;
+  historyCompactedSize = size;
+  historyPendingCount = 0;  // Già nel set, quindi nel file nuovo
+  historyCompactions++;
+  return true;
+}
 
-  const char* cliente = obj["Cliente"] | "";
-  strncpy(s.cliente, cliente, sizeof(s.cliente) - 1);
+// Oltre questa dimensione il journal va compattato: relativa al set, così
+// uno storico grande non fa riscrivere il file a ogni salvataggio
+uint32_t historyCompactThreshold() {
+  uint32_t t = 2 * historyCompactedSize + HISTORY_LOG_SLACK;
+  return t > HISTORY_LOG_MAX ? t : HISTORY_LOG_MAX;
+}
 
-  const char* indirizzo = obj["Indirizzo"] | "";
-  strncpy(s.indirizzo, indirizzo, sizeof(s.indirizzo) - 1);
+// Dal task dell'indice, quando il journal supera historyCompactThreshold()
+void historyCompact() {
+  if (!historyMutex) return;
+  xSemaphoreTake(historyMutex, portMAX_DELAY);
+  uint32_t before = historyLogSize;
+  if (historyCompactLocked()) {
+    debugPrint("[HISTORY] Journal compattato: ");
+    debugPrint((unsigned long)before);
+    debugPrint(" -> ");
+    debugPrint((unsigned long)historyLogSize);
+    debugPrintln(" byte");
+  }
+  xSemaphoreGive(historyMutex);
+}
 
-  const char* telefono = obj["Telefono"] | "";
-  strncpy(s.telefono, telefono, sizeof(s.telefono) - 1);
-  s.ddt = obj["DDT"] | false;
+// Formato precedente: una riga "AA/NNNN" per scheda, in ordine di stampa
+void historyLoadText() {
+  storageRun(ST_HISTORY, [&] {
+    File f = SD.open(HISTORY_TXT, FILE_READ);
+    if (!f) return;
+    while (f.available()) {
+      String line = f.readStringUntil('\n');
+      line.trim();
+      if (line.length() > 0 && line.length() < 12) {
+        printedAdd(packNumero(line.c_str()));
+      }
+    }
+    f.close();
+  });
+}
 
-  // Parse attrezzi
-  JsonArray attrezzi = obj["Attrezzi"].as<JsonArray>();
-  s.numAttrezzi = 0;
-  for (JsonObject att : attrezzi) {
-    if (s.numAttrezzi >= 5) break;
-    Attrezzo& a = s.attrezzi[s.numAttrezzi];
-    const char* marca = att["marca"] | "";
-    const char* dotazione = att["dotazione"] | "";
-    const char* note = att["note"] | "";
-    strncpy(a.marca, marca, sizeof(a.marca) - 1);
-    strncpy(a.dotazione, dotazione, sizeof(a.dotazione) - 1);
-    strncpy(a.note, note, sizeof(a.note) - 1);
-    s.numAttrezzi++;
+// Rigioca i record di un journal aperto; true se la coda è rovinata
+bool historyReplay(File& f) {
+  // Record in ordine di stampa: il ring resta con le ultime
+  static HistoryRecord buf[32];
+  int got;
+  while ((got = f.read((uint8_t*)buf, sizeof(buf))) > 0) {
+    int n = got / sizeof(HistoryRecord);
+    for (int i = 0; i < n; i++) {
+      if (!historyRecordValid(buf[i])) return true;
+      printedAdd(buf[i].id);
+      historyLogSize += sizeof(HistoryRecord);
+    }
+    if (n * (int)sizeof(HistoryRecord) != got) return true;
   }
+  return false;
+}
 
-  // Riaccendi schermo per mostrare stampa
-  if (!screenOn) {
-    printFromSleep = true;  // Segnala a printEtichetta di usare 31 caratteri
-    screenOn = true;
-    digitalWrite(TFT_BL, HIGH);
-    delay(100);
+// Carica history: prima dalla flash interna, poi da SD
+void loadPrintHistory() {
+  if (!historyMutex) historyMutex = xSemaphoreCreateMutex();
+  xSemaphoreTake(historyMutex, portMAX_DELAY);
+  printedClear();
+  historyPendingCount = 0;
+  historyLogSize = 0;
+  historyCompactedSize = 0;
+  if (!sdOK && !flashOK) {
+    xSemaphoreGive(historyMutex);
+    return;
   }
 
-  // Stampa
-  int numEtichette = max(1, s.numAttrezzi);
-  debugPrint("[FAST] Stampo ");
-  debugPrint(numEtichette);
-  debugPrintln(" etichette");
-
-  for (int i = 0; i < numEtichette; i++) {
-    char msg[40];
-    sprintf(msg, "Fast: %s (%d/%d)", s.numero, i + 1, numEtichette);
-    showMessage(msg, TFT_CYAN);
-    printEtichetta(s, i, numEtichette);
-
-    if (i < numEtichette - 1) {
-      for (int sec = 8; sec > 0; sec--) {
-        char countdown[32];
-        sprintf(countdown, "Prossima in %ds...", sec);
-        showMessage(countdown, TFT_CYAN);
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+  bool found = false, torn = false, legacy = false;
+  bool resync = false;  // Copie diverse: si riscrivono entrambe
+  if (flashOK) {
+    File f = LittleFS.open(HISTORY_LOG, FILE_READ);
+    if (f) {
+      found = true;
+      torn = historyReplay(f);
+      f.close();
+    }
+  }
+  if (sdOK) {
+    uint32_t flashSize = historyLogSize;
+    storageRun(ST_HISTORY, [&] {
+      File f = SD.open(HISTORY_LOG, FILE_READ);
+      if (!f) {
+        legacy = !found && SD.exists(HISTORY_TXT);
+        resync = found;
+        return;
+      }
+      // SD diversa dalla flash (scambiata, o una scrittura persa): unione
+      // dei due set. Senza copia in flash è l'unica sorgente
+      if (!found || f.size() != flashSize) {
+        resync = true;
+        if (historyReplay(f)) torn = true;
       }
+      found = true;
+      f.close();
+    });
+  }
+  if (found) {
+    // Coda rovinata da uno spegnimento, o copie da riallineare
+    if (torn) {
+      debugPrintln("[HISTORY] Journal troncato, compatto");
+      historyCompactLocked();
+    } else if (resync && sdOK && flashOK) {
+      debugPrintln("[HISTORY] Riallineo flash e SD");
+      historyCompactLocked();
     }
+  } else if (legacy) {
+    historyLoadText();
+    if (historyCompactLocked()) {
+      storageRun(ST_HISTORY, [&] { SD.remove(HISTORY_TXT); });
+      debugPrintln("[HISTORY] Convertito print_history.txt in journal");
+    }
+  } else {
+    debugPrintln("[HISTORY] File non trovato, creo nuovo");
   }
+  // Senza compattazione all'avvio: dimensione che avrebbe il file compattato
+  if (historyCompactedSize == 0) historyCompactedSize = historyCount * sizeof(HistoryRecord);
+  xSemaphoreGive(historyMutex);
 
-  // Aggiungi a history
-  addToHistory(s.numero);
-  savePrintHistory();
-
-  // Salva numero per verifica CSV
-  strncpy(lastFastPrintNumero, s.numero, sizeof(lastFastPrintNumero) - 1);
-  lastFastPrintNumero[sizeof(lastFastPrintNumero) - 1] = '\0';
-
-  showMessage("Stampa rapida OK!", TFT_GREEN);
-  debugPrintln("[FAST] Stampa completata");
-
-  return true;
+  debugPrint("[HISTORY] Caricate ");
+  debugPrint(historyCount);
+  debugPrintln(" schede gia' stampate");
 }
 
-// Download CSV e ritorna true se OK
-bool downloadCSV() {
-  if (WiFi.status() != WL_CONNECTED) return false;
+// Scrive in coda al journal le schede aggiunte dall'ultimo salvataggio
+void savePrintHistory() {
+  if ((!sdOK && !flashOK) || !historyMutex) return;
+  xSemaphoreTake(historyMutex, portMAX_DELAY);
+  if (historyPendingCount == 0) {
+    xSemaphoreGive(historyMutex);
+    return;
+  }
 
-  showMessage("Download CSV...", TFT_YELLOW);
-  debugPrintln("[AUTO] Download CSV...");
+  HistoryRecord recs[HISTORY_PENDING];
+  for (int i = 0; i < historyPendingCount; i++) historyRecord(recs[i], historyPending[i]);
+  size_t bytes = historyPendingCount * sizeof(HistoryRecord);
 
-  HTTPClient http;
-  http.begin(CSV_URL);
-  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-  int httpCode = http.GET();
+  // In flash subito: pochi ms, e la copia che si rilegge all'avvio
+  if (flashOK) {
+    File f = LittleFS.open(HISTORY_LOG, FILE_APPEND);
+    if (!f || f.write((const uint8_t*)recs, bytes) != bytes) {
+      errorPrintln("[HISTORY] Errore scrittura flash");
+    }
+    if (f) f.close();
+  }
 
-  if (httpCode == HTTP_CODE_OK) {
-    csvData = http.getString();
-    debugPrint("[AUTO] CSV: ");
-    debugPrint(csvData.length());
-    debugPrintln(" bytes");
+  int saved = historyPendingCount;
+  historyLogSize += bytes;
+  historyBytesWritten += bytes;
+  historySaved += saved;
+  historyPendingCount = 0;
+  bool compact = historyLogSize > historyCompactThreshold();
 
-    // Salva su SD
-    if (sdOK) {
-      File f = SD.open("/riparazioni.csv", FILE_WRITE);
-      if (f) {
-        f.print(csvData);
-        f.close();
-      }
-    }
+  // Su SD in modo asincrono, ma accodata prima di lasciare il mutex: una
+  // compattazione (che lo prende) arriva al task storage dopo, e la coda
+  // è FIFO, quindi i record non finiscono in coda al file già compattato
+  if (sdOK) storageAppend(ST_HISTORY, HISTORY_LOG, (const uint8_t*)recs, bytes);
+  xSemaphoreGive(historyMutex);
+  debugPrint("[HISTORY] Salvate ");
+  debugPrint(saved);
+  debugPrintln(" schede");
 
-    http.end();
-    return true;
-  }
+  if (compact && jobDirTaskHandle) xTaskNotify(jobDirTaskHandle, JOBDIR_HISTORY, eSetBits);
+}
 
-  debugPrint("[AUTO] HTTP error: ");
-  debugPrintln(httpCode);
-  http.end();
-  return false;
+// Verifica se scheda è già stampata
+bool isAlreadyPrinted(const char* numero) {
+  int id = packNumero(numero);
+  if (historyMutex) xSemaphoreTake(historyMutex, portMAX_DELAY);
+  bool found = id >= 0 ? printedTest(id) : printedOddTest(numero);
+  if (historyMutex) xSemaphoreGive(historyMutex);
+  return found;
 }
 
-// Stampa automatica nuove schede
-void autoPrintNewSchede() {
-  int printed = 0;
+// Aggiunge scheda a history (su SD alla prossima savePrintHistory)
+void addToHistory(const char* numero) {
+  int id = packNumero(numero);
+  if (historyMutex) xSemaphoreTake(historyMutex, portMAX_DELAY);
+  bool added = id >= 0 ? printedAdd(id) : printedOddAdd(numero);
+  bool full = false;
+  if (added && id >= 0) {
+    historyPending[historyPendingCount++] = id;
+    full = historyPendingCount == HISTORY_PENDING;
+  }
+  if (historyMutex) xSemaphoreGive(historyMutex);
+  if (added) syncUpdateSeen();
+  if (full) savePrintHistory();
+}
 
-  for (int i = 0; i < numSchede; i++) {
-    if (!isAlreadyPrinted(schede[i].numero)) {
-      debugPrint("[AUTO] Nuova scheda: ");
-      debugPrintln(schede[i].numero);
+// Segna tutte le schede correnti come stampate (all'avvio). Le più vecchie
+// restano nel set: niente più reset a sole schede del CSV
+void markAllAsPrinted() {
+  SchedeRef schede;
+  int before = historyCount;
+  for (int i = 0; i < schede.count(); i++) {
+    addToHistory(schede[i].numero);
+  }
+  syncUpdateSeen();  // Anche se erano già tutte in history
+  int added = historyCount - before;
+  savePrintHistory();
+  debugPrint("[HISTORY] Segnate ");
+  debugPrint(added);
+  debugPrint(" schede dal CSV, totale ");
+  debugPrintln(historyCount);
+}
 
-      // Stampa
-      Scheda& s = schede[i];
-      int numEtichette = max(1, s.numAttrezzi);
-      debugPrint("[AUTO] numAttrezzi=");
-      debugPrint(s.numAttrezzi);
-      debugPrint(" -> numEtichette=");
-      debugPrintln(numEtichette);
-
-      for (int j = 0; j < numEtichette; j++) {
-        debugPrint("[AUTO] Stampo etichetta ");
-        debugPrint(j + 1);
-        debugPrint("/");
-        debugPrintln(numEtichette);
-
-        char msg[40];
-        sprintf(msg, "Auto: %s (%d/%d)", s.numero, j + 1, numEtichette);
-        showMessage(msg, TFT_CYAN);
-
-        printEtichetta(s, j, numEtichette);
-        debugPrintln("[AUTO] printEtichetta completato");
-
-        // Pausa tra etichette multiple
-        if (j < numEtichette - 1) {
-          for (int sec = 8; sec > 0; sec--) {
-            char countdown[32];
-            sprintf(countdown, "Prossima in %ds...", sec);
-            showMessage(countdown, TFT_CYAN);
-            delay(1000);
-          }
-        }
-      }
+// ===== STATO SINCRONIZZAZIONE (NVS) =====
+// Timestamp dell'ultimo poll, numero fino a cui la lista è tutta in
+// history e generazione delle sincronizzazioni CSV restano in NVS. Al riavvio si
+// riparte da lì: niente getLastUpdate e niente "tutto il CSV già stampato",
+// le schede arrivate a dispositivo spento (o rimaste indietro in una
+// raffica interrotta) vengono stampate. Si scrive solo ciò che cambia.
+#undef LOG_SUB
+#define LOG_SUB LOG_SUB_POLL
+Preferences syncPrefs;
+SemaphoreHandle_t syncMutex = NULL;
+struct SyncState {
+  uint32_t ts;       // lastKnownTimestamp
+  int32_t lastSeen;  // Schede in lista fino a questo numero tutte in history, -1 = nessuna
+  uint32_t gen;      // Sincronizzazioni CSV riuscite
+};
+SyncState syncState = {0, -1, 0};
+bool syncStateValid = false;  // Letto da NVS all'avvio (non primo avvio)
+uint32_t syncNvsWrites = 0;
+
+void syncStateLoad() {
+  syncMutex = xSemaphoreCreateMutex();
+  if (!syncPrefs.begin("sync", false)) {
+    debugPrintln("[SYNC] NVS non disponibile");
+    return;
+  }
+  syncStateValid = syncPrefs.isKey("seen");
+  syncState.ts = syncPrefs.getUInt("ts", 0);
+  syncState.lastSeen = (int32_t)syncPrefs.getUInt("seen", (uint32_t)-1);
+  syncState.gen = syncPrefs.getUInt("gen", 0);
 
-      // Aggiungi a history
-      addToHistory(s.numero);
-      printed++;
-    }
+  debugPrint("[SYNC] Stato NVS: ");
+  if (!syncStateValid) {
+    debugPrintln("assente (primo avvio)");
+    return;
   }
+  char numero[12];
+  unpackNumero(syncState.lastSeen, numero, sizeof(numero));
+  debugPrint("ts ");
+  debugPrint((unsigned long)syncState.ts);
+  debugPrint(", ultima ");
+  debugPrint(numero);
+  debugPrint(", gen ");
+  debugPrintln((unsigned long)syncState.gen);
+}
 
-  if (printed > 0) {
-    savePrintHistory();
-    char msg[32];
-    sprintf(msg, "Stampate %d nuove", printed);
-    showMessage(msg, TFT_GREEN);
-    debugPrint("[AUTO] Stampate ");
-    debugPrint(printed);
-    debugPrintln(" nuove schede");
+void syncSaveTimestamp(unsigned long ts) {
+  if (!syncMutex) return;
+  xSemaphoreTake(syncMutex, portMAX_DELAY);
+  if (ts != syncState.ts) {
+    syncState.ts = ts;
+    syncPrefs.putUInt("ts", ts);
+    syncNvsWrites++;
+  }
+  xSemaphoreGive(syncMutex);
+}
 
-    // Aggiorna UI
-    drawList();
-  } else {
-    showMessage("", TFT_BLACK);
+void syncSaveSeen(int id) {
+  if (!syncMutex || id < 0) return;
+  xSemaphoreTake(syncMutex, portMAX_DELAY);
+  if (id > syncState.lastSeen) {
+    syncState.lastSeen = id;
+    syncPrefs.putUInt("seen", (uint32_t)id);
+    syncNvsWrites++;
   }
+  xSemaphoreGive(syncMutex);
 }
 
-// Check per nuove schede - solo controllo timestamp (non bloccante)
-bool checkTimestampChanged() {
-  unsigned long serverTs = fetchLastUpdate();
+// Avanza lastSeen fin dove la lista è stampata senza buchi, dalla scheda
+// più vecchia in su. Una scheda stampata prima di altre della stessa
+// raffica (polling veloce, o autoPrint che parte dalla più recente) non
+// la sposta: se si riavvia in quel momento, quelle rimaste indietro sono
+// ancora oltre lastSeen e syncCatchUp le stampa invece di segnarle fatte
+void syncUpdateSeen() {
+  SchedeRef schede;
+  int top = -1;
+  for (int i = schede.count() - 1; i >= 0; i--) {  // Lista dalla più recente
+    if (!isAlreadyPrinted(schede[i].numero)) break;
+    top = max(top, packNumero(schede[i].numero));
+  }
+  syncSaveSeen(top);
+}
 
-  if (serverTs > lastKnownTimestamp) {
-    debugPrint("[POLL] Timestamp cambiato: ");
-    debugPrint(lastKnownTimestamp);
-    debugPrint(" -> ");
-    debugPrintln(serverTs);
-    lastKnownTimestamp = serverTs;
-    return true;
+// CSV scaricato e salvato su SD
+void syncSaveGeneration() {
+  if (!syncMutex) return;
+  xSemaphoreTake(syncMutex, portMAX_DELAY);
+  syncState.gen++;
+  syncPrefs.putUInt("gen", syncState.gen);
+  syncNvsWrites++;
+  xSemaphoreGive(syncMutex);
+}
+
+// Avvio con stato salvato: le schede del CSV non in history oltre l'ultima
+// vista sono nuove e le stampa il loop (autoPrintNewSchede); quelle prima
+// (history persa, schede vecchie) si segnano come fatte
+void syncCatchUp() {
+  SchedeRef schede;
+  int nuove = 0;
+  int segnate = 0;
+  for (int i = 0; i < schede.count(); i++) {
+    if (isAlreadyPrinted(schede[i].numero)) continue;
+    if (packNumero(schede[i].numero) > syncState.lastSeen) {
+      nuove++;
+    } else {
+      addToHistory(schede[i].numero);
+      segnate++;
+    }
   }
-  return false;
+  savePrintHistory();
+  lastKnownTimestamp = syncState.ts;
+  if (nuove > 0) newSchedeReady = true;
+
+  debugPrint("[SYNC] Recupero: ");
+  debugPrint(nuove);
+  debugPrint(" da stampare, ");
+  debugPrint(segnate);
+  debugPrintln(" segnate come fatte");
 }
 
-// Tenta riconnessione WiFi (rotazione su tutte le reti)
-bool tryReconnectWifi() {
-  debugPrintln("[WIFI] Tentativo riconnessione...");
+// ===== POLLING & AUTO-PRINT =====
 
-  // Prova la prossima rete nella lista
-  int startIndex = currentNetworkIndex;
-  int tried = 0;
+// Polling ottimizzato: singola chiamata che verifica timestamp E ritorna scheda
+// Ritorna: 0 = nessuna novità, 1 = stampata nuova scheda, -1 = errore
+int pollAndPrint() {
+  if (WiFi.status() != WL_CONNECTED) {
+    debugPrintln("[POLL] WiFi non connesso");
+    wifiError = true;
+    showWifiStatus = true;
+    return -1;
+  }
 
-  while (tried < numSavedNetworks) {
-    currentNetworkIndex = (currentNetworkIndex + 1) % numSavedNetworks;
-    tried++;
+  HTTPClient http;
+  String url = String(API_URL) + "?action=pollPrinter&ts=" + String(lastKnownTimestamp);
+  http.begin(url);
+  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+  http.setTimeout(8000);  // 8 secondi (ridotto per velocità)
 
-    debugPrint("[WIFI] Provo: ");
-    debugPrintln(savedNetworks[currentNetworkIndex].ssid);
+  uint32_t pollStartUs = micros();
+  int httpCode = http.GET();
+  metricsHttp(httpCode);
 
-    WiFi.disconnect();
-    vTaskDelay(500 / portTICK_PERIOD_MS);
-    WiFi.begin(savedNetworks[currentNetworkIndex].ssid, savedNetworks[currentNetworkIndex].pass);
+  if (httpCode != HTTP_CODE_OK) {
+    mPollRtt.record(micros() - pollStartUs);
+    errorPrint("[POLL] HTTP error: ");
+    errorPrintln(httpCode);
+    http.end();
+    wifiError = true;
+    showWifiStatus = true;
+    return -1;
+  }
 
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 15) {
-      vTaskDelay(500 / portTICK_PERIOD_MS);
+  String response = http.getString();
+  http.end();
+  mPollRtt.record(micros() - pollStartUs);
+
+  // Connessione OK
+  if (wifiError) {
+    wifiError = false;
+    showWifiStatus = true;
+    debugPrintln("[POLL] Connessione ripristinata");
+  }
+
+  // Parse JSON
+  JsonDocument doc;
+  uint32_t parseStartUs = micros();
+  DeserializationError error = deserializeJson(doc, response);
+  mJsonParse.record(micros() - parseStartUs);
+  if (error) {
+    errorPrint("[POLL] JSON error: ");
+    errorPrintln(error.c_str());
+    return -1;
+  }
+
+  // Verifica se ts è un comando remoto (stringa) invece di un timestamp (numero)
+  JsonVariant tsVar = doc["ts"];
+  if (tsVar.is<const char*>()) {
+    const char* tsStr = tsVar.as<const char*>();
+    if (tsStr && strlen(tsStr) > 0) {
+      debugPrint("[POLL] Comando remoto: ");
+      debugPrintln(tsStr);
+      executeRemoteCommand(tsStr);
+      return 0;  // Comando eseguito, non è una nuova scheda
+    }
+  }
+
+  // ts è un numero (timestamp) o vuoto/0
+  double tsDouble = tsVar.as<double>();
+
+  // Se ts è 0 o vuoto, tratta come "nessun cambiamento" e mantieni lastKnownTimestamp
+  if (tsDouble == 0) {
+    return 0;
+  }
+
+  lastKnownTimestamp = (unsigned long)fmod(tsDouble, 1000000000.0);
+  syncSaveTimestamp(lastKnownTimestamp);
+
+  // Nessuna novità
+  if (!doc["changed"].as<bool>()) {
+    return 0;
+  }
+
+  debugPrintln("[POLL] Nuova scheda rilevata!");
+
+  // Verifica che ci sia una riparazione
+  if (doc["riparazione"].isNull()) {
+    debugPrintln("[POLL] Riparazione null");
+    return 0;
+  }
+
+  JsonObject obj = doc["riparazione"].as<JsonObject>();
+  const char* numero = obj["Numero"] | "";
+
+  // Controlla se già stampata
+  if (isAlreadyPrinted(numero)) {
+    debugPrint("[POLL] Scheda ");
+    debugPrint(numero);
+    debugPrintln(" gia' stampata");
+    return 0;
+  }
+
+  debugPrint("[POLL] Nuova scheda: ");
+  debugPrintln(numero);
+  markPrintTrigger();
+  pollPaperUs = pollStartUs ? pollStartUs : 1;
+  showMessage("Nuova scheda!", TFT_CYAN);
+
+  // Costruisci scheda per stampa
+  Scheda s;
+  memset(&s, 0, sizeof(Scheda));
+
+  strncpy(s.numero, numero, sizeof(s.numero) - 1);
+  strncpy(s.data, obj["Data consegna"] | "", sizeof(s.data) - 1);
+  strncpy(s.cliente, obj["Cliente"] | "", sizeof(s.cliente) - 1);
+  strncpy(s.indirizzo, obj["Indirizzo"] | "", sizeof(s.indirizzo) - 1);
+  strncpy(s.telefono, obj["Telefono"] | "", sizeof(s.telefono) - 1);
+  s.ddt = obj["DDT"] | false;
+
+  // Parse attrezzi
+  JsonArray attrezzi = obj["Attrezzi"].as<JsonArray>();
+  s.numAttrezzi = 0;
+  for (JsonObject att : attrezzi) {
+    if (s.numAttrezzi >= 5) break;
+    Attrezzo& a = s.attrezzi[s.numAttrezzi];
+    strncpy(a.marca, att["marca"] | "", sizeof(a.marca) - 1);
+    strncpy(a.dotazione, att["dotazione"] | "", sizeof(a.dotazione) - 1);
+    strncpy(a.note, att["note"] | "", sizeof(a.note) - 1);
+    s.numAttrezzi++;
+  }
+
+  // Riaccendi schermo
+  if (!screenOn) {
+    screenOn = true;
+    digitalWrite(TFT_BL, HIGH);
+    delay(100);
+  }
+
+  // Stampa (il task di stampa gestisce etichette e pause)
+  debugPrint("[POLL] Accodo ");
+  debugPrint(max(1, s.numAttrezzi));
+  debugPrintln(" etichette");
+  enqueuePrint(s, PAUSE_NORMAL_SEC, portMAX_DELAY, 0);
+
+  // Salva in history
+  addToHistory(s.numero);
+  savePrintHistory();
+
+  // Salva numero per sync CSV
+  strncpy(lastFastPrintNumero, s.numero, sizeof(lastFastPrintNumero) - 1);
+
+  showMessage("Stampato!", TFT_GREEN);
+  debugPrintln("[POLL] Stampa completata");
+
+  return 1;
+}
+
+// === FUNZIONI LEGACY (mantenute per compatibilità) ===
+
+// Fetch timestamp da API - ritorna 0 se errore
+unsigned long fetchLastUpdate() {
+  if (WiFi.status() != WL_CONNECTED) return 0;
+
+  HTTPClient http;
+  String url = String(API_URL) + "?action=getLastUpdate";
+  http.begin(url);
+  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+  http.setTimeout(8000);
+
+  int httpCode = http.GET();
+  metricsHttp(httpCode);
+  unsigned long ts = 0;
+
+  if (httpCode == HTTP_CODE_OK) {
+    String response = http.getString();
+    JsonDocument doc;
+    uint32_t parseStartUs = micros();
+    DeserializationError error = deserializeJson(doc, response);
+    mJsonParse.record(micros() - parseStartUs);
+    if (!error) {
+      double tsDouble = doc["ts"] | 0.0;
+      ts = (unsigned long)fmod(tsDouble, 1000000000.0);
+    }
+  }
+
+  http.end();
+  return ts;
+}
+
+// Fetch rapido ultima scheda (legacy, non più usata nel polling)
+bool fetchAndPrintLastScheda() {
+  if (WiFi.status() != WL_CONNECTED) return false;
+
+  HTTPClient http;
+  String url = String(API_URL) + "?action=getRiparazioni&limit=1";
+  http.begin(url);
+  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+  http.setTimeout(8000);
+
+  int httpCode = http.GET();
+  metricsHttp(httpCode);
+
+  if (httpCode != HTTP_CODE_OK) {
+    errorPrint("[FAST] HTTP error: ");
+    errorPrintln(httpCode);
+    http.end();
+    return false;
+  }
+
+  String response = http.getString();
+  http.end();
+
+  debugPrint("[FAST] Response: ");
+  debugPrint(response.length());
+  debugPrintln(" bytes");
+
+  // Parse JSON
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, response);
+  if (error) {
+    errorPrint("[FAST] JSON error: ");
+    errorPrintln(error.c_str());
+    return false;
+  }
+
+  JsonArray arr = doc["riparazioni"].as<JsonArray>();
+  if (arr.size() == 0) {
+    debugPrintln("[FAST] Nessuna scheda trovata");
+    return false;
+  }
+
+  // Prendi la prima (ultima inserita)
+  JsonObject obj = arr[0];
+  const char* numero = obj["Numero"] | "";
+
+  // Controlla se già stampata
+  if (isAlreadyPrinted(numero)) {
+    debugPrint("[FAST] Scheda ");
+    debugPrint(numero);
+    debugPrintln(" gia' stampata");
+    return false;
+  }
+
+  debugPrint("[FAST] Nuova scheda: ");
+  debugPrintln(numero);
+
+  // Costruisci scheda temporanea per stampa
+  Scheda s;
+  memset(&s, 0, sizeof(Scheda));
+
+  strncpy(s.numero, numero, sizeof(s.numero) - 1);
+
+  const char* data = obj["Data consegna"] | "";
+  strncpy(s.data, data, sizeof(s.data) - 1);
+
+  const char* cliente = obj["Cliente"] | "";
+  strncpy(s.cliente, cliente, sizeof(s.cliente) - 1);
+
+  const char* indirizzo = obj["Indirizzo"] | "";
+  strncpy(s.indirizzo, indirizzo, sizeof(s.indirizzo) - 1);
+
+  const char* telefono = obj["Telefono"] | "";
+  strncpy(s.telefono, telefono, sizeof(s.telefono) - 1);
+  s.ddt = obj["DDT"] | false;
+
+  // Parse attrezzi
+  JsonArray attrezzi = obj["Attrezzi"].as<JsonArray>();
+  s.numAttrezzi = 0;
+  for (JsonObject att : attrezzi) {
+    if (s.numAttrezzi >= 5) break;
+    Attrezzo& a = s.attrezzi[s.numAttrezzi];
+    const char* marca = att["marca"] | "";
+    const char* dotazione = att["dotazione"] | "";
+    const char* note = att["note"] | "";
+    strncpy(a.marca, marca, sizeof(a.marca) - 1);
+    strncpy(a.dotazione, dotazione, sizeof(a.dotazione) - 1);
+    strncpy(a.note, note, sizeof(a.note) - 1);
+    s.numAttrezzi++;
+  }
+
+  // Riaccendi schermo per mostrare stampa
+  if (!screenOn) {
+    printFromSleep = true;  // Segnala a printEtichetta di usare 31 caratteri
+    screenOn = true;
+    digitalWrite(TFT_BL, HIGH);
+    delay(100);
+  }
+
+  // Stampa (il task di stampa gestisce etichette e pause)
+  debugPrint("[FAST] Accodo ");
+  debugPrint(max(1, s.numAttrezzi));
+  debugPrintln(" etichette");
+  enqueuePrint(s, PAUSE_NORMAL_SEC, portMAX_DELAY, 0);
+
+  // Aggiungi a history
+  addToHistory(s.numero);
+  savePrintHistory();
+
+  // Salva numero per verifica CSV
+  strncpy(lastFastPrintNumero, s.numero, sizeof(lastFastPrintNumero) - 1);
+  lastFastPrintNumero[sizeof(lastFastPrintNumero) - 1] = '\0';
+
+  showMessage("Stampa rapida OK!", TFT_GREEN);
+  debugPrintln("[FAST] Stampa completata");
+
+  return true;
+}
+
+// Download CSV e ritorna true se OK
+bool downloadCSV() {
+  if (WiFi.status() != WL_CONNECTED) return false;
+
+  showMessage("Download CSV...", TFT_YELLOW);
+  debugPrintln("[AUTO] Download CSV...");
+
+  HTTPClient http;
+  http.begin(CSV_URL);
+  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+  int httpCode = http.GET();
+  metricsHttp(httpCode);
+
+  if (httpCode == HTTP_CODE_OK) {
+    csvData = http.getString();
+    debugPrint("[AUTO] CSV: ");
+    debugPrint(csvData.length());
+    debugPrintln(" bytes");
+
+    // Salva su SD
+    if (sdOK) csvSave(csvData);
+    syncSaveGeneration();
+
+    http.end();
+    return true;
+  }
+
+  errorPrint("[AUTO] HTTP error: ");
+  errorPrintln(httpCode);
+  http.end();
+  return false;
+}
+
+// Stampa automatica nuove schede
+void autoPrintNewSchede() {
+  SchedeRef schede;
+  int printed = 0;
+
+  for (int i = 0; i < schede.count(); i++) {
+    if (!isAlreadyPrinted(schede[i].numero)) {
+      debugPrint("[AUTO] Nuova scheda: ");
+      debugPrintln(schede[i].numero);
+
+      // Stampa: accoda, si blocca solo se la coda è piena
+      const Scheda& s = schede[i];
+      tracePrint("[AUTO] numAttrezzi=");
+      tracePrintln(s.numAttrezzi);
+      enqueuePrint(s, PAUSE_NORMAL_SEC, portMAX_DELAY, 0);
+
+      // Aggiungi a history
+      addToHistory(s.numero);
+      printed++;
+    }
+  }
+
+  if (printed > 0) {
+    savePrintHistory();
+    char msg[32];
+    sprintf(msg, "Stampate %d nuove", printed);
+    showMessage(msg, TFT_GREEN);
+    debugPrint("[AUTO] Stampate ");
+    debugPrint(printed);
+    debugPrintln(" nuove schede");
+
+    // Aggiorna UI
+    drawList();
+  } else {
+    showMessage("", TFT_BLACK);
+  }
+}
+
+// Check per nuove schede - solo controllo timestamp (non bloccante)
+bool checkTimestampChanged() {
+  unsigned long serverTs = fetchLastUpdate();
+
+  if (serverTs > lastKnownTimestamp) {
+    debugPrint("[POLL] Timestamp cambiato: ");
+    debugPrint(lastKnownTimestamp);
+    debugPrint(" -> ");
+    debugPrintln(serverTs);
+    lastKnownTimestamp = serverTs;
+    return true;
+  }
+  return false;
+}
+
+// Tenta riconnessione WiFi (rotazione su tutte le reti)
+bool tryReconnectWifi() {
+  debugPrintln("[WIFI] Tentativo riconnessione...");
+
+  // Prova la prossima rete nella lista
+  int startIndex = currentNetworkIndex;
+  int tried = 0;
+
+  while (tried < numSavedNetworks) {
+    currentNetworkIndex = (currentNetworkIndex + 1) % numSavedNetworks;
+    tried++;
+
+    debugPrint("[WIFI] Provo: ");
+    debugPrintln(savedNetworks[currentNetworkIndex].ssid);
+
+    WiFi.disconnect();
+    vTaskDelay(500 / portTICK_PERIOD_MS);
+    WiFi.begin(savedNetworks[currentNetworkIndex].ssid, savedNetworks[currentNetworkIndex].pass);
+
+    int attempts = 0;
+    while (WiFi.status() != WL_CONNECTED && attempts < 15) {
+      vTaskDelay(500 / portTICK_PERIOD_MS);
+      debugPrint(".");
+      attempts++;
+    }
+
+    if (WiFi.status() == WL_CONNECTED) {
+      debugPrint("\n[WIFI] Riconnesso a ");
+      debugPrint(savedNetworks[currentNetworkIndex].ssid);
+      debugPrint(": ");
+      debugPrintln(WiFi.localIP());
+      wifiOK = true;
+      wifiError = false;
+      showWifiStatus = true;
+      return true;
+    }
+    debugPrintln(" fallito");
+  }
+
+  // Fallback: prova default se non nelle salvate
+  bool defaultInList = false;
+  for (int i = 0; i < numSavedNetworks; i++) {
+    if (strcmp(savedNetworks[i].ssid, DEFAULT_WIFI_SSID) == 0) {
+      defaultInList = true;
+      break;
+    }
+  }
+
+  if (!defaultInList && numSavedNetworks == 0) {
+    debugPrint("[WIFI] Provo default: ");
+    debugPrintln(DEFAULT_WIFI_SSID);
+
+    WiFi.disconnect();
+    vTaskDelay(500 / portTICK_PERIOD_MS);
+    WiFi.begin(DEFAULT_WIFI_SSID, DEFAULT_WIFI_PASS);
+
+    int attempts = 0;
+    while (WiFi.status() != WL_CONNECTED && attempts < 15) {
+      vTaskDelay(500 / portTICK_PERIOD_MS);
       debugPrint(".");
       attempts++;
     }
 
-    if (WiFi.status() == WL_CONNECTED) {
-      debugPrint("\n[WIFI] Riconnesso a ");
-      debugPrint(savedNetworks[currentNetworkIndex].ssid);
-      debugPrint(": ");
-      debugPrintln(WiFi.localIP());
-      wifiOK = true;
-      wifiError = false;
+    if (WiFi.status() == WL_CONNECTED) {
+      debugPrint("\n[WIFI] Riconnesso a default: ");
+      debugPrintln(WiFi.localIP());
+      wifiOK = true;
+      wifiError = false;
+      showWifiStatus = true;
+      return true;
+    }
+  }
+
+  errorPrintln("[WIFI] Riconnessione fallita su tutte le reti");
+  return false;
+}
+
+// Calcola intervallo polling in base all'ora corrente (NTP)
+// Lavoro (7:30-19:15): 2.2s  |  Transizione (7:00-7:30, 19:15-19:45): 60s  |  Notte: 3600s
+int getPollInterval() {
+  if (!ntpSynced) {
+    // Se NTP non sincronizzato, usa intervallo conservativo
+    return POLL_TRANS;
+  }
+
+  struct tm timeinfo;
+  if (!getLocalTime(&timeinfo)) {
+    // Fallback se getLocalTime fallisce
+    return POLL_TRANS;
+  }
+
+  int hour = timeinfo.tm_hour;
+  int minute = timeinfo.tm_min;
+  int totalMinutes = hour * 60 + minute;  // Minuti dall'inizio del giorno
+
+  // Fasce orarie in minuti:
+  // Lavoro: 7:30 (450) - 19:15 (1155)
+  // Transizione mattina: 7:00 (420) - 7:30 (450)
+  // Transizione sera: 19:15 (1155) - 19:45 (1185)
+  // Notte: tutto il resto
+
+  if (totalMinutes >= 450 && totalMinutes < 1155) {
+    // Fascia lavoro: 7:30 - 19:15
+    return POLL_FAST;
+  } else if ((totalMinutes >= 420 && totalMinutes < 450) ||
+             (totalMinutes >= 1155 && totalMinutes < 1185)) {
+    // Fascia transizione: 7:00-7:30 o 19:15-19:45
+    return POLL_TRANS;
+  } else {
+    // Notte
+    return POLL_NIGHT;
+  }
+}
+
+// ===== COMANDI REMOTI =====
+
+// Stampa scontrino con report di stato
+void printStatusReport() {
+  debugPrintln("[CMD] Stampa STATUS report");
+
+  // Riaccendi schermo se spento
+  if (!screenOn) {
+    screenOn = true;
+    digitalWrite(TFT_BL, HIGH);
+    delay(100);
+  }
+
+  showMessage("Stampa STATUS...", TFT_YELLOW);
+
+  // Reset stampante
+  escpos::emit(printerSerial, escpos::reset());
+  delay(100);
+
+  // Titolo (bold) + firmware: tutto fisso, costruito a compile-time
+  constexpr auto kTitolo = escpos::bold(true) + escpos::text("=== STATUS REPORT ===") +
+                           escpos::crlf() + escpos::bold(false) + escpos::crlf() +
+                           escpos::text("Firmware: v" FIRMWARE_VERSION) + escpos::crlf();
+  escpos::emit(printerSerial, kTitolo);
+
+  // Uptime
+  unsigned long uptime = millis() / 1000;
+  int hours = uptime / 3600;
+  int mins = (uptime % 3600) / 60;
+  int secs = uptime % 60;
+  printerSerial.print("Uptime: ");
+  printerSerial.print(hours);
+  printerSerial.print("h ");
+  printerSerial.print(mins);
+  printerSerial.print("m ");
+  printerSerial.print(secs);
+  printerSerial.println("s");
+
+  // WiFi
+  printerSerial.print("WiFi: ");
+  if (wifiOK && WiFi.status() == WL_CONNECTED) {
+    printerSerial.println("OK");
+    printerSerial.print("  SSID: ");
+    printerSerial.println(WiFi.SSID());
+    printerSerial.print("  IP: ");
+    printerSerial.println(WiFi.localIP());
+    printerSerial.print("  RSSI: ");
+    printerSerial.print(WiFi.RSSI());
+    printerSerial.println(" dBm");
+  } else {
+    printerSerial.println("ERRORE");
+  }
+
+  // NTP
+  printerSerial.print("NTP: ");
+  if (ntpSynced) {
+    struct tm timeinfo;
+    if (getLocalTime(&timeinfo)) {
+      char timeBuf[20];
+      sprintf(timeBuf, "%02d:%02d:%02d", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+      printerSerial.println(timeBuf);
+    } else {
+      printerSerial.println("Errore lettura");
+    }
+  } else {
+    printerSerial.println("Non sincronizzato");
+  }
+
+  // Polling interval attuale
+  printerSerial.print("Poll interval: ");
+  int interval = getPollInterval();
+  if (interval >= 60000) {
+    printerSerial.print(interval / 60000);
+    printerSerial.println(" min");
+  } else {
+    printerSerial.print(interval / 1000.0, 1);
+    printerSerial.println(" sec");
+  }
+
+  // SD Card
+  printerSerial.print("SD Card: ");
+  printerSerial.println(sdOK ? "OK" : "ERRORE");
+  if (csvStoreStats.rawBytes > 0) {
+    printerSerial.print(CSV_COMPRESSED ? "  CSV lzss: " : "  CSV: ");
+    printerSerial.print((unsigned long)(csvStoreStats.rawBytes / 1024));
+    printerSerial.print(" -> ");
+    printerSerial.print((unsigned long)(csvStoreStats.storedBytes / 1024));
+    printerSerial.print(" KB (");
+    printerSerial.print((int)(csvStoreStats.storedBytes * 100ULL / csvStoreStats.rawBytes));
+    printerSerial.print("%) ");
+    printerSerial.print((unsigned long)csvStoreStats.saveMs);
+    printerSerial.println(" ms");
+  }
+  if (csvStoreStats.loadMs > 0) {
+    printerSerial.print("  CSV letto in ");
+    printerSerial.print((unsigned long)csvStoreStats.loadMs);
+    printerSerial.println(" ms");
+  }
+  printerSerial.print("Flash: ");
+  if (flashOK) {
+    printerSerial.print((int)(LittleFS.usedBytes() / 1024));
+    printerSerial.print("/");
+    printerSerial.print((int)(LittleFS.totalBytes() / 1024));
+    printerSerial.println(" KB");
+    printerSerial.print("  lettura ");
+    printerSerial.print(flashBench.bytes);
+    printerSerial.print(" B: flash ");
+    printerSerial.print(flashBench.flashUs);
+    printerSerial.print("us SD ");
+    printerSerial.print(flashBench.sdUs);
+    printerSerial.println("us");
+  } else {
+    printerSerial.println("ERRORE");
+  }
+
+  // Schede in memoria
+  SchedeRef schede;
+  printerSerial.print("Schede in RAM: ");
+  printerSerial.print(schede.count());
+  printerSerial.print(" (gen ");
+  printerSerial.print(schede.gen());
+  printerSerial.print(", attese ");
+  printerSerial.print(schedeClaimWaits);
+  printerSerial.println(")");
+
+  // History stampe
+  printerSerial.print("Schede stampate: ");
+  printerSerial.print(historyCount);
+  printerSerial.print(" (");
+  printerSerial.print(printedBytes());
+  printerSerial.println(" byte)");
+  // Byte su SD per scheda: journal vs riscrittura completa del vecchio .txt (9 byte a riga)
+  printerSerial.print("  SD: ");
+  printerSerial.print(historySaved ? (unsigned long)(historyBytesWritten / historySaved) : 0UL);
+  printerSerial.print(" B/stampa (prima ");
+  printerSerial.print((unsigned long)historyCount * 9);
+  printerSerial.print(") journal ");
+  printerSerial.print((unsigned long)historyLogSize);
+  printerSerial.print("/");
+  printerSerial.print((unsigned long)historyCompactThreshold());
+  printerSerial.print(" B, compatt. ");
+  printerSerial.println(historyCompactions);
+  printerSerial.print("  ultime:");
+  for (int i = 0; i < min(printedRecentCount, 4); i++) {
+    char numero[12];
+    unpackNumero(printedRecentAt(i), numero, sizeof(numero));
+    printerSerial.print(" ");
+    printerSerial.print(numero);
+  }
+  printerSerial.println();
+
+  // Last timestamp
+  printerSerial.print("Last TS: ");
+  printerSerial.println(lastKnownTimestamp);
+
+  // Cache etichette + latenza richiesta -> primo byte
+  printerSerial.print("Cache etichette: ");
+  printerSerial.print(labelCacheUsed());
+  printerSerial.print("/");
+  printerSerial.println(LABEL_CACHE_JOBS);
+  const char* latNomi[3] = {"  render: ", "  cache:  ", "  manuale:"};
+  printerSerial.println("Latenza stampa (ms):");
+  for (int i = 0; i < 3; i++) {
+    printerSerial.print(latNomi[i]);
+    printerSerial.print(printLatency[i].lastUs / 1000.0, 1);
+    printerSerial.print(" max ");
+    printerSerial.print(printLatency[i].maxUs / 1000.0, 1);
+    printerSerial.print(" n=");
+    printerSerial.println(printLatency[i].count);
+  }
+  printerSerial.print("Manuale da: ram ");
+  printerSerial.print(manualSource[MANUAL_FROM_RAM]);
+  printerSerial.print(" prefetch ");
+  printerSerial.print(manualSource[MANUAL_FROM_PREFETCH]);
+  printerSerial.print(" archivio ");
+  printerSerial.print(manualSource[MANUAL_FROM_ARCHIVE]);
+  printerSerial.print(" indice ");
+  printerSerial.print(manualSource[MANUAL_FROM_INDEX]);
+  printerSerial.print(" scan ");
+  printerSerial.println(manualSource[MANUAL_FROM_SCAN]);
+
+  // Traffico SPI della lista dall'avvio (2 byte per pixel RGB565)
+  printerSerial.print("Display lista: ");
+  printerSerial.print(listPixels * 2 / 1024);
+  printerSerial.println(" KB");
+  printerSerial.print("Scroll: ");
+  printerSerial.print(listScrollSteps);
+  printerSerial.print(" passi, px ");
+  printerSerial.print(listScrollLastPx);
+  printerSerial.print(" max ");
+  printerSerial.println(listScrollMaxPx);
+
+  // Tempi frame per schermata: medio/max e quota in attesa dell'SPI
+  printerSerial.print("Pulsanti: ");
+  printerSerial.print(inputStats.events);
+  printerSerial.print(" lat ms ");
+  printerSerial.print(inputStats.lastLatUs / 1000.0, 1);
+  printerSerial.print(" max ");
+  printerSerial.print(inputStats.maxLatUs / 1000.0, 1);
+  printerSerial.print(" rimb ");
+  printerSerial.print(inputStats.bounces);
+  printerSerial.print(" persi ");
+  printerSerial.println(inputStats.dropped);
+  printerSerial.print("Loop ms: ");
+  printerSerial.print(loopLastUs / 1000.0, 1);
+  printerSerial.print(" max ");
+  printerSerial.println(loopMaxUs / 1000.0, 1);
+  printerSerial.print("Richieste UI: ");
+  printerSerial.print(uiPosted);
+  printerSerial.print(" (unite ");
+  printerSerial.print(uiCoalesced);
+  printerSerial.print(") frame ");
+  printerSerial.println(uiRendered);
+  const char* uiNomi[UI_SCREENS] = {"  lista: ", "  msg:   ", "  manual:"};
+  printerSerial.print("Frame UI (ms)");
+  printerSerial.println(uiSprites ? " DMA:" : ":");
+  for (int i = 0; i < UI_SCREENS; i++) {
+    const UiFrameStats& st = uiStats[i];
+    printerSerial.print(uiNomi[i]);
+    printerSerial.print(st.frames ? st.totUs / st.frames / 1000.0 : 0.0, 1);
+    printerSerial.print(" max ");
+    printerSerial.print(st.maxUs / 1000.0, 1);
+    printerSerial.print(" spi ");
+    printerSerial.print(st.totUs ? (int)(st.spiUs * 100 / st.totUs) : 0);
+    printerSerial.println("%");
+  }
+
+  // Risparmio energetico (stima, non misura)
+  uint32_t powerMa = powerEstimateMa();
+  uint64_t powerTot = powerStats.activeUs + powerStats.idleUs;
+  uint64_t idleAwake = min(powerStats.idleAwakeUs, powerStats.idleUs);
+  printerSerial.print("Energia: idle ");
+  printerSerial.print(powerTot ? (int)(powerStats.idleUs * 100 / powerTot) : 0);
+  printerSerial.print("% sveglio ");
+  printerSerial.print(powerStats.idleUs ? (int)(idleAwake * 100 / powerStats.idleUs) : 0);
+  printerSerial.print("% ~");
+  printerSerial.print(powerMa);
+  printerSerial.print(" mA (");
+  printerSerial.print(powerModeName());
+  printerSerial.println(")");
+
+  // Indice schede (ricerca per cliente)
+  printerSerial.print("Indice: ");
+  printerSerial.print(jobDir.count);
+  printerSerial.print(" schede in ");
+  printerSerial.print((unsigned long)jobDirBuildMs);
+  printerSerial.print("ms, ricerca ");
+  printerSerial.print((unsigned long)jobDirLookupUs);
+  printerSerial.print("us max ");
+  printerSerial.print((unsigned long)jobDirLookupMaxUs);
+  printerSerial.println("us");
+  printerSerial.print("  idx SD: incr ");
+  printerSerial.print(jobIdxIncremental);
+  printerSerial.print(" completi ");
+  printerSerial.print(jobIdxFull);
+  printerSerial.print(" scritti ");
+  printerSerial.print(jobIdxBytesWritten / 1024);
+  printerSerial.println(" KB");
+  printerSerial.print("Archivio: scritti ");
+  printerSerial.print(archiveWritten);
+  printerSerial.print(" invariati ");
+  printerSerial.print(archiveSkipped);
+  printerSerial.print(" ricerca ");
+  printerSerial.print((unsigned long)archiveLookupUs);
+  printerSerial.print("us max ");
+  printerSerial.print((unsigned long)archiveLookupMaxUs);
+  printerSerial.println("us");
+
+  // Stato sincronizzazione persistente
+  char syncNumero[12];
+  unpackNumero(max(0, (int)syncState.lastSeen), syncNumero, sizeof(syncNumero));
+  printerSerial.print("Sync: gen ");
+  printerSerial.print(syncState.gen);
+  printerSerial.print(" ultima ");
+  printerSerial.print(syncNumero);
+  printerSerial.print(" NVS ");
+  printerSerial.println(syncNvsWrites);
+
+  // Task storage: latenza per tipo (attesa in coda + operazione)
+  printerSerial.println("SD (ms): media max n");
+  for (int i = 0; i < ST_KINDS; i++) {
+    const StorageStats& st = storageStats[i];
+    if (st.ops == 0) continue;
+    printerSerial.print("  ");
+    printerSerial.print(kStorageKindName[i]);
+    printerSerial.print(": ");
+    printerSerial.print(st.totalUs / st.ops / 1000.0, 1);
+    printerSerial.print(" ");
+    printerSerial.print(st.maxUs / 1000.0, 1);
+    printerSerial.print(" ");
+    printerSerial.println(st.ops);
+  }
+  printerSerial.print("  append ");
+  printerSerial.print((unsigned long)storageAppends.load());
+  printerSerial.print(" -> scritture ");
+  printerSerial.print(storageWrites);
+  printerSerial.print(" errori ");
+  printerSerial.println(storageAppendErrors);
+
+  // Free heap
+  printerSerial.print("Free heap: ");
+  printerSerial.print(ESP.getFreeHeap() / 1024);
+  printerSerial.println(" KB");
+
+  // Chiusura + avanza carta
+  constexpr auto kChiusura = escpos::crlf() + escpos::text("=====================") +
+                             escpos::crlf() + escpos::feedDots(40);
+  escpos::emit(printerSerial, kChiusura);
+
+  showMessage("STATUS stampato", TFT_GREEN);
+  delay(1500);
+  drawList();
+}
+
+// ===== METRICHE =====
+
+void metricsHttp(int httpCode) {
+  if (httpCode >= 200 && httpCode < 600) mHttp[httpCode / 100 - 2].add();
+  else mHttp[HTTP_ERR].add();  // Errori di HTTPClient (negativi) e codici anomali
+}
+
+// Valori istantanei: campionati dal polling e prima di ogni lettura
+void metricsSample() {
+  mHeapFree.set(ESP.getFreeHeap());
+  mHeapMin.set(ESP.getMinFreeHeap());
+  mPsramMin.set(ESP.getMinFreePsram());
+
+  portENTER_CRITICAL(&logMux);
+  LogStats ls = logStats;
+  portEXIT_CRITICAL(&logMux);
+  mLogCalls.set(ls.calls);
+  mLogAvgCycles.set(ls.calls ? (int32_t)(ls.cycles / ls.calls) : 0);
+  mLogMaxCycles.set(ls.maxCycles);
+  mLogDropped.set(ls.dropped);
+}
+
+const metrics::Entry kMetrics[] = {
+  {"poll.rtt", &mPollRtt},
+  {"poll.paper", &mPollPaper},
+  {"http.2xx", &mHttp[HTTP_2XX]},
+  {"http.3xx", &mHttp[HTTP_3XX]},
+  {"http.4xx", &mHttp[HTTP_4XX]},
+  {"http.5xx", &mHttp[HTTP_5XX]},
+  {"http.err", &mHttp[HTTP_ERR]},
+  {"json.parse", &mJsonParse},
+  {"csv.parse", &mCsvParse},
+  {"sd.op", &mSdOp},
+  {"label.print", &mLabelPrint},
+  {"heap.free", &mHeapFree},
+  {"heap.min", &mHeapMin},
+  {"psram.min", &mPsramMin},
+  {"log.calls", &mLogCalls},
+  {"log.cyc.avg", &mLogAvgCycles},
+  {"log.cyc.max", &mLogMaxCycles},
+  {"log.persi", &mLogDropped},
+};
+
+void metricsPrint(Print& out) {
+  metricsSample();
+  metrics::print(out, kMetrics, sizeof(kMetrics) / sizeof(kMetrics[0]));
+}
+
+// Comando METRICS: su carta (come STATUS) e su seriale
+void printMetricsReport() {
+  debugPrintln("[CMD] Stampa METRICS");
+  Serial.println("=== METRICS ===");
+  metricsPrint(Serial);
+
+  escpos::emit(printerSerial, escpos::reset());
+  delay(100);
+  constexpr auto kTitolo = escpos::bold(true) + escpos::text("=== METRICS ===") +
+                           escpos::crlf() + escpos::bold(false);
+  escpos::emit(printerSerial, kTitolo);
+  metricsPrint(printerSerial);
+  constexpr auto kChiusura = escpos::crlf() + escpos::text("=====================") +
+                             escpos::crlf() + escpos::feedDots(40);
+  escpos::emit(printerSerial, kChiusura);
+  showMessage("METRICS stampato", TFT_GREEN);
+}
+
+// ===== CONSOLE SERIALE =====
+// Comandi dal monitor seriale, una riga per comando (\n o \r)
+#define CONSOLE_LINE_MAX 32
+char consoleLine[CONSOLE_LINE_MAX];
+size_t consoleLen = 0;
+
+void consoleExecute(const char* cmd) {
+  if (strcmp(cmd, "METRICS") == 0) {
+    metricsPrint(Serial);
+    return;
+  }
+  Serial.print("[CONSOLE] Comando sconosciuto: ");
+  Serial.println(cmd);
+  Serial.println("[CONSOLE] Comandi: METRICS");
+}
+
+// Callback di ricezione della UART (task eventi del driver, non il loop)
+void consoleReceive() {
+  while (Serial.available()) {
+    int c = Serial.read();
+    if (c == '\n' || c == '\r') {
+      if (consoleLen == 0) continue;
+      consoleLine[consoleLen] = '\0';
+      consoleLen = 0;
+      consoleExecute(consoleLine);
+    } else if (consoleLen < CONSOLE_LINE_MAX - 1) {
+      consoleLine[consoleLen++] = toupper(c);
+    }
+  }
+}
+
+// Esegue un comando remoto ricevuto via M1
+void executeRemoteCommand(const char* cmd) {
+  debugPrint("[CMD] Esecuzione: ");
+  debugPrintln(cmd);
+
+  // Riaccendi schermo se spento
+  if (!screenOn) {
+    screenOn = true;
+    digitalWrite(TFT_BL, HIGH);
+    delay(100);
+  }
+
+  // REBOOT
+  if (strcmp(cmd, "REBOOT") == 0) {
+    showMessage("REBOOT remoto...", TFT_YELLOW);
+    delay(1000);
+    logFlush();
+    ESP.restart();
+    return;
+  }
+
+  // OTA
+  if (strcmp(cmd, "OTA") == 0) {
+    showMessage("OTA remoto...", TFT_YELLOW);
+    delay(500);
+    if (performOTAUpdate()) {
+      // Se OTA riesce, il dispositivo si riavvia automaticamente
+    } else {
+      showMessage("OTA fallito!", TFT_RED);
+      delay(2000);
+      drawList();
+    }
+    return;
+  }
+
+  // STATUS - Il report va sulla stampante: lo stampa il task di stampa,
+  // in coda dopo le etichette già accodate
+  if (strcmp(cmd, "STATUS") == 0) {
+    enqueueStatusReport(portMAX_DELAY);
+    return;
+  }
+
+  // METRICS - Contatori e istogrammi di latenza
+  if (strcmp(cmd, "METRICS") == 0) {
+    enqueueMetricsReport(portMAX_DELAY);
+    return;
+  }
+
+  // PRINT:XX/XXXX - Forza stampa di una o più schede
+  // Accetta intervalli e liste: PRINT:26/0010-26/0025,26/0030
+  if (strncmp(cmd, "PRINT:", 6) == 0) {
+    const char* spec = cmd + 6;  // Salta "PRINT:"
+    markPrintTrigger();
+    debugPrint("[CMD] Forza stampa: ");
+    debugPrintln(spec);
+
+    showMessage("Ricerca scheda...", TFT_YELLOW);
+    printBatch(spec);
+    return;
+  }
+
+  // Comando non riconosciuto
+  debugPrint("[CMD] Comando sconosciuto: ");
+  debugPrintln(cmd);
+  showMessage("Cmd sconosciuto", TFT_RED);
+  delay(1500);
+  drawList();
+}
+
+// Task di polling su core 0 (loop principale gira su core 1)
+void pollTask(void* parameter) {
+  debugPrintln("[TASK] Poll task avviato su core 0");
+
+  unsigned long lastWifiCheck = 0;
+
+  for (;;) {
+    unsigned long now = millis();
+    uint64_t wakeUs = esp_timer_get_time();
+    metricsSample();
+
+    // Se WiFi disconnesso, prova a riconnettersi ogni 60s
+    if (WiFi.status() != WL_CONNECTED) {
+      wifiOK = false;
+      wifiError = true;
       showWifiStatus = true;
-      return true;
+
+      if (now - lastWifiCheck >= WIFI_RETRY_INTERVAL) {
+        lastWifiCheck = now;
+        tryReconnectWifi();
+      }
     }
-    debugPrintln(" fallito");
+
+    // Polling ottimizzato: singola chiamata che verifica E stampa
+    if (wifiOK && !newSchedeReady) {
+      int result = pollAndPrint();
+
+      if (result == 1) {
+        // Stampata nuova scheda, aggiorna CSV in background
+        debugPrintln("[TASK] Aggiorno CSV in background...");
+
+        for (int retry = 0; retry < 10; retry++) {
+          vTaskDelay(10000 / portTICK_PERIOD_MS);
+
+          debugPrint("[TASK] CSV tentativo ");
+          debugPrint(retry + 1);
+          debugPrintln("/10");
+
+          if (downloadCSV()) {
+            parseCSV(csvData);
+
+            // Verifica che CSV contenga la scheda stampata
+            if (lastFastPrintNumero[0] != '\0') {
+              if (!isSchedaInList(lastFastPrintNumero)) {
+                debugPrint("[TASK] CSV non contiene ancora ");
+                debugPrintln(lastFastPrintNumero);
+                continue;
+              }
+              debugPrint("[TASK] CSV sincronizzato con ");
+              debugPrintln(lastFastPrintNumero);
+            }
+
+            // Verifica altre schede non stampate
+            SchedeRef schede;
+            int newCount = 0;
+            for (int i = 0; i < schede.count(); i++) {
+              if (!isAlreadyPrinted(schede[i].numero)) {
+                newCount++;
+              }
+            }
+
+            if (newCount > 0) {
+              debugPrint("[TASK] Trovate altre ");
+              debugPrint(newCount);
+              debugPrintln(" schede da stampare");
+              newSchedeReady = true;
+            } else {
+              debugPrint("[TASK] Lista sincronizzata (");
+              debugPrint(schede.count());
+              debugPrintln(" schede)");
+              newSchedeReady = true;
+            }
+
+            lastFastPrintNumero[0] = '\0';
+            break;
+          }
+        }
+
+        lastFastPrintNumero[0] = '\0';
+      }
+    }
+    // Polling dinamico basato su fascia oraria
+    // In modalità debug stampa su carta: polling più lento per risparmiare carta
+    int pollDelay = debugPrintMode ? 5000 : getPollInterval();
+    if (powerIdle) powerStats.idleAwakeUs += esp_timer_get_time() - wakeUs;
+    // Batch PRINT: in corso: si accodano le schede man mano che la coda si
+    // libera, senza rimandare il prossimo polling
+    while (pollDelay > 0 && printBatchStep()) {
+      vTaskDelay(BATCH_STEP_MS / portTICK_PERIOD_MS);
+      pollDelay -= BATCH_STEP_MS;
+    }
+    if (pollDelay > 0) vTaskDelay(pollDelay / portTICK_PERIOD_MS);
+  }
+}
+
+// ===== SPRITE + DMA DISPLAY =====
+// Le regioni che cambiano spesso (righe lista, barra messaggi, inserimento
+// manuale) si compongono in sprite in PSRAM e vanno al display via DMA.
+// Il DMA SPI dell'ESP32 non legge la PSRAM: lo sprite passa a bande da due
+// buffer in RAM interna, e mentre il DMA invia una banda la CPU copia la
+// successiva o compone già la riga seguente. Senza PSRAM/DMA si disegna
+// direttamente come prima.
+#undef LOG_SUB
+#define LOG_SUB LOG_SUB_UI
+#define UI_BOUNCE_LINES 8
+#define UI_BOUNCE_WIDTH 270       // Sprite più largo: area manuale
+#define LIST_ROW_WIDTH (320 - BUTTON_PANEL_WIDTH - SCROLLBAR_WIDTH - 4)
+#define MSG_BAR_WIDTH (320 - BUTTON_PANEL_WIDTH - SCROLLBAR_WIDTH - 2)
+
+TFT_eSprite rowSprite = TFT_eSprite(&tft);     // Una riga lista
+TFT_eSprite msgSprite = TFT_eSprite(&tft);     // Barra messaggi
+TFT_eSprite manualSprite = TFT_eSprite(&tft);  // Area inserimento manuale
+uint16_t* uiBounce[2] = {NULL, NULL};
+int uiBounceIdx = 0;
+uint32_t uiFrameStartUs = 0;
+uint32_t uiFrameSpiUs = 0;
+
+void uiInit() {
+  uiMutex = xSemaphoreCreateRecursiveMutex();
+
+  for (int i = 0; i < 2; i++) {
+    uiBounce[i] = (uint16_t*)heap_caps_malloc(UI_BOUNCE_WIDTH * UI_BOUNCE_LINES * 2, MALLOC_CAP_DMA);
+  }
+  rowSprite.setAttribute(PSRAM_ENABLE, true);
+  msgSprite.setAttribute(PSRAM_ENABLE, true);
+  manualSprite.setAttribute(PSRAM_ENABLE, true);
+
+  uiSprites = uiBounce[0] && uiBounce[1] &&
+              rowSprite.createSprite(LIST_ROW_WIDTH, 21) &&
+              msgSprite.createSprite(MSG_BAR_WIDTH, 20) &&
+              manualSprite.createSprite(320 - BUTTON_PANEL_WIDTH, 240 - HEADER_HEIGHT) &&
+              tft.initDMA();
+
+  debugPrint("[UI] Sprite + DMA: ");
+  debugPrintln(uiSprites ? "OK" : "NO (disegno diretto)");
+}
+
+// Inizio frame: prende il display per tutta la composizione
+void uiBegin() {
+  if (uiMutex) xSemaphoreTakeRecursive(uiMutex, portMAX_DELAY);
+  uiFrameStartUs = micros();
+  uiFrameSpiUs = 0;
+  if (uiSprites) tft.startWrite();
+}
+
+// Attende la banda in volo: prima di riusare un buffer o di disegnare diretto
+void uiWaitDMA() {
+  if (!uiSprites) return;
+  uint32_t t = micros();
+  tft.dmaWait();
+  uiFrameSpiUs += micros() - t;
+}
+
+// Invia (w x h) dall'angolo dello sprite a (x, y), a bande via DMA.
+// Ritorna subito dopo aver avviato l'ultima banda
+void uiPushSprite(TFT_eSprite& spr, int x, int y, int w, int h) {
+  const uint16_t* src = (const uint16_t*)spr.getPointer();
+  int sw = spr.width();
+  for (int line = 0; line < h; line += UI_BOUNCE_LINES) {
+    int n = min(UI_BOUNCE_LINES, h - line);
+    // Copia nel buffer libero mentre l'altro è ancora in trasmissione
+    uint16_t* dst = uiBounce[uiBounceIdx];
+    for (int r = 0; r < n; r++) {
+      memcpy(dst + r * w, src + (line + r) * sw, w * 2);
+    }
+    uiWaitDMA();
+    tft.pushImageDMA(x, y + line, w, n, dst);
+    uiBounceIdx ^= 1;
+  }
+}
+
+// Fine frame: svuota il DMA e registra i tempi per tipo di schermata
+void uiEnd(UiScreen screen, bool drawn) {
+  if (uiSprites) {
+    uiWaitDMA();
+    tft.endWrite();
+  }
+  if (drawn) {
+    uint32_t us = micros() - uiFrameStartUs;
+    UiFrameStats& st = uiStats[screen];
+    st.frames++;
+    st.lastUs = us;
+    if (us > st.maxUs) st.maxUs = us;
+    st.totUs += us;
+    // Disegno diretto: tutto il frame è tempo SPI
+    st.spiUs += uiSprites ? uiFrameSpiUs : us;
+  }
+  if (uiMutex) xSemaphoreGiveRecursive(uiMutex);
+}
+
+// ===== UI DISPLAY =====
+void drawButtons() {
+  // Pannello pulsanti a destra (landscape 320x240)
+  int panelX = 320 - BUTTON_PANEL_WIDTH;
+  int btnHeight = 80;  // Altezza di ogni pulsante (240 / 3)
+
+  // Sfondo pannello (bordo grigio)
+  tft.fillRect(panelX, 0, BUTTON_PANEL_WIDTH, 240, TFT_DARKGREY);
+
+  // Pulsante SU (in alto) - sfondo nero, triangolo bianco
+  tft.fillRect(panelX + 1, 1, BUTTON_PANEL_WIDTH - 2, btnHeight - 2, TFT_BLACK);
+  int centerX = panelX + BUTTON_PANEL_WIDTH / 2;
+  int centerY1 = btnHeight / 2;
+  tft.fillTriangle(
+    centerX - 15, centerY1 + 10,   // punta basso sx
+    centerX, centerY1 - 12,        // punta alto centro
+    centerX + 15, centerY1 + 10,   // punta basso dx
+    TFT_WHITE
+  );
+
+  // Pulsante OK (centro) - sfondo nero, testo bianco
+  tft.fillRect(panelX + 1, btnHeight + 1, BUTTON_PANEL_WIDTH - 2, btnHeight - 2, TFT_BLACK);
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  tft.setTextSize(2);
+  tft.setCursor(panelX + 10, btnHeight + btnHeight / 2 - 8);
+  tft.print("OK");
+
+  // Pulsante GIU (in basso) - sfondo nero, triangolo bianco
+  tft.fillRect(panelX + 1, btnHeight * 2 + 1, BUTTON_PANEL_WIDTH - 2, btnHeight - 2, TFT_BLACK);
+  int centerY3 = btnHeight * 2 + btnHeight / 2;
+  tft.fillTriangle(
+    centerX - 15, centerY3 - 10,  // punta alto sx
+    centerX, centerY3 + 12,       // punta basso centro
+    centerX + 15, centerY3 - 10,  // punta alto dx
+    TFT_WHITE
+  );
+}
+
+// Forza il ridisegno completo alla prossima drawList (dopo fillScreen)
+void invalidateList() {
+  listValid = false;
+}
+
+// Geometria riga: altezza alternata 20/21px (media 20.5px)
+int listRowY(int i) {
+  return HEADER_HEIGHT + 5 + (i * 41) / 2;  // +5 invece di +4 per prima riga
+}
+
+// Sorgente righe della lista: la UI chiede solo le righe visibili per
+// indice, senza sapere da dove vengono (schede in RAM o risultati di una
+// ricerca per cliente nell'indice)
+struct ListRow {
+  const char* numero;
+  const char* cliente;
+  bool completato;
+  char numBuf[12];  // Copie: indice e lista possono cambiare sotto
+  char cliBuf[sizeof(Scheda::cliente)];
+};
+
+// Risultati della ricerca per cliente mostrati al posto della lista
+bool searchFilter = false;
+char searchFilterQuery[JOB_KEY_LEN + 1] = "";
+int searchLo = 0;
+int searchCount = 0;
+uint32_t searchGen = 0;
+
+// Intervallo dei risultati, ricalcolato se l'indice è stato ricostruito (mutex preso)
+void searchFilterRefresh() {
+  if (searchGen == jobDirGen) return;
+  searchCount = jobDirSearch(searchFilterQuery, searchLo);
+  searchGen = jobDirGen;
+}
+
+int listRowCount() {
+  if (!searchFilter) return SchedeRef().count();
+  xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+  searchFilterRefresh();
+  int n = searchCount;
+  xSemaphoreGive(jobDirMutex);
+  return n;
+}
+
+bool listRowAt(int idx, ListRow& out) {
+  if (searchFilter) {
+    xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+    searchFilterRefresh();
+    bool ok = idx >= 0 && idx < searchCount;
+    if (ok) {
+      const JobDirEntry& e = jobDir.entries[jobDir.byName[searchLo + idx]];
+      unpackNumero(e.id, out.numBuf, sizeof(out.numBuf));
+      strcpy(out.cliBuf, e.cliente);
+      out.numero = out.numBuf;
+      out.cliente = out.cliBuf;
+      out.completato = e.completato;
+    }
+    xSemaphoreGive(jobDirMutex);
+    return ok;
+  }
+  SchedeRef schede;
+  if (idx < 0 || idx >= schede.count()) return false;
+  strcpy(out.numBuf, schede[idx].numero);
+  strcpy(out.cliBuf, schede[idx].cliente);
+  out.numero = out.numBuf;
+  out.cliente = out.cliBuf;
+  out.completato = schede[idx].completato;
+  return true;
+}
+
+// Hash di ciò che la riga mostra: cambia solo se cambia il disegno
+uint32_t listRowContentHash(int idx) {
+  ListRow r;
+  if (!listRowAt(idx, r)) return 1;  // Riga vuota
+  uint32_t h = 2166136261u;
+  h = fnv1a(h, r.numero);
+  h = fnv1a(h, r.cliente);
+  h ^= (r.completato ? 2 : 0) | (idx == selectedIndex ? 4 : 0);
+  return h | 8;  // Mai 0 (= da ridisegnare) né 1 (= vuota)
+}
+
+// Disegna la riga i su g; (ox, oy) = origine di g in coordinate schermo
+// (tft: 0,0 - sprite di riga: angolo della riga)
+void drawListRow(TFT_eSPI& g, int i, int ox, int oy) {
+  int idx = scrollOffset + i;
+  int listX = SCROLLBAR_WIDTH + 2;  // Dopo scrollbar + gap
+  int listWidth = 320 - BUTTON_PANEL_WIDTH - listX;
+  int y = listRowY(i);
+  int rowH = (i % 2 == 0) ? 20 : 21;
+  bool selected = (idx == selectedIndex);
+  ListRow r;
+  bool exists = listRowAt(idx, r);
+
+  // Sfondo riga: bianco se selezionata, nero altrimenti (o riga vuota)
+  g.fillRect(listX - ox, y - 2 - oy, listWidth - 2, rowH, selected && exists ? TFT_WHITE : TFT_BLACK);
+  listPixels += (listWidth - 2) * rowH;
+  if (!exists) return;
+
+  // Usa font built-in numero 2 (piccolo, proporzionale)
+  g.setTextFont(2);
+  g.setTextSize(1);
+
+  if (selected) {
+    g.setTextColor(TFT_BLACK, TFT_WHITE);
+  } else {
+    g.setTextColor(r.completato ? TFT_DARKGREY : TFT_WHITE, TFT_BLACK);
+  }
+
+  // Numero + Cliente
+  g.setCursor(listX + 2 - ox, y - oy);
+  g.print(r.numero);
+  g.print(" ");
+
+  // Troncamento: "COSTRUZIONI TAGLIAMENTO SRL" -> "COSTRUZIONI TAGLIAMENTO S."
+  // 26 caratteri max per cliente (dopo numero 7 char + spazio)
+  char cliente[sizeof(Scheda::cliente)];
+  cliente[0] = '\0';
+  appendTrunc(cliente, sizeof(cliente), r.cliente, 26);
+  g.print(cliente);
+
+  // Indicatore stato completato
+  if (r.completato) {
+    g.setTextColor(TFT_GREEN, selected ? TFT_WHITE : TFT_BLACK);
+    g.setCursor(listX + listWidth - 16 - ox, y - oy);
+    g.print("V");
+  }
+}
+
+// Ridisegna solo le righe il cui contenuto o stato di selezione è cambiato
+// (solo dal task display: altrove usare drawList)
+void renderList() {
+  // Schermo spento: niente SPI, si ridisegna al risveglio (vedi loop)
+  if (!screenOn) {
+    listStale = true;
+    return;
+  }
+  listStale = false;
+
+  // Area lista (landscape: sotto header, a sinistra dei pulsanti)
+  // Scrollbar a sinistra, poi lista, poi pulsanti a destra
+  int listTop = HEADER_HEIGHT;
+  int listX = SCROLLBAR_WIDTH + 2;
+  int listHeight = 240 - HEADER_HEIGHT;
+  bool drawn = false;
+  uint32_t pixelsBefore = listPixels;
+
+  uiBegin();
+
+  if (!listValid) {
+    // Pulisci area scrollbar + lista
+    tft.fillRect(0, listTop, 320 - BUTTON_PANEL_WIDTH, listHeight, TFT_BLACK);
+    listPixels += (320 - BUTTON_PANEL_WIDTH) * listHeight;
+    for (int i = 0; i < VISIBLE_ROWS; i++) listRowHash[i] = 1;  // Già vuote
+    listBarHash = 0;
+    listValid = true;
+    drawn = true;
+  }
+
+  // Scrollbar a sinistra (margine libero): solo se cambia posizione o totale.
+  // Disegno diretto, prima delle righe che occupano il DMA
+  int total = listRowCount();
+  uint32_t barHash = ((uint32_t)total << 16) | (uint32_t)scrollOffset | 0x80000000u;
+  if (barHash != listBarHash) {
+    listBarHash = barHash;
+    tft.fillRect(0, listTop, SCROLLBAR_WIDTH, listHeight, TFT_DARKGREY);
+    listPixels += SCROLLBAR_WIDTH * listHeight;
+    if (total > VISIBLE_ROWS) {
+      int barHeight = (listHeight * VISIBLE_ROWS) / total;
+      if (barHeight < 10) barHeight = 10;
+      int scrollRange = listHeight - barHeight;
+      int barY = listTop + (int)((int64_t)scrollOffset * scrollRange / max(1, total - VISIBLE_ROWS));
+      tft.fillRect(0, barY, SCROLLBAR_WIDTH, barHeight, TFT_WHITE);
+      listPixels += SCROLLBAR_WIDTH * barHeight;
+    }
+    drawn = true;
+  }
+
+  for (int i = 0; i < VISIBLE_ROWS; i++) {
+    uint32_t h = listRowContentHash(scrollOffset + i);
+    if (h == listRowHash[i]) continue;
+
+    if (uiSprites) {
+      // Compone la riga mentre il DMA invia la precedente
+      int rowTop = listRowY(i) - 2;
+      drawListRow(rowSprite, i, listX, rowTop);
+      uiPushSprite(rowSprite, listX, rowTop, LIST_ROW_WIDTH, (i % 2 == 0) ? 20 : 21);
+    } else {
+      drawListRow(tft, i, 0, 0);
+    }
+    listRowHash[i] = h;
+    drawn = true;
+  }
+
+  // Torna al font di default
+  tft.setTextFont(1);
+
+  uiEnd(UI_LIST, drawn);
+
+  // Pixel per passo di scorrimento (la selezione esce dalla vista)
+  if (listLastScroll >= 0 && scrollOffset != listLastScroll) {
+    uint32_t px = listPixels - pixelsBefore;
+    listScrollLastPx = px;
+    if (px > listScrollMaxPx) listScrollMaxPx = px;
+    listScrollSteps++;
+  }
+  listLastScroll = scrollOffset;
+}
+
+void drawHeader() {
+  // Header in alto (landscape: larghezza fino ai pulsanti)
+  int headerWidth = 320 - BUTTON_PANEL_WIDTH;
+  tft.fillRect(0, 0, headerWidth, HEADER_HEIGHT, TFT_BLACK);
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  tft.setTextSize(2);
+  // Centro orizzontale nell'area header
+  tft.setCursor((headerWidth - 132) / 2, (HEADER_HEIGHT - 16) / 2);
+  tft.print("EM Maranzan");
+
+  // Linea separatore
+  tft.drawFastHLine(0, HEADER_HEIGHT - 1, headerWidth, TFT_DARKGREY);
+}
+
+void renderMessage(const char* msg, uint16_t color) {
+  // Mostra messaggio temporaneo in basso (dopo scrollbar, prima dei pulsanti)
+  int msgX = SCROLLBAR_WIDTH + 2;  // Dopo scrollbar + gap
+  int msgY = 240 - 20;
+  int msgWidth = 320 - BUTTON_PANEL_WIDTH - msgX;
+
+  uiBegin();
+  TFT_eSPI& g = uiSprites ? (TFT_eSPI&)msgSprite : (TFT_eSPI&)tft;
+  int ox = uiSprites ? msgX : 0;
+  int oy = uiSprites ? msgY : 0;
+  g.fillRect(msgX - ox, msgY - oy, msgWidth, 20, TFT_BLACK);
+  g.setTextColor(color, TFT_BLACK);
+  g.setTextSize(1);
+  g.setCursor(msgX + 3 - ox, msgY + 6 - oy);
+  g.print(msg);
+  if (uiSprites) uiPushSprite(msgSprite, msgX, msgY, msgWidth, 20);
+  uiEnd(UI_MESSAGE, true);
+
+  // Il messaggio copre le ultime righe: vanno ridisegnate quando sparisce
+  for (int i = 0; i < VISIBLE_ROWS; i++) {
+    if (listRowY(i) - 2 + 21 > msgY) listRowHash[i] = 0;
+  }
+}
+
+// ===== TASK DISPLAY =====
+// Un solo task disegna: loop, poll task e print task chiedono un ridisegno
+// e proseguono subito. Le richieste sono bit in attesa (più ridisegni della
+// lista ne fanno uno solo) e il messaggio è una casella: vince l'ultimo.
+#define UI_REQ_SCREEN   0x01  // Schermata completa (header, lista o manuale, pulsanti)
+#define UI_REQ_LIST     0x02
+#define UI_REQ_MANUAL   0x04
+#define UI_REQ_MESSAGE  0x08
+
+TaskHandle_t uiTaskHandle = NULL;
+portMUX_TYPE uiReqMux = portMUX_INITIALIZER_UNLOCKED;
+uint8_t uiPending = 0;
+char uiMsgText[48];
+uint16_t uiMsgColor = TFT_WHITE;
+
+// Registra una richiesta (mai bloccante: niente SPI, niente mutex)
+void uiPost(uint8_t req, const char* msg, uint16_t color) {
+  portENTER_CRITICAL(&uiReqMux);
+  uiPosted++;
+  if (uiPending & req) uiCoalesced++;
+  uiPending |= req;
+  if (req == UI_REQ_MESSAGE) {
+    uiMsgSeq++;
+    strncpy(uiMsgText, msg, sizeof(uiMsgText) - 1);
+    uiMsgText[sizeof(uiMsgText) - 1] = '\0';
+    uiMsgColor = color;
+  }
+  portEXIT_CRITICAL(&uiReqMux);
+  if (uiTaskHandle) xTaskNotifyGive(uiTaskHandle);
+}
+
+void drawList() {
+  uiPost(UI_REQ_LIST, NULL, 0);
+}
+
+void drawManualInput() {
+  uiPost(UI_REQ_MANUAL, NULL, 0);
+}
+
+void drawScreen() {
+  uiPost(UI_REQ_SCREEN, NULL, 0);
+}
+
+void showMessage(const char* msg, uint16_t color) {
+  if (msg[0] != '\0') {
+    uiPost(UI_REQ_MESSAGE, msg, color);
+    return;
+  }
+  // Messaggio vuoto: scarta quello in attesa e ripristina l'area sotto
+  portENTER_CRITICAL(&uiReqMux);
+  uiPending &= ~UI_REQ_MESSAGE;
+  portEXIT_CRITICAL(&uiReqMux);
+  uiPost(manualInputMode ? UI_REQ_MANUAL : UI_REQ_LIST, NULL, 0);
+}
+
+void renderScreen() {
+  tft.fillScreen(TFT_BLACK);
+  invalidateList();
+  drawHeader();
+  if (manualInputMode) {
+    renderManualInput();
+  } else {
+    renderList();
+  }
+  drawButtons();
+}
+
+void uiTask(void* parameter) {
+  char msg[sizeof(uiMsgText)];
+  debugPrintln("[TASK] Display task avviato");
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    // Preleva tutto ciò che è in attesa in un colpo solo
+    portENTER_CRITICAL(&uiReqMux);
+    uint8_t req = uiPending;
+    uiPending = 0;
+    uint16_t color = uiMsgColor;
+    memcpy(msg, uiMsgText, sizeof(msg));
+    portEXIT_CRITICAL(&uiReqMux);
+    if (req == 0) continue;
+
+    // Il mutex tiene fuori chi disegna in esclusiva (schermata OTA)
+    xSemaphoreTakeRecursive(uiMutex, portMAX_DELAY);
+    if (req & UI_REQ_SCREEN) {
+      renderScreen();
+    } else if (manualInputMode) {
+      if (req & UI_REQ_MANUAL) renderManualInput();
+    } else if (req & UI_REQ_LIST) {
+      renderList();
+    }
+    if (req & UI_REQ_MESSAGE) renderMessage(msg, color);
+    uiRendered++;
+    xSemaphoreGiveRecursive(uiMutex);
+  }
+}
+
+// ===== TIMER WHEEL (loop) =====
+// Le attese della UI (messaggi a tempo, errori in modalità manuale, sleep
+// schermo, timeout inattività) sono timer invece di delay(): il loop resta
+// libero di gestire pulsanti e nuove schede. Ruota di 32 posizioni da 50ms,
+// ogni timer sta nella lista della sua posizione con i giri mancanti.
+// Solo il loop usa la ruota (nessun lock).
+#define WHEEL_SLOTS 32
+#define WHEEL_TICK_MS 50
+
+struct LoopTimer {
+  void (*fn)();
+  uint32_t rounds;   // Giri completi prima di scattare
+  uint8_t slot;      // WHEEL_SLOTS = in lista di scatto
+  bool active;
+  LoopTimer* next;
+};
+
+LoopTimer* wheel[WHEEL_SLOTS];
+LoopTimer* wheelFiring = NULL;  // Posizione in elaborazione
+uint8_t wheelPos = 0;
+unsigned long wheelLastMs = 0;
+int wheelActive = 0;
+
+void timerStop(LoopTimer& t) {
+  if (!t.active) return;
+  LoopTimer** pp = (t.slot == WHEEL_SLOTS) ? &wheelFiring : &wheel[t.slot];
+  while (*pp && *pp != &t) pp = &(*pp)->next;
+  if (*pp) *pp = t.next;
+  t.active = false;
+  wheelActive--;
+}
+
+// (Ri)programma t tra ms millisecondi (arrotondati al tick)
+void timerStart(LoopTimer& t, uint32_t ms) {
+  timerStop(t);
+  if (wheelActive == 0) wheelLastMs = millis();  // Ruota ferma: riparte da ora
+
+  uint32_t ticks = max((uint32_t)1, (ms + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS);
+  t.slot = (wheelPos + ticks) % WHEEL_SLOTS;
+  t.rounds = (ticks - 1) / WHEEL_SLOTS;
+  t.next = wheel[t.slot];
+  wheel[t.slot] = &t;
+  t.active = true;
+  wheelActive++;
+}
+
+// Avanza la ruota fino a ora e fa scattare i timer scaduti
+void timerWheelRun() {
+  unsigned long now = millis();
+  if (wheelActive == 0) {
+    wheelLastMs = now;
+    return;
   }
 
-  // Fallback: prova default se non nelle salvate
-  bool defaultInList = false;
-  for (int i = 0; i < numSavedNetworks; i++) {
-    if (strcmp(savedNetworks[i].ssid, DEFAULT_WIFI_SSID) == 0) {
-      defaultInList = true;
-      break;
+  while (now - wheelLastMs >= WHEEL_TICK_MS) {
+    wheelLastMs += WHEEL_TICK_MS;
+    wheelPos = (wheelPos + 1) % WHEEL_SLOTS;
+
+    // Stacca la lista: i callback possono riprogrammare qualsiasi timer
+    wheelFiring = wheel[wheelPos];
+    wheel[wheelPos] = NULL;
+    for (LoopTimer* t = wheelFiring; t; t = t->next) t->slot = WHEEL_SLOTS;
+
+    while (wheelFiring) {
+      LoopTimer* t = wheelFiring;
+      wheelFiring = t->next;
+      if (t->rounds > 0) {
+        t->rounds--;
+        t->slot = wheelPos;
+        t->next = wheel[wheelPos];
+        wheel[wheelPos] = t;
+      } else {
+        t->active = false;
+        wheelActive--;
+        t->fn();
+      }
     }
   }
+}
 
-  if (!defaultInList && numSavedNetworks == 0) {
-    debugPrint("[WIFI] Provo default: ");
-    debugPrintln(DEFAULT_WIFI_SSID);
+// Quanto può dormire il loop prima del prossimo tick utile
+uint32_t timerWheelIdleMs() {
+  uint32_t idleMs = powerIdle ? POWER_IDLE_LOOP_MS : LOOP_IDLE_MS;
+  if (wheelActive == 0) return idleMs;
+  unsigned long elapsed = millis() - wheelLastMs;
+  return elapsed >= WHEEL_TICK_MS ? 0 : min(idleMs, (uint32_t)(WHEEL_TICK_MS - elapsed));
+}
 
-    WiFi.disconnect();
-    vTaskDelay(500 / portTICK_PERIOD_MS);
-    WiFi.begin(DEFAULT_WIFI_SSID, DEFAULT_WIFI_PASS);
+// ===== TIMER DELLA UI =====
+void onScreenSleepTimer();
+void onMessageClearTimer();
+void onManualTimeoutTimer();
+void onManualRedrawTimer();
+
+LoopTimer screenSleepTimer = {onScreenSleepTimer, 0, 0, false, NULL};
+LoopTimer messageClearTimer = {onMessageClearTimer, 0, 0, false, NULL};
+LoopTimer manualTimeoutTimer = {onManualTimeoutTimer, 0, 0, false, NULL};
+LoopTimer manualRedrawTimer = {onManualRedrawTimer, 0, 0, false, NULL};
+uint32_t messageClearSeq = 0;
+
+// Spegni schermo dopo SCREEN_TIMEOUT dall'ultima attività
+void onScreenSleepTimer() {
+  if (!screenOn) return;
+  unsigned long idle = millis() - lastButtonActivity;
+  if (idle < SCREEN_TIMEOUT) {
+    timerStart(screenSleepTimer, SCREEN_TIMEOUT - idle);
+    return;
+  }
+  screenOn = false;
+  digitalWrite(TFT_BL, LOW);
+  debugPrintln("[SCREEN] Sleep");
+  powerEnterIdle();
+}
 
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 15) {
-      vTaskDelay(500 / portTICK_PERIOD_MS);
-      debugPrint(".");
-      attempts++;
+// Messaggio temporaneo: sparisce dopo ms, se nel frattempo non ne è arrivato un altro
+void showMessageFor(const char* msg, uint16_t color, uint32_t ms) {
+  showMessage(msg, color);
+  messageClearSeq = uiMsgSeq;
+  timerStart(messageClearTimer, ms);
+}
+
+void onMessageClearTimer() {
+  if (uiMsgSeq == messageClearSeq) showMessage("", TFT_BLACK);
+}
+
+// Timeout inattività modalità manuale (20s dall'ultimo pulsante)
+void onManualTimeoutTimer() {
+  if (!manualInputMode) return;
+  unsigned long idle = millis() - lastManualActivity;
+  if (idle < MANUAL_TIMEOUT_MS) {
+    timerStart(manualTimeoutTimer, MANUAL_TIMEOUT_MS - idle);
+    return;
+  }
+  debugPrintln("[MANUAL] Timeout inattività");
+  exitManualInputMode();
+}
+
+// Dopo un errore in modalità manuale: torna a mostrare il numero
+void onManualRedrawTimer() {
+  if (manualInputMode) drawManualInput();
+}
+
+// ===== MODALITA' INSERIMENTO MANUALE =====
+
+// Inizializza numero manuale con la scheda più recente
+void initManualNumero() {
+  SchedeRef schede;
+  if (schede.count() > 0) {
+    strncpy(manualNumero, schede[0].numero, 7);
+    manualNumero[7] = '\0';
+  } else {
+    strcpy(manualNumero, "26/0001");
+  }
+  manualCursorPos = 0;
+}
+
+// Mappa posizione cursore logica (0-5) a posizione stringa (0-6, salta /)
+int cursorToStringPos(int cursorPos) {
+  if (cursorPos < 2) return cursorPos;  // 0,1 -> 0,1
+  return cursorPos + 1;  // 2,3,4,5 -> 3,4,5,6
+}
+
+// Anteprima durante l'inserimento: cliente del numero mostrato e quante
+// schede hanno le stesse cifre fino al cursore
+struct ManualPreview {
+  int candidates;  // -1 = indice non ancora pronto
+  bool exact;      // Il numero mostrato esiste
+  char cliente[sizeof(Scheda::cliente)];
+};
+
+void manualPreview(ManualPreview& out) {
+  SchedeRef schede;
+  out.candidates = -1;
+  out.exact = false;
+  out.cliente[0] = '\0';
+
+  // Nelle ultime 50: nome originale, non serve l'indice
+  for (int i = 0; i < schede.count(); i++) {
+    if (strcmp(schede[i].numero, manualNumero) == 0) {
+      strcpy(out.cliente, schede[i].cliente);
+      out.exact = true;
+      break;
     }
+  }
+  if (!jobDirMutex) return;
 
-    if (WiFi.status() == WL_CONNECTED) {
-      debugPrint("\n[WIFI] Riconnesso a default: ");
-      debugPrintln(WiFi.localIP());
-      wifiOK = true;
-      wifiError = false;
-      showWifiStatus = true;
-      return true;
+  // Cifre fino al cursore compreso -> intervallo di id [prefix * scale, (prefix + 1) * scale)
+  int prefix = 0;
+  int scale = 1000000;
+  int digits = min(manualCursorPos + 1, 6);
+  for (int i = 0; i < digits; i++) {
+    prefix = prefix * 10 + (manualNumero[cursorToStringPos(i)] - '0');
+    scale /= 10;
+  }
+
+  xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+  if (jobDir.count > 0) {
+    out.candidates = jobDirLowerBound((prefix + 1) * scale) - jobDirLowerBound(prefix * scale);
+    int idx = out.exact ? -1 : jobDirFind(packNumero(manualNumero));
+    if (idx >= 0) {
+      strcpy(out.cliente, jobDir.entries[idx].cliente);
+      out.exact = true;
     }
   }
+  xSemaphoreGive(jobDirMutex);
+}
 
-  debugPrintln("[WIFI] Riconnessione fallita su tutte le reti");
-  return false;
+// Numero cambiato: se non è in RAM, la scheda si legge dal CSV in background
+void manualRequestPrefetch() {
+  if (isSchedaInList(manualNumero)) return;
+  jobDirRequestPrefetch(packNumero(manualNumero));
 }
 
-// Calcola intervallo polling in base all'ora corrente (NTP)
-// Lavoro (7:30-19:15): 2.2s  |  Transizione (7:00-7:30, 19:15-19:45): 60s  |  Notte: 3600s
-int getPollInterval() {
-  if (!ntpSynced) {
-    // Se NTP non sincronizzato, usa intervallo conservativo
-    return POLL_TRANS;
+// Disegna UI modalità inserimento manuale
+void renderManualInput() {
+  if (manualSearch) {
+    renderSearchInput();
+    return;
   }
 
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
-    // Fallback se getLocalTime fallisce
-    return POLL_TRANS;
+  // Pulisci area centrale (landscape: a sinistra dei pulsanti)
+  int areaWidth = 320 - BUTTON_PANEL_WIDTH;
+  int areaTop = HEADER_HEIGHT;
+  int areaHeight = 240 - areaTop;
+
+  // Composizione nello sprite (origine = angolo dell'area) o diretta
+  uiBegin();
+  TFT_eSPI& g = uiSprites ? (TFT_eSPI&)manualSprite : (TFT_eSPI&)tft;
+  int oy = uiSprites ? areaTop : 0;
+  g.fillRect(0, areaTop - oy, areaWidth, areaHeight, TFT_BLACK);
+  invalidateList();
+
+  // Anteprima sopra il numero: cliente (12px/carattere) e candidati
+  ManualPreview pv;
+  manualPreview(pv);
+  if (pv.exact || pv.candidates >= 0) {
+    char nome[sizeof(pv.cliente)];
+    strcpy(nome, pv.exact ? pv.cliente : "Nessuna scheda");
+    nome[min((int)sizeof(nome) - 1, (areaWidth - 20) / 12)] = '\0';
+    g.setTextSize(2);
+    g.setTextColor(pv.exact ? TFT_WHITE : TFT_RED, TFT_BLACK);
+    g.setCursor(10, areaTop + 12 - oy);
+    g.print(nome);
+  }
+  if (pv.candidates >= 0) {
+    g.setTextSize(1);
+    g.setTextColor(pv.candidates ? TFT_CYAN : TFT_RED, TFT_BLACK);
+    g.setCursor(10, areaTop + 34 - oy);
+    g.print(pv.candidates);
+    g.print(pv.candidates == 1 ? " candidato" : " candidati");
   }
 
-  int hour = timeinfo.tm_hour;
-  int minute = timeinfo.tm_min;
-  int totalMinutes = hour * 60 + minute;  // Minuti dall'inizio del giorno
+  // Numero grande centrato
+  g.setTextSize(4);  // Font grande
 
-  // Fasce orarie in minuti:
-  // Lavoro: 7:30 (450) - 19:15 (1155)
-  // Transizione mattina: 7:00 (420) - 7:30 (450)
-  // Transizione sera: 19:15 (1155) - 19:45 (1185)
-  // Notte: tutto il resto
+  // Calcola larghezza totale: 7 caratteri × 24px = 168px
+  int charWidth = 24;
+  int totalWidth = 7 * charWidth;
+  int startX = (areaWidth - totalWidth) / 2;
+  int numY = areaTop + (areaHeight / 2) - 40;
 
-  if (totalMinutes >= 450 && totalMinutes < 1155) {
-    // Fascia lavoro: 7:30 - 19:15
-    return POLL_FAST;
-  } else if ((totalMinutes >= 420 && totalMinutes < 450) ||
-             (totalMinutes >= 1155 && totalMinutes < 1185)) {
-    // Fascia transizione: 7:00-7:30 o 19:15-19:45
-    return POLL_TRANS;
+  // Disegna ogni carattere
+  for (int i = 0; i < 7; i++) {
+    int x = startX + i * charWidth;
+    int logicalPos = (i < 2) ? i : (i > 2 ? i - 1 : -1);  // -1 per /
+    bool isSelected = (logicalPos == manualCursorPos);
+
+    if (isSelected) {
+      // Sfondo bianco, testo nero (come riga selezionata nella lista)
+      g.fillRect(x - 2, numY - 4 - oy, charWidth, 36, TFT_WHITE);
+      g.setTextColor(TFT_BLACK, TFT_WHITE);
+    } else {
+      g.setTextColor(TFT_WHITE, TFT_BLACK);
+    }
+
+    g.setCursor(x, numY - oy);
+    g.print(manualNumero[i]);
+  }
+
+  // Istruzioni
+  g.setTextSize(1);
+  g.setTextColor(TFT_DARKGREY, TFT_BLACK);
+  int instrY = numY + 55 - oy;
+  int instrX = (areaWidth - 150) / 2;
+  g.setCursor(instrX, instrY);
+  g.print("Frecce: cambia cifra");
+  g.setCursor(instrX, instrY + 15);
+  g.print("OK: prossima / stampa");
+  g.setCursor(instrX, instrY + 30);
+  g.print("OK 2s: annulla");
+  g.setCursor(instrX, instrY + 45);
+  g.print("GIU lungo: cerca cliente");
+
+  if (uiSprites) uiPushSprite(manualSprite, 0, areaTop, areaWidth, areaHeight);
+  uiEnd(UI_MANUAL, true);
+}
+
+// Cambia cifra corrente (su/giù)
+void changeManualDigit(int delta) {
+  int strPos = cursorToStringPos(manualCursorPos);
+  char c = manualNumero[strPos];
+
+  if (c >= '0' && c <= '9') {
+    int digit = c - '0';
+    digit = (digit + delta + 10) % 10;  // Wrap 0-9
+    manualNumero[strPos] = '0' + digit;
+  }
+
+  manualRequestPrefetch();
+  drawManualInput();
+}
+
+// Avanza cursore o stampa
+void advanceManualCursor() {
+  manualCursorPos++;
+
+  if (manualCursorPos >= 6) {
+    // Ultima posizione raggiunta, cerca e stampa
+    markPrintTrigger(true);
+    tryPrintManualScheda();
   } else {
-    // Notte
-    return POLL_NIGHT;
+    drawManualInput();
   }
 }
 
-// ===== COMANDI REMOTI =====
+// Stampa manuale terminata: torna alla lista
+void finishManualPrint() {
+  // Esci dalla modalità manuale, conferma sopra la lista
+  manualInputMode = false;
+  timerStop(manualTimeoutTimer);
+  timerStop(manualRedrawTimer);
+  drawScreen();
+  showMessageFor("Stampa avviata!", TFT_GREEN, 1500);
+}
 
-// Stampa scontrino con report di stato
-void printStatusReport() {
-  debugPrintln("[CMD] Stampa STATUS report");
+// Cerca la scheda (RAM, prefetch, archivio, indice, al limite scansione del CSV) e stampa
+void tryPrintManualScheda() {
+  debugPrint("[MANUAL] Cerco scheda: ");
+  debugPrintln(manualNumero);
 
-  // Riaccendi schermo se spento
-  if (!screenOn) {
-    screenOn = true;
-    digitalWrite(TFT_BL, HIGH);
-    delay(100);
+  // Già renderizzata: replay diretto, niente SD né JSON
+  if (printFromCache(manualNumero)) {
+    debugPrintln("[MANUAL] Stampata da cache");
+    manualSource[MANUAL_FROM_RAM]++;
+    finishManualPrint();
+    return;
   }
 
-  showMessage("Stampa STATUS...", TFT_YELLOW);
+  static Scheda s;  // Solo il loop stampa da qui
+  int from = -1;
+  {
+    SchedeRef schede;
+    for (int i = 0; i < schede.count(); i++) {
+      if (strcmp(schede[i].numero, manualNumero) == 0) {
+        s = schede[i];
+        from = MANUAL_FROM_RAM;
+        break;
+      }
+    }
+  }
 
-  // Reset stampante
-  printerSerial.write(0x1B); printerSerial.write('@');
-  delay(100);
+  // Letta in background durante l'inserimento, un record dall'archivio o
+  // una sola riga dall'offset
+  bool indexReady = false;
+  if (from < 0 && jobDirMutex) {
+    int id = packNumero(manualNumero);
+    int idx = -1;
+    JobDirEntry e;
+    xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+    indexReady = jobDir.count > 0;
+    if (prefetchValid(id)) {
+      s = prefetchScheda;
+      from = MANUAL_FROM_PREFETCH;
+    } else if (indexReady) {
+      idx = jobDirFind(id);
+      if (idx >= 0) e = jobDir.entries[idx];
+    }
+    xSemaphoreGive(jobDirMutex);
+    if (from < 0 && archiveFind(id, s)) from = MANUAL_FROM_ARCHIVE;
+    if (from < 0 && idx >= 0 && jobDirLoad(e, s)) from = MANUAL_FROM_INDEX;
+  }
 
-  // Titolo
-  printerSerial.write(0x1B); printerSerial.write('E'); printerSerial.write(1);  // bold ON
-  printerSerial.println("=== STATUS REPORT ===");
-  printerSerial.write(0x1B); printerSerial.write('E'); printerSerial.write(0);  // bold OFF
-  printerSerial.println();
+  // Indice in PSRAM non pronto: ricerca binaria su /riparazioni.idx, se
+  // una ricostruzione precedente l'ha lasciato (senza PSRAM di norma no)
+  if (from < 0 && !indexReady) {
+    JobDirEntry e;
+    if (jobIdxFindSd(packNumero(manualNumero), e) && jobDirLoad(e, s)) from = MANUAL_FROM_INDEX;
+  }
 
-  // Firmware
-  printerSerial.print("Firmware: v");
-  printerSerial.println(FIRMWARE_VERSION);
+  // Nessun indice: scansione del CSV come prima
+  if (from < 0 && !indexReady) {
+    showMessage("Ricerca scheda...", TFT_YELLOW);
+    if (!sdOK) {
+      debugPrintln("[MANUAL] SD non disponibile");
+      showMessage("SD non disponibile!", TFT_RED);
+      manualCursorPos = 0;  // Torna alla prima cifra
+      timerStart(manualRedrawTimer, 2000);
+      return;
+    }
 
-  // Uptime
-  unsigned long uptime = millis() / 1000;
-  int hours = uptime / 3600;
-  int mins = (uptime % 3600) / 60;
-  int secs = uptime % 60;
-  printerSerial.print("Uptime: ");
-  printerSerial.print(hours);
-  printerSerial.print("h ");
-  printerSerial.print(mins);
-  printerSerial.print("m ");
-  printerSerial.print(secs);
-  printerSerial.println("s");
+    CsvCursor csv;
+    if (!csv.open()) {
+      debugPrintln("[MANUAL] File CSV non trovato");
+      showMessage("File CSV non trovato!", TFT_RED);
+      manualCursorPos = 0;  // Torna alla prima cifra
+      timerStart(manualRedrawTimer, 2000);
+      return;
+    }
 
-  // WiFi
-  printerSerial.print("WiFi: ");
-  if (wifiOK && WiFi.status() == WL_CONNECTED) {
-    printerSerial.println("OK");
-    printerSerial.print("  SSID: ");
-    printerSerial.println(WiFi.SSID());
-    printerSerial.print("  IP: ");
-    printerSerial.println(WiFi.localIP());
-    printerSerial.print("  RSSI: ");
-    printerSerial.print(WiFi.RSSI());
-    printerSerial.println(" dBm");
-  } else {
-    printerSerial.println("ERRORE");
+    if (csv.find(manualNumero, s)) from = MANUAL_FROM_SCAN;
+    csv.close();
+    debugPrint("[MANUAL] Righe lette: ");
+    debugPrintln(csv.linesRead);
   }
 
-  // NTP
-  printerSerial.print("NTP: ");
-  if (ntpSynced) {
-    struct tm timeinfo;
-    if (getLocalTime(&timeinfo)) {
-      char timeBuf[20];
-      sprintf(timeBuf, "%02d:%02d:%02d", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-      printerSerial.println(timeBuf);
-    } else {
-      printerSerial.println("Errore lettura");
+  if (from >= 0) {
+    const char* fonti[5] = {"RAM", "prefetch", "archivio", "indice", "scansione"};
+    debugPrint("[MANUAL] Trovata (");
+    debugPrint(fonti[from]);
+    debugPrintln(")");
+    manualSource[from]++;
+
+    // Stampa (in coda al task di stampa)
+    if (!enqueuePrint(s, PAUSE_NORMAL_SEC, 0, 0)) {
+      showMessage("Coda stampa piena!", TFT_ORANGE);
+      timerStart(manualRedrawTimer, 1500);
+      return;
     }
+    finishManualPrint();
+
   } else {
-    printerSerial.println("Non sincronizzato");
+    debugPrintln("[MANUAL] Scheda non trovata");
+    showMessage("Scheda non trovata!", TFT_RED);
+    manualCursorPos = 0;  // Torna alla prima cifra
+    timerStart(manualRedrawTimer, 2000);
   }
+}
 
-  // Polling interval attuale
-  printerSerial.print("Poll interval: ");
-  int interval = getPollInterval();
-  if (interval >= 60000) {
-    printerSerial.print(interval / 60000);
-    printerSerial.println(" min");
+// Entra in modalità inserimento manuale
+void enterManualInputMode() {
+  manualInputMode = true;
+  initManualNumero();
+  lastManualActivity = millis();  // Inizializza timer inattività
+  timerStart(manualTimeoutTimer, MANUAL_TIMEOUT_MS);
+
+  debugPrintln("[MANUAL] Modalità inserimento manuale attivata");
+
+  drawScreen();
+}
+
+// Esci dalla modalità inserimento manuale
+void exitManualInputMode() {
+  manualInputMode = false;
+  manualSearch = false;
+  timerStop(manualTimeoutTimer);
+  timerStop(manualRedrawTimer);
+
+  debugPrintln("[MANUAL] Modalità inserimento manuale disattivata");
+
+  drawScreen();
+}
+
+// ===== RICERCA PER CLIENTE =====
+// Dalla modalità manuale, GIU tenuto premuto: il nome si compone una lettera
+// alla volta (frecce = lettera, OK = aggiungi, OK 2s = mostra i risultati in
+// lista). A ogni cambio l'anteprima riporta quante schede iniziano così e le
+// prime, cercate nell'indice in PSRAM.
+const char kSearchAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789<";  // '<' = cancella
+#define SEARCH_LETTERS ((int)sizeof(kSearchAlphabet) - 1)
+#define SEARCH_PREVIEW_ROWS 5
+char searchQuery[JOB_KEY_LEN + 1] = "";
+int searchLetter = 0;  // Indice in kSearchAlphabet
+
+// Query più la lettera sotto il cursore (quella in anteprima)
+void searchCandidate(char* out) {
+  strcpy(out, searchQuery);
+  size_t n = strlen(out);
+  char c = kSearchAlphabet[searchLetter];
+  if (c != '<' && n < JOB_KEY_LEN) {
+    out[n] = c;
+    out[n + 1] = '\0';
+  }
+}
+
+void renderSearchInput() {
+  int areaWidth = 320 - BUTTON_PANEL_WIDTH;
+  int areaTop = HEADER_HEIGHT;
+  int areaHeight = 240 - areaTop;
+
+  uiBegin();
+  TFT_eSPI& g = uiSprites ? (TFT_eSPI&)manualSprite : (TFT_eSPI&)tft;
+  int oy = uiSprites ? areaTop : 0;
+  g.fillRect(0, areaTop - oy, areaWidth, areaHeight, TFT_BLACK);
+  invalidateList();
+
+  // Ultimi 12 caratteri della query + lettera corrente in negativo (18px/carattere)
+  int qLen = strlen(searchQuery);
+  const char* tail = searchQuery + max(0, qLen - 12);
+  int x = 10;
+  int y = areaTop + 10;
+  g.setTextSize(3);
+  g.setTextColor(TFT_WHITE, TFT_BLACK);
+  g.setCursor(x, y - oy);
+  g.print(tail);
+  x += strlen(tail) * 18;
+  char c = kSearchAlphabet[searchLetter];
+  g.fillRect(x - 2, y - 4 - oy, 20, 30, TFT_WHITE);
+  g.setTextColor(TFT_BLACK, TFT_WHITE);
+  g.setCursor(x, y - oy);
+  g.print(c == ' ' ? '_' : c);
+
+  // Anteprima: conteggio + prime schede
+  char cand[JOB_KEY_LEN + 1];
+  searchCandidate(cand);
+  g.setTextSize(1);
+  g.setCursor(10, y + 36 - oy);
+  if (jobDirMutex && jobDir.count > 0) {
+    xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+    int lo;
+    int n = jobDirSearch(cand, lo);
+    g.setTextColor(n ? TFT_CYAN : TFT_RED, TFT_BLACK);
+    g.print(n);
+    g.print(n == 1 ? " scheda" : " schede");
+    g.setTextSize(2);
+    for (int i = 0; i < min(n, SEARCH_PREVIEW_ROWS); i++) {
+      const JobDirEntry& e = jobDir.entries[jobDir.byName[lo + i]];
+      char line[40];
+      unpackNumero(e.id, line, sizeof(line));
+      strcat(line, " ");
+      strcat(line, e.cliente);
+      line[(areaWidth - 10) / 12] = '\0';  // 12px/carattere
+      g.setTextColor(e.completato ? TFT_DARKGREY : TFT_WHITE, TFT_BLACK);
+      g.setCursor(10, y + 52 + i * 20 - oy);
+      g.print(line);
+    }
+    xSemaphoreGive(jobDirMutex);
   } else {
-    printerSerial.print(interval / 1000.0, 1);
-    printerSerial.println(" sec");
+    g.setTextColor(TFT_RED, TFT_BLACK);
+    g.print("Indice non pronto");
   }
 
-  // SD Card
-  printerSerial.print("SD Card: ");
-  printerSerial.println(sdOK ? "OK" : "ERRORE");
+  // Istruzioni
+  g.setTextSize(1);
+  g.setTextColor(TFT_DARKGREY, TFT_BLACK);
+  g.setCursor(10, 240 - 14 - oy);
+  g.print("Frecce: lettera  OK: aggiungi  OK 2s: vedi");
 
-  // Schede in memoria
-  printerSerial.print("Schede in RAM: ");
-  printerSerial.println(numSchede);
+  if (uiSprites) uiPushSprite(manualSprite, 0, areaTop, areaWidth, areaHeight);
+  uiEnd(UI_MANUAL, true);
+}
 
-  // History stampe
-  printerSerial.print("Schede stampate: ");
-  printerSerial.println(historyCount);
+void enterSearchMode() {
+  manualSearch = true;
+  searchQuery[0] = '\0';
+  searchLetter = 0;
+  timerStop(manualRedrawTimer);
+  debugPrintln("[SEARCH] Ricerca per cliente");
+  drawManualInput();
+}
 
-  // Last timestamp
-  printerSerial.print("Last TS: ");
-  printerSerial.println(lastKnownTimestamp);
+// OK: aggiunge la lettera corrente (o cancella l'ultima con '<')
+void acceptSearchLetter() {
+  size_t n = strlen(searchQuery);
+  char c = kSearchAlphabet[searchLetter];
+  if (c == '<') {
+    if (n > 0) searchQuery[n - 1] = '\0';
+  } else if (n < JOB_KEY_LEN) {
+    searchQuery[n] = c;
+    searchQuery[n + 1] = '\0';
+    searchLetter = 0;
+  }
+  drawManualInput();
+}
 
-  // Free heap
-  printerSerial.print("Free heap: ");
-  printerSerial.print(ESP.getFreeHeap() / 1024);
-  printerSerial.println(" KB");
+// OK 2s: la lista mostra i risultati (query vuota = annulla)
+void showSearchResults() {
+  if (searchQuery[0] == '\0' || !jobDirMutex) {
+    exitManualInputMode();
+    return;
+  }
 
-  printerSerial.println();
-  printerSerial.println("=====================");
+  xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+  strcpy(searchFilterQuery, searchQuery);
+  searchCount = jobDirSearch(searchFilterQuery, searchLo);
+  searchGen = jobDirGen;
+  int n = searchCount;
+  xSemaphoreGive(jobDirMutex);
 
-  // Avanza carta
-  printerSerial.write(0x1B); printerSerial.write('J'); printerSerial.write(40);
+  if (n == 0) {
+    showMessage("Nessuna scheda", TFT_RED);
+    timerStart(manualRedrawTimer, 1500);
+    return;
+  }
 
-  showMessage("STATUS stampato", TFT_GREEN);
-  delay(1500);
-  drawList();
+  debugPrint("[SEARCH] ");
+  debugPrint(searchFilterQuery);
+  debugPrint(": ");
+  debugPrintln(n);
+  searchFilter = true;
+  selectedIndex = 0;
+  scrollOffset = 0;
+  exitManualInputMode();
+
+  char msg[48];
+  snprintf(msg, sizeof(msg), "%d schede (OK 2s: tutte)", n);
+  showMessageFor(msg, TFT_CYAN, 3000);
 }
 
-// Esegue un comando remoto ricevuto via M1
-void executeRemoteCommand(const char* cmd) {
-  debugPrint("[CMD] Esecuzione: ");
-  debugPrintln(cmd);
+// OK 2s sui risultati: torna alla lista normale
+void clearSearchFilter() {
+  searchFilter = false;
+  selectedIndex = 0;
+  scrollOffset = 0;
+  drawScreen();
+}
 
-  // Riaccendi schermo se spento
-  if (!screenOn) {
-    screenOn = true;
-    digitalWrite(TFT_BL, HIGH);
-    delay(100);
-  }
+// ===== TESTO ETICHETTA (buffer fissi, nessuna allocazione) =====
+#undef LOG_SUB
+#define LOG_SUB LOG_SUB_PRINT
 
-  // REBOOT
-  if (strcmp(cmd, "REBOOT") == 0) {
-    showMessage("REBOOT remoto...", TFT_YELLOW);
-    delay(1000);
-    ESP.restart();
-    return;
+// Numero di caratteri UTF-8 (i byte di continuazione 10xxxxxx non contano)
+int utf8Len(const char* s) {
+  int n = 0;
+  for (; *s; s++) {
+    if (((uint8_t)*s & 0xC0) != 0x80) n++;
   }
+  return n;
+}
 
-  // OTA
-  if (strcmp(cmd, "OTA") == 0) {
-    showMessage("OTA remoto...", TFT_YELLOW);
-    delay(500);
-    if (performOTAUpdate()) {
-      // Se OTA riesce, il dispositivo si riavvia automaticamente
-    } else {
-      showMessage("OTA fallito!", TFT_RED);
-      delay(2000);
-      drawList();
-    }
-    return;
+// Byte occupati dai primi nChars caratteri (mai a metà di una sequenza)
+size_t utf8Prefix(const char* s, int nChars) {
+  size_t i = 0;
+  while (s[i] && nChars > 0) {
+    i++;
+    while (((uint8_t)s[i] & 0xC0) == 0x80) i++;
+    nChars--;
   }
+  return i;
+}
 
-  // STATUS
-  if (strcmp(cmd, "STATUS") == 0) {
-    printStatusReport();
+// Accoda src a dst (capacità cap) senza superare la capacità
+void appendStr(char* dst, size_t cap, const char* src, size_t srcLen) {
+  size_t len = strlen(dst);
+  if (len + 1 >= cap) return;
+  if (srcLen > cap - 1 - len) {
+    srcLen = cap - 1 - len;
+    // Non spezzare un carattere multibyte al limite del buffer
+    while (srcLen > 0 && ((uint8_t)src[srcLen] & 0xC0) == 0x80) srcLen--;
+  }
+  memcpy(dst + len, src, srcLen);
+  dst[len + srcLen] = '\0';
+}
+
+void appendStr(char* dst, size_t cap, const char* src) {
+  appendStr(dst, cap, src, strlen(src));
+}
+
+// Accoda src troncato a maxChars caratteri: "COSTRUZIONI TAGLIAMENTO SRL" -> "COSTRUZIONI TAGLIAMENTO S."
+void appendTrunc(char* dst, size_t cap, const char* src, int maxChars) {
+  if (utf8Len(src) <= maxChars) {
+    appendStr(dst, cap, src);
     return;
   }
+  appendStr(dst, cap, src, utf8Prefix(src, maxChars - 1));
+  appendStr(dst, cap, ".");
+}
 
-  // PRINT:XX/XXXX - Forza stampa di una scheda specifica
-  if (strncmp(cmd, "PRINT:", 6) == 0) {
-    const char* numero = cmd + 6;  // Salta "PRINT:"
-    debugPrint("[CMD] Forza stampa scheda: ");
-    debugPrintln(numero);
+// ===== FORMATTA DATA gg.mm.aa =====
+void formatDate(const char* isoDate, char* out, size_t cap) {
+  // Input: "2025-01-21" -> Output: "21.01.25"
+  if (strlen(isoDate) >= 10) {
+    snprintf(out, cap, "%.2s.%.2s.%.2s", isoDate + 8, isoDate + 5, isoDate + 2);
+  } else {
+    out[0] = '\0';
+    appendStr(out, cap, isoDate);
+  }
+}
 
-    showMessage("Ricerca scheda...", TFT_YELLOW);
+// ===== STAMPA SINGOLA ETICHETTA =====
 
-    // Cerca la scheda nella lista
-    bool found = false;
-    for (int i = 0; i < numSchede; i++) {
-      if (strcmp(schede[i].numero, numero) == 0) {
-        found = true;
-
-        // Stampa tutte le etichette di questa scheda
-        int numEtichette = max(1, schede[i].numAttrezzi);
-        for (int j = 0; j < numEtichette; j++) {
-          char msg[40];
-          sprintf(msg, "Stampa %s (%d/%d)", numero, j + 1, numEtichette);
-          showMessage(msg, TFT_CYAN);
-          printEtichetta(schede[i], j, numEtichette);
-
-          if (j < numEtichette - 1) {
-            delay(3000);  // Pausa tra etichette
-          }
-        }
+// Formato etichetta 50x30mm passo 34mm: tutte le parti fisse sono byte
+// costruiti a compile-time (include/escpos.h), a runtime si scrivono solo i campi.
+// Per un formato diverso basta una struct con gli stessi membri.
+struct Etichetta50x30 {
+  // Usa sempre 31 caratteri per evitare wrap da byte spurio occasionale
+  static constexpr int rowWidth = 31;
+  static constexpr int maxLine = 32;  // Caratteri per riga in font normale
+
+  // Disattiva tutto esplicitamente: reverse OFF, bold OFF, font normale
+  static constexpr auto statoPulito =
+      escpos::reverse(false) + escpos::bold(false) + escpos::condensed(false);
+  // Newline in stato pulito + spazio ~2.1mm (ESC J 16)
+  static constexpr auto dopoNumero = escpos::crlf() + escpos::feedDots(16);
+  // Fine riga condensata, font normale + spazio ~2mm (ESC J 15)
+  static constexpr auto dopoInfo =
+      escpos::crlf() + escpos::condensed(false) + escpos::feedDots(15);
+  // Note in condensato
+  static constexpr auto noteOn = escpos::condensed(true);
+  static constexpr auto noteOff = escpos::crlf() + escpos::condensed(false);
+  // Feed carta per staccare etichetta (solo line feed, no spazio extra)
+  static constexpr auto fine = escpos::lf() + escpos::lf() + escpos::lf();
+};
 
-        showMessage("Stampa forzata OK", TFT_GREEN);
-        delay(1500);
-        break;
-      }
-    }
+// Byte attesi = sequenze scritte a mano fino alla v1.6.9
+namespace {
+constexpr uint8_t kAttesoStatoPulito[] = {0x1D, 'B', 0, 0x1B, 'E', 0, 0x1B, 'M', 0};
+constexpr uint8_t kAttesoDopoNumero[] = {'\r', '\n', 0x1B, 'J', 16};
+constexpr uint8_t kAttesoDopoInfo[] = {'\r', '\n', 0x1B, 'M', 0, 0x1B, 'J', 15};
+constexpr uint8_t kAttesoFine[] = {0x0A, 0x0A, 0x0A};
+static_assert(escpos::equals(Etichetta50x30::statoPulito, kAttesoStatoPulito), "stato pulito");
+static_assert(escpos::equals(Etichetta50x30::dopoNumero, kAttesoDopoNumero), "dopo numero");
+static_assert(escpos::equals(Etichetta50x30::dopoInfo, kAttesoDopoInfo), "dopo info");
+static_assert(escpos::equals(Etichetta50x30::fine, kAttesoFine), "fine etichetta");
+}
 
-    if (!found) {
-      char msg[40];
-      sprintf(msg, "%s non trovata", numero);
-      showMessage(msg, TFT_RED);
-      debugPrint("[CMD] Scheda non trovata: ");
-      debugPrintln(numero);
-      delay(2000);
+// Etichetta già renderizzata: byte ESC/POS + pause (flush + delay) nei punti
+// in cui la stampante ha bisogno di tempo. Una ristampa è un semplice replay.
+#define LABEL_MAX_BYTES 320   // Caso peggiore con tutti i campi Scheda pieni: ~310 byte
+#define LABEL_MAX_PAUSES 8
+
+struct LabelStream {
+  uint16_t len;
+  uint8_t numPauses;
+  struct { uint16_t offset; uint16_t ms; } pauses[LABEL_MAX_PAUSES];
+  uint8_t bytes[LABEL_MAX_BYTES];
+
+  void clear() { len = 0; numPauses = 0; }
+
+  size_t write(const uint8_t* b, size_t n) {
+    if (n > (size_t)(LABEL_MAX_BYTES - len)) n = LABEL_MAX_BYTES - len;
+    memcpy(bytes + len, b, n);
+    len += n;
+    return n;
+  }
+  void print(const char* t) { write((const uint8_t*)t, strlen(t)); }
+  void println(const char* t) { print(t); escpos::emit(*this, escpos::crlf()); }
+
+  // Attende che la stampante abbia ricevuto tutto il precedente
+  void pause(uint16_t ms) {
+    if (numPauses < LABEL_MAX_PAUSES) {
+      pauses[numPauses].offset = len;
+      pauses[numPauses].ms = ms;
+      numPauses++;
     }
-
-    drawList();
-    return;
   }
+};
 
-  // Comando non riconosciuto
-  debugPrint("[CMD] Comando sconosciuto: ");
-  debugPrintln(cmd);
-  showMessage("Cmd sconosciuto", TFT_RED);
-  delay(1500);
-  drawList();
+// Scrive un comando e registra l'attesa successiva
+template <size_t N>
+void labelCmd(LabelStream& out, const escpos::Bytes<N>& cmd, uint16_t waitMs) {
+  escpos::emit(out, cmd);
+  out.pause(waitMs);
 }
 
-// Task di polling su core 0 (loop principale gira su core 1)
-void pollTask(void* parameter) {
-  debugPrintln("[TASK] Poll task avviato su core 0");
+template <typename Fmt>
+void renderEtichettaFmt(LabelStream& out, const Scheda& s, int attrezzoIdx, int totAttrezzi) {
+  out.clear();
 
-  unsigned long lastWifiCheck = 0;
+  // Reset completo stampante
+  labelCmd(out, escpos::reset(), 100);  // Attesa più lunga per reset completo
 
-  for (;;) {
-    unsigned long now = millis();
+  // Assicura stato pulito
+  labelCmd(out, Fmt::statoPulito, 50);
 
-    // Se WiFi disconnesso, prova a riconnettersi ogni 60s
-    if (WiFi.status() != WL_CONNECTED) {
-      wifiOK = false;
-      wifiError = true;
-      showWifiStatus = true;
+  // === NUMERO SCHEDA (bold, reverse, riga nera) ===
+  const int rowWidth = Fmt::rowWidth;
 
-      if (now - lastWifiCheck >= WIFI_RETRY_INTERVAL) {
-        lastWifiCheck = now;
-        tryReconnectWifi();
-      }
-    }
+  char numStr[24];
+  if (totAttrezzi > 1) {
+    snprintf(numStr, sizeof(numStr), "%s (%d/%d)", s.numero, attrezzoIdx + 1, totAttrezzi);
+  } else {
+    snprintf(numStr, sizeof(numStr), "%s", s.numero);
+  }
+  int numLen = strlen(numStr);
 
-    // Polling ottimizzato: singola chiamata che verifica E stampa
-    if (wifiOK && !newSchedeReady) {
-      int result = pollAndPrint();
+  // Centra il testo nella riga
+  int padding = (rowWidth - numLen) / 2;
+  if (padding < 0) padding = 0;
 
-      if (result == 1) {
-        // Stampata nuova scheda, aggiorna CSV in background
-        debugPrintln("[TASK] Aggiorno CSV in background...");
+  char rigaNera[Fmt::rowWidth + 1];
+  memset(rigaNera, ' ', rowWidth);
+  rigaNera[rowWidth] = '\0';
+  // Copia il numero al centro
+  for (int i = 0; i < numLen && (padding + i) < rowWidth; i++) {
+    rigaNera[padding + i] = numStr[i];
+  }
 
-        for (int retry = 0; retry < 10; retry++) {
-          vTaskDelay(10000 / portTICK_PERIOD_MS);
+  // Attiva bold, flush, delay, poi reverse
+  labelCmd(out, escpos::bold(true), 30);
+  labelCmd(out, escpos::reverse(true), 30);
 
-          debugPrint("[TASK] CSV tentativo ");
-          debugPrint(retry + 1);
-          debugPrintln("/10");
+  // Riga nera in un'unica scrittura
+  out.write((const uint8_t*)rigaNera, rowWidth);
+  out.pause(20);
 
-          if (downloadCSV()) {
-            parseCSV(csvData);
+  // Disattiva reverse, poi bold, poi newline
+  labelCmd(out, escpos::reverse(false), 20);
+  labelCmd(out, escpos::bold(false), 20);
 
-            // Verifica che CSV contenga la scheda stampata
-            if (lastFastPrintNumero[0] != '\0') {
-              if (!isSchedaInList(lastFastPrintNumero)) {
-                debugPrint("[TASK] CSV non contiene ancora ");
-                debugPrintln(lastFastPrintNumero);
-                continue;
-              }
-              debugPrint("[TASK] CSV sincronizzato con ");
-              debugPrintln(lastFastPrintNumero);
-            }
+  // Newline in stato completamente pulito + spazio
+  escpos::emit(out, Fmt::dopoNumero);
 
-            // Verifica altre schede non stampate
-            int newCount = 0;
-            for (int i = 0; i < numSchede; i++) {
-              if (!isAlreadyPrinted(schede[i].numero)) {
-                newCount++;
-              }
-            }
+  // === Cliente (normale, max 32 char) + eventuale " - DDT" ===
+  char riga[Fmt::maxLine * 4 + 1];  // 32 caratteri UTF-8 nel caso peggiore
+  riga[0] = '\0';
+  if (s.ddt) {
+    // Se DDT presente, aggiungi " - DDT" (6 caratteri)
+    // Max 32 char totali: cliente max 32-6=26, poi " - DDT"
+    appendTrunc(riga, sizeof(riga), s.cliente, Fmt::maxLine - 6);
+    appendStr(riga, sizeof(riga), " - DDT");
+  } else {
+    // Senza DDT: max 32 char
+    appendTrunc(riga, sizeof(riga), s.cliente, Fmt::maxLine);
+  }
+  out.println(riga);
 
-            if (newCount > 0) {
-              debugPrint("[TASK] Trovate altre ");
-              debugPrint(newCount);
-              debugPrintln(" schede da stampare");
-              newSchedeReady = true;
-            } else {
-              debugPrint("[TASK] Lista sincronizzata (");
-              debugPrint(numSchede);
-              debugPrintln(" schede)");
-              newSchedeReady = true;
-            }
+  // === Data - Telefono - Indirizzo (condensato) ===
+  escpos::emit(out, escpos::condensed(true));
 
-            lastFastPrintNumero[0] = '\0';
-            break;
-          }
-        }
+  bool hasTel = strlen(s.telefono) > 0;
+  bool hasInd = strlen(s.indirizzo) > 0;
 
-        lastFastPrintNumero[0] = '\0';
+  char data[12];
+  formatDate(s.data, data, sizeof(data));
+  out.print(data);
+  if (hasTel) {
+    out.print(" - ");
+    out.print(s.telefono);
+  }
+  if (hasInd) {
+    out.print(" - ");
+    out.print(s.indirizzo);
+  }
+  escpos::emit(out, Fmt::dopoInfo);
+
+  // === Attrezzo - Dotazione (max 32 caratteri) ===
+  if (attrezzoIdx < s.numAttrezzi) {
+    const Attrezzo& a = s.attrezzi[attrezzoIdx];
+
+    if (strlen(a.marca) > 0) {
+      riga[0] = '\0';
+
+      if (strlen(a.dotazione) > 0) {
+        // "marca - dotazione" deve stare in 32 char
+        // Se troppo lungo, tronca la marca e aggiungi "."
+        int maxMarca = Fmt::maxLine - 3 - utf8Len(a.dotazione);
+        if (maxMarca < 2) maxMarca = 2;  // Almeno 1 carattere + "."
+        appendTrunc(riga, sizeof(riga), a.marca, maxMarca);
+        appendStr(riga, sizeof(riga), " - ");
+        appendStr(riga, sizeof(riga), a.dotazione);
+      } else {
+        // Solo marca, tronca a 32 se necessario
+        appendTrunc(riga, sizeof(riga), a.marca, Fmt::maxLine);
       }
+
+      out.println(riga);
+    }
+
+    // Note (condensato)
+    if (strlen(a.note) > 0) {
+      escpos::emit(out, Fmt::noteOn);
+      out.print(a.note);
+      escpos::emit(out, Fmt::noteOff);
     }
-    // Polling dinamico basato su fascia oraria
-    // In modalità debug stampa su carta: polling più lento per risparmiare carta
-    int pollDelay = debugPrintMode ? 5000 : getPollInterval();
-    vTaskDelay(pollDelay / portTICK_PERIOD_MS);
   }
+
+  escpos::emit(out, Fmt::fine);
 }
 
-// ===== UI DISPLAY =====
-void drawButtons() {
-  // Pannello pulsanti a destra (landscape 320x240)
-  int panelX = 320 - BUTTON_PANEL_WIDTH;
-  int btnHeight = 80;  // Altezza di ogni pulsante (240 / 3)
+void renderEtichetta(LabelStream& out, const Scheda& s, int attrezzoIdx, int totAttrezzi) {
+  renderEtichettaFmt<Etichetta50x30>(out, s, attrezzoIdx, totAttrezzi);
+}
 
-  // Sfondo pannello (bordo grigio)
-  tft.fillRect(panelX, 0, BUTTON_PANEL_WIDTH, 240, TFT_DARKGREY);
+// ===== LATENZA STAMPA (pressione/comando -> primo byte alla stampante) =====
 
-  // Pulsante SU (in alto) - sfondo nero, triangolo bianco
-  tft.fillRect(panelX + 1, 1, BUTTON_PANEL_WIDTH - 2, btnHeight - 2, TFT_BLACK);
-  int centerX = panelX + BUTTON_PANEL_WIDTH / 2;
-  int centerY1 = btnHeight / 2;
-  tft.fillTriangle(
-    centerX - 15, centerY1 + 10,   // punta basso sx
-    centerX, centerY1 - 12,        // punta alto centro
-    centerX + 15, centerY1 + 10,   // punta basso dx
-    TFT_WHITE
-  );
+// Da chiamare quando l'utente (o un comando) chiede una stampa
+void markPrintTrigger(bool manual) {
+  uint32_t now = micros();
+  printTriggerManual = manual;
+  printTriggerUs = now ? now : 1;
+}
 
-  // Pulsante OK (centro) - sfondo nero, testo bianco
-  tft.fillRect(panelX + 1, btnHeight + 1, BUTTON_PANEL_WIDTH - 2, btnHeight - 2, TFT_BLACK);
-  tft.setTextColor(TFT_WHITE, TFT_BLACK);
-  tft.setTextSize(2);
-  tft.setCursor(panelX + 10, btnHeight + btnHeight / 2 - 8);
-  tft.print("OK");
+// Invia un'etichetta renderizzata alla stampante
+void replayLabel(const LabelStream& l, bool fromCache) {
+  // Svuota buffer prima del reset
+  printerSerial.flush();
+  while (printerSerial.available()) printerSerial.read();  // Svuota buffer RX
 
-  // Pulsante GIU (in basso) - sfondo nero, triangolo bianco
-  tft.fillRect(panelX + 1, btnHeight * 2 + 1, BUTTON_PANEL_WIDTH - 2, btnHeight - 2, TFT_BLACK);
-  int centerY3 = btnHeight * 2 + btnHeight / 2;
-  tft.fillTriangle(
-    centerX - 15, centerY3 - 10,  // punta alto sx
-    centerX, centerY3 + 12,       // punta basso centro
-    centerX + 15, centerY3 - 10,  // punta alto dx
-    TFT_WHITE
-  );
+  uint32_t startUs = micros();
+  uint16_t pos = 0;
+  for (int p = 0; p <= l.numPauses; p++) {
+    uint16_t end = (p < l.numPauses) ? l.pauses[p].offset : l.len;
+    if (end > pos) {
+      printerSerial.write(l.bytes + pos, end - pos);
+
+      // Primo byte inviato: registra la latenza dalla richiesta
+      if (printTriggerUs != 0) {
+        uint32_t us = micros() - printTriggerUs;
+        printTriggerUs = 0;
+        PrintLatency& pl = printLatency[printTriggerManual ? 2 : (fromCache ? 1 : 0)];
+        printTriggerManual = false;
+        pl.lastUs = us;
+        if (us > pl.maxUs) pl.maxUs = us;
+        pl.count++;
+        debugPrint(fromCache ? "[PRINT] Primo byte (cache): " : "[PRINT] Primo byte: ");
+        debugPrint((unsigned long)us);
+        debugPrintln(" us");
+      }
+      if (pollPaperUs != 0) {
+        mPollPaper.record(micros() - pollPaperUs);
+        pollPaperUs = 0;
+      }
+      pos = end;
+    }
+    if (p < l.numPauses) {
+      printerSerial.flush();
+      delay(l.pauses[p].ms);
+    }
+  }
+  mLabelPrint.record(micros() - startUs);
 }
 
-void drawList() {
-  // Area lista (landscape: sotto header, a sinistra dei pulsanti)
-  // Scrollbar a sinistra, poi lista, poi pulsanti a destra
-  int listTop = HEADER_HEIGHT;
-  int listX = SCROLLBAR_WIDTH + 2;  // Dopo scrollbar + gap
-  int listWidth = 320 - BUTTON_PANEL_WIDTH - listX;
-  int listHeight = 240 - HEADER_HEIGHT;
+// ===== CACHE ETICHETTE (PSRAM, spill su SD) =====
+// Ogni scheda che entra in memoria (CSV, polling, ricerca manuale) viene
+// renderizzata subito: ristampe da pulsante, PRINT: e inserimento manuale
+// diventano un replay del buffer. Invalidata dall'hash del record.
+#define LABELS_PER_JOB 5        // = attrezzi[5] in Scheda
+#define LABEL_CACHE_DIR "/labels"
+#define LABEL_CACHE_MAGIC 0x4C424C31  // "LBL1"
+
+struct LabelCacheEntry {
+  char numero[12];
+  uint32_t hash;      // Hash del record al momento del render
+  uint32_t gen;       // Generazione CSV in cui il record è stato visto
+  uint32_t lastUse;   // Per LRU
+  uint8_t numLabels;  // 0 = slot libero
+};
 
-  // Pulisci area scrollbar + lista
-  tft.fillRect(0, listTop, 320 - BUTTON_PANEL_WIDTH, listHeight, TFT_BLACK);
+struct LabelCacheFileHeader {
+  uint32_t magic;
+  uint32_t hash;
+  uint32_t gen;
+  uint8_t numLabels;
+};
 
-  // Usa font built-in numero 2 (piccolo, proporzionale)
-  tft.setTextFont(2);
-  tft.setTextSize(1);
+LabelCacheEntry labelCache[LABEL_CACHE_JOBS];
+LabelStream* labelSlots = NULL;  // PSRAM: LABEL_CACHE_JOBS * LABELS_PER_JOB
+SemaphoreHandle_t labelCacheMutex = NULL;
+uint32_t labelCacheGen = 0;
+uint32_t labelCacheTick = 0;
 
-  for (int i = 0; i < VISIBLE_ROWS && (scrollOffset + i) < numSchede; i++) {
-    int idx = scrollOffset + i;
-    Scheda& s = schede[idx];
+void labelCacheInit() {
+  labelSlots = (LabelStream*)ps_malloc(sizeof(LabelStream) * LABEL_CACHE_JOBS * LABELS_PER_JOB);
+  if (!labelSlots) {
+    debugPrintln("[CACHE] PSRAM non disponibile, cache etichette disattivata");
+    return;
+  }
+  memset(labelCache, 0, sizeof(labelCache));
+  labelCacheMutex = xSemaphoreCreateMutex();
+  // Generazione diversa ad ogni avvio: i file su SD di un boot precedente
+  // valgono solo se l'hash del record coincide
+  labelCacheGen = esp_random();
+  if (sdOK) {
+    storageRun(ST_CACHE, [] {
+      if (!SD.exists(LABEL_CACHE_DIR)) SD.mkdir(LABEL_CACHE_DIR);
+    });
+  }
+  debugPrint("[CACHE] Etichette in PSRAM: ");
+  debugPrint((int)(sizeof(LabelStream) * LABEL_CACHE_JOBS * LABELS_PER_JOB / 1024));
+  debugPrintln(" KB");
+}
 
-    // Altezza alternata 20/21px (media 20.5px), +1px padding sopra prima riga
-    int y = listTop + 5 + (i * 41) / 2;  // 41/2 = 20.5 in media, +5 invece di +4 per prima riga
-    int rowH = (i % 2 == 0) ? 20 : 21;
+// Hash FNV-1a dei soli campi stampati
+uint32_t fnv1a(uint32_t h, const char* str) {
+  for (; *str; str++) {
+    h ^= (uint8_t)*str;
+    h *= 16777619u;
+  }
+  return h * 16777619u;  // Separatore tra campi
+}
 
-    // Riga selezionata = sfondo bianco, testo nero
-    if (idx == selectedIndex) {
-      tft.fillRect(listX, y - 2, listWidth - 2, rowH, TFT_WHITE);
-      tft.setTextColor(TFT_BLACK, TFT_WHITE);
-    } else {
-      tft.setTextColor(s.completato ? TFT_DARKGREY : TFT_WHITE, TFT_BLACK);
-    }
+uint32_t hashScheda(const Scheda& s) {
+  uint32_t h = 2166136261u;
+  h = fnv1a(h, s.numero);
+  h = fnv1a(h, s.data);
+  h = fnv1a(h, s.cliente);
+  h = fnv1a(h, s.telefono);
+  h = fnv1a(h, s.indirizzo);
+  h ^= s.ddt ? 1 : 0;
+  for (int i = 0; i < s.numAttrezzi && i < LABELS_PER_JOB; i++) {
+    h = fnv1a(h, s.attrezzi[i].marca);
+    h = fnv1a(h, s.attrezzi[i].dotazione);
+    h = fnv1a(h, s.attrezzi[i].note);
+  }
+  return h ? h : 1;
+}
 
-    // Numero + Cliente
-    tft.setCursor(listX + 2, y);
-    tft.print(s.numero);
-    tft.print(" ");
+void labelCachePath(const char* numero, char* path, size_t cap) {
+  // "26/0021" -> "/labels/26_0021.bin"
+  snprintf(path, cap, LABEL_CACHE_DIR "/%s.bin", numero);
+  for (char* c = path + sizeof(LABEL_CACHE_DIR); *c; c++) {
+    if (*c == '/') *c = '_';
+  }
+}
 
-    String cliente = String(s.cliente);
-    // Troncamento: "COSTRUZIONI TAGLIAMENTO SRL" -> "COSTRUZIONI TAGLIAMENTO S."
-    // 26 caratteri max per cliente (dopo numero 7 char + spazio)
-    if (cliente.length() > 26) {
-      cliente = cliente.substring(0, 25) + ".";
+int labelCacheFind(const char* numero) {
+  for (int i = 0; i < LABEL_CACHE_JOBS; i++) {
+    if (labelCache[i].numLabels > 0 && strcmp(labelCache[i].numero, numero) == 0) {
+      return i;
     }
-    tft.print(cliente);
+  }
+  return -1;
+}
+
+// Sposta una voce su SD (chiamata con mutex preso)
+void labelCacheSpill(int i) {
+  if (!sdOK) return;
+  LabelCacheEntry& e = labelCache[i];
+  char path[32];
+  labelCachePath(e.numero, path, sizeof(path));
+  storageRun(ST_CACHE, [&] {
+    File f = SD.open(path, FILE_WRITE);
+    if (!f) return;
+    LabelCacheFileHeader h = {LABEL_CACHE_MAGIC, e.hash, e.gen, e.numLabels};
+    f.write((const uint8_t*)&h, sizeof(h));
+    f.write((const uint8_t*)&labelSlots[i * LABELS_PER_JOB], sizeof(LabelStream) * e.numLabels);
+    f.close();
+  });
+}
+
+// Slot libero o meno usato di recente (spill su SD)
+int labelCacheVictim() {
+  int victim = 0;
+  for (int i = 0; i < LABEL_CACHE_JOBS; i++) {
+    if (labelCache[i].numLabels == 0) return i;
+    if (labelCache[i].lastUse < labelCache[victim].lastUse) victim = i;
+  }
+  labelCacheSpill(victim);
+  labelCache[victim].numLabels = 0;
+  return victim;
+}
 
-    // Indicatore stato completato
-    if (s.completato) {
-      tft.setTextColor(TFT_GREEN, idx == selectedIndex ? TFT_WHITE : TFT_BLACK);
-      tft.setCursor(listX + listWidth - 16, y);
-      tft.print("V");
+// Ricarica da SD una voce uscita dalla PSRAM (tutto sul task storage:
+// anche lo spill della vittima, che ci gira direttamente)
+int labelCacheLoad(const char* numero) {
+  if (!sdOK) return -1;
+  char path[32];
+  labelCachePath(numero, path, sizeof(path));
+  int i = -1;
+  storageRun(ST_CACHE, [&] {
+    if (!SD.exists(path)) return;
+    File f = SD.open(path, FILE_READ);
+    if (!f) return;
+
+    LabelCacheFileHeader h;
+    if (f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == LABEL_CACHE_MAGIC &&
+        h.numLabels > 0 && h.numLabels <= LABELS_PER_JOB) {
+      i = labelCacheVictim();
+      size_t n = sizeof(LabelStream) * h.numLabels;
+      if (f.read((uint8_t*)&labelSlots[i * LABELS_PER_JOB], n) == n) {
+        LabelCacheEntry& e = labelCache[i];
+        strncpy(e.numero, numero, sizeof(e.numero) - 1);
+        e.numero[sizeof(e.numero) - 1] = '\0';
+        e.hash = h.hash;
+        e.gen = h.gen;
+        e.lastUse = ++labelCacheTick;  // Appena ricaricata: non è la prossima vittima
+        e.numLabels = h.numLabels;
+      } else {
+        i = -1;
+      }
     }
+    f.close();
+  });
+  return i;
+}
+
+// Renderizza (se serve) tutte le etichette di una scheda
+void labelCachePut(const Scheda& s) {
+  if (!labelSlots || s.numero[0] == '\0') return;
+  uint32_t h = hashScheda(s);
+  int numLabels = max(1, min(s.numAttrezzi, LABELS_PER_JOB));
+
+  xSemaphoreTake(labelCacheMutex, portMAX_DELAY);
+  int i = labelCacheFind(s.numero);
+  if (i < 0) i = labelCacheLoad(s.numero);
+  if (i >= 0 && labelCache[i].hash == h) {
+    labelCache[i].gen = labelCacheGen;  // Invariato: confermato per questa generazione
+    xSemaphoreGive(labelCacheMutex);
+    return;
   }
+  if (i < 0) i = labelCacheVictim();
 
-  // Torna al font di default
-  tft.setTextFont(1);
+  for (int j = 0; j < numLabels; j++) {
+    renderEtichetta(labelSlots[i * LABELS_PER_JOB + j], s, j, numLabels);
+  }
+  LabelCacheEntry& e = labelCache[i];
+  strncpy(e.numero, s.numero, sizeof(e.numero) - 1);
+  e.numero[sizeof(e.numero) - 1] = '\0';
+  e.hash = h;
+  e.gen = labelCacheGen;
+  e.lastUse = ++labelCacheTick;
+  e.numLabels = numLabels;
+  xSemaphoreGive(labelCacheMutex);
+}
 
-  // Scrollbar a sinistra (margine libero)
-  if (numSchede > VISIBLE_ROWS) {
-    int barHeight = (listHeight * VISIBLE_ROWS) / numSchede;
-    if (barHeight < 10) barHeight = 10;
-    int scrollRange = listHeight - barHeight;
-    int barY = listTop + (scrollOffset * scrollRange) / max(1, numSchede - VISIBLE_ROWS);
-    tft.fillRect(0, listTop, SCROLLBAR_WIDTH, listHeight, TFT_DARKGREY);
-    tft.fillRect(0, barY, SCROLLBAR_WIDTH, barHeight, TFT_WHITE);
-  } else {
-    tft.fillRect(0, listTop, SCROLLBAR_WIDTH, listHeight, TFT_DARKGREY);
+// Copia un'etichetta in cache. hash = 0: basta che la voce sia della
+// generazione CSV corrente (ricerca per solo numero, senza record)
+bool labelCacheCopy(const char* numero, uint32_t hash, int idx, int tot, LabelStream& out,
+                    int* numLabels) {
+  if (!labelSlots) return false;
+  bool ok = false;
+  xSemaphoreTake(labelCacheMutex, portMAX_DELAY);
+  int i = labelCacheFind(numero);
+  if (i < 0) i = labelCacheLoad(numero);
+  if (i >= 0) {
+    LabelCacheEntry& e = labelCache[i];
+    bool valid = hash ? (e.hash == hash) : (e.gen == labelCacheGen);
+    if (valid && (tot == 0 || tot == e.numLabels) && idx < e.numLabels) {
+      out = labelSlots[i * LABELS_PER_JOB + idx];
+      e.lastUse = ++labelCacheTick;
+      if (numLabels) *numLabels = e.numLabels;
+      ok = true;
+    }
   }
+  xSemaphoreGive(labelCacheMutex);
+  return ok;
 }
 
-void drawHeader() {
-  // Header in alto (landscape: larghezza fino ai pulsanti)
-  int headerWidth = 320 - BUTTON_PANEL_WIDTH;
-  tft.fillRect(0, 0, headerWidth, HEADER_HEIGHT, TFT_BLACK);
-  tft.setTextColor(TFT_WHITE, TFT_BLACK);
-  tft.setTextSize(2);
-  // Centro orizzontale nell'area header
-  tft.setCursor((headerWidth - 132) / 2, (HEADER_HEIGHT - 16) / 2);
-  tft.print("EM Maranzan");
+bool labelCacheGet(const Scheda& s, int idx, int tot, LabelStream& out) {
+  return labelCacheCopy(s.numero, hashScheda(s), idx, tot, out, NULL);
+}
 
-  // Linea separatore
-  tft.drawFastHLine(0, HEADER_HEIGHT - 1, headerWidth, TFT_DARKGREY);
+// Numero di etichette in cache per una scheda valida nella generazione
+// corrente (0 = non in cache). hash: impronta della voce, per ritrovare
+// la stessa versione anche dopo un nuovo CSV
+int labelCacheCount(const char* numero, uint32_t* hash = NULL) {
+  if (!labelSlots) return 0;
+  int n = 0;
+  xSemaphoreTake(labelCacheMutex, portMAX_DELAY);
+  int i = labelCacheFind(numero);
+  if (i < 0) i = labelCacheLoad(numero);
+  if (i >= 0 && labelCache[i].gen == labelCacheGen) {
+    n = labelCache[i].numLabels;
+    if (hash) *hash = labelCache[i].hash;
+  }
+  xSemaphoreGive(labelCacheMutex);
+  return n;
 }
 
-void showMessage(const char* msg, uint16_t color) {
-  // Se messaggio vuoto, ridisegna la lista per ripristinare l'area
-  if (msg[0] == '\0') {
-    drawList();
-    return;
+// Nuovo CSV: le schede fuori dalla lista restano valide solo per hash
+void labelCacheRefresh() {
+  if (!labelSlots) return;
+  labelCacheGen++;
+  SchedeRef schede;
+  for (int i = 0; i < schede.count(); i++) {
+    labelCachePut(schede[i]);
   }
-  // Mostra messaggio temporaneo in basso (dopo scrollbar, prima dei pulsanti)
-  int msgX = SCROLLBAR_WIDTH + 2;  // Dopo scrollbar + gap
-  int msgY = 240 - 20;
-  int msgWidth = 320 - BUTTON_PANEL_WIDTH - msgX;
-  tft.fillRect(msgX, msgY, msgWidth, 20, TFT_BLACK);
-  tft.setTextColor(color, TFT_BLACK);
-  tft.setTextSize(1);
-  tft.setCursor(msgX + 3, msgY + 6);
-  tft.print(msg);
 }
 
-// ===== MODALITA' INSERIMENTO MANUALE =====
+int labelCacheUsed() {
+  int n = 0;
+  for (int i = 0; i < LABEL_CACHE_JOBS; i++) {
+    if (labelCache[i].numLabels > 0) n++;
+  }
+  return n;
+}
 
-// Inizializza numero manuale con la scheda più recente
-void initManualNumero() {
-  if (numSchede > 0) {
-    strncpy(manualNumero, schede[0].numero, 7);
-    manualNumero[7] = '\0';
-  } else {
-    strcpy(manualNumero, "26/0001");
+// Stampa un'etichetta: usa la versione in cache se il record non è cambiato
+void printEtichetta(Scheda& s, int attrezzoIdx, int totAttrezzi) {
+  LabelStream l;
+  bool cached = labelCacheGet(s, attrezzoIdx, totAttrezzi, l);
+  if (!cached) {
+    renderEtichetta(l, s, attrezzoIdx, totAttrezzi);
+    labelCachePut(s);
   }
-  manualCursorPos = 0;
+  replayLabel(l, cached);
 }
 
-// Mappa posizione cursore logica (0-5) a posizione stringa (0-6, salta /)
-int cursorToStringPos(int cursorPos) {
-  if (cursorPos < 2) return cursorPos;  // 0,1 -> 0,1
-  return cursorPos + 1;  // 2,3,4,5 -> 3,4,5,6
+// Stampa una scheda direttamente dalla cache (nessun record necessario)
+bool printFromCache(const char* numero) {
+  uint32_t hash = 0;
+  if (labelCacheCount(numero, &hash) == 0) return false;
+  return enqueueCachedPrint(numero, hash, PAUSE_NORMAL_SEC, 0);
 }
 
-// Disegna UI modalità inserimento manuale
-void drawManualInput() {
-  // Pulisci area centrale (landscape: a sinistra dei pulsanti)
-  int areaWidth = 320 - BUTTON_PANEL_WIDTH;
-  int areaTop = HEADER_HEIGHT;
-  int areaHeight = 240 - areaTop;
-  tft.fillRect(0, areaTop, areaWidth, areaHeight, TFT_BLACK);
+// ===== SPOOL DI STAMPA (SD, sopravvive a cali di corrente) =====
+// Log append-only in /spool.log, un record per riga chiuso da checksum:
+//   J <seq> <numero> <pausa> <maschera>   job accodato (maschera = etichette già fatte)
+//   L <seq> <idx>                          etichetta idx stampata
+//   D <seq>                                job completato o scartato
+// Ogni record è flushato su SD prima di proseguire. Una riga troncata da un
+// calo di corrente non supera il checksum e viene ignorata: nel caso peggiore
+// l'ultima etichetta uscita viene ristampata, mai persa.
+#define SPOOL_PATH "/spool.log"
+#define SPOOL_TMP_PATH "/spool.tmp"
+#define SPOOL_MAX_OPEN 16          // > PRINT_QUEUE_LEN + job in stampa + produttori
+#define SPOOL_COMPACT_BYTES 8192   // Oltre questa dimensione riscrive solo i job aperti
+
+struct SpoolJob {
+  uint32_t seq;
+  char numero[12];
+  uint8_t pauseSec;
+  uint8_t doneMask;  // bit i = etichetta i già stampata
+};
 
-  // Numero grande centrato
-  tft.setTextSize(4);  // Font grande
+File spoolFile;
+SemaphoreHandle_t spoolMutex = NULL;
+uint32_t spoolNextSeq = 1;
 
-  // Calcola larghezza totale: 7 caratteri × 24px = 168px
-  int charWidth = 24;
-  int totalWidth = 7 * charWidth;
-  int startX = (areaWidth - totalWidth) / 2;
-  int numY = areaTop + (areaHeight / 2) - 40;
+// Checksum di riga (xor con rotazione: rileva anche byte scambiati)
+uint8_t spoolChecksum(const char* str, size_t len) {
+  uint8_t c = 0;
+  for (size_t i = 0; i < len; i++) {
+    c = (uint8_t)((c << 1) | (c >> 7)) ^ (uint8_t)str[i];
+  }
+  return c;
+}
 
-  // Disegna ogni carattere
-  for (int i = 0; i < 7; i++) {
-    int x = startX + i * charWidth;
-    int logicalPos = (i < 2) ? i : (i > 2 ? i - 1 : -1);  // -1 per /
-    bool isSelected = (logicalPos == manualCursorPos);
+// Scrive un record + checksum e lo porta su SD (chiamare con spoolMutex preso)
+bool spoolWrite(File& f, const char* rec) {
+  char line[48];
+  int n = snprintf(line, sizeof(line), "%s*%02X\n", rec, spoolChecksum(rec, strlen(rec)));
+  if (n <= 0 || n >= (int)sizeof(line)) return false;
+  // Sincrona: il record deve essere su SD prima che il job vada avanti
+  bool ok = false;
+  storageRun(ST_SPOOL, [&] {
+    ok = f.write((const uint8_t*)line, n) == (size_t)n;
+    f.flush();
+  });
+  return ok;
+}
 
-    if (isSelected) {
-      // Sfondo bianco, testo nero (come riga selezionata nella lista)
-      tft.fillRect(x - 2, numY - 4, charWidth, 36, TFT_WHITE);
-      tft.setTextColor(TFT_BLACK, TFT_WHITE);
-    } else {
-      tft.setTextColor(TFT_WHITE, TFT_BLACK);
+// Verifica il checksum e tronca la riga al record. false = riga da ignorare
+bool spoolCheckLine(char* line) {
+  char* star = strrchr(line, '*');
+  if (!star || strlen(star) != 3) return false;
+  uint8_t expected = (uint8_t)strtoul(star + 1, NULL, 16);
+  *star = '\0';
+  return spoolChecksum(line, strlen(line)) == expected;
+}
+
+// Rilegge il log e ricostruisce i job non completati (chiamare con spoolMutex preso)
+int spoolScan(SpoolJob* open, int maxOpen) {
+  int n = 0;
+  storageRun(ST_SPOOL, [&] {
+    spoolFile.close();
+    File f = SD.open(SPOOL_PATH, FILE_READ);
+    if (f) {
+      while (f.available()) {
+        String str = f.readStringUntil('\n');
+        str.trim();
+        char line[48];
+        if (str.length() == 0 || str.length() >= sizeof(line)) continue;
+        strcpy(line, str.c_str());
+        if (!spoolCheckLine(line)) continue;  // Riga troncata o corrotta
+
+        unsigned long seq = 0;
+        if (line[0] == 'J') {
+          SpoolJob j;
+          unsigned int pauseSec = 0, mask = 0;
+          if (sscanf(line, "J %lu %11s %u %u", &seq, j.numero, &pauseSec, &mask) != 4) continue;
+          if (n >= maxOpen) {
+            debugPrintln("[SPOOL] Troppi job aperti, ignoro");
+            continue;
+          }
+          j.seq = seq;
+          j.pauseSec = pauseSec;
+          j.doneMask = mask;
+          open[n++] = j;
+        } else if (line[0] == 'L') {
+          unsigned int idx = 0;
+          if (sscanf(line, "L %lu %u", &seq, &idx) != 2 || idx >= 8) continue;
+          for (int i = 0; i < n; i++) {
+            if (open[i].seq == seq) open[i].doneMask |= (1 << idx);
+          }
+        } else if (line[0] == 'D') {
+          if (sscanf(line, "D %lu", &seq) != 1) continue;
+          for (int i = 0; i < n; i++) {
+            if (open[i].seq == seq) {
+              open[i] = open[--n];
+              break;
+            }
+          }
+        } else {
+          continue;
+        }
+        if (seq >= spoolNextSeq) spoolNextSeq = seq + 1;
+      }
+      f.close();
     }
+    spoolFile = SD.open(SPOOL_PATH, FILE_APPEND);
+  });
+  return n;
+}
 
-    tft.setCursor(x, numY);
-    tft.print(manualNumero[i]);
-  }
+// Riscrive il log con i soli job aperti: file temporaneo, poi rename
+// (se si spegne a metà, all'avvio spoolInit recupera il temporaneo)
+void spoolRewrite(const SpoolJob* open, int n) {
+  storageRun(ST_SPOOL, [&] {
+    File f = SD.open(SPOOL_TMP_PATH, FILE_WRITE);
+    if (!f) return;
+    for (int i = 0; i < n; i++) {
+      char rec[40];
+      snprintf(rec, sizeof(rec), "J %lu %s %u %u", (unsigned long)open[i].seq,
+               open[i].numero, open[i].pauseSec, open[i].doneMask);
+      spoolWrite(f, rec);
+    }
+    f.close();
 
-  // Istruzioni
-  tft.setTextSize(1);
-  tft.setTextColor(TFT_DARKGREY, TFT_BLACK);
-  int instrY = numY + 55;
-  int instrX = (areaWidth - 150) / 2;
-  tft.setCursor(instrX, instrY);
-  tft.print("Frecce: cambia cifra");
-  tft.setCursor(instrX, instrY + 15);
-  tft.print("OK: prossima / stampa");
-  tft.setCursor(instrX, instrY + 30);
-  tft.print("OK 2s: annulla");
+    spoolFile.close();
+    SD.remove(SPOOL_PATH);
+    SD.rename(SPOOL_TMP_PATH, SPOOL_PATH);
+    spoolFile = SD.open(SPOOL_PATH, FILE_APPEND);
+  });
 }
 
-// Cambia cifra corrente (su/giù)
-void changeManualDigit(int delta) {
-  int strPos = cursorToStringPos(manualCursorPos);
-  char c = manualNumero[strPos];
+// Apre il log e ripara una coda troncata (chiamare dopo SD.begin)
+void spoolInit() {
+  if (!sdOK) return;
+  spoolMutex = xSemaphoreCreateMutex();
 
-  if (c >= '0' && c <= '9') {
-    int digit = c - '0';
-    digit = (digit + delta + 10) % 10;  // Wrap 0-9
-    manualNumero[strPos] = '0' + digit;
-  }
+  storageRun(ST_SPOOL, [&] {
+    // Spento durante spoolRewrite: il temporaneo è completo, il log no
+    if (!SD.exists(SPOOL_PATH) && SD.exists(SPOOL_TMP_PATH)) {
+      SD.rename(SPOOL_TMP_PATH, SPOOL_PATH);
+    }
 
-  drawManualInput();
-}
+    // Ultima riga senza \n: chiudila, altrimenti il prossimo record ci si attacca
+    bool needNewline = false;
+    File f = SD.open(SPOOL_PATH, FILE_READ);
+    if (f) {
+      if (f.size() > 0) {
+        f.seek(f.size() - 1);
+        needNewline = f.read() != '\n';
+      }
+      f.close();
+    }
 
-// Avanza cursore o stampa
-void advanceManualCursor() {
-  manualCursorPos++;
+    spoolFile = SD.open(SPOOL_PATH, FILE_APPEND);
+    if (needNewline && spoolFile) {
+      spoolFile.write('\n');
+      spoolFile.flush();
+    }
+  });
+}
 
-  if (manualCursorPos >= 6) {
-    // Ultima posizione raggiunta, cerca e stampa
-    tryPrintManualScheda();
-  } else {
-    drawManualInput();
-  }
+// Registra un job prima di accodarlo. Ritorna 0 se lo spool non è disponibile
+uint32_t spoolBegin(const char* numero, uint8_t pauseSec) {
+  if (!spoolMutex || !spoolFile) return 0;
+  xSemaphoreTake(spoolMutex, portMAX_DELAY);
+  uint32_t seq = spoolNextSeq++;
+  char rec[40];
+  snprintf(rec, sizeof(rec), "J %lu %s %u 0", (unsigned long)seq, numero, pauseSec);
+  spoolWrite(spoolFile, rec);
+  xSemaphoreGive(spoolMutex);
+  return seq;
 }
 
-// Cerca scheda nel CSV su SD e stampa
-void tryPrintManualScheda() {
-  showMessage("Ricerca scheda...", TFT_YELLOW);
-  debugPrint("[MANUAL] Cerco scheda: ");
-  debugPrintln(manualNumero);
+// Etichetta idx uscita dalla stampante
+void spoolLabel(uint32_t seq, int idx) {
+  if (seq == 0 || !spoolMutex) return;
+  xSemaphoreTake(spoolMutex, portMAX_DELAY);
+  char rec[24];
+  snprintf(rec, sizeof(rec), "L %lu %d", (unsigned long)seq, idx);
+  spoolWrite(spoolFile, rec);
+  xSemaphoreGive(spoolMutex);
+}
 
-  if (!sdOK) {
-    debugPrintln("[MANUAL] SD non disponibile");
-    showMessage("SD non disponibile!", TFT_RED);
-    delay(2000);
-    manualCursorPos = 0;  // Torna alla prima cifra
-    drawManualInput();
-    return;
-  }
+// Job chiuso (stampato o scartato); compatta il log se è cresciuto troppo
+void spoolDone(uint32_t seq) {
+  if (seq == 0 || !spoolMutex) return;
+  xSemaphoreTake(spoolMutex, portMAX_DELAY);
+  char rec[24];
+  snprintf(rec, sizeof(rec), "D %lu", (unsigned long)seq);
+  spoolWrite(spoolFile, rec);
+
+  size_t size = 0;
+  storageRun(ST_SPOOL, [&] { size = spoolFile.size(); });
+  if (size > SPOOL_COMPACT_BYTES) {
+    static SpoolJob open[SPOOL_MAX_OPEN];
+    int n = spoolScan(open, SPOOL_MAX_OPEN);
+    spoolRewrite(open, n);
+  }
+  xSemaphoreGive(spoolMutex);
+}
 
-  File f = SD.open("/riparazioni.csv", FILE_READ);
-  if (!f) {
-    debugPrintln("[MANUAL] File CSV non trovato");
-    showMessage("File CSV non trovato!", TFT_RED);
-    delay(2000);
-    manualCursorPos = 0;  // Torna alla prima cifra
-    drawManualInput();
-    return;
-  }
+// ===== CODA DI STAMPA =====
+// Tutte le stampe passano da un unico task che possiede la stampante:
+// chi chiede una stampa (pulsante, polling, comandi, manuale) accoda e
+// prosegue, e i batch si risolvono mentre le schede precedenti stampano.
+enum PrintJobKind : uint8_t {
+  JOB_SCHEDA,     // Scheda completa (renderizzata o già in cache)
+  JOB_CACHED,     // Solo numero: etichette già in cache
+  JOB_BATCH_END,  // Fine batch: stampa il report
+  JOB_STATUS,     // Comando STATUS: report su carta
+  JOB_METRICS     // Comando METRICS: report su carta
+};
 
-  debugPrint("[MANUAL] File aperto, dimensione: ");
-  debugPrintln(f.size());
+struct PrintJob {
+  uint8_t kind;
+  uint8_t pauseSec;
+  uint16_t batchId;       // 0 = stampa singola
+  uint16_t batchTot;      // JOB_BATCH_END: schede richieste
+  uint16_t batchMissing;  // JOB_BATCH_END: schede non trovate
+  uint32_t spoolSeq;      // Record nello spool su SD (0 = non registrato)
+  uint8_t doneMask;       // Etichette già stampate prima di un riavvio
+  uint32_t cacheHash;     // JOB_CACHED: versione in cache al momento dell'accodamento
+  Scheda s;               // JOB_CACHED: solo s.numero
+};
 
-  bool found = false;
-  Scheda s;
-  memset(&s, 0, sizeof(Scheda));
+// Statistiche del batch in corso (aggiornate dal task di stampa)
+struct BatchStats {
+  uint16_t id;
+  unsigned long startMs;
+  int jobs;
+  int labels;
+};
 
-  // Salta header
-  if (f.available()) {
-    f.readStringUntil('\n');
+BatchStats batchStats = {0, 0, 0, 0};
+uint16_t nextBatchId = 1;
+
+// Accoda una scheda. wait = 0 dal loop (non blocca se la coda è piena)
+bool enqueueJob(uint8_t kind, const Scheda* s, const char* numero, uint8_t pauseSec,
+                TickType_t wait, uint16_t batchId, int batchTot, int batchMissing,
+                uint32_t spoolSeq, uint8_t doneMask, uint32_t cacheHash = 0) {
+  // PrintJob è troppo grande per lo stack del chiamante: buffer unico
+  // protetto da mutex (xQueueSend lo copia nella coda)
+  static PrintJob job;
+  static SemaphoreHandle_t jobLock = xSemaphoreCreateMutex();
+
+  xSemaphoreTake(jobLock, portMAX_DELAY);
+  job.kind = kind;
+  job.pauseSec = pauseSec;
+  job.batchId = batchId;
+  job.batchTot = batchTot;
+  job.batchMissing = batchMissing;
+  job.spoolSeq = spoolSeq;
+  job.doneMask = doneMask;
+  job.cacheHash = cacheHash;
+  if (s) {
+    job.s = *s;
+  } else {
+    memset(&job.s, 0, sizeof(Scheda));
+    if (numero) strncpy(job.s.numero, numero, sizeof(job.s.numero) - 1);
   }
+  bool ok = xQueueSend(printQueue, &job, wait) == pdTRUE;
+  xSemaphoreGive(jobLock);
+  return ok;
+}
 
-  int lineCount = 0;
+// Il job va nello spool prima di entrare in coda: se la coda è piena si
+// chiude subito il record, altrimenti al riavvio verrebbe stampato
+bool enqueuePrint(const Scheda& s, uint8_t pauseSec, TickType_t wait, uint16_t batchId) {
+  uint32_t seq = spoolBegin(s.numero, pauseSec);
+  if (enqueueJob(JOB_SCHEDA, &s, NULL, pauseSec, wait, batchId, 0, 0, seq, 0)) return true;
+  spoolDone(seq);
+  return false;
+}
 
-  // Cerca la riga con il numero corrispondente
-  while (f.available()) {
-    String line = f.readStringUntil('\n');
-    line.trim();
-    lineCount++;
+// Accoda una ristampa dalla cache (nessun record necessario). Il job è
+// legato all'hash della voce: un CSV riletto prima della stampa non lo
+// invalida se la scheda non è cambiata
+bool enqueueCachedPrint(const char* numero, uint32_t hash, uint8_t pauseSec, TickType_t wait) {
+  uint32_t seq = spoolBegin(numero, pauseSec);
+  if (enqueueJob(JOB_CACHED, NULL, numero, pauseSec, wait, 0, 0, 0, seq, 0, hash)) return true;
+  spoolDone(seq);
+  return false;
+}
 
-    if (line.length() == 0) continue;
+// Accoda il marcatore di fine batch (report a stampa completata)
+bool enqueueBatchEnd(uint16_t batchId, int requested, int missing, TickType_t wait) {
+  return enqueueJob(JOB_BATCH_END, NULL, NULL, 0, wait, batchId, requested, missing, 0, 0);
+}
 
-    // Estrai il numero (primo campo)
-    String numero = getCSVField(line, 0);
+// Accoda i report su carta dei comandi remoti: solo il task di stampa
+// scrive sulla stampante, anche tra un job e l'altro
+bool enqueueStatusReport(TickType_t wait) {
+  return enqueueJob(JOB_STATUS, NULL, NULL, 0, wait, 0, 0, 0, 0, 0);
+}
 
-    if (numero.equals(manualNumero)) {
-      // Trovata! Parsa la riga
-      debugPrint("[MANUAL] Scheda trovata alla riga ");
-      debugPrintln(lineCount);
+bool enqueueMetricsReport(TickType_t wait) {
+  return enqueueJob(JOB_METRICS, NULL, NULL, 0, wait, 0, 0, 0, 0, 0);
+}
 
-      strncpy(s.numero, numero.c_str(), sizeof(s.numero) - 1);
-      strncpy(s.data, getCSVField(line, 1).c_str(), sizeof(s.data) - 1);
-      strncpy(s.cliente, getCSVField(line, 2).c_str(), sizeof(s.cliente) - 1);
-      strncpy(s.indirizzo, getCSVField(line, 3).c_str(), sizeof(s.indirizzo) - 1);
-      strncpy(s.telefono, getCSVField(line, 4).c_str(), sizeof(s.telefono) - 1);
+// Report finale di un batch: schede, etichette, etichette al minuto
+void reportBatch(const PrintJob& job) {
+  unsigned long ms = (batchStats.id == job.batchId) ? millis() - batchStats.startMs : 0;
+  int jobs = (batchStats.id == job.batchId) ? batchStats.jobs : 0;
+  int labels = (batchStats.id == job.batchId) ? batchStats.labels : 0;
+  float perMin = ms > 0 ? labels * 60000.0f / ms : 0;
+
+  debugPrint("[BATCH] Completato: ");
+  debugPrint(jobs);
+  debugPrint("/");
+  debugPrint((int)job.batchTot);
+  debugPrint(" schede, ");
+  debugPrint(labels);
+  debugPrint(" etichette in ");
+  debugPrint(ms / 1000);
+  debugPrint("s, non trovate: ");
+  debugPrintln((int)job.batchMissing);
+
+  char msg[40];
+  snprintf(msg, sizeof(msg), "Batch %d/%d: %d etich. %.1f/min", jobs, job.batchTot, labels, perMin);
+  showMessage(msg, job.batchMissing > 0 ? TFT_ORANGE : TFT_GREEN);
+}
 
-      // Parse attrezzi (campo 6)
-      String attrezziJson = getCSVField(line, 6);
-      parseAttrezziJSON(attrezziJson, s);
+// JOB_CACHED uscito dalla cache (scheda modificata o voce eliminata):
+// ricarica il record come farebbe l'inserimento manuale
+bool runPrintJobLoad(PrintJob& job) {
+  {
+    SchedeRef schede;
+    for (int i = 0; i < schede.count(); i++) {
+      if (strcmp(schede[i].numero, job.s.numero) == 0) {
+        job.s = schede[i];
+        return true;
+      }
+    }
+  }
+  int id = packNumero(job.s.numero);
+  return id >= 0 && archiveFind(id, job.s);
+}
 
-      found = true;
-      break;
+// Stampa tutte le etichette di un job. false se la scheda sparisce a metà:
+// il record nello spool resta aperto per le etichette non stampate
+bool runPrintJob(PrintJob& job) {
+  bool fromCache = (job.kind == JOB_CACHED);
+  int numEtichette = max(1, job.s.numAttrezzi);
+  if (fromCache) {
+    LabelStream tmp;
+    if (labelCacheCopy(job.s.numero, job.cacheHash, 0, 0, tmp, &numEtichette)) {
+      // Versione accodata ancora disponibile
+    } else if (runPrintJobLoad(job)) {
+      debugPrint("[PRINT] Non piu' in cache, ricaricata: ");
+      debugPrintln(job.s.numero);
+      fromCache = false;
+      numEtichette = max(1, job.s.numAttrezzi);
+    } else {
+      errorPrint("[PRINT] Scheda non trovata: ");
+      errorPrintln(job.s.numero);
+      showMessage("Scheda non trovata!", TFT_RED);
+      spoolDone(job.spoolSeq);
+      return false;
     }
   }
 
-  f.close();
-  debugPrint("[MANUAL] Righe lette: ");
-  debugPrint(lineCount);
-  debugPrint(", trovata: ");
-  debugPrintln(found ? "SI" : "NO");
+  // Statistiche batch: il primo job di un nuovo batch azzera
+  if (job.batchId != 0 && job.batchId != batchStats.id) {
+    batchStats.id = job.batchId;
+    batchStats.startMs = millis();
+    batchStats.jobs = 0;
+    batchStats.labels = 0;
+  }
 
-  if (found) {
-    // Stampa
-    int numEtichette = max(1, s.numAttrezzi);
-    for (int i = 0; i < numEtichette; i++) {
-      char msg[32];
-      sprintf(msg, "Stampa %s (%d/%d)", s.numero, i + 1, numEtichette);
-      showMessage(msg, TFT_CYAN);
-      printEtichetta(s, i, numEtichette);
-
-      if (i < numEtichette - 1) {
-        for (int sec = 8; sec > 0; sec--) {
-          char countdown[32];
-          sprintf(countdown, "Prossima in %ds...", sec);
-          showMessage(countdown, TFT_CYAN);
-          delay(1000);
-        }
+  debugPrint("[PRINT] Stampa scheda ");
+  debugPrint(job.s.numero);
+  debugPrint(" - ");
+  debugPrint(numEtichette);
+  debugPrintln(" etichette");
+
+  int printed = 0;
+  for (int i = 0; i < numEtichette; i++) {
+    // Già uscita prima di un riavvio (ripresa dallo spool)
+    if (job.doneMask & (1 << i)) continue;
+
+    // Voce uscita dalla cache a metà job (CSV riletto, slot riusato): le
+    // etichette rimaste dal record, con il conteggio del record
+    LabelStream l;
+    if (fromCache && !labelCacheCopy(job.s.numero, job.cacheHash, i, numEtichette, l, NULL)) {
+      if (!runPrintJobLoad(job)) {
+        errorPrint("[PRINT] Scheda sparita a meta' stampa: ");
+        errorPrintln(job.s.numero);
+        showMessage("Scheda non trovata!", TFT_RED);
+        return false;
       }
+      debugPrint("[PRINT] Uscita dalla cache a meta' stampa, ricaricata: ");
+      debugPrintln(job.s.numero);
+      fromCache = false;
+      numEtichette = max(1, job.s.numAttrezzi);
+      if (i >= numEtichette) break;
     }
 
-    showMessage("Stampa completata!", TFT_GREEN);
-    delay(1500);
+    // Pausa tra etichette multiple
+    if (printed > 0) {
+      for (int sec = job.pauseSec; sec > 0; sec--) {
+        char countdown[32];
+        sprintf(countdown, "Prossima in %ds...", sec);
+        showMessage(countdown, TFT_CYAN);
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+      }
+    }
 
-    // Esci dalla modalità manuale
-    manualInputMode = false;
-    tft.fillScreen(TFT_BLACK);
-    drawHeader();
-    drawList();
-    drawButtons();
+    char msg[40];
+    snprintf(msg, sizeof(msg), "Stampa %s (%d/%d)", job.s.numero, i + 1, numEtichette);
+    showMessage(msg, TFT_CYAN);
 
-  } else {
-    debugPrintln("[MANUAL] Scheda non trovata");
-    showMessage("Scheda non trovata!", TFT_RED);
-    delay(2000);
-    manualCursorPos = 0;  // Torna alla prima cifra
-    drawManualInput();
+    if (fromCache) {
+      replayLabel(l, true);
+    } else {
+      printEtichetta(job.s, i, numEtichette);
+    }
+    spoolLabel(job.spoolSeq, i);
+    printed++;
+    if (job.batchId != 0) batchStats.labels++;
   }
+  spoolDone(job.spoolSeq);
+  if (job.batchId != 0) batchStats.jobs++;
+  return true;
 }
 
-// Entra in modalità inserimento manuale
-void enterManualInputMode() {
-  manualInputMode = true;
-  initManualNumero();
-  lastManualActivity = millis();  // Inizializza timer inattività
+// Task di stampa: consuma la coda una scheda alla volta
+void printTask(void* parameter) {
+  static PrintJob job;
+  debugPrintln("[TASK] Print task avviato");
 
-  debugPrintln("[MANUAL] Modalità inserimento manuale attivata");
+  for (;;) {
+    xQueueReceive(printQueue, &job, portMAX_DELAY);
+    printBusy = true;
+
+    if (job.kind == JOB_BATCH_END) {
+      reportBatch(job);
+    } else if (job.kind == JOB_STATUS) {
+      printStatusReport();
+    } else if (job.kind == JOB_METRICS) {
+      printMetricsReport();
+    } else {
+      bool ok = runPrintJob(job);
+      // Coda vuota e nessun batch in corso: conferma
+      if (ok && job.batchId == 0 && uxQueueMessagesWaiting(printQueue) == 0) {
+        showMessage("Stampa OK!", TFT_GREEN);
+        debugPrintln("[PRINT] Completato");
+      }
+    }
 
-  tft.fillScreen(TFT_BLACK);
-  drawHeader();
-  drawManualInput();
-  drawButtons();
+    printBusy = false;
+  }
 }
 
-// Esci dalla modalità inserimento manuale
-void exitManualInputMode() {
-  manualInputMode = false;
+// Ripresa all'avvio: rimette in coda le etichette non stampate prima dello
+// spegnimento. Va chiamata dopo parseCSV e prima di markAllAsPrinted
+void spoolResume() {
+  if (!spoolMutex) return;
+  static SpoolJob open[SPOOL_MAX_OPEN];
+
+  xSemaphoreTake(spoolMutex, portMAX_DELAY);
+  int n = spoolScan(open, SPOOL_MAX_OPEN);
+  spoolRewrite(open, n);  // Riparte da un log con i soli job aperti
+  xSemaphoreGive(spoolMutex);
+
+  if (n == 0) return;
+  debugPrint("[SPOOL] Job da riprendere: ");
+  debugPrintln(n);
+
+  CsvCursor csv;
+  bool csvOpen = false;
+  static Scheda s;
+  for (int k = 0; k < n; k++) {
+    bool found = false;
+    {
+      SchedeRef schede;
+      for (int i = 0; i < schede.count(); i++) {
+        if (strcmp(schede[i].numero, open[k].numero) == 0) {
+          s = schede[i];
+          found = true;
+          break;
+        }
+      }
+    }
+    if (!found) {
+      if (!csvOpen) csvOpen = csv.open();
+      if (csvOpen) found = csv.find(open[k].numero, s);
+    }
 
-  debugPrintln("[MANUAL] Modalità inserimento manuale disattivata");
+    if (!found) {
+      debugPrint("[SPOOL] Scheda non trovata, scarto: ");
+      debugPrintln(open[k].numero);
+      spoolDone(open[k].seq);
+      continue;
+    }
 
-  tft.fillScreen(TFT_BLACK);
-  drawHeader();
-  drawList();
-  drawButtons();
+    debugPrint("[SPOOL] Riprendo ");
+    debugPrint(open[k].numero);
+    debugPrint(" (maschera ");
+    debugPrint((int)open[k].doneMask);
+    debugPrintln(")");
+    // Stesso seq: le etichette successive si registrano sul record originale
+    enqueueJob(JOB_SCHEDA, &s, NULL, open[k].pauseSec, portMAX_DELAY, 0, 0, 0,
+               open[k].seq, open[k].doneMask);
+  }
+  if (csvOpen) csv.close();
+  showMessage("Ripresa stampa interrotta", TFT_YELLOW);
 }
 
-// ===== FORMATTA DATA gg.mm.aa =====
-String formatDate(const char* isoDate) {
-  // Input: "2025-01-21" -> Output: "21.01.25"
-  String d = String(isoDate);
-  if (d.length() >= 10) {
-    return d.substring(8, 10) + "." + d.substring(5, 7) + "." + d.substring(2, 4);
+// ===== STAMPA SCHEDA (multi-etichetta) =====
+bool printScheda(const Scheda& s) {
+  if (!enqueuePrint(s, PAUSE_NORMAL_SEC, 0, 0)) {
+    showMessage("Coda stampa piena!", TFT_ORANGE);
+    return false;
+  }
+  return true;
+}
+
+// ===== STAMPA BATCH (PRINT:26/0010-26/0025, PRINT:26/0010,26/0012) =====
+#define MAX_BATCH 100
+
+// Espande "26/0010-26/0025,26/0030" in numeri impacchettati.
+// Ritorna il numero di elementi, -1 se la sintassi non è valida
+int parseBatchSpec(const char* spec, int* ids, int maxIds) {
+  int n = 0;
+  const char* p = spec;
+  while (*p) {
+    // Un elemento: "AA/NNNN" oppure "AA/NNNN-AA/NNNN"
+    char item[24];
+    size_t len = strcspn(p, ",");
+    if (len == 0 || len >= sizeof(item)) return -1;
+    memcpy(item, p, len);
+    item[len] = '\0';
+    p += len;
+    if (*p == ',') p++;
+
+    char* dash = strchr(item, '-');
+    int from, to;
+    if (dash) {
+      *dash = '\0';
+      from = packNumero(item);
+      to = packNumero(dash + 1);
+      // Intervalli solo nello stesso anno (il progressivo riparte ogni anno)
+      if (from < 0 || to < from || to / 10000 != from / 10000) return -1;
+    } else {
+      from = to = packNumero(item);
+      if (from < 0) return -1;
+    }
+    for (int id = from; id <= to; id++) {
+      if (n >= maxIds) return -1;
+      ids[n++] = id;
+    }
+  }
+  return n;
+}
+
+// Batch in corso: si accoda solo quando la coda ha posto, il resto
+// riprende ai passi successivi del task di polling (che intanto continua
+// a cercare nuove schede). Usato solo dal task di polling.
+struct PendingBatch {
+  int ids[MAX_BATCH];
+  int count;    // 0 = nessun batch in corso
+  int next;     // Prossima scheda da risolvere
+  int missing;
+  uint16_t batchId;
+};
+
+PendingBatch pendingBatch = {{0}, 0, 0, 0, 0};
+
+// Cerca una scheda: prima in RAM (ultime 50), poi nel CSV su SD
+bool printBatchResolve(const char* numero, Scheda& s, CsvCursor& csv, bool& csvOpen) {
+  {
+    SchedeRef schede;
+    for (int i = 0; i < schede.count(); i++) {
+      if (strcmp(schede[i].numero, numero) == 0) {
+        s = schede[i];
+        return true;
+      }
+    }
   }
-  return d;
+  if (!csvOpen) csvOpen = csv.open();
+  return csvOpen && csv.find(numero, s);
 }
 
-// ===== STAMPA SINGOLA ETICHETTA =====
-void printEtichetta(Scheda& s, int attrezzoIdx, int totAttrezzi) {
-  // Reset completo stampante e svuota buffer
-  printerSerial.flush();
-  while (printerSerial.available()) printerSerial.read();  // Svuota buffer RX
+// Accoda quante più schede del batch ci stanno in coda, senza attendere.
+// Ritorna true se il batch non è ancora finito
+bool printBatchStep() {
+  PendingBatch& b = pendingBatch;
+  if (b.count == 0) return false;
 
-  printerSerial.write(0x1B); printerSerial.write('@');  // ESC @ = reset
-  delay(100);  // Attesa più lunga per reset completo
+  CsvCursor csv;
+  bool csvOpen = false;
+  static Scheda s;  // Scheda corrente (fuori dallo stack del task)
 
-  // Assicura stato pulito: disattiva tutto esplicitamente
-  printerSerial.write(0x1D); printerSerial.write('B'); printerSerial.write(0);  // reverse OFF
-  printerSerial.write(0x1B); printerSerial.write('E'); printerSerial.write(0);  // bold OFF
-  printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);  // font normale
-  printerSerial.flush();
-  delay(50);
+  while (b.next < b.count && uxQueueSpacesAvailable(printQueue) > 0) {
+    char numero[12];
+    unpackNumero(b.ids[b.next], numero, sizeof(numero));
 
-  // === NUMERO SCHEDA (bold, reverse, riga nera) ===
-  // Usa sempre 31 caratteri per evitare wrap da byte spurio occasionale
-  const int rowWidth = 31;
+    char msg[40];
+    snprintf(msg, sizeof(msg), "Batch %d/%d: %s", b.next + 1, b.count, numero);
+    showMessage(msg, TFT_YELLOW);
 
-  String numStr = String(s.numero);
-  if (totAttrezzi > 1) {
-    numStr += " (" + String(attrezzoIdx + 1) + "/" + String(totAttrezzi) + ")";
+    if (!printBatchResolve(numero, s, csv, csvOpen)) {
+      debugPrint("[BATCH] Non trovata: ");
+      debugPrintln(numero);
+      b.missing++;
+      b.next++;
+      continue;
+    }
+    // Un altro produttore può aver preso il posto: si riprova al passo dopo
+    if (!enqueuePrint(s, PAUSE_REMOTE_SEC, 0, b.batchId)) break;
+    b.next++;
   }
+  if (csvOpen) csv.close();
 
-  // Centra il testo nella riga di 31 caratteri
-  int padding = (rowWidth - numStr.length()) / 2;
-  if (padding < 0) padding = 0;
+  if (b.next < b.count || !enqueueBatchEnd(b.batchId, b.count, b.missing, 0)) return true;
+  b.count = 0;
+  return false;
+}
 
-  char rigaNera[32];
-  memset(rigaNera, ' ', rowWidth);
-  rigaNera[rowWidth] = '\0';
-  // Copia il numero al centro
-  for (int i = 0; i < (int)numStr.length() && (padding + i) < rowWidth; i++) {
-    rigaNera[padding + i] = numStr[i];
+// Avvia un batch: le schede si risolvono e si accodano una dopo l'altra,
+// mentre una stampa si cerca la successiva. Chiamata dal task di polling.
+void printBatch(const char* spec) {
+  PendingBatch& b = pendingBatch;
+  if (b.count > 0) {
+    debugPrintln("[BATCH] Batch precedente ancora in corso");
+    showMessage("Batch in corso, riprova", TFT_ORANGE);
+    return;
   }
 
-  // Attiva bold, flush, delay, poi reverse
-  printerSerial.write(0x1B); printerSerial.write('E'); printerSerial.write(1);  // bold ON
-  printerSerial.flush();
-  delay(30);
-
-  printerSerial.write(0x1D); printerSerial.write('B'); printerSerial.write(1);  // reverse ON
-  printerSerial.flush();
-  delay(30);
-
-  // Stampa carattere per carattere
-  for (int i = 0; i < rowWidth; i++) {
-    printerSerial.write(rigaNera[i]);
+  int count = parseBatchSpec(spec, b.ids, MAX_BATCH);
+  if (count <= 0) {
+    debugPrint("[BATCH] Sintassi non valida: ");
+    debugPrintln(spec);
+    showMessage("PRINT: sintassi errata", TFT_RED);
+    return;
   }
-  printerSerial.flush();
-  delay(20);
 
-  // Disattiva reverse, poi bold, poi newline
-  printerSerial.write(0x1D); printerSerial.write('B'); printerSerial.write(0);  // reverse OFF
-  printerSerial.flush();
-  delay(20);
+  b.batchId = nextBatchId++;
+  if (nextBatchId == 0) nextBatchId = 1;
+  b.count = count;
+  b.next = 0;
+  b.missing = 0;
 
-  printerSerial.write(0x1B); printerSerial.write('E'); printerSerial.write(0);  // bold OFF
-  printerSerial.flush();
-  delay(20);
+  debugPrint("[BATCH] ");
+  debugPrint(count);
+  debugPrintln(" schede richieste");
+  printBatchStep();
+}
 
-  // Newline in stato completamente pulito
-  printerSerial.println();
+// ===== PULSANTI (interrupt + coda eventi) =====
+// Gli ISR registrano solo il fronte con il timestamp. Un task dedicato fa il
+// debounce (rilegge il livello dopo DEBOUNCE_MS dall'ultimo fronte), genera
+// long press e ripetizioni e consegna eventi al loop, che resta fermo in
+// attesa invece di campionare i pin ogni 30ms.
+// GPIO36/39 (BTN_UP) hanno un'errata ESP32: fronti spuri quando si accende
+// il WiFi o l'ADC. Impulsi brevi che non lasciano il livello cambiato
+// vengono scartati dalla rilettura come un normale rimbalzo.
+#undef LOG_SUB
+#define LOG_SUB LOG_SUB_UI
+#define NUM_BUTTONS 3
+enum ButtonId : uint8_t { BUTTON_UP, BUTTON_CENTER, BUTTON_DOWN };
+enum ButtonEventType : uint8_t {
+  BTN_PRESS,    // Premuto (dopo debounce)
+  BTN_RELEASE,  // Rilasciato; wasLong = c'è stato un long press
+  BTN_LONG,     // Tenuto per longMs
+  BTN_REPEAT    // Ancora tenuto: ogni repeatMs dopo il long press
+};
 
-  // Spazio ~2.1mm (ESC J 16) - per etichette 50x30mm passo 34mm
-  printerSerial.write(0x1B); printerSerial.write('J'); printerSerial.write(16);
+struct ButtonEvent {
+  uint8_t button;
+  uint8_t type;
+  bool wasLong;
+  uint8_t heldMask;  // Pulsanti ancora premuti dopo questo evento
+  uint32_t edgeUs;   // Primo fronte che ha originato l'evento
+};
 
-  // === Cliente (normale, max 32 char) + eventuale " - DDT" ===
-  String clienteStr = String(s.cliente);
-  if (s.ddt) {
-    // Se DDT presente, aggiungi " - DDT" (6 caratteri)
-    // Max 32 char totali: cliente max 32-6=26, poi " - DDT"
-    if (clienteStr.length() > 26) {
-      clienteStr = clienteStr.substring(0, 25) + ".";
-    }
-    clienteStr += " - DDT";
-  } else {
-    // Senza DDT: max 32 char
-    if (clienteStr.length() > 32) {
-      clienteStr = clienteStr.substring(0, 31) + ".";
-    }
-  }
-  printerSerial.println(clienteStr);
+struct ButtonEdge {
+  uint8_t button;
+  uint32_t us;
+};
 
-  // === Data - Telefono - Indirizzo (condensato) ===
-  printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);  // font condensato
+struct ButtonState {
+  uint8_t pin;
+  uint16_t longMs;    // 0 = nessun long press
+  uint16_t repeatMs;  // 0 = nessuna ripetizione
+  bool down;
+  bool pending;       // Fronte ricevuto, in attesa di stabilizzarsi
+  bool longSent;
+  uint32_t firstEdgeUs;
+  unsigned long settleMs;
+  unsigned long pressMs;
+  unsigned long nextRepeatMs;
+};
 
-  bool hasTel = strlen(s.telefono) > 0;
-  bool hasInd = strlen(s.indirizzo) > 0;
+ButtonState buttons[NUM_BUTTONS] = {
+  {BTN_UP, LONG_PRESS_MS, LONG_PRESS_MS, false, false, false, 0, 0, 0, 0},
+  {BTN_CENTER, MANUAL_LONG_PRESS_MS, 0, false, false, false, 0, 0, 0, 0},
+  {BTN_DOWN, LONG_PRESS_MS, LONG_PRESS_MS, false, false, false, 0, 0, 0, 0},
+};
 
-  printerSerial.print(formatDate(s.data));
-  if (hasTel) {
-    printerSerial.print(" - ");
-    printerSerial.print(s.telefono);
-  }
-  if (hasInd) {
-    printerSerial.print(" - ");
-    printerSerial.print(s.indirizzo);
+QueueHandle_t buttonEdgeQueue = NULL;
+QueueHandle_t buttonEventQueue = NULL;
+TaskHandle_t buttonTaskHandle = NULL;
+
+void IRAM_ATTR buttonISR(void* arg) {
+  ButtonEdge e = {(uint8_t)(uintptr_t)arg, (uint32_t)micros()};
+  BaseType_t woken = pdFALSE;
+  if (xQueueSendFromISR(buttonEdgeQueue, &e, &woken) != pdTRUE) {
+    portENTER_CRITICAL_ISR(&inputStatsMux);
+    inputStats.dropped++;
+    portEXIT_CRITICAL_ISR(&inputStatsMux);
   }
-  printerSerial.println();
+  if (woken) portYIELD_FROM_ISR();
+}
 
-  printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);  // font normale
+uint8_t buttonsHeldMask() {
+  uint8_t mask = 0;
+  for (int i = 0; i < NUM_BUTTONS; i++) {
+    if (buttons[i].down) mask |= (1 << i);
+  }
+  return mask;
+}
 
-  // Spazio ~2mm (ESC J 15) - per etichette 50x30mm passo 34mm
-  printerSerial.write(0x1B); printerSerial.write('J'); printerSerial.write(15);
+void emitButtonEvent(int b, uint8_t type, bool wasLong, uint32_t edgeUs) {
+  ButtonEvent ev = {(uint8_t)b, type, wasLong, buttonsHeldMask(), edgeUs};
+  if (xQueueSend(buttonEventQueue, &ev, 0) != pdTRUE) {
+    portENTER_CRITICAL(&inputStatsMux);
+    inputStats.dropped++;
+    portEXIT_CRITICAL(&inputStatsMux);
+  }
+}
 
-  // === Attrezzo - Dotazione (max 32 caratteri) ===
-  if (attrezzoIdx < s.numAttrezzi) {
-    Attrezzo& a = s.attrezzi[attrezzoIdx];
+void buttonTask(void* parameter) {
+  debugPrintln("[TASK] Button task avviato");
 
-    if (strlen(a.marca) > 0) {
-      String attrezzoLine = String(a.marca);
-      bool hasDotazione = strlen(a.dotazione) > 0;
+  for (;;) {
+    // Dorme fino al prossimo fronte o alla prossima scadenza (debounce, long, repeat)
+    unsigned long now = millis();
+    long wait = -1;  // -1 = nessuna scadenza
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+      ButtonState& bt = buttons[i];
+      unsigned long due;
+      if (bt.pending) {
+        due = bt.settleMs;
+      } else if (bt.down && bt.longMs && !bt.longSent) {
+        due = bt.pressMs + bt.longMs;
+      } else if (bt.down && bt.longSent && bt.repeatMs) {
+        due = bt.nextRepeatMs;
+      } else {
+        continue;
+      }
+      long d = max(0L, (long)(due - now));
+      if (wait < 0 || d < wait) wait = d;
+    }
 
-      if (hasDotazione) {
-        // "marca - dotazione" deve stare in 32 char
-        // Se troppo lungo, tronca la marca e aggiungi "."
-        String separator = " - ";
-        String dotazione = String(a.dotazione);
-        int totalLen = attrezzoLine.length() + separator.length() + dotazione.length();
-
-        if (totalLen > 32) {
-          // Calcola spazio disponibile per la marca
-          // marca + " - " + dotazione <= 32
-          // marca <= 32 - 3 - dotazione.length() - 1 (per il punto)
-          int maxMarcaLen = 32 - separator.length() - dotazione.length() - 1;
-          if (maxMarcaLen < 1) maxMarcaLen = 1;
-          attrezzoLine = attrezzoLine.substring(0, maxMarcaLen) + ".";
-        }
-        attrezzoLine += separator + dotazione;
+    ButtonEdge e;
+    TickType_t ticks = wait < 0 ? portMAX_DELAY : pdMS_TO_TICKS(wait);
+    if (xQueueReceive(buttonEdgeQueue, &e, ticks) == pdTRUE && e.button < NUM_BUTTONS) {
+      ButtonState& bt = buttons[e.button];
+      if (!bt.pending) {
+        bt.pending = true;
+        bt.firstEdgeUs = e.us;
       } else {
-        // Solo marca, tronca a 32 se necessario
-        if (attrezzoLine.length() > 32) {
-          attrezzoLine = attrezzoLine.substring(0, 31) + ".";
+        inputStats.bounces++;
+      }
+      bt.settleMs = millis() + DEBOUNCE_MS;  // Ogni fronte riavvia l'attesa
+    }
+
+    now = millis();
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+      ButtonState& bt = buttons[i];
+
+      // Debounce: il livello dopo la quiete decide
+      if (bt.pending && (long)(now - bt.settleMs) >= 0) {
+        bt.pending = false;
+        bool level = digitalRead(bt.pin) == LOW;
+        if (level == bt.down) {
+          inputStats.bounces++;  // Impulso tornato al livello di partenza
+        } else if (level) {
+          bt.down = true;
+          bt.longSent = false;
+          bt.pressMs = now;
+          emitButtonEvent(i, BTN_PRESS, false, bt.firstEdgeUs);
+        } else {
+          bt.down = false;
+          emitButtonEvent(i, BTN_RELEASE, bt.longSent, bt.firstEdgeUs);
         }
       }
 
-      printerSerial.println(attrezzoLine);
+      // Long press e ripetizioni (timestamp = scadenza, non un fronte)
+      if (bt.down && !bt.pending && bt.longMs && !bt.longSent && now - bt.pressMs >= bt.longMs) {
+        bt.longSent = true;
+        bt.nextRepeatMs = now + bt.repeatMs;
+        emitButtonEvent(i, BTN_LONG, false, micros());
+      } else if (bt.down && !bt.pending && bt.longSent && bt.repeatMs &&
+                 (long)(now - bt.nextRepeatMs) >= 0) {
+        bt.nextRepeatMs += bt.repeatMs;
+        emitButtonEvent(i, BTN_REPEAT, false, micros());
+      }
     }
+  }
+}
 
-    // Note (condensato)
-    if (strlen(a.note) > 0) {
-      printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1);  // font condensato
-      printerSerial.println(a.note);
-      printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);  // font normale
-    }
+// Interrupt sui tre pulsanti (dopo il menu di avvio, che legge i pin a polling)
+void buttonsInit() {
+  buttonEdgeQueue = xQueueCreate(32, sizeof(ButtonEdge));
+  buttonEventQueue = xQueueCreate(16, sizeof(ButtonEvent));
+
+  for (int i = 0; i < NUM_BUTTONS; i++) {
+    buttons[i].down = digitalRead(buttons[i].pin) == LOW;
   }
 
-  // Feed carta per staccare etichetta (solo line feed, no spazio extra)
-  printerSerial.write(0x0A);
-  printerSerial.write(0x0A);
-  printerSerial.write(0x0A);
+  xTaskCreatePinnedToCore(
+    buttonTask,         // Funzione
+    "ButtonTask",       // Nome
+    3072,               // Stack size
+    NULL,               // Parametri
+    3,                  // Priorità (sopra display e stampa)
+    &buttonTaskHandle,  // Handle
+    1                   // Core 1
+  );
+
+  for (int i = 0; i < NUM_BUTTONS; i++) {
+    attachInterruptArg(buttons[i].pin, buttonISR, (void*)(uintptr_t)i, CHANGE);
+  }
 }
 
-// ===== STAMPA SCHEDA (multi-etichetta) =====
-void printScheda(int index) {
-  if (index < 0 || index >= numSchede) return;
+// ===== RISPARMIO ENERGETICO =====
+// A schermo spento il WiFi passa a modem sleep massimo (la radio si sveglia
+// solo ai beacon DTIM), la CPU scende a 80MHz quando non c'è lavoro (DFS,
+// con CONFIG_PM_ENABLE) e il loop attende 1s fra un giro e l'altro.
+// Niente light sleep: richiede tickless idle (CONFIG_FREERTOS_USE_TICKLESS_IDLE),
+// che il sdkconfig precompilato del core Arduino non ha. I pulsanti restano
+// a fronte come a schermo acceso, quindi la latenza non cambia.
+#undef LOG_SUB
+#define LOG_SUB LOG_SUB_SYS
+
+// Correnti tipiche (datasheet ESP32 + retroilluminazione), per la stima in STATUS
+#define POWER_ACTIVE_MA 110  // Schermo acceso, WiFi modem sleep minimo
+#define POWER_AWAKE_MA 45    // Schermo spento, CPU sveglia a 240MHz
+#define POWER_DFS_MA 30      // Schermo spento, CPU in attesa a 80MHz
+
+// DFS acceso/spento (frequenza minima 80MHz: APB fisso per UART stampante
+// e SPI, quindi una stampa non ha bisogno di lock)
+void powerConfigure(bool dfs) {
+#if CONFIG_PM_ENABLE
+  esp_pm_config_esp32_t pm = {};
+  pm.max_freq_mhz = 240;
+  pm.min_freq_mhz = dfs ? 80 : 240;
+  esp_err_t err = esp_pm_configure(&pm);
+  if (err != ESP_OK) {
+    errorPrint("[POWER] esp_pm_configure fallito: ");
+    errorPrintln((int)err);
+    powerDfs = false;
+  }
+#else
+  (void)dfs;
+#endif
+}
 
-  Scheda& s = schede[index];
-  int numEtichette = max(1, s.numAttrezzi);
+void powerInit() {
+#if CONFIG_PM_ENABLE
+  powerDfs = true;
+#endif
+  powerConfigure(false);
+  powerStats.lastChangeUs = esp_timer_get_time();
 
-  debugPrint("[PRINT] Stampa scheda ");
-  debugPrint(s.numero);
-  debugPrint(" - ");
-  debugPrint(numEtichette);
-  debugPrintln(" etichette");
+  // Modem sleep minimo: la radio dorme tra i beacon DTIM anche a schermo acceso
+  WiFi.setSleep(true);
 
-  for (int i = 0; i < numEtichette; i++) {
-    char msg[32];
-    if (numEtichette > 1) {
-      sprintf(msg, "Stampa %d/%d...", i + 1, numEtichette);
-    } else {
-      strcpy(msg, "Stampa...");
-    }
-    showMessage(msg, TFT_YELLOW);
+  debugPrint("[POWER] Schermo spento: ");
+  debugPrintln(powerModeName());
+}
 
-    printEtichetta(s, i, numEtichette);
+// Chiude l'intervallo in corso (attivo o idle) nei contatori
+void powerAccount() {
+  uint64_t now = esp_timer_get_time();
+  uint64_t elapsed = now - powerStats.lastChangeUs;
+  if (powerIdle) powerStats.idleUs += elapsed;
+  else powerStats.activeUs += elapsed;
+  powerStats.lastChangeUs = now;
+}
 
-    // Pausa tra etichette multiple
-    if (i < numEtichette - 1) {
-      for (int sec = 8; sec > 0; sec--) {
-        char countdown[32];
-        sprintf(countdown, "Prossima in %ds...", sec);
-        showMessage(countdown, TFT_CYAN);
-        delay(1000);
-      }
-    }
-  }
+// Schermo spento: modem sleep lungo, CPU a 80MHz in attesa
+void powerEnterIdle() {
+  if (powerIdle) return;
+  powerAccount();
+  powerStats.idleEntries++;
+  powerIdle = true;
+
+  if (wifiOK) esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+  powerConfigure(true);
+  debugPrintln("[POWER] Idle");
+}
 
-  debugPrintln("[PRINT] Completato");
-  showMessage("Stampa OK!", TFT_GREEN);
+// Schermo riacceso: CPU a piena frequenza, modem sleep minimo
+void powerExitIdle() {
+  if (!powerIdle) return;
+  powerAccount();
+  powerConfigure(false);
+  if (wifiOK) esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+  powerIdle = false;
+  debugPrintln("[POWER] Attivo");
+}
+
+// Risparmio effettivo a schermo spento, per log e STATUS
+const char* powerModeName() {
+  return powerDfs ? "modem sleep + DFS" : "modem sleep";
+}
+
+// Corrente media stimata dai tempi attivo / al lavoro / in attesa
+uint32_t powerEstimateMa() {
+  powerAccount();
+  uint64_t awake = min(powerStats.idleAwakeUs, powerStats.idleUs);
+  uint64_t asleep = powerStats.idleUs - awake;
+  uint64_t total = powerStats.activeUs + powerStats.idleUs;
+  if (total == 0) return 0;
+  // Tra un poll e l'altro la CPU resta sveglia: a 80MHz con DFS
+  uint32_t sleepMa = powerDfs ? POWER_DFS_MA : POWER_AWAKE_MA;
+  return (uint32_t)((powerStats.activeUs * POWER_ACTIVE_MA + awake * POWER_AWAKE_MA +
+                     asleep * sleepMa) / total);
 }
 
 // ===== SETUP =====
 void setup() {
   Serial.begin(115200);
+  Serial.onReceive(consoleReceive);  // Console: METRICS
+  logInit();  // Da qui i log passano dal ring
   delay(1000);
 
   debugPrintln("\n\n=================================");
@@ -2606,6 +7213,7 @@ void setup() {
   digitalWrite(TFT_BL, HIGH);
   tft.init();
   tft.setRotation(1);  // Landscape con pulsanti a destra (ruotato 180° rispetto a rot 3)
+  uiInit();            // Sprite in PSRAM + DMA (fallback: disegno diretto)
   tft.fillScreen(TFT_BLACK);
 
   // Messaggio avvio con versione (landscape 320x240)
@@ -2671,24 +7279,49 @@ void setup() {
   // Imposta densità stampa più alta per carta adesiva più spessa
   // ESC 7 n1 n2 n3: n1=max heating dots (default 7), n2=heating time (default 80), n3=heating interval (default 2)
   // Valori più alti = stampa più scura
-  printerSerial.write(0x1B);  // ESC
-  printerSerial.write(0x37);  // '7'
-  printerSerial.write(11);    // n1: heating dots (max 11, default 7)
-  printerSerial.write(120);   // n2: heating time (max 255, default 80) - più alto = più scuro
-  printerSerial.write(40);    // n3: heating interval (default 2) - più alto = più lento ma migliore qualità
+  escpos::emit(printerSerial, escpos::heating(11, 120, 40));
   printerSerial.flush();
   debugPrintln("[INIT] Stampante densita' aumentata");
 
+  // Buffer della lista schede (prima di qualsiasi parseCSV)
+  schedeInit();
+
+  // Flash interna (copia di config e storico)
+  flashInit();
+
   // SD
   debugPrintln("[INIT] SD card...");
   sdSPI.begin(SD_SCK, SD_MISO, SD_MOSI, SD_CS);
   if (SD.begin(SD_CS, sdSPI)) {
     sdOK = true;
     debugPrintln("[OK] SD card");
+    // Da qui ogni accesso alla SD passa dal task storage
+    storageInit();
   } else {
-    debugPrintln("[FAIL] SD card");
+    errorPrintln("[FAIL] SD card");
   }
 
+  // Stato di sincronizzazione del boot precedente (NVS)
+  syncStateLoad();
+
+  // Cache etichette pre-renderizzate (PSRAM + SD)
+  labelCacheInit();
+
+  // Spool di stampa persistente (riparazione dopo spegnimento)
+  spoolInit();
+
+  // Task di stampa su core 1 (unico proprietario della stampante)
+  printQueue = xQueueCreate(PRINT_QUEUE_LEN, sizeof(PrintJob));
+  xTaskCreatePinnedToCore(
+    printTask,          // Funzione
+    "PrintTask",        // Nome
+    6144,               // Stack size
+    NULL,               // Parametri
+    1,                  // Priorità
+    &printTaskHandle,   // Handle
+    1                   // Core 1
+  );
+
   // Carica reti WiFi salvate
   loadWifiConfig();
 
@@ -2705,11 +7338,12 @@ void setup() {
     debugPrintMode = true;
     debugPrintln("[INIT] SER selezionato - DEBUG PRINT MODE ATTIVO");
     // Stampa intestazione debug su carta
-    printerSerial.write(0x1B); printerSerial.write('@'); // Reset stampante
+    escpos::emit(printerSerial, escpos::reset());
     delay(50);
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(1); // Font condensato
-    printerSerial.println("=== DEBUG MODE v" FIRMWARE_VERSION " ===");
-    printerSerial.write(0x1B); printerSerial.write('M'); printerSerial.write(0);
+    constexpr auto kDebugHeader = escpos::condensed(true) +
+                                  escpos::text("=== DEBUG MODE v" FIRMWARE_VERSION " ===") +
+                                  escpos::crlf() + escpos::condensed(false);
+    escpos::emit(printerSerial, kDebugHeader);
   }
 
   if (bootMenuSelection == 0) {
@@ -2765,7 +7399,7 @@ void setup() {
       debugPrintln("[NTP] Fallito, uso polling conservativo");
     }
   } else {
-    debugPrintln("[FAIL] Nessuna rete disponibile");
+    errorPrintln("[FAIL] Nessuna rete disponibile");
   }
 
   // Download CSV
@@ -2778,6 +7412,7 @@ void setup() {
     http.begin(CSV_URL);
     http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
     int httpCode = http.GET();
+    metricsHttp(httpCode);
 
     if (httpCode == HTTP_CODE_OK) {
       csvData = http.getString();
@@ -2786,56 +7421,55 @@ void setup() {
       debugPrintln(" bytes");
 
       // Salva su SD
-      if (sdOK) {
-        File f = SD.open("/riparazioni.csv", FILE_WRITE);
-        if (f) {
-          f.print(csvData);
-          f.close();
-        }
-      }
+      if (sdOK) csvSave(csvData);
+      syncSaveGeneration();
 
       // Parse
       parseCSV(csvData);
 
     } else {
-      debugPrint("[FAIL] HTTP: ");
-      debugPrintln(httpCode);
+      errorPrint("[FAIL] HTTP: ");
+      errorPrintln(httpCode);
 
       // Prova da SD
-      if (sdOK) {
-        File f = SD.open("/riparazioni.csv", FILE_READ);
-        if (f) {
-          csvData = f.readString();
-          f.close();
-          parseCSV(csvData);
-          debugPrintln("[OK] CSV da SD");
-        }
+      if (sdOK && loadCsvFromSd(csvData)) {
+        parseCSV(csvData);
+        debugPrintln("[OK] CSV da SD");
       }
     }
     http.end();
-  } else if (sdOK) {
+  } else if (sdOK && loadCsvFromSd(csvData)) {
     // Offline: carica da SD
-    File f = SD.open("/riparazioni.csv", FILE_READ);
-    if (f) {
-      csvData = f.readString();
-      f.close();
-      parseCSV(csvData);
-      debugPrintln("[OK] CSV da SD (offline)");
-    }
+    parseCSV(csvData);
+    debugPrintln("[OK] CSV da SD (offline)");
   }
 
   // Carica print history
   loadPrintHistory();
+  flashBenchRun(HISTORY_LOG);
 
-  // Segna tutte le schede correnti come già stampate
-  // (all'avvio non vogliamo ristampare tutto)
-  markAllAsPrinted();
+  // Indice di tutte le schede per la ricerca per cliente (costruito in background)
+  jobDirInit();
 
-  // Leggi timestamp iniziale per polling (se WiFi OK)
-  if (wifiOK) {
-    lastKnownTimestamp = fetchLastUpdate();
-    debugPrint("[POLL] Timestamp iniziale: ");
-    debugPrintln(lastKnownTimestamp);
+  // Etichette rimaste a metà prima dello spegnimento: vanno stampate
+  // prima che markAllAsPrinted le consideri fatte
+  spoolResume();
+
+  if (syncStateValid) {
+    // Riavvio: riprende dallo stato salvato, stampa ciò che è arrivato nel frattempo
+    syncCatchUp();
+  } else {
+    // Primo avvio: segna tutte le schede correnti come già stampate
+    // (non vogliamo ristampare tutto)
+    markAllAsPrinted();
+
+    // Leggi timestamp iniziale per polling (se WiFi OK)
+    if (wifiOK) {
+      lastKnownTimestamp = fetchLastUpdate();
+      syncSaveTimestamp(lastKnownTimestamp);
+      debugPrint("[POLL] Timestamp iniziale: ");
+      debugPrintln(lastKnownTimestamp);
+    }
   }
 
   // Avvia SEMPRE task di polling su core 0 (gestisce anche retry WiFi)
@@ -2849,11 +7483,23 @@ void setup() {
     0                   // Core 0
   );
 
+  // Pulsanti a interrupt: da qui il loop attende eventi invece di campionare
+  buttonsInit();
+  powerInit();
+
+  // Da qui disegna solo il task display (core 1, sopra loop e stampa)
+  xTaskCreatePinnedToCore(
+    uiTask,             // Funzione
+    "UiTask",           // Nome
+    6144,               // Stack size
+    NULL,               // Parametri
+    2,                  // Priorità
+    &uiTaskHandle,      // Handle
+    1                   // Core 1
+  );
+
   // Disegna UI
-  tft.fillScreen(TFT_BLACK);
-  drawHeader();
-  drawList();
-  drawButtons();
+  drawScreen();
 
   // Inizializza timer screen sleep
   lastButtonActivity = millis();
@@ -2862,50 +7508,200 @@ void setup() {
 }
 
 // ===== LOOP =====
-void loop() {
-  static bool lastUp = HIGH;
-  static bool lastCenter = HIGH;
-  static bool lastDown = HIGH;
-  static unsigned long btnCenterPressed = 0;
-  static bool centerLongPressHandled = false;
+// Eventi ignorati finché i pulsanti non sono tutti rilasciati: il resto di
+// un gesto già usato (risveglio dello schermo, cambio di modalità)
+bool swallowUntilRelease = false;
+
+// Pulsanti in ricerca per cliente
+void handleSearchButton(const ButtonEvent& ev) {
+  if (ev.button == BUTTON_CENTER) {
+    if (ev.type == BTN_LONG) {
+      showSearchResults();
+    } else if (ev.type == BTN_RELEASE && !ev.wasLong) {
+      acceptSearchLetter();
+    }
+    return;
+  }
+
+  int step = 0;
+  if (ev.type == BTN_PRESS) step = 1;                               // Lettera successiva/precedente
+  if (ev.type == BTN_LONG || ev.type == BTN_REPEAT) step = 5;       // Tenuto: salta di 5
+  if (step == 0) return;
+  if (ev.button == BUTTON_DOWN) step = -step;
+  searchLetter = (searchLetter + step + SEARCH_LETTERS) % SEARCH_LETTERS;
+  drawManualInput();
+}
+
+// Stampa una scheda dei risultati: cache, lista in RAM, archivio o riga dal CSV
+bool printSearchResult(int idx) {
+  JobDirEntry e;
+  xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+  searchFilterRefresh();
+  bool ok = idx >= 0 && idx < searchCount;
+  if (ok) e = jobDir.entries[jobDir.byName[searchLo + idx]];
+  xSemaphoreGive(jobDirMutex);
+  if (!ok) return false;
+
+  char numero[12];
+  unpackNumero(e.id, numero, sizeof(numero));
+  if (printFromCache(numero)) return true;
+  {
+    SchedeRef schede;
+    for (int i = 0; i < schede.count(); i++) {
+      if (strcmp(schede[i].numero, numero) == 0) return printScheda(schede[i]);
+    }
+  }
+
+  static Scheda s;  // Solo il loop stampa dai risultati
+  if (!archiveFind(e.id, s) && !jobDirLoad(e, s)) {
+    showMessage("Scheda non trovata!", TFT_RED);
+    return false;
+  }
+  if (!enqueuePrint(s, PAUSE_NORMAL_SEC, 0, 0)) {
+    showMessage("Coda stampa piena!", TFT_ORANGE);
+    return false;
+  }
+  return true;
+}
+
+// Pulsanti in modalità inserimento manuale
+void handleManualButton(const ButtonEvent& ev, unsigned long now) {
+  lastManualActivity = now;  // Reset timer
+
+  if (manualSearch) {
+    handleSearchButton(ev);
+    return;
+  }
 
-  bool currUp = digitalRead(BTN_UP);
-  bool currCenter = digitalRead(BTN_CENTER);
-  bool currDown = digitalRead(BTN_DOWN);
+  if (ev.button == BUTTON_CENTER) {
+    if (ev.type == BTN_LONG) {
+      // Long press: esci dalla modalità
+      exitManualInputMode();
+    } else if (ev.type == BTN_RELEASE && !ev.wasLong) {
+      // Short press: avanza cursore
+      advanceManualCursor();
+    }
+  } else if (ev.type == BTN_PRESS) {
+    // SU incrementa cifra, GIU decrementa
+    changeManualDigit(ev.button == BUTTON_UP ? 1 : -1);
+  } else if (ev.button == BUTTON_DOWN && ev.type == BTN_LONG) {
+    // GIU tenuto: ricerca per nome cliente. Le ripetizioni dello stesso
+    // GIU non devono scorrere subito le lettere
+    enterSearchMode();
+    swallowUntilRelease = true;
+  }
+}
 
+// Pulsanti in modalità lista normale
+void handleListButton(const ButtonEvent& ev) {
   bool needRedraw = false;
+
+  if (ev.button == BUTTON_CENTER) {
+    if (ev.type == BTN_LONG) {
+      // Long press: entra in modalità inserimento manuale (o lascia i risultati)
+      if (searchFilter) clearSearchFilter();
+      else enterManualInputMode();
+    } else if (ev.type == BTN_RELEASE && !ev.wasLong) {
+      // === STAMPA (short press) ===
+      markPrintTrigger();
+      if (searchFilter) {
+        printSearchResult(selectedIndex);
+        return;
+      }
+      // Accoda e torna subito ai pulsanti: la stampa prosegue sul suo task
+      SchedeRef schede;
+      if (selectedIndex < 0 || selectedIndex >= schede.count()) return;
+      if (printScheda(schede[selectedIndex])) {
+        // Aggiungi a history se non già presente
+        if (!isAlreadyPrinted(schede[selectedIndex].numero)) {
+          addToHistory(schede[selectedIndex].numero);
+          savePrintHistory();
+        }
+      }
+    }
+    return;
+  }
+
+  int step = 0;
+  if (ev.type == BTN_PRESS) step = 1;                               // Appena premuto: muovi di 1
+  if (ev.type == BTN_LONG || ev.type == BTN_REPEAT) step = 10;      // Long press: muovi di 10
+  if (step == 0) return;
+
+  if (ev.button == BUTTON_UP) {
+    int newIdx = max(0, selectedIndex - step);
+    if (newIdx != selectedIndex) {
+      selectedIndex = newIdx;
+      if (step > 1) {
+        scrollOffset = max(0, selectedIndex - VISIBLE_ROWS / 2);
+      } else if (selectedIndex < scrollOffset) {
+        scrollOffset = selectedIndex;
+      }
+      needRedraw = true;
+    }
+  } else {
+    int newIdx = min(listRowCount() - 1, selectedIndex + step);
+    if (newIdx > selectedIndex) {
+      selectedIndex = newIdx;
+      if (selectedIndex >= scrollOffset + VISIBLE_ROWS) {
+        scrollOffset = selectedIndex - VISIBLE_ROWS + 1;
+      }
+      needRedraw = true;
+    }
+  }
+
+  if (needRedraw) {
+    drawList();
+  }
+}
+
+void loop() {
+  // Attende un evento pulsante, il prossimo tick dei timer o i controlli periodici
+  ButtonEvent ev;
+  bool gotEvent = xQueueReceive(buttonEventQueue, &ev, pdMS_TO_TICKS(timerWheelIdleMs())) == pdTRUE;
+  uint32_t iterStartUs = micros();
   unsigned long now = millis();
 
   // === Gestione screen sleep ===
-  bool anyButtonPressed = (currUp == LOW || currCenter == LOW || currDown == LOW);
-
-  if (anyButtonPressed) {
-    lastButtonActivity = now;
+  if (gotEvent) {
+    lastButtonActivity = now;  // Il timer di sleep ricalcola da qui
+
+    // Latenza fronte -> gestione (solo pressioni/rilasci reali)
+    if (ev.type == BTN_PRESS || ev.type == BTN_RELEASE) {
+      uint32_t lat = micros() - ev.edgeUs;
+      inputStats.events++;
+      inputStats.lastLatUs = lat;
+      if (lat > inputStats.maxLatUs) inputStats.maxLatUs = lat;
+    }
 
     // Risveglia schermo se spento
-    if (!screenOn) {
+    if (!screenOn && ev.type == BTN_PRESS) {
       printFromSleep = true;  // Prima stampa dopo sleep userà 31 caratteri
       screenOn = true;
       digitalWrite(TFT_BL, HIGH);
       debugPrintln("[SCREEN] Riattivato");
-      // Aspetta che tutti i pulsanti vengano rilasciati prima di continuare
-      while (digitalRead(BTN_UP) == LOW || digitalRead(BTN_CENTER) == LOW || digitalRead(BTN_DOWN) == LOW) {
-        delay(10);
-      }
-      // Reset stati pulsanti per evitare azioni indesiderate
-      lastUp = HIGH;
-      lastCenter = HIGH;
-      lastDown = HIGH;
-      delay(100);  // Delay più lungo per stabilizzazione
-      return;
+      // Ignora tutto finché i pulsanti non vengono rilasciati
+      swallowUntilRelease = true;
+    }
+    if (swallowUntilRelease) {
+      if (ev.heldMask == 0) swallowUntilRelease = false;
+      gotEvent = false;
     }
   }
 
-  // Spegni schermo dopo timeout
-  if (screenOn && (now - lastButtonActivity >= SCREEN_TIMEOUT)) {
-    screenOn = false;
-    digitalWrite(TFT_BL, LOW);
-    debugPrintln("[SCREEN] Sleep");
+  // Schermo riacceso (pulsante, nuove schede, comando remoto): fine risparmio
+  if (screenOn && powerIdle) powerExitIdle();
+
+  // Timer scaduti (sleep schermo, messaggi a tempo, modalità manuale)
+  timerWheelRun();
+
+  // Schermo acceso (da pulsante o da un altro task): arma lo sleep
+  if (screenOn && !screenSleepTimer.active) {
+    timerStart(screenSleepTimer, SCREEN_TIMEOUT);
+  }
+
+  // === Lista aggiornata mentre lo schermo era spento ===
+  if (screenOn && listStale && !manualInputMode) {
+    drawList();
   }
 
   // === Mostra stato WiFi/connessione ===
@@ -2916,9 +7712,7 @@ void loop() {
     } else if (wifiError) {
       showMessage("Errore connessione", TFT_ORANGE);
     } else {
-      showMessage("Connesso", TFT_GREEN);
-      delay(1500);
-      showMessage("", TFT_BLACK);
+      showMessageFor("Connesso", TFT_GREEN, 1500);
     }
   }
 
@@ -2932,7 +7726,6 @@ void loop() {
       printFromSleep = true;  // Segnala a printEtichetta di usare 31 caratteri
       screenOn = true;
       digitalWrite(TFT_BL, HIGH);
-      delay(100);
       lastButtonActivity = now;
     }
 
@@ -2944,150 +7737,17 @@ void loop() {
   // ============================================
   // MODALITA' INSERIMENTO MANUALE
   // ============================================
+  // (timeout inattività 20s: manualTimeoutTimer)
   if (manualInputMode) {
-    // === Timeout inattività 20s ===
-    if (now - lastManualActivity >= MANUAL_TIMEOUT_MS) {
-      debugPrintln("[MANUAL] Timeout inattività");
-      exitManualInputMode();
-      lastUp = currUp;
-      lastCenter = currCenter;
-      lastDown = currDown;
-      return;
-    }
-
-    // === Long press CENTER per uscire ===
-    if (currCenter == LOW) {
-      if (lastCenter == HIGH) {
-        btnCenterPressed = now;
-        centerLongPressHandled = false;
-        lastManualActivity = now;  // Reset timer
-      } else if (!centerLongPressHandled && (now - btnCenterPressed >= MANUAL_LONG_PRESS_MS)) {
-        // Long press: esci dalla modalità
-        centerLongPressHandled = true;
-        exitManualInputMode();
-      }
-    }
-
-    // === Short press CENTER: avanza cursore ===
-    if (currCenter == HIGH && lastCenter == LOW && !centerLongPressHandled) {
-      lastManualActivity = now;  // Reset timer
-      advanceManualCursor();
-    }
-
-    // === SU (UP button): incrementa cifra ===
-    if (currUp == LOW && lastUp == HIGH) {
-      lastManualActivity = now;  // Reset timer
-      changeManualDigit(1);
-    }
-
-    // === GIU (DOWN button): decrementa cifra ===
-    if (currDown == LOW && lastDown == HIGH) {
-      lastManualActivity = now;  // Reset timer
-      changeManualDigit(-1);
-    }
-
-    lastUp = currUp;
-    lastCenter = currCenter;
-    lastDown = currDown;
-    delay(30);
-    return;
-  }
-
-  // ============================================
-  // MODALITA' LISTA NORMALE
-  // ============================================
-
-  // === Long press CENTER per entrare in modalità manuale ===
-  if (currCenter == LOW) {
-    if (lastCenter == HIGH) {
-      btnCenterPressed = now;
-      centerLongPressHandled = false;
-    } else if (!centerLongPressHandled && (now - btnCenterPressed >= MANUAL_LONG_PRESS_MS)) {
-      // Long press: entra in modalità inserimento manuale
-      centerLongPressHandled = true;
-      enterManualInputMode();
-      lastUp = currUp;
-      lastCenter = currCenter;
-      lastDown = currDown;
-      return;
-    }
-  }
-
-  // === SU (UP button) ===
-  if (currUp == LOW) {
-    if (lastUp == HIGH) {
-      // Appena premuto: muovi di 1
-      if (selectedIndex > 0) {
-        selectedIndex--;
-        if (selectedIndex < scrollOffset) {
-          scrollOffset = selectedIndex;
-        }
-        needRedraw = true;
-      }
-      btnUpPressed = now;
-      lastPageSkip = now;
-    } else if (now - btnUpPressed >= LONG_PRESS_MS && now - lastPageSkip >= LONG_PRESS_MS) {
-      // Long press: muovi di 10
-      int newIdx = selectedIndex - 10;
-      if (newIdx < 0) newIdx = 0;
-      if (newIdx != selectedIndex) {
-        selectedIndex = newIdx;
-        scrollOffset = max(0, selectedIndex - VISIBLE_ROWS / 2);
-        needRedraw = true;
-      }
-      lastPageSkip = now;
-    }
-  }
-
-  // === GIU (DOWN button) ===
-  if (currDown == LOW) {
-    if (lastDown == HIGH) {
-      // Appena premuto: muovi di 1
-      if (selectedIndex < numSchede - 1) {
-        selectedIndex++;
-        if (selectedIndex >= scrollOffset + VISIBLE_ROWS) {
-          scrollOffset = selectedIndex - VISIBLE_ROWS + 1;
-        }
-        needRedraw = true;
-      }
-      btnDownPressed = now;
-      lastPageSkip = now;
-    } else if (now - btnDownPressed >= LONG_PRESS_MS && now - lastPageSkip >= LONG_PRESS_MS) {
-      // Long press: muovi di 10
-      int newIdx = selectedIndex + 10;
-      if (newIdx >= numSchede) newIdx = numSchede - 1;
-      if (newIdx != selectedIndex) {
-        selectedIndex = newIdx;
-        if (selectedIndex >= scrollOffset + VISIBLE_ROWS) {
-          scrollOffset = selectedIndex - VISIBLE_ROWS + 1;
-        }
-        needRedraw = true;
-      }
-      lastPageSkip = now;
-    }
-  }
-
-  // === STAMPA (CENTER button short press) ===
-  if (currCenter == HIGH && lastCenter == LOW && !centerLongPressHandled) {
-    printScheda(selectedIndex);
-
-    // Aggiungi a history se non già presente
-    if (!isAlreadyPrinted(schede[selectedIndex].numero)) {
-      addToHistory(schede[selectedIndex].numero);
-      savePrintHistory();
-    }
-
-    delay(1000);
-    showMessage("", TFT_BLACK);
-  }
-
-  if (needRedraw) {
-    drawList();
+    if (gotEvent) handleManualButton(ev, now);
+  } else {
+    // ============================================
+    // MODALITA' LISTA NORMALE
+    // ============================================
+    if (gotEvent) handleListButton(ev);
   }
 
-  lastUp = currUp;
-  lastCenter = currCenter;
-  lastDown = currDown;
-
-  delay(30);
+  // Durata del giro (senza l'attesa iniziale)
+  loopLastUs = micros() - iterStartUs;
+  if (loopLastUs > loopMaxUs) loopMaxUs = loopLastUs;
 }
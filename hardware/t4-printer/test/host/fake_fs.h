@@ -0,0 +1,237 @@
+/*
+ * FAKE FS - File system in memoria con l'interfaccia di SD/LittleFS
+ *
+ * Due cose che la SD vera non dice:
+ * - calo di corrente: con budget >= 0 ogni scrittura (byte) e ogni
+ *   operazione sui file (creazione, troncamento, remove, rename) ne
+ *   consuma un'unità; a budget finito la scrittura in corso si ferma a metà
+ *   e da lì in poi nulla cambia più sul "disco";
+ * - accessi concorrenti: la libreria SD non regge due task insieme, qui ogni
+ *   operazione segna in overlaps se ne trova un'altra ancora in corso.
+ * In più conta letture, scritture, byte e seek, per i benchmark: sul PC il
+ * tempo non dice niente della SD, il numero di accessi sì; con readFail
+ * >= 0 le letture dopo le prime readFail danno errore.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "host.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+class FakeFs;
+
+class File {
+ public:
+  File() {}
+  File(FakeFs* fs, const std::string& path, bool append) : fs_(fs), path_(path), append_(append) {}
+
+  explicit operator bool() const { return fs_ != nullptr; }
+
+  size_t write(const uint8_t* data, size_t len);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+  void flush() {}
+  int read();
+  int read(uint8_t* buf, size_t len);
+  int available();
+  size_t size();
+  size_t position() const { return pos_; }
+  bool seek(size_t pos);
+  String readStringUntil(char end);
+  String readString() { return readStringUntil('\0'); }
+  void close() { fs_ = nullptr; }
+
+ private:
+  FakeFs* fs_ = nullptr;
+  std::string path_;
+  bool append_ = false;
+  size_t pos_ = 0;
+};
+
+class FakeFs {
+ public:
+  std::map<std::string, std::string> files;
+  std::set<std::string> dirs;    // Solo per exists(): i file hanno il percorso intero
+  long budget = -1;              // Unità di scrittura prima del calo di corrente (-1 = mai)
+  bool cut = false;              // Corrente mancata: il disco non cambia più
+  unsigned long spent = 0;       // Unità consumate (per sapere quanti punti provare)
+  std::atomic<int> overlaps{0};  // Operazioni sovrapposte (accesso non serializzato)
+  std::atomic<unsigned long> reads{0};      // Chiamate di lettura
+  std::atomic<unsigned long> readBytes{0};  // Byte letti
+  std::atomic<unsigned long> seeks{0};
+  std::atomic<unsigned long> writes{0};      // Chiamate di scrittura
+  std::atomic<unsigned long> writeBytes{0};  // Byte scritti
+  long readFail = -1;            // Letture riuscite prima dell'errore (-1 = mai)
+
+  // Nuovo avvio: stessi file, corrente di nuovo presente
+  void powerOn(long newBudget = -1) {
+    cut = false;
+    budget = newBudget;
+    spent = 0;
+  }
+
+  File open(const char* path, const char* mode = FILE_READ, bool create = false) {
+    Use use(this);
+    std::lock_guard<std::mutex> lock(m_);
+    if (mode[0] == 'r') {
+      if (!files.count(path)) return File();
+      return File(this, path, false);
+    }
+    if (mode[0] == 'w' || !files.count(path)) {
+      if (!spendLocked(1)) return File();
+      files[path].clear();
+    }
+    return File(this, path, mode[0] == 'a');
+  }
+
+  bool exists(const char* path) {
+    Use use(this);
+    std::lock_guard<std::mutex> lock(m_);
+    return files.count(path) > 0 || dirs.count(path) > 0;
+  }
+
+  bool remove(const char* path) {
+    Use use(this);
+    std::lock_guard<std::mutex> lock(m_);
+    if (!files.count(path) || !spendLocked(1)) return false;
+    files.erase(path);
+    return true;
+  }
+
+  bool rename(const char* from, const char* to) {
+    Use use(this);
+    std::lock_guard<std::mutex> lock(m_);
+    if (!files.count(from) || !spendLocked(1)) return false;
+    files[to] = files[from];
+    files.erase(from);
+    return true;
+  }
+
+  bool mkdir(const char* path) {
+    std::lock_guard<std::mutex> lock(m_);
+    dirs.insert(path);
+    return true;
+  }
+
+  bool rmdir(const char* path) {
+    std::lock_guard<std::mutex> lock(m_);
+    return dirs.erase(path) > 0;
+  }
+
+ private:
+  friend class File;
+  std::mutex m_;             // Protegge la mappa: il test non deve andare in crash
+  std::atomic<int> active_{0};
+
+  // Segna l'operazione in corso; una pausa allarga la finestra in cui
+  // un accesso concorrente si farebbe vedere
+  struct Use {
+    FakeFs* fs;
+    explicit Use(FakeFs* f) : fs(f) {
+      if (fs->active_.fetch_add(1) > 0) fs->overlaps++;
+      std::this_thread::yield();
+    }
+    ~Use() { fs->active_.fetch_sub(1); }
+  };
+
+  // Consuma fino a n unità e ritorna quante ne ha concesse: meno di n se
+  // la corrente manca a metà, 0 se manca già
+  size_t spendLocked(size_t n) {
+    if (cut) return 0;
+    if (budget >= 0) {
+      if ((long)n > budget) n = budget;
+      budget -= n;
+      if (budget == 0) cut = true;
+    }
+    spent += n;
+    return n;
+  }
+};
+
+inline size_t File::write(const uint8_t* data, size_t len) {
+  if (!fs_) return 0;
+  FakeFs::Use use(fs_);
+  std::lock_guard<std::mutex> lock(fs_->m_);
+  size_t n = fs_->spendLocked(len);
+  if (n == 0) return 0;
+  std::string& f = fs_->files[path_];
+  if (append_) pos_ = f.size();
+  if (pos_ > f.size()) f.resize(pos_);
+  f.replace(pos_, std::min(n, f.size() - pos_), (const char*)data, n);
+  pos_ += n;
+  fs_->writes++;
+  fs_->writeBytes += n;
+  return n;
+}
+
+inline int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+inline int File::read(uint8_t* buf, size_t len) {
+  if (!fs_) return -1;
+  FakeFs::Use use(fs_);
+  std::lock_guard<std::mutex> lock(fs_->m_);
+  auto it = fs_->files.find(path_);
+  if (it == fs_->files.end() || pos_ >= it->second.size()) return 0;
+  if (fs_->readFail == 0) return -1;
+  if (fs_->readFail > 0) fs_->readFail--;
+  size_t n = std::min(len, it->second.size() - pos_);
+  memcpy(buf, it->second.data() + pos_, n);
+  pos_ += n;
+  fs_->reads++;
+  fs_->readBytes += n;
+  return n;
+}
+
+inline int File::available() {
+  if (!fs_) return 0;
+  std::lock_guard<std::mutex> lock(fs_->m_);
+  auto it = fs_->files.find(path_);
+  return it != fs_->files.end() && pos_ < it->second.size() ? it->second.size() - pos_ : 0;
+}
+
+inline size_t File::size() {
+  if (!fs_) return 0;
+  std::lock_guard<std::mutex> lock(fs_->m_);
+  auto it = fs_->files.find(path_);
+  return it != fs_->files.end() ? it->second.size() : 0;
+}
+
+inline bool File::seek(size_t pos) {
+  if (!fs_) return false;
+  pos_ = pos;
+  fs_->seeks++;
+  return true;
+}
+
+// Una lettura sola fino al terminatore (Stream lo legge a byte, dal buffer della libreria)
+inline String File::readStringUntil(char end) {
+  if (!fs_) return String();
+  FakeFs::Use use(fs_);
+  std::lock_guard<std::mutex> lock(fs_->m_);
+  auto it = fs_->files.find(path_);
+  if (it == fs_->files.end() || pos_ >= it->second.size()) return String();
+  const std::string& f = it->second;
+  size_t stop = f.find(end, pos_);
+  if (stop == std::string::npos) stop = f.size();
+  String out(f.substr(pos_, stop - pos_));
+  fs_->reads++;
+  fs_->readBytes += std::min(stop + 1, f.size()) - pos_;
+  pos_ = std::min(stop + 1, f.size());
+  return out;
+}
+
+inline FakeFs SD;
@@ -0,0 +1,277 @@
+// Flussi di riferimento: printEtichetta della v1.6.9 (commit 8b69465,
+// byte scritti a mano su printerSerial) per le schede di schede_prova.h.
+// Generato una volta; non modificare a mano.
+
+#pragma once
+
+const uint8_t kGolden0[157] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F,
+    0x30, 0x30, 0x32, 0x31, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x52, 0x4F, 0x53, 0x53, 0x49,
+    0x20, 0x4D, 0x41, 0x52, 0x49, 0x4F, 0x0D, 0x0A, 0x1B, 0x4D, 0x01, 0x30, 0x38, 0x2E, 0x30, 0x31,
+    0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x30, 0x34, 0x32, 0x33, 0x20, 0x31, 0x32, 0x33, 0x34, 0x35,
+    0x36, 0x20, 0x2D, 0x20, 0x56, 0x49, 0x41, 0x20, 0x52, 0x4F, 0x4D, 0x41, 0x20, 0x31, 0x0D, 0x0A,
+    0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x48, 0x49, 0x4C, 0x54, 0x49, 0x20, 0x2D, 0x20, 0x56, 0x41,
+    0x4C, 0x49, 0x47, 0x45, 0x54, 0x54, 0x41, 0x0D, 0x0A, 0x1B, 0x4D, 0x01, 0x4E, 0x4F, 0x4E, 0x20,
+    0x50, 0x41, 0x52, 0x54, 0x45, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden1[178] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x32, 0x20, 0x28, 0x31, 0x2F, 0x33, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x43, 0x4F, 0x53, 0x54, 0x52,
+    0x55, 0x5A, 0x49, 0x4F, 0x4E, 0x49, 0x20, 0x54, 0x41, 0x47, 0x4C, 0x49, 0x41, 0x4D, 0x45, 0x4E,
+    0x54, 0x4F, 0x20, 0x53, 0x2E, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x30, 0x39, 0x2E, 0x30, 0x31, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x33, 0x33, 0x33, 0x31, 0x32,
+    0x33, 0x34, 0x35, 0x36, 0x37, 0x20, 0x2D, 0x20, 0x56, 0x49, 0x41, 0x20, 0x44, 0x45, 0x4C, 0x4C,
+    0x45, 0x20, 0x49, 0x4E, 0x44, 0x55, 0x53, 0x54, 0x52, 0x49, 0x45, 0x20, 0x32, 0x34, 0x0D, 0x0A,
+    0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x4D, 0x41, 0x4B, 0x49, 0x54, 0x41, 0x20, 0x2D, 0x20, 0x43,
+    0x41, 0x52, 0x49, 0x43, 0x41, 0x42, 0x41, 0x54, 0x54, 0x45, 0x52, 0x49, 0x45, 0x0D, 0x0A, 0x0A,
+    0x0A, 0x0A,
+};
+
+const uint8_t kGolden2[215] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x32, 0x20, 0x28, 0x32, 0x2F, 0x33, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x43, 0x4F, 0x53, 0x54, 0x52,
+    0x55, 0x5A, 0x49, 0x4F, 0x4E, 0x49, 0x20, 0x54, 0x41, 0x47, 0x4C, 0x49, 0x41, 0x4D, 0x45, 0x4E,
+    0x54, 0x4F, 0x20, 0x53, 0x2E, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x30, 0x39, 0x2E, 0x30, 0x31, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x33, 0x33, 0x33, 0x31, 0x32,
+    0x33, 0x34, 0x35, 0x36, 0x37, 0x20, 0x2D, 0x20, 0x56, 0x49, 0x41, 0x20, 0x44, 0x45, 0x4C, 0x4C,
+    0x45, 0x20, 0x49, 0x4E, 0x44, 0x55, 0x53, 0x54, 0x52, 0x49, 0x45, 0x20, 0x32, 0x34, 0x0D, 0x0A,
+    0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x42, 0x4F, 0x53, 0x43, 0x48, 0x20, 0x2E, 0x20, 0x2D, 0x20,
+    0x32, 0x20, 0x42, 0x41, 0x54, 0x54, 0x45, 0x52, 0x49, 0x45, 0x20, 0x2B, 0x20, 0x56, 0x41, 0x4C,
+    0x49, 0x47, 0x45, 0x54, 0x54, 0x41, 0x0D, 0x0A, 0x1B, 0x4D, 0x01, 0x53, 0x43, 0x49, 0x4E, 0x54,
+    0x49, 0x4C, 0x4C, 0x45, 0x20, 0x44, 0x41, 0x4C, 0x20, 0x4D, 0x4F, 0x54, 0x4F, 0x52, 0x45, 0x0D,
+    0x0A, 0x1B, 0x4D, 0x00, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden3[186] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x32, 0x20, 0x28, 0x33, 0x2F, 0x33, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x43, 0x4F, 0x53, 0x54, 0x52,
+    0x55, 0x5A, 0x49, 0x4F, 0x4E, 0x49, 0x20, 0x54, 0x41, 0x47, 0x4C, 0x49, 0x41, 0x4D, 0x45, 0x4E,
+    0x54, 0x4F, 0x20, 0x53, 0x2E, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x30, 0x39, 0x2E, 0x30, 0x31, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x33, 0x33, 0x33, 0x31, 0x32,
+    0x33, 0x34, 0x35, 0x36, 0x37, 0x20, 0x2D, 0x20, 0x56, 0x49, 0x41, 0x20, 0x44, 0x45, 0x4C, 0x4C,
+    0x45, 0x20, 0x49, 0x4E, 0x44, 0x55, 0x53, 0x54, 0x52, 0x49, 0x45, 0x20, 0x32, 0x34, 0x0D, 0x0A,
+    0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x53, 0x54, 0x49, 0x48, 0x4C, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x43, 0x41, 0x54, 0x45, 0x4E, 0x41, 0x20, 0x44, 0x41, 0x20, 0x41, 0x46, 0x46, 0x49, 0x4C, 0x41,
+    0x52, 0x45, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden4[98] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F,
+    0x30, 0x30, 0x32, 0x33, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x4E, 0x49, 0x43, 0x4F, 0x4C,
+    0xC3, 0x92, 0x20, 0x5A, 0x41, 0x4E, 0x45, 0x54, 0x54, 0x49, 0x0D, 0x0A, 0x1B, 0x4D, 0x01, 0x30,
+    0x31, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x0A,
+    0x0A, 0x0A,
+};
+
+const uint8_t kGolden5[268] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x34, 0x20, 0x28, 0x31, 0x2F, 0x35, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x53, 0x4F, 0x43, 0x49, 0x45,
+    0x54, 0x41, 0x27, 0x20, 0x41, 0x47, 0x52, 0x49, 0x43, 0x4F, 0x4C, 0x41, 0x20, 0x46, 0x52, 0x41,
+    0x54, 0x45, 0x4C, 0x4C, 0x2E, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x30, 0x32, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x30, 0x34, 0x32, 0x32, 0x20,
+    0x39, 0x38, 0x37, 0x36, 0x35, 0x34, 0x20, 0x2D, 0x20, 0x4C, 0x4F, 0x43, 0x41, 0x4C, 0x49, 0x54,
+    0xC3, 0x80, 0x20, 0x43, 0xC3, 0x80, 0x20, 0x44, 0x49, 0x20, 0x53, 0x4F, 0x50, 0x52, 0x41, 0x20,
+    0x31, 0x32, 0x20, 0x49, 0x4E, 0x54, 0x45, 0x52, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F,
+    0x48, 0x2E, 0x20, 0x2D, 0x20, 0x53, 0x54, 0x41, 0x5A, 0x49, 0x4F, 0x4E, 0x45, 0x20, 0x44, 0x49,
+    0x20, 0x52, 0x49, 0x43, 0x41, 0x52, 0x49, 0x43, 0x41, 0x20, 0x45, 0x20, 0x43, 0x41, 0x56, 0x4F,
+    0x0D, 0x0A, 0x1B, 0x4D, 0x01, 0x50, 0x45, 0x52, 0x49, 0x4D, 0x45, 0x54, 0x52, 0x4F, 0x20, 0x49,
+    0x4E, 0x54, 0x45, 0x52, 0x52, 0x4F, 0x54, 0x54, 0x4F, 0x2C, 0x20, 0x56, 0x45, 0x52, 0x49, 0x46,
+    0x49, 0x43, 0x41, 0x52, 0x45, 0x20, 0x53, 0x43, 0x48, 0x45, 0x44, 0x41, 0x20, 0x4D, 0x41, 0x44,
+    0x52, 0x45, 0x20, 0x45, 0x20, 0x53, 0x45, 0x4E, 0x53, 0x4F, 0x52, 0x49, 0x20, 0x50, 0x49, 0x4F,
+    0x47, 0x47, 0x49, 0x41, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden6[217] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x34, 0x20, 0x28, 0x32, 0x2F, 0x35, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x53, 0x4F, 0x43, 0x49, 0x45,
+    0x54, 0x41, 0x27, 0x20, 0x41, 0x47, 0x52, 0x49, 0x43, 0x4F, 0x4C, 0x41, 0x20, 0x46, 0x52, 0x41,
+    0x54, 0x45, 0x4C, 0x4C, 0x2E, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x30, 0x32, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x30, 0x34, 0x32, 0x32, 0x20,
+    0x39, 0x38, 0x37, 0x36, 0x35, 0x34, 0x20, 0x2D, 0x20, 0x4C, 0x4F, 0x43, 0x41, 0x4C, 0x49, 0x54,
+    0xC3, 0x80, 0x20, 0x43, 0xC3, 0x80, 0x20, 0x44, 0x49, 0x20, 0x53, 0x4F, 0x50, 0x52, 0x41, 0x20,
+    0x31, 0x32, 0x20, 0x49, 0x4E, 0x54, 0x45, 0x52, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F,
+    0x44, 0x45, 0x57, 0x41, 0x4C, 0x54, 0x20, 0x2D, 0x20, 0x4E, 0x45, 0x53, 0x53, 0x55, 0x4E, 0x41,
+    0x0D, 0x0A, 0x1B, 0x4D, 0x01, 0x50, 0x45, 0x52, 0x43, 0x48, 0xC3, 0x89, 0x20, 0x4E, 0x4F, 0x4E,
+    0x20, 0x43, 0x41, 0x52, 0x49, 0x43, 0x41, 0x3F, 0x20, 0xC3, 0x88, 0x20, 0x4E, 0x55, 0x4F, 0x56,
+    0x41, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden7[182] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x34, 0x20, 0x28, 0x33, 0x2F, 0x35, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x53, 0x4F, 0x43, 0x49, 0x45,
+    0x54, 0x41, 0x27, 0x20, 0x41, 0x47, 0x52, 0x49, 0x43, 0x4F, 0x4C, 0x41, 0x20, 0x46, 0x52, 0x41,
+    0x54, 0x45, 0x4C, 0x4C, 0x2E, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x30, 0x32, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x30, 0x34, 0x32, 0x32, 0x20,
+    0x39, 0x38, 0x37, 0x36, 0x35, 0x34, 0x20, 0x2D, 0x20, 0x4C, 0x4F, 0x43, 0x41, 0x4C, 0x49, 0x54,
+    0xC3, 0x80, 0x20, 0x43, 0xC3, 0x80, 0x20, 0x44, 0x49, 0x20, 0x53, 0x4F, 0x50, 0x52, 0x41, 0x20,
+    0x31, 0x32, 0x20, 0x49, 0x4E, 0x54, 0x45, 0x52, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F,
+    0x48, 0x49, 0x4C, 0x54, 0x49, 0x20, 0x2D, 0x20, 0x56, 0x41, 0x4C, 0x49, 0x47, 0x45, 0x54, 0x54,
+    0x41, 0x0D, 0x0A, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden8[177] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x34, 0x20, 0x28, 0x34, 0x2F, 0x35, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x53, 0x4F, 0x43, 0x49, 0x45,
+    0x54, 0x41, 0x27, 0x20, 0x41, 0x47, 0x52, 0x49, 0x43, 0x4F, 0x4C, 0x41, 0x20, 0x46, 0x52, 0x41,
+    0x54, 0x45, 0x4C, 0x4C, 0x2E, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x30, 0x32, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x30, 0x34, 0x32, 0x32, 0x20,
+    0x39, 0x38, 0x37, 0x36, 0x35, 0x34, 0x20, 0x2D, 0x20, 0x4C, 0x4F, 0x43, 0x41, 0x4C, 0x49, 0x54,
+    0xC3, 0x80, 0x20, 0x43, 0xC3, 0x80, 0x20, 0x44, 0x49, 0x20, 0x53, 0x4F, 0x50, 0x52, 0x41, 0x20,
+    0x31, 0x32, 0x20, 0x49, 0x4E, 0x54, 0x45, 0x52, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F,
+    0x46, 0x45, 0x49, 0x4E, 0x20, 0x2D, 0x20, 0x44, 0x49, 0x53, 0x43, 0x4F, 0x0D, 0x0A, 0x0A, 0x0A,
+    0x0A,
+};
+
+const uint8_t kGolden9[199] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x34, 0x20, 0x28, 0x35, 0x2F, 0x35, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x53, 0x4F, 0x43, 0x49, 0x45,
+    0x54, 0x41, 0x27, 0x20, 0x41, 0x47, 0x52, 0x49, 0x43, 0x4F, 0x4C, 0x41, 0x20, 0x46, 0x52, 0x41,
+    0x54, 0x45, 0x4C, 0x4C, 0x2E, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x30, 0x32, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x30, 0x34, 0x32, 0x32, 0x20,
+    0x39, 0x38, 0x37, 0x36, 0x35, 0x34, 0x20, 0x2D, 0x20, 0x4C, 0x4F, 0x43, 0x41, 0x4C, 0x49, 0x54,
+    0xC3, 0x80, 0x20, 0x43, 0xC3, 0x80, 0x20, 0x44, 0x49, 0x20, 0x53, 0x4F, 0x50, 0x52, 0x41, 0x20,
+    0x31, 0x32, 0x20, 0x49, 0x4E, 0x54, 0x45, 0x52, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F,
+    0x4D, 0x41, 0x4B, 0x49, 0x54, 0x41, 0x20, 0x2D, 0x20, 0x32, 0x20, 0x42, 0x41, 0x54, 0x54, 0x45,
+    0x52, 0x49, 0x45, 0x0D, 0x0A, 0x1B, 0x4D, 0x01, 0x55, 0x52, 0x47, 0x45, 0x4E, 0x54, 0x45, 0x0D,
+    0x0A, 0x1B, 0x4D, 0x00, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden10[135] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F,
+    0x30, 0x30, 0x32, 0x35, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x42, 0x49, 0x41, 0x4E, 0x43,
+    0x48, 0x49, 0x0D, 0x0A, 0x1B, 0x4D, 0x01, 0x30, 0x38, 0x2F, 0x30, 0x31, 0x2F, 0x32, 0x36, 0x20,
+    0x2D, 0x20, 0x30, 0x34, 0x32, 0x33, 0x20, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x20, 0x2D, 0x20,
+    0x56, 0x49, 0x41, 0x20, 0x56, 0x45, 0x52, 0x44, 0x49, 0x20, 0x33, 0x0D, 0x0A, 0x1B, 0x4D, 0x00,
+    0x1B, 0x4A, 0x0F, 0x1B, 0x4D, 0x01, 0x53, 0x4F, 0x4C, 0x4F, 0x20, 0x4E, 0x4F, 0x54, 0x45, 0x0D,
+    0x0A, 0x1B, 0x4D, 0x00, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden11[160] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x36, 0x20, 0x28, 0x31, 0x2F, 0x34, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x41, 0x42, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5A, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x31, 0x30, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x56, 0x49, 0x41, 0x20, 0x50,
+    0x4F, 0x20, 0x32, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x41, 0x42, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5A, 0x20, 0x2D, 0x20, 0x41, 0x42, 0x43, 0x0D, 0x0A, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden12[160] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x36, 0x20, 0x28, 0x32, 0x2F, 0x34, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x41, 0x42, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5A, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x31, 0x30, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x56, 0x49, 0x41, 0x20, 0x50,
+    0x4F, 0x20, 0x32, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x41, 0x42, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x2E, 0x20, 0x2D, 0x20, 0x41, 0x42, 0x43, 0x0D, 0x0A, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden13[159] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x36, 0x20, 0x28, 0x33, 0x2F, 0x34, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x41, 0x42, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5A, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x31, 0x30, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x56, 0x49, 0x41, 0x20, 0x50,
+    0x4F, 0x20, 0x32, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x41, 0x42, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5A, 0x31, 0x32, 0x33, 0x34, 0x35, 0x0D, 0x0A, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden14[163] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F, 0x30, 0x30, 0x32,
+    0x36, 0x20, 0x28, 0x34, 0x2F, 0x34, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x41, 0x42, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5A, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x31, 0x30, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x56, 0x49, 0x41, 0x20, 0x50,
+    0x4F, 0x20, 0x32, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x4D, 0x2E, 0x20, 0x2D, 0x20,
+    0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50,
+    0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x31, 0x32, 0x33, 0x34, 0x0D, 0x0A,
+    0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden15[202] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x36, 0x2F,
+    0x30, 0x30, 0x32, 0x37, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x41, 0x42, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x2E, 0x20, 0x2D, 0x20, 0x44, 0x44, 0x54, 0x0D, 0x0A, 0x1B, 0x4D, 0x01,
+    0x31, 0x31, 0x2E, 0x30, 0x32, 0x2E, 0x32, 0x36, 0x20, 0x2D, 0x20, 0x30, 0x34, 0x32, 0x33, 0x20,
+    0x31, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x42, 0x4F, 0x53, 0x43, 0x48, 0x0D, 0x0A,
+    0x1B, 0x4D, 0x01, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D,
+    0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x41, 0x42, 0x43,
+    0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53,
+    0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x4B, 0x0D, 0x0A, 0x1B, 0x4D, 0x00, 0x0A, 0x0A, 0x0A,
+};
+
+const uint8_t kGolden16[106] = {
+    0x1B, 0x40, 0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x1B, 0x4D, 0x00, 0x1B, 0x45, 0x01, 0x1D, 0x42,
+    0x01, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x39, 0x39, 0x2F,
+    0x39, 0x39, 0x39, 0x39, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x1D, 0x42, 0x00, 0x1B, 0x45, 0x00, 0x0D, 0x0A, 0x1B, 0x4A, 0x10, 0x41, 0x42, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5A, 0x31, 0x32, 0x33, 0x34, 0x35, 0x0D, 0x0A, 0x1B, 0x4D, 0x01, 0x0D,
+    0x0A, 0x1B, 0x4D, 0x00, 0x1B, 0x4A, 0x0F, 0x0A, 0x0A, 0x0A,
+};
+
+struct GoldenLabel {
+  const char* numero;
+  int idx;
+  int tot;
+  const uint8_t* bytes;
+  size_t len;
+};
+
+const GoldenLabel kGolden[] = {
+    {"26/0021", 0, 1, kGolden0, sizeof(kGolden0)},
+    {"26/0022", 0, 3, kGolden1, sizeof(kGolden1)},
+    {"26/0022", 1, 3, kGolden2, sizeof(kGolden2)},
+    {"26/0022", 2, 3, kGolden3, sizeof(kGolden3)},
+    {"26/0023", 0, 1, kGolden4, sizeof(kGolden4)},
+    {"26/0024", 0, 5, kGolden5, sizeof(kGolden5)},
+    {"26/0024", 1, 5, kGolden6, sizeof(kGolden6)},
+    {"26/0024", 2, 5, kGolden7, sizeof(kGolden7)},
+    {"26/0024", 3, 5, kGolden8, sizeof(kGolden8)},
+    {"26/0024", 4, 5, kGolden9, sizeof(kGolden9)},
+    {"26/0025", 0, 1, kGolden10, sizeof(kGolden10)},
+    {"26/0026", 0, 4, kGolden11, sizeof(kGolden11)},
+    {"26/0026", 1, 4, kGolden12, sizeof(kGolden12)},
+    {"26/0026", 2, 4, kGolden13, sizeof(kGolden13)},
+    {"26/0026", 3, 4, kGolden14, sizeof(kGolden14)},
+    {"26/0027", 0, 1, kGolden15, sizeof(kGolden15)},
+    {"99/9999", 0, 1, kGolden16, sizeof(kGolden16)},
+};
@@ -0,0 +1,279 @@
+/*
+ * HOST - Quel che serve del core Arduino e di FreeRTOS per compilare sul PC
+ * le sezioni di src/main.cpp usate dai test (estratte con section.sh).
+ *
+ * I task sono thread, code e semafori sono mutex + condition variable:
+ * stessa semantica delle chiamate usate dal firmware, non dei tempi.
+ */
+
+#pragma once
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+
+using std::max;
+using std::min;
+
+// ===== TEST =====
+inline int hostFailures = 0;
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      hostFailures++;                                                      \
+      if (hostFailures <= 20) {                                            \
+        fprintf(stderr, "%s:%d: CHECK(%s) fallito\n", __FILE__, __LINE__, #cond); \
+      }                                                                    \
+    }                                                                      \
+  } while (0)
+
+// Esito finale del test: 0 = tutto ok
+inline int hostResult(const char* name) {
+  if (hostFailures) {
+    printf("%s: %d controlli falliti\n", name, hostFailures);
+    return 1;
+  }
+  printf("%s: OK\n", name);
+  return 0;
+}
+
+// ===== ARDUINO =====
+// Log del firmware: zitti nei test
+#define debugPrint(...) ((void)0)
+#define debugPrintln(...) ((void)0)
+#define errorPrint(...) ((void)0)
+#define errorPrintln(...) ((void)0)
+#define tracePrint(...) ((void)0)
+#define tracePrintln(...) ((void)0)
+
+inline uint64_t hostNowUs() {
+  using namespace std::chrono;
+  static const steady_clock::time_point t0 = steady_clock::now();
+  return duration_cast<microseconds>(steady_clock::now() - t0).count();
+}
+
+inline unsigned long millis() { return (unsigned long)(hostNowUs() / 1000); }
+inline unsigned long micros() { return (unsigned long)hostNowUs(); }
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void* ps_malloc(size_t n) { return malloc(n); }
+
+// String di Arduino: solo i metodi usati dalle sezioni sotto test
+class String {
+ public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+
+  unsigned int length() const { return s_.size(); }
+  const char* c_str() const { return s_.c_str(); }
+  char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+  String& operator+=(char c) {
+    s_ += c;
+    return *this;
+  }
+  bool concat(const char* s, size_t n) {
+    s_.append(s, n);
+    return true;
+  }
+  void reserve(unsigned int n) { s_.reserve(n); }
+  bool equals(const char* s) const { return s_ == s; }
+  bool operator==(const char* s) const { return s_ == s; }
+  bool equalsIgnoreCase(const char* s) const { return strcasecmp(s_.c_str(), s) == 0; }
+  bool startsWith(const char* s) const { return s_.compare(0, strlen(s), s) == 0; }
+  bool endsWith(const char* s) const {
+    size_t n = strlen(s);
+    return s_.size() >= n && s_.compare(s_.size() - n, n, s) == 0;
+  }
+  String substring(unsigned int from) const { return substring(from, s_.size()); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > s_.size()) from = s_.size();
+    if (to > s_.size()) to = s_.size();
+    return String(s_.substr(from, to > from ? to - from : 0));
+  }
+  void trim() {
+    size_t a = s_.find_first_not_of(" \t\r\n");
+    size_t b = s_.find_last_not_of(" \t\r\n");
+    s_ = a == std::string::npos ? std::string() : s_.substr(a, b - a + 1);
+  }
+
+ private:
+  std::string s_;
+};
+
+// CRC32 della ROM ESP32 (come zlib): crc32_le(crc32_le(0, a), b) == crc32_le(0, ab)
+inline uint32_t crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+  struct Table {
+    uint32_t v[256];
+    Table() {
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        v[i] = c;
+      }
+    }
+  };
+  static const Table t;
+  const uint32_t* table = t.v;
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) crc = table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+// ===== FREERTOS =====
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+
+inline void vTaskDelay(TickType_t ticks) {
+  if (ticks == 0) std::this_thread::yield();
+  else std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+// Attesa con timeout in tick (1 tick = 1 ms, portMAX_DELAY = per sempre)
+template <typename Pred>
+bool hostWait(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, TickType_t wait,
+              Pred ready) {
+  if (wait == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(wait), ready);
+}
+
+// Semafori e mutex (non ricorsivi): contatore con massimo
+struct HostSemaphore {
+  std::mutex m;
+  std::condition_variable cv;
+  int count;
+  int maxCount;
+  HostSemaphore(int c, int mx) : count(c), maxCount(mx) {}
+};
+typedef HostSemaphore* SemaphoreHandle_t;
+struct StaticSemaphore_t {
+  alignas(HostSemaphore) unsigned char buf[sizeof(HostSemaphore)];
+};
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore(1, 1); }
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return new HostSemaphore(0, 1); }
+inline SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buf) {
+  return new (buf->buf) HostSemaphore(0, 1);
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t s) {
+  // Le statiche vivono nel buffer del chiamante: niente delete
+  s->~HostSemaphore();
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait) {
+  std::unique_lock<std::mutex> lock(s->m);
+  if (!hostWait(lock, s->cv, wait, [s] { return s->count > 0; })) return pdFALSE;
+  s->count--;
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  std::lock_guard<std::mutex> lock(s->m);
+  if (s->count >= s->maxCount) return pdFALSE;
+  s->count++;
+  s->cv.notify_one();
+  return pdTRUE;
+}
+
+// Code: elementi copiati per valore, come xQueueSend/xQueueReceive
+struct HostQueue {
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  size_t itemSize;
+  size_t len;
+};
+typedef HostQueue* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t itemSize) {
+  HostQueue* q = new HostQueue();
+  q->itemSize = itemSize;
+  q->len = len;
+  return q;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t wait) {
+  std::unique_lock<std::mutex> lock(q->m);
+  if (!hostWait(lock, q->cv, wait, [q] { return q->items.size() < q->len; })) return pdFALSE;
+  const uint8_t* p = static_cast<const uint8_t*>(item);
+  q->items.emplace_back(p, p + q->itemSize);
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t wait) {
+  std::unique_lock<std::mutex> lock(q->m);
+  if (!hostWait(lock, q->cv, wait, [q] { return !q->items.empty(); })) return pdFALSE;
+  memcpy(item, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lock(q->m);
+  return q->items.size();
+}
+
+inline UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lock(q->m);
+  return q->len - q->items.size();
+}
+
+// Task: un thread staccato per task, l'handle identifica il thread
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+inline thread_local TaskHandle_t hostCurrentTask = NULL;
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return hostCurrentTask; }
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack,
+                                          void* param, UBaseType_t prio, TaskHandle_t* out,
+                                          BaseType_t core) {
+  TaskHandle_t h = new int(0);
+  if (out) *out = h;
+  std::thread([fn, param, h] {
+    hostCurrentTask = h;
+    fn(param);
+  }).detach();
+  return pdPASS;
+}
+
+// Notifiche dei task: nessun test avvia un task che le aspetta
+enum eNotifyAction { eNoAction, eSetBits, eIncrement };
+
+inline BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+  return pdPASS;
+}
+
+inline BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t* value,
+                                  TickType_t wait) {
+  if (value) *value = 0;
+  vTaskDelay(wait == portMAX_DELAY ? 1000 : wait);
+  return pdFALSE;
+}
@@ -0,0 +1,101 @@
+/*
+ * INDEX ENV - Le sezioni di src/main.cpp dietro l'indice schede (CsvSource,
+ * archivio per anno, indice) con quel che si aspettano dal resto del
+ * firmware, più un CSV sintetico con la forma del foglio.
+ */
+
+#pragma once
+
+#include "host.h"
+#include "fake_fs.h"
+#include "lzss.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+bool sdOK = true;
+bool suppressJsonLogs = false;
+metrics::Histogram mSdOp;
+
+#include "scheda.h"
+#define MAX_SCHEDE 50
+#include "snapshot.inc"
+#include "storage.inc"
+#include "numero.inc"
+#include "csvfield.inc"
+
+// parseSchedaLine senza gli attrezzi: il JSON passa da ArduinoJson, che sul
+// PC non c'è. Per indice e archivio contano i campi semplici
+void parseSchedaLine(const String& line, Scheda& s) {
+  memset(&s, 0, sizeof(Scheda));
+  strncpy(s.numero, getCSVField(line, 0).c_str(), sizeof(s.numero) - 1);
+  strncpy(s.data, getCSVField(line, 1).c_str(), sizeof(s.data) - 1);
+  strncpy(s.cliente, getCSVField(line, 2).c_str(), sizeof(s.cliente) - 1);
+  strncpy(s.indirizzo, getCSVField(line, 3).c_str(), sizeof(s.indirizzo) - 1);
+  strncpy(s.telefono, getCSVField(line, 4).c_str(), sizeof(s.telefono) - 1);
+  s.ddt = getCSVField(line, 5).equalsIgnoreCase("true");
+  s.completato = getCSVField(line, 7).equalsIgnoreCase("true");
+}
+
+void historyCompact() {}
+
+#include "csvsrc.inc"
+#include "archive.inc"
+#include "index.inc"
+
+// ===== CSV SINTETICO =====
+// Righe come quelle del foglio: numero, data, cliente, indirizzo, telefono,
+// DDT, attrezzi (JSON con le virgolette raddoppiate), completato
+const char* const kCsvHeader =
+    "Numero,Data consegna,Cliente,Indirizzo,Telefono,DDT,Attrezzi,Completato,Data completamento\n";
+
+const char* const kCognomi[] = {"ROSSI", "BIANCHI", "VERDI", "DAL BEN", "ZANETTI", "BORTOLIN",
+                                "FAVARO", "SCHIAVON", "BERTON", "DE LUCA", "GASPARINI", "ZAMPIERI",
+                                "MARCON", "PELLIZZARI", "TONIOLO", "VIANELLO", "CARRARO", "BOSCOLO"};
+const char* const kNomi[] = {"MARIO", "GIUSEPPE", "ANNA", "LUCA", "PAOLA", "NICOLÒ", "SRL",
+                             "SNC", "COSTRUZIONI", "EDILIZIA", "IMPIANTI", "GIARDINI"};
+const char* const kMarche[] = {"HILTI", "MAKITA", "BOSCH", "STIHL", "HUSQVARNA", "DEWALT"};
+
+struct SynthCsv {
+  std::string text;
+  std::vector<int> ids;
+  std::vector<uint32_t> offsets;  // Inizio riga nel file
+  std::vector<uint32_t> lens;     // Senza \n
+};
+
+// Riga della scheda id; variant cambia i campi (una riga "modificata")
+std::string csvRow(int id, int variant = 0) {
+  std::mt19937 rng(id * 7919 + variant);
+  char numero[12];
+  unpackNumero(id, numero, sizeof(numero));
+  char row[512];
+  snprintf(row, sizeof(row),
+           "%s,20%02d-%02d-%02d,%s %s,VIA ROMA %u,0423 %06u,%s,\"[{\"\"marca\"\":\"\"%s\"\","
+           "\"\"dotazione\"\":\"\"VALIGETTA\"\",\"\"note\"\":\"\"%s\"\"}]\",%s,",
+           numero, id / 10000, 1 + (int)(rng() % 12), 1 + (int)(rng() % 28),
+           kCognomi[rng() % (sizeof(kCognomi) / sizeof(kCognomi[0]))],
+           kNomi[rng() % (sizeof(kNomi) / sizeof(kNomi[0]))], (unsigned)(rng() % 200),
+           (unsigned)(rng() % 1000000), rng() % 4 ? "FALSE" : "TRUE",
+           kMarche[rng() % (sizeof(kMarche) / sizeof(kMarche[0]))],
+           variant ? "RIVISTA" : "NON PARTE", rng() % 3 ? "TRUE" : "FALSE");
+  return row;
+}
+
+// n schede da firstId, cambiando anno ogni perYear
+SynthCsv csvBuild(int firstId, int n, int perYear = 9999) {
+  SynthCsv csv;
+  csv.text = kCsvHeader;
+  int id = firstId;
+  for (int i = 0; i < n; i++) {
+    if (id % 10000 == 0 || id % 10000 > perYear) id = (id / 10000 + 1) * 10000 + 1;
+    std::string row = csvRow(id);
+    csv.ids.push_back(id);
+    csv.offsets.push_back(csv.text.size());
+    csv.lens.push_back(row.size());
+    csv.text += row;
+    csv.text += '\n';
+    id++;
+  }
+  return csv;
+}
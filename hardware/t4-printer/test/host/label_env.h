@@ -0,0 +1,60 @@
+/*
+ * LABEL ENV - Le sezioni di src/main.cpp che compongono e inviano
+ * un'etichetta (testo, data, render, replay) con una stampante finta al
+ * posto di printerSerial. Le schede di prova sono in schede_prova.h.
+ */
+
+#pragma once
+
+#include "host.h"
+#include "escpos.h"
+
+#include "scheda.h"
+
+// ===== STAMPANTE FINTA =====
+// Tiene i byte ricevuti in un buffer fisso: nessuna allocazione, così i
+// conteggi dei test vedono solo quelle del firmware. Con baud > 0 flush()
+// aspetta quanto la UART a quella velocità per i byte non ancora inviati
+struct FakePrinter {
+  static constexpr size_t kCap = 1 << 16;
+  uint8_t bytes[kCap];
+  size_t len = 0;
+  size_t sent = 0;  // Byte già "usciti" dalla UART
+  unsigned long flushes = 0;
+  unsigned long baud = 0;  // 0 = istantanea
+
+  size_t write(const uint8_t* b, size_t n) {
+    if (n > kCap - len) n = kCap - len;
+    memcpy(bytes + len, b, n);
+    len += n;
+    return n;
+  }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t print(const char* t) { return write((const uint8_t*)t, strlen(t)); }
+  size_t println(const char* t = "") { return print(t) + print("\r\n"); }
+  void flush() {
+    flushes++;
+    if (baud) delay((len - sent) * 10 * 1000 / baud);  // 8N1: 10 bit per byte
+    sent = len;
+  }
+  int available() { return 0; }
+  int read() { return -1; }
+  void clear() { len = sent = 0; }
+};
+
+FakePrinter printerSerial;
+
+volatile uint32_t printTriggerUs = 0;
+struct PrintLatency {
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint32_t count;
+};
+PrintLatency printLatency[3];
+volatile bool printTriggerManual = false;
+metrics::Histogram mLabelPrint;
+metrics::Histogram mPollPaper;
+volatile uint32_t pollPaperUs = 0;
+
+#include "label.inc"
+#include "schede_prova.h"
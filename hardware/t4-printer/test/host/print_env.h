@@ -0,0 +1,56 @@
+/*
+ * PRINT ENV - Coda di stampa, spool e batch PRINT: di src/main.cpp sopra
+ * gli ambienti dell'indice (CSV su SD finta) e delle etichette (stampante
+ * finta). Display e cache etichette sono stub.
+ */
+
+#pragma once
+
+#include "index_env.h"
+#include "label_env.h"
+
+#define TFT_GREEN 0x07E0
+#define TFT_RED 0xF800
+#define TFT_ORANGE 0xFDA0
+#define TFT_YELLOW 0xFFE0
+#define TFT_CYAN 0x07FF
+
+// Coda di stampa: stessi valori del firmware
+#define PRINT_QUEUE_LEN 6
+#define PAUSE_NORMAL_SEC 8
+#define PAUSE_REMOTE_SEC 3
+#define BATCH_STEP_MS 500
+QueueHandle_t printQueue = NULL;
+volatile bool printBusy = false;
+
+// Messaggi a schermo: passano al test, che definisce showBatchMessage
+void showBatchMessage(const char* msg);
+void showMessage(const char* msg, uint16_t color) { showBatchMessage(msg); }
+
+// Report dei comandi remoti: un segno riconoscibile nello stream
+const char* const kStatusMark = "=== STATUS REPORT ===\r\n";
+void printStatusReport() { printerSerial.print(kStatusMark); }
+void printMetricsReport() { printerSerial.print("=== METRICS ===\r\n"); }
+
+// Senza cache etichette: ogni etichetta si renderizza al momento
+bool labelCacheCopy(const char* numero, uint32_t hash, int idx, int tot, LabelStream& out,
+                    int* numLabels) {
+  return false;
+}
+
+void printEtichetta(Scheda& s, int attrezzoIdx, int totAttrezzi) {
+  static LabelStream l;  // Solo il task di stampa
+  renderEtichetta(l, s, attrezzoIdx, totAttrezzi);
+  replayLabel(l, false);
+}
+
+#include "spool.inc"
+#include "queue.inc"
+#include "batch.inc"
+
+// Task di stampa come in setup()
+void printInit() {
+  spoolInit();
+  printQueue = xQueueCreate(PRINT_QUEUE_LEN, sizeof(PrintJob));
+  xTaskCreatePinnedToCore(printTask, "PrintTask", 4096, NULL, 2, NULL, 1);
+}
@@ -0,0 +1,8 @@
+/*
+ * SCHEDA - Struttura Scheda di src/main.cpp, inclusa una volta sola anche
+ * quando un test mette insieme più ambienti (indice, etichette).
+ */
+
+#pragma once
+
+#include "scheda.inc"
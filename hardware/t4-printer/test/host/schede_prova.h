@@ -0,0 +1,82 @@
+/*
+ * SCHEDE DI PROVA - Schede rappresentative per i test delle etichette.
+ * Servono solo struct Scheda e string.h: le usa anche chi genera i flussi
+ * di riferimento con il codice della v1.6.9.
+ */
+
+#pragma once
+
+#include <string.h>
+#include <vector>
+
+void schedaAttrezzo(Scheda& s, const char* marca, const char* dotazione, const char* note) {
+  Attrezzo& a = s.attrezzi[s.numAttrezzi++];
+  strncpy(a.marca, marca, sizeof(a.marca) - 1);
+  strncpy(a.dotazione, dotazione, sizeof(a.dotazione) - 1);
+  strncpy(a.note, note, sizeof(a.note) - 1);
+}
+
+Scheda schedaBase(const char* numero, const char* data, const char* cliente, const char* tel,
+                  const char* indirizzo, bool ddt) {
+  Scheda s;
+  memset(&s, 0, sizeof(s));
+  strncpy(s.numero, numero, sizeof(s.numero) - 1);
+  strncpy(s.data, data, sizeof(s.data) - 1);
+  strncpy(s.cliente, cliente, sizeof(s.cliente) - 1);
+  strncpy(s.telefono, tel, sizeof(s.telefono) - 1);
+  strncpy(s.indirizzo, indirizzo, sizeof(s.indirizzo) - 1);
+  s.ddt = ddt;
+  return s;
+}
+
+// Casi tipici del foglio: un attrezzo, più attrezzi, nessuno, campi al
+// limite dei buffer della Scheda, DDT, accenti, data non ISO; poi i limiti
+// di riga (cliente con DDT, marca - dotazione) attorno ai 32 caratteri.
+// I troncamenti sono su testo ASCII: lì l'uscita è quella della v1.6.9,
+// che contava byte (i casi UTF-8 sono in test_label)
+std::vector<Scheda> schedeProva() {
+  std::vector<Scheda> v;
+  Scheda s = schedaBase("26/0021", "2026-01-08", "ROSSI MARIO", "0423 123456", "VIA ROMA 1", false);
+  schedaAttrezzo(s, "HILTI", "VALIGETTA", "NON PARTE");
+  v.push_back(s);
+
+  s = schedaBase("26/0022", "2026-01-09", "COSTRUZIONI TAGLIAMENTO SRL", "3331234567",
+                 "VIA DELLE INDUSTRIE 24", true);
+  schedaAttrezzo(s, "MAKITA", "CARICABATTERIE", "");
+  schedaAttrezzo(s, "BOSCH PROFESSIONAL", "2 BATTERIE + VALIGETTA", "SCINTILLE DAL MOTORE");
+  schedaAttrezzo(s, "STIHL", "", "CATENA DA AFFILARE");
+  v.push_back(s);
+
+  s = schedaBase("26/0023", "2026-02-01", "NICOLÒ ZANETTI", "", "", false);
+  v.push_back(s);
+
+  s = schedaBase("26/0024", "2026-02-02", "SOCIETA' AGRICOLA FRATELLI DE LUCA", "0422 987654",
+                 "LOCALITÀ CÀ DI SOPRA 12 INTERNO", true);
+  schedaAttrezzo(s, "HUSQVARNA AUTOMOWER 430X NERA", "STAZIONE DI RICARICA E CAVO",
+                 "PERIMETRO INTERROTTO, VERIFICARE SCHEDA MADRE E SENSORI PIOGGIA");
+  schedaAttrezzo(s, "DEWALT", "NESSUNA", "PERCHÉ NON CARICA? È NUOVA");
+  schedaAttrezzo(s, "HILTI", "VALIGETTA", "");
+  schedaAttrezzo(s, "FEIN", "DISCO", "");
+  schedaAttrezzo(s, "MAKITA", "2 BATTERIE", "URGENTE");
+  v.push_back(s);
+
+  s = schedaBase("26/0025", "08/01/26", "BIANCHI", "0423 000000", "VIA VERDI 3", false);
+  schedaAttrezzo(s, "", "VALIGETTA", "SOLO NOTE");
+  v.push_back(s);
+
+  // Cliente di 26 e 27 caratteri con DDT
+  s = schedaBase("26/0026", "2026-02-10", "ABCDEFGHIJKLMNOPQRSTUVWXYZ", "", "VIA PO 2", true);
+  schedaAttrezzo(s, "ABCDEFGHIJKLMNOPQRSTUVWXYZ", "ABC", "");            // 32: intera
+  schedaAttrezzo(s, "ABCDEFGHIJKLMNOPQRSTUVWXYZ1", "ABC", "");           // 33: marca tagliata
+  schedaAttrezzo(s, "ABCDEFGHIJKLMNOPQRSTUVWXYZ12345", "", "");          // 31, senza dotazione
+  schedaAttrezzo(s, "MAKITA", "ABCDEFGHIJKLMNOPQRSTUVWXYZ1234", "");     // Dotazione lunga: marca al minimo
+  v.push_back(s);
+
+  s = schedaBase("26/0027", "2026-02-11", "ABCDEFGHIJKLMNOPQRSTUVWXYZ1", "0423 1", "", true);
+  schedaAttrezzo(s, "BOSCH", "", "ABCDEFGHIJKLMNOPQRSTUVWXYZABCDEFGHIJKLMNOPQRSTUVWXYZABCDEFGHIJK");
+  v.push_back(s);
+
+  s = schedaBase("99/9999", "", "ABCDEFGHIJKLMNOPQRSTUVWXYZ12345", "", "", false);
+  v.push_back(s);
+  return v;
+}
@@ -0,0 +1,10 @@
+#!/bin/sh
+# Estrae una sezione di src/main.cpp: dalla riga che inizia con $2 (inclusa)
+# alla prima riga successiva che inizia con $3 (esclusa). I test compilano
+# così il codice del firmware, non una sua copia.
+#   sh section.sh ../../src/main.cpp "// ===== SPOOL" "// ===== CODA" > spool.inc
+awk -v a="$2" -v b="$3" '
+  p && index($0, b) == 1 { exit }
+  index($0, a) == 1 { p = 1 }
+  p { print }
+' "$1"
@@ -0,0 +1,235 @@
+// Archivio per anno (/archive/AA.bin) aggiornato da jobDirBuild.
+//
+// - riga più lunga del buffer di jobDirBuild: una modifica oltre il byte
+//   1535 (Completato dopo attrezzi lunghi) riscrive il record;
+// - CSV invariato riletto tutto: nessun record riscritto, anche con \r\n;
+// - riga cancellata dal CSV: slot svuotato;
+// - indice fermo a JOB_DIR_MAX o lettura del CSV fallita a metà: le righe
+//   non lette sono ancora nel CSV, niente va svuotato;
+// - benchmark su 5 anni di schede sintetiche: prima scrittura, sincronizzazione
+//   con righe cambiate o aggiunte, ricerche casuali. Conta gli accessi alla
+//   SD finta (letture, scritture, seek, byte): sul PC il tempo dice poco.
+
+#include "index_env.h"
+
+#include <chrono>
+
+#define BENCH_YEARS 5
+#define BENCH_JOBS 2000     // Schede per anno
+#define BENCH_CHANGED 20    // Righe cambiate (e aggiunte) per sincronizzazione
+#define BENCH_LOOKUPS 2000
+
+// Riga con attrezzi oltre il buffer di jobDirBuild; Completato in fondo
+std::string longRow(int id, bool completato) {
+  std::string row = csvRow(id);
+  size_t note = row.find("NON PARTE");
+  row.replace(note, 9, std::string(1600, 'X'));
+  row.erase(row.rfind("\",") + 2);
+  return row + (completato ? "TRUE," : "FALSE,");
+}
+
+// Ricostruzione dal CSV intero, come dopo una modifica in mezzo al foglio
+void rebuildFull() {
+  SD.remove(JOB_IDX_PATH);
+  jobDirBuild();
+}
+
+bool found(int id) {
+  Scheda s;
+  return archiveFind(id, s);
+}
+
+void checkLongRow() {
+  SynthCsv csv = csvBuild(250001, 20);
+  int id = csv.ids[10];
+  std::string text = csv.text;
+  text.replace(csv.offsets[10], csv.lens[10], longRow(id, false));
+  SD.files[CSV_PATH] = text;
+  rebuildFull();
+  Scheda s;
+  CHECK(archiveFind(id, s) && !s.completato);
+
+  uint32_t written = archiveWritten;
+  text.replace(csv.offsets[10], text.find('\n', csv.offsets[10]) - csv.offsets[10], longRow(id, true));
+  SD.files[CSV_PATH] = text;
+  rebuildFull();
+  CHECK(archiveWritten == written + 1);
+  CHECK(archiveFind(id, s) && s.completato);
+}
+
+void checkUnchanged() {
+  SynthCsv csv = csvBuild(250001, 300);
+  std::string crlf;
+  for (char c : csv.text) {
+    if (c == '\n') crlf += '\r';
+    crlf += c;
+  }
+  SD.files[CSV_PATH] = crlf;
+  rebuildFull();
+  uint32_t written = archiveWritten, skipped = archiveSkipped;
+  rebuildFull();
+  CHECK(archiveWritten == written);
+  CHECK(archiveSkipped == skipped + csv.ids.size());
+}
+
+void checkPrune() {
+  SynthCsv csv = csvBuild(250001, 300);
+  SD.files[CSV_PATH] = csv.text;
+  rebuildFull();
+  int gone = csv.ids[150];
+  CHECK(found(gone));
+  uint32_t pruned = archivePruned;
+  std::string text = csv.text;
+  text.erase(csv.offsets[150], csv.lens[150] + 1);
+  SD.files[CSV_PATH] = text;
+  rebuildFull();
+  CHECK(archivePruned == pruned + 1);
+  CHECK(!found(gone));
+  CHECK(found(csv.ids[149]) && found(csv.ids[151]));
+}
+
+void checkCapNoPrune() {
+  SynthCsv csv = csvBuild(250001, JOB_DIR_MAX);
+  SD.files[CSV_PATH] = csv.text;
+  rebuildFull();
+  CHECK(jobDir.count == JOB_DIR_MAX);
+  CHECK(found(csv.ids.back()));
+
+  // Una scheda in più in testa: l'ultima resta fuori dall'indice
+  std::string text = csv.text;
+  text.insert(strlen(kCsvHeader), csvRow(240001) + "\n");
+  SD.files[CSV_PATH] = text;
+  uint32_t pruned = archivePruned;
+  rebuildFull();
+  CHECK(jobDir.count == JOB_DIR_MAX);
+  CHECK(archivePruned == pruned);
+  CHECK(found(csv.ids.back()));
+}
+
+void checkReadErrorNoPrune() {
+  SynthCsv csv = csvBuild(250001, 2000);
+  SD.files[CSV_PATH] = csv.text;
+  rebuildFull();
+  CHECK(SD.exists(JOB_IDX_PATH));
+
+  uint32_t pruned = archivePruned;
+  SD.readFail = 20;  // Qualche blocco del CSV, poi errore
+  rebuildFull();
+  SD.readFail = -1;
+  CHECK(jobDir.count < (int)csv.ids.size());
+  CHECK(archivePruned == pruned);
+  CHECK(!SD.exists(JOB_IDX_PATH));
+  CHECK(found(csv.ids.back()));
+}
+
+// Accessi alla SD tra due istanti
+struct SdCount {
+  unsigned long reads, readBytes, writes, writeBytes, seeks;
+
+  static SdCount now() {
+    return {SD.reads, SD.readBytes, SD.writes, SD.writeBytes, SD.seeks};
+  }
+
+  SdCount since(const SdCount& a) const {
+    return {reads - a.reads, readBytes - a.readBytes, writes - a.writes,
+            writeBytes - a.writeBytes, seeks - a.seeks};
+  }
+};
+
+// Una sincronizzazione misurata: record riscritti, accessi e tempo
+void benchSync(const char* name, uint32_t expectWritten) {
+  using clock = std::chrono::steady_clock;
+  uint32_t written = archiveWritten;
+  SdCount c0 = SdCount::now();
+  auto t0 = clock::now();
+  jobDirBuild();
+  double ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+  SdCount c = SdCount::now().since(c0);
+  CHECK(archiveWritten - written == expectWritten);
+  printf("  %-22s %5u record, %6lu letture (%5lu KB), %5lu scritture (%5lu KB), %.0f ms su PC\n",
+         name, (unsigned)(archiveWritten - written), c.reads, c.readBytes / 1024, c.writes,
+         c.writeBytes / 1024, ms);
+}
+
+void bench() {
+  using clock = std::chrono::steady_clock;
+  SD.files.clear();
+  SD.dirs.clear();
+  int firstYear = 22;
+  SynthCsv csv = csvBuild(firstYear * 10000 + 1, BENCH_YEARS * BENCH_JOBS, BENCH_JOBS);
+  SD.files[CSV_PATH] = csv.text;
+  printf("archivio: %d anni x %d schede, CSV %zu KB\n", BENCH_YEARS, BENCH_JOBS,
+         csv.text.size() / 1024);
+
+  benchSync("prima scrittura", csv.ids.size());
+  size_t archiveBytes = 0;
+  for (auto& f : SD.files) {
+    if (f.first.rfind(ARCHIVE_DIR "/", 0) == 0) archiveBytes += f.second.size();
+  }
+  // Quanto occuperebbero in blocchi LZSS da 4 KB come il CSV compresso
+  // (l'archivio resta a record fissi: vedi ARCHIVIO PER ANNO in main.cpp)
+  static lzss::Workspace w;
+  static uint8_t packed[lzss::kMaxOut];
+  size_t packedBytes = 0;
+  for (auto& f : SD.files) {
+    if (f.first.rfind(ARCHIVE_DIR "/", 0) != 0) continue;
+    const uint8_t* data = (const uint8_t*)f.second.data();
+    for (size_t off = 0; off < f.second.size(); off += lzss::kBlock) {
+      size_t len = min(lzss::kBlock, f.second.size() - off);
+      packedBytes += min(len, lzss::compress(data + off, len, packed, w));
+    }
+  }
+  printf("  partizioni: %zu KB (%zu KB in blocchi LZSS, %.0f%%), record da %zu byte\n",
+         archiveBytes / 1024, packedBytes / 1024, 100.0 * packedBytes / archiveBytes,
+         sizeof(ArchiveRecord));
+
+  // Riga cambiata nell'anno in corso: il CSV cambia a metà, si rilegge tutto
+  // ma si riscrivono solo quelle righe
+  std::string text = kCsvHeader;
+  size_t n = csv.ids.size();
+  for (size_t i = 0; i < n; i++) {
+    text += csvRow(csv.ids[i], i >= n - BENCH_CHANGED ? 1 : 0);
+    text += '\n';
+  }
+  SD.files[CSV_PATH] = text;
+  benchSync("sync, righe cambiate", BENCH_CHANGED);
+
+  // Righe aggiunte in fondo: aggiornamento incrementale
+  for (int i = 1; i <= BENCH_CHANGED; i++) {
+    text += csvRow(csv.ids.back() + i);
+    text += '\n';
+  }
+  SD.files[CSV_PATH] = text;
+  benchSync("sync, righe aggiunte", BENCH_CHANGED);
+  benchSync("sync, CSV invariato", 0);
+
+  std::mt19937 rng(11);
+  SdCount c0 = SdCount::now();
+  auto t0 = clock::now();
+  int miss = 0;
+  for (int i = 0; i < BENCH_LOOKUPS; i++) {
+    int id = (firstYear + (int)(rng() % BENCH_YEARS)) * 10000 + 1 + (int)(rng() % BENCH_JOBS);
+    Scheda s;
+    if (!archiveFind(id, s)) miss++;
+  }
+  double us = std::chrono::duration<double, std::micro>(clock::now() - t0).count() / BENCH_LOOKUPS;
+  SdCount c = SdCount::now().since(c0);
+  CHECK(miss == 0);
+  printf("  ricerca: %.1f letture, %.1f seek, %.0f byte, %.1f us su PC\n",
+         (double)c.reads / BENCH_LOOKUPS, (double)c.seeks / BENCH_LOOKUPS,
+         (double)c.readBytes / BENCH_LOOKUPS, us);
+}
+
+int main() {
+  SD.files.clear();
+  storageInit();
+  jobDirMutex = xSemaphoreCreateMutex();
+
+  checkLongRow();
+  checkUnchanged();
+  checkPrune();
+  checkCapNoPrune();
+  checkReadErrorNoPrune();
+  bench();
+  return hostResult("test_archive");
+}
@@ -0,0 +1,112 @@
+// Batch PRINT: in streaming: throughput in etichette al minuto.
+//
+// printBatch e printBatchStep (il task di polling, che riprova ogni
+// BATCH_STEP_MS) risolvono le schede dal CSV sulla SD finta mentre
+// printTask stampa su una stampante finta a 19200 baud, con le pause vere
+// del formato. A metà arriva un comando STATUS. Il limite è la somma di
+// pause e byte in UART: se la coda si svuota tra un job e l'altro il
+// batch ci resta lontano. Il report va tra due etichette, mai in mezzo.
+
+#include "print_env.h"
+
+#include <chrono>
+
+#define BATCH_FIRST 101  // Progressivi in mezzo al CSV: ricerca su SD
+#define BATCH_JOBS 16
+#define PRINTER_BAUD 19200
+
+// Report di fine batch (da reportBatch, via showMessage)
+std::atomic<bool> batchReported(false);
+char batchReport[40];
+
+void showBatchMessage(const char* msg) {
+  if (!strstr(msg, "/min")) return;
+  strncpy(batchReport, msg, sizeof(batchReport) - 1);
+  batchReported = true;
+}
+
+// Tempo minimo di un'etichetta: pause del formato più byte sulla UART
+double labelMinMs(const Scheda& s) {
+  static LabelStream l;
+  renderEtichetta(l, s, 0, 1);
+  double ms = l.len * 10 * 1000.0 / PRINTER_BAUD;
+  for (int p = 0; p < l.numPauses; p++) ms += l.pauses[p].ms;
+  return ms;
+}
+
+// Il report STATUS è uno stream a sé tra due etichette
+void checkStatusPlacement() {
+  const uint8_t* b = printerSerial.bytes;
+  const uint8_t* end = b + printerSerial.len;
+  const char* mark = kStatusMark;
+  const uint8_t* p = std::search(b, end, mark, mark + strlen(mark));
+  CHECK(p != end);
+  if (p == end) return;
+  const uint8_t* after = p + strlen(mark);
+  CHECK(p - b >= 3 && memcmp(p - 3, "\n\n\n", 3) == 0);  // Fine etichetta
+  CHECK(after == end || (after[0] == escpos::ESC && after[1] == '@'));
+  CHECK(std::search(after, end, mark, mark + strlen(mark)) == end);
+}
+
+int main() {
+  using clock = std::chrono::steady_clock;
+  SD.files.clear();
+  storageInit();
+  SynthCsv csv = csvBuild(260001, 400);
+  SD.files[CSV_PATH] = csv.text;
+  printerSerial.baud = PRINTER_BAUD;
+  printInit();
+
+  char from[12], to[12], spec[32];
+  unpackNumero(260000 + BATCH_FIRST, from, sizeof(from));
+  unpackNumero(260000 + BATCH_FIRST + BATCH_JOBS - 1, to, sizeof(to));
+  snprintf(spec, sizeof(spec), "%s-%s", from, to);
+
+  double minMs = 0;
+  {
+    CsvCursor cur;
+    CHECK(cur.open());
+    static Scheda s;
+    for (int i = 0; i < BATCH_JOBS; i++) {
+      char numero[12];
+      unpackNumero(260000 + BATCH_FIRST + i, numero, sizeof(numero));
+      CHECK(cur.find(numero, s));
+      minMs += labelMinMs(s);
+    }
+    cur.close();
+  }
+
+  // Task di polling: avvia, poi riprova ogni BATCH_STEP_MS; STATUS a metà
+  auto t0 = clock::now();
+  printBatch(spec);
+  bool statusSent = false;
+  while (!batchReported) {
+    vTaskDelay(BATCH_STEP_MS);
+    printBatchStep();
+    if (!statusSent && batchStats.labels >= BATCH_JOBS / 2) {
+      enqueueStatusReport(portMAX_DELAY);
+      statusSent = true;
+    }
+  }
+  printerSerial.flush();
+  double ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+
+  CHECK(batchStats.jobs == BATCH_JOBS);
+  CHECK(batchStats.labels == BATCH_JOBS);
+  double perMin = BATCH_JOBS * 60000.0 / ms;
+  double maxPerMin = BATCH_JOBS * 60000.0 / minMs;
+  printf("batch: %d schede dal CSV, %d etichette in %.0f ms: %.1f etichette/min\n", BATCH_JOBS,
+         batchStats.labels, ms, perMin);
+  printf("  limite (pause + UART a %d baud): %.1f etichette/min, report: \"%s\"\n", PRINTER_BAUD,
+         maxPerMin, batchReport);
+  // Streaming: nessun buco tra un job e l'altro oltre a un passo di polling
+  CHECK(ms < minMs * 1.25 + BATCH_STEP_MS);
+  checkStatusPlacement();
+
+  // Tutti i job chiusi nello spool
+  static SpoolJob open[SPOOL_MAX_OPEN];
+  xSemaphoreTake(spoolMutex, portMAX_DELAY);
+  CHECK(spoolScan(open, SPOOL_MAX_OPEN) == 0);
+  xSemaphoreGive(spoolMutex);
+  return hostResult("test_batch");
+}
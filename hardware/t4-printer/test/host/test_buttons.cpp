@@ -0,0 +1,250 @@
+// Pulsanti: buttonTask su tracce di fronti scritte a mano.
+//
+// I pin sono livelli in memoria; cambiarli chiama buttonISR come farebbe
+// l'interrupt CHANGE. Le tracce hanno i tempi veri: rimbalzi di pochi ms,
+// impulsi più corti del debounce (il glitch di GPIO39 con il WiFi), long
+// press con ripetizioni, due pulsanti insieme e una raffica di pressioni
+// rapide. Per ogni traccia gli eventi consegnati devono essere esattamente
+// quelli attesi: nessuna pressione persa né doppia, nessun evento da un
+// glitch. La latenza va dal primo fronte all'evento ricevuto dal "loop".
+
+#include "host.h"
+
+#include <map>
+
+// ===== GPIO FINTI =====
+#define LOW 0
+#define HIGH 1
+#define CHANGE 3
+#define IRAM_ATTR
+#define BTN_UP 39
+#define BTN_CENTER 37
+#define BTN_DOWN 38
+#define LONG_PRESS_MS 1500
+#define MANUAL_LONG_PRESS_MS 2000
+#define DEBOUNCE_MS 25
+
+std::atomic<int> pinLevel[40];  // Pull-up: HIGH a riposo
+
+int digitalRead(uint8_t pin) { return pinLevel[pin]; }
+void attachInterruptArg(uint8_t pin, void (*isr)(void*), void* arg, int mode) {}
+
+typedef std::mutex portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(m) (m)->lock()
+#define portEXIT_CRITICAL(m) (m)->unlock()
+#define portENTER_CRITICAL_ISR(m) (m)->lock()
+#define portEXIT_CRITICAL_ISR(m) (m)->unlock()
+#define portYIELD_FROM_ISR() ((void)0)
+
+inline BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* woken) {
+  return xQueueSend(q, item, 0);
+}
+
+struct InputStats {
+  uint32_t events;
+  uint32_t lastLatUs;
+  uint32_t maxLatUs;
+  uint32_t bounces;
+  uint32_t dropped;
+};
+InputStats inputStats = {0, 0, 0, 0, 0};
+portMUX_TYPE inputStatsMux;
+
+#include "buttons.inc"
+
+// ===== TRACCE =====
+const uint8_t kPins[NUM_BUTTONS] = {BTN_UP, BTN_CENTER, BTN_DOWN};
+
+// Un fronte: il livello cambia, poi l'interrupt
+void edge(int b, bool pressed) {
+  pinLevel[kPins[b]] = pressed ? LOW : HIGH;
+  buttonISR((void*)(uintptr_t)b);
+}
+
+// Rimbalzi: n fronti a gap ms l'uno dall'altro, l'ultimo lascia pressed
+void bouncy(int b, bool pressed, int n, int gap) {
+  for (int i = n - 1; i >= 0; i--) {
+    edge(b, i % 2 ? !pressed : pressed);
+    if (i) delay(gap);
+  }
+}
+
+// ===== EVENTI CONSEGNATI =====
+struct Received {
+  ButtonEvent ev;
+  uint32_t us;  // Quando il "loop" l'ha ricevuto
+};
+
+std::mutex receivedMutex;
+std::vector<Received> received;
+
+void loopTask(void*) {
+  for (;;) {
+    ButtonEvent ev;
+    if (xQueueReceive(buttonEventQueue, &ev, portMAX_DELAY) != pdTRUE) continue;
+    std::lock_guard<std::mutex> lock(receivedMutex);
+    received.push_back({ev, (uint32_t)micros()});
+  }
+}
+
+// Eventi della traccia appena finita (dopo la quiete del debounce)
+std::vector<Received> take() {
+  delay(DEBOUNCE_MS * 3);
+  std::lock_guard<std::mutex> lock(receivedMutex);
+  std::vector<Received> out;
+  out.swap(received);
+  return out;
+}
+
+// "UP:P UP:R" e così via: l'ordine degli eventi in forma leggibile
+std::string describe(const std::vector<Received>& evs) {
+  const char* names[] = {"UP", "CENTER", "DOWN"};
+  const char* types[] = {"P", "R", "L", "T"};
+  std::string s;
+  for (const Received& r : evs) {
+    if (!s.empty()) s += ' ';
+    s += names[r.ev.button];
+    s += ':';
+    s += types[r.ev.type];
+    if (r.ev.type == BTN_RELEASE && r.ev.wasLong) s += '*';
+  }
+  return s;
+}
+
+// Latenza primo fronte -> evento al loop, solo per PRESS e RELEASE
+uint32_t latMaxUs = 0;
+uint64_t latSumUs = 0;
+int latCount = 0;
+
+void addLatency(const std::vector<Received>& evs) {
+  for (const Received& r : evs) {
+    if (r.ev.type != BTN_PRESS && r.ev.type != BTN_RELEASE) continue;
+    uint32_t lat = r.us - r.ev.edgeUs;
+    latMaxUs = max(latMaxUs, lat);
+    latSumUs += lat;
+    latCount++;
+  }
+}
+
+bool expect(const char* name, const std::vector<Received>& evs, const char* want) {
+  std::string got = describe(evs);
+  if (got == want) return true;
+  fprintf(stderr, "%s: \"%s\" invece di \"%s\"\n", name, got.c_str(), want);
+  return false;
+}
+
+// ===== TEST =====
+void checkClean() {
+  edge(BUTTON_CENTER, true);
+  delay(120);
+  edge(BUTTON_CENTER, false);
+  std::vector<Received> evs = take();
+  CHECK(expect("pulita", evs, "CENTER:P CENTER:R"));
+  addLatency(evs);
+}
+
+void checkBounces() {
+  uint32_t before = inputStats.bounces;
+  bouncy(BUTTON_DOWN, true, 7, 2);
+  delay(150);
+  bouncy(BUTTON_DOWN, false, 5, 3);
+  std::vector<Received> evs = take();
+  CHECK(expect("rimbalzi", evs, "DOWN:P DOWN:R"));
+  CHECK(inputStats.bounces - before == 6 + 4);
+  addLatency(evs);
+  // Il press riporta il primo fronte, non l'ultimo rimbalzo
+  if (evs.size() == 2) CHECK(evs[0].us - evs[0].ev.edgeUs >= (6 * 2 + DEBOUNCE_MS) * 1000);
+}
+
+// Impulsi più corti del debounce, anche ripetuti: nessun evento
+void checkGlitches() {
+  uint32_t before = inputStats.bounces;
+  for (int i = 0; i < 5; i++) {
+    edge(BUTTON_UP, true);
+    delay(3);
+    edge(BUTTON_UP, false);
+    delay(DEBOUNCE_MS * 2);
+  }
+  // Con il pulsante tenuto: un rilascio spurio non lo rilascia
+  edge(BUTTON_UP, true);
+  delay(80);
+  edge(BUTTON_UP, false);
+  delay(2);
+  edge(BUTTON_UP, true);
+  delay(80);
+  edge(BUTTON_UP, false);
+  std::vector<Received> evs = take();
+  CHECK(expect("glitch", evs, "UP:P UP:R"));
+  CHECK(inputStats.bounces - before >= 5 + 1);
+  addLatency(evs);
+}
+
+// UP tenuto 3,4 s (long a 1,5 s, ripetizione a 3 s) mentre CENTER è
+// tenuto 2,3 s (long a 2 s, nessuna ripetizione)
+void checkLong() {
+  edge(BUTTON_UP, true);
+  delay(200);
+  edge(BUTTON_CENTER, true);
+  delay(2300);
+  edge(BUTTON_CENTER, false);
+  delay(900);
+  edge(BUTTON_UP, false);
+  std::vector<Received> evs = take();
+  CHECK(expect("long", evs, "UP:P CENTER:P UP:L CENTER:L CENTER:R* UP:T UP:R*"));
+  if (evs.size() != 7) return;
+  CHECK(evs[1].ev.heldMask == 0x3);
+  CHECK(evs[4].ev.heldMask == 0x1);
+  // Long e ripetizione entro pochi ms dalla scadenza
+  uint32_t press = evs[0].ev.edgeUs;
+  long longMs = (long)(evs[2].ev.edgeUs - press) / 1000;
+  long repeatMs = (long)(evs[5].ev.edgeUs - press) / 1000;
+  CHECK(longMs >= LONG_PRESS_MS && longMs < LONG_PRESS_MS + DEBOUNCE_MS + 30);
+  CHECK(repeatMs >= 2 * LONG_PRESS_MS && repeatMs < 2 * LONG_PRESS_MS + DEBOUNCE_MS + 30);
+}
+
+// Pressioni rapide con rimbalzi, alternate su due pulsanti: nessuna persa
+#define BURST_PRESSES 20
+void checkBurst() {
+  for (int i = 0; i < BURST_PRESSES; i++) {
+    int b = i % 2 ? BUTTON_DOWN : BUTTON_UP;
+    bouncy(b, true, 3, 1);
+    delay(DEBOUNCE_MS + 30);
+    bouncy(b, false, 3, 1);
+    delay(DEBOUNCE_MS + 30);
+  }
+  std::vector<Received> evs = take();
+  std::map<int, int> presses, releases;
+  for (const Received& r : evs) {
+    if (r.ev.type == BTN_PRESS) presses[r.ev.button]++;
+    if (r.ev.type == BTN_RELEASE) releases[r.ev.button]++;
+  }
+  int missed = BURST_PRESSES - presses[BUTTON_UP] - presses[BUTTON_DOWN];
+  printf("pulsanti: %d pressioni rapide, %d perse, %d eventi\n", BURST_PRESSES, missed,
+         (int)evs.size());
+  CHECK(missed == 0);
+  CHECK(evs.size() == 2 * BURST_PRESSES);
+  CHECK(releases[BUTTON_UP] == BURST_PRESSES / 2 && releases[BUTTON_DOWN] == BURST_PRESSES / 2);
+  addLatency(evs);
+}
+
+int main() {
+  for (int i = 0; i < 40; i++) pinLevel[i] = HIGH;
+  buttonsInit();
+  xTaskCreatePinnedToCore(loopTask, "Loop", 4096, NULL, 1, NULL, 1);
+
+  checkClean();
+  checkBounces();
+  checkGlitches();
+  checkLong();
+  checkBurst();
+
+  CHECK(inputStats.dropped == 0);
+  printf("  latenza primo fronte -> loop: %.1f ms media, %.1f ms max (debounce %d ms), "
+         "%u rimbalzi scartati\n",
+         latSumUs / 1000.0 / max(1, latCount), latMaxUs / 1000.0, DEBOUNCE_MS,
+         inputStats.bounces);
+  // Debounce più i rimbalzi della traccia (al più 6 x 3 ms), con margine
+  CHECK(latMaxUs < (DEBOUNCE_MS + 18 + 20) * 1000);
+  return hostResult("test_buttons");
+}
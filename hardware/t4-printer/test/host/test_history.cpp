@@ -0,0 +1,118 @@
+// Print history: set delle schede stampate letto da più task.
+//
+// Un task (come il polling dopo una stampa) aggiunge schede di anni nuovi,
+// quindi printedAdd alloca i bitset e cambia i bit, mentre altri task (UI,
+// autoPrint, batch) chiedono isAlreadyPrinted sugli stessi numeri. Sotto
+// ThreadSanitizer nessun accesso deve restare scoperto; ogni scheda
+// aggiunta resta vista come stampata da lì in poi.
+// Poi il costo di isAlreadyPrinted (mutex compreso) con 200 e con 100.000
+// schede nel set: un bit per numero, quindi lo stesso tempo.
+
+#include "host.h"
+#include "fake_fs.h"
+
+#include <chrono>
+#include <random>
+
+bool sdOK = false;  // Solo flash: niente task storage
+bool flashOK = true;
+metrics::Histogram mSdOp;
+FakeFs LittleFS;
+namespace fs {
+using FS = FakeFs;
+}
+
+#include "scheda.h"
+#define MAX_SCHEDE 50
+#include "snapshot.inc"
+#include "storage.inc"
+#include "numero.inc"
+
+TaskHandle_t jobDirTaskHandle = NULL;
+#define JOBDIR_HISTORY 0x04
+void syncUpdateSeen() {}
+
+#include "history_vars.inc"
+#include "history.inc"
+
+#define READERS 3
+#define ADDED 20000    // Schede aggiunte durante la lettura (due anni)
+#define FIRST_ID 300000
+#define BENCH_LOOKUPS 200000
+
+std::atomic<int> addedUpTo(FIRST_ID - 1);  // Ultimo id di cui addToHistory è tornata
+
+// Lettori: un numero già aggiunto non torna mai "da stampare"
+void reader(int t, std::atomic<int>* wrong) {
+  std::mt19937 rng(t);
+  while (addedUpTo < FIRST_ID + ADDED - 1) {
+    int done = addedUpTo;
+    int id = FIRST_ID + (int)(rng() % ADDED);
+    char numero[12];
+    unpackNumero(id, numero, sizeof(numero));
+    bool printed = isAlreadyPrinted(numero);
+    if (id <= done && !printed) (*wrong)++;
+  }
+}
+
+void checkConcurrent() {
+  std::atomic<int> wrong(0);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < READERS; t++) readers.emplace_back(reader, t, &wrong);
+  for (int id = FIRST_ID; id < FIRST_ID + ADDED; id++) {
+    char numero[12];
+    unpackNumero(id, numero, sizeof(numero));
+    addToHistory(numero);
+    addedUpTo = id;
+  }
+  for (std::thread& r : readers) r.join();
+  CHECK(wrong == 0);
+  CHECK(historyCount == ADDED);
+  CHECK(printedRecentAt(0) == FIRST_ID + ADDED - 1);
+}
+
+// Set con n schede (dal 2010 in su), senza passare dal journal
+void fillSet(int n) {
+  xSemaphoreTake(historyMutex, portMAX_DELAY);
+  printedClear();
+  for (int i = 0; i < n; i++) printedAdd(100000 + i);
+  xSemaphoreGive(historyMutex);
+}
+
+// Microsecondi per isAlreadyPrinted: metà presenti, metà no
+double lookupUs(int n) {
+  static char numeri[1024][12];
+  std::mt19937 rng(n);
+  for (int i = 0; i < 1024; i++) {
+    int id = i % 2 ? 100000 + (int)(rng() % n) : 100000 + n + (int)(rng() % 50000);
+    unpackNumero(id, numeri[i], sizeof(numeri[i]));
+  }
+  int found = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_LOOKUPS; i++) found += isAlreadyPrinted(numeri[i & 1023]);
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  CHECK(found == BENCH_LOOKUPS / 2);
+  return us / BENCH_LOOKUPS;
+}
+
+void bench() {
+  const int sizes[] = {200, 100000};
+  double us[2];
+  for (int k = 0; k < 2; k++) {
+    fillSet(sizes[k]);
+    CHECK(historyCount == sizes[k]);
+    lookupUs(sizes[k]);  // Riscaldamento
+    us[k] = lookupUs(sizes[k]);
+    printf("history: %6d schede, %5d byte di bitset, isAlreadyPrinted %.3f us su PC\n", sizes[k],
+           printedBytes(), us[k]);
+  }
+  // Un bit per numero: il set grande costa come quello piccolo
+  CHECK(us[1] < us[0] * 3 + 0.05);
+}
+
+int main() {
+  loadPrintHistory();  // Crea historyMutex, journal vuoto
+  checkConcurrent();
+  bench();
+  return hostResult("test_history");
+}
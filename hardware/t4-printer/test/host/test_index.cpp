@@ -0,0 +1,206 @@
+// Indice schede su SD (/riparazioni.idx): ricostruzione, limiti, ricerca.
+//
+// jobDirBuild, jobIdxFindSd e CsvCursor (codice vero di src/main.cpp)
+// girano sulla SD finta con CSV sintetici:
+// - una scheda oltre JOB_DIR_MAX, nell'ultimo blocco letto: indice
+//   parziale, non va scritto su SD come se descrivesse tutto il CSV;
+// - JOB_DIR_MAX schede: indice scritto, poi righe aggiunte in coda
+//   (aggiornamento incrementale) e ogni numero ritrovato sul file;
+// - benchmark con 100.000 righe: ricerca binaria sull'indice contro la
+//   scansione del CSV (la via senza indice). Sul PC il tempo conta poco:
+//   il confronto vero sono letture e byte letti dalla SD per ricerca;
+// - ricerca per cliente con 10.000 schede: ogni lettera digitata è una
+//   jobDirSearch, confrontata con il conteggio su tutte le chiavi.
+
+#include "index_env.h"
+
+#include <chrono>
+
+#define BENCH_ROWS 100000
+#define BENCH_LOOKUPS 2000
+#define BENCH_SCANS 3
+#define SEARCH_JOBS 10000
+#define SEARCH_QUERIES 2000
+#define SEARCH_CHECKED 200   // Query confrontate con il conteggio lineare
+#define SEARCH_MAX_US 10000  // Obiettivo per tasto
+
+// Ogni numero del CSV ritrovato su /riparazioni.idx con la sua riga
+void checkAllFound(const SynthCsv& csv) {
+  int bad = 0;
+  for (size_t i = 0; i < csv.ids.size(); i++) {
+    JobDirEntry e;
+    Scheda s;
+    char numero[12];
+    unpackNumero(csv.ids[i], numero, sizeof(numero));
+    bool ok = jobIdxFindSd(csv.ids[i], e) && e.offset == csv.offsets[i] && e.len == csv.lens[i] &&
+              jobDirLoad(e, s) && strcmp(s.numero, numero) == 0;
+    if (!ok && bad++ < 5) fprintf(stderr, "%s non trovata sull'indice\n", numero);
+  }
+  CHECK(bad == 0);
+  JobDirEntry e;
+  CHECK(!jobIdxFindSd(csv.ids.back() + 1, e));
+  CHECK(!jobIdxFindSd(csv.ids.front() - 1, e));
+}
+
+void checkLimit() {
+  // La scheda in più è nell'ultimo blocco da 512 byte: il lettore arriva a
+  // fine file anche se il ciclo si ferma prima
+  SynthCsv csv = csvBuild(200001, JOB_DIR_MAX + 1);
+  SD.files[CSV_PATH] = csv.text;
+  jobDirBuild();
+  CHECK(jobDir.count == JOB_DIR_MAX);
+  CHECK(!SD.exists(JOB_IDX_PATH));
+  CHECK(jobIdxFull == 0);
+}
+
+void checkBuild() {
+  SynthCsv csv = csvBuild(200001, JOB_DIR_MAX);
+  size_t cut = csv.offsets[JOB_DIR_MAX - 100];
+  SD.files[CSV_PATH] = csv.text.substr(0, cut);
+  jobDirBuild();
+  CHECK(jobDir.count == JOB_DIR_MAX - 100);
+  CHECK(jobIdxFull == 1);
+
+  // Sincronizzazione con 100 schede nuove in fondo: solo quelle
+  SD.files[CSV_PATH] = csv.text;
+  jobDirBuild();
+  CHECK(jobDir.count == JOB_DIR_MAX);
+  CHECK(jobIdxIncremental == 1);
+  CHECK(jobIdxFull == 1);
+  checkAllFound(csv);
+}
+
+void bench() {
+  using clock = std::chrono::steady_clock;
+  SynthCsv csv = csvBuild(160001, BENCH_ROWS);
+  SD.files.clear();
+  SD.dirs.clear();
+  SD.files[CSV_PATH] = csv.text;
+
+  // L'indice in PSRAM si ferma a JOB_DIR_MAX; il file su SD no: lo si
+  // scrive direttamente per misurare la ricerca a 100.000 record
+  std::vector<JobDirEntry> entries(csv.ids.size());
+  for (size_t i = 0; i < csv.ids.size(); i++) {
+    JobDirEntry& e = entries[i];
+    memset(&e, 0, sizeof(e));
+    e.id = csv.ids[i];
+    e.offset = csv.offsets[i];
+    e.len = csv.lens[i];
+  }
+  CHECK(jobIdxWrite(entries.data(), entries.size(), csv.text.size(),
+                    crc32_le(0, (const uint8_t*)csv.text.data(), csv.text.size())));
+
+  std::mt19937 rng(7);
+  unsigned long reads0 = SD.reads, bytes0 = SD.readBytes, seeks0 = SD.seeks;
+  auto t0 = clock::now();
+  int found = 0;
+  for (int i = 0; i < BENCH_LOOKUPS; i++) {
+    int id = csv.ids[rng() % csv.ids.size()];
+    JobDirEntry e;
+    Scheda s;
+    if (jobIdxFindSd(id, e) && jobDirLoad(e, s) && packNumero(s.numero) == id) found++;
+  }
+  double idxUs = std::chrono::duration<double, std::micro>(clock::now() - t0).count() / BENCH_LOOKUPS;
+  CHECK(found == BENCH_LOOKUPS);
+  double idxReads = (double)(SD.reads - reads0) / BENCH_LOOKUPS;
+  double idxBytes = (double)(SD.readBytes - bytes0) / BENCH_LOOKUPS;
+  double idxSeeks = (double)(SD.seeks - seeks0) / BENCH_LOOKUPS;
+
+  // Senza indice: CsvCursor dall'inizio del file, numeri a metà e in fondo
+  reads0 = SD.reads;
+  bytes0 = SD.readBytes;
+  t0 = clock::now();
+  found = 0;
+  for (int i = 0; i < BENCH_SCANS; i++) {
+    CsvCursor cur;
+    CHECK(cur.open());
+    char numero[12];
+    unpackNumero(csv.ids[(i + 1) * (BENCH_ROWS - 1) / BENCH_SCANS], numero, sizeof(numero));
+    Scheda s;
+    if (cur.find(numero, s) && strcmp(s.numero, numero) == 0) found++;
+    cur.close();
+  }
+  double scanUs = std::chrono::duration<double, std::micro>(clock::now() - t0).count() / BENCH_SCANS;
+  CHECK(found == BENCH_SCANS);
+  double scanReads = (double)(SD.reads - reads0) / BENCH_SCANS;
+  double scanBytes = (double)(SD.readBytes - bytes0) / BENCH_SCANS;
+
+  printf("indice: %d righe, CSV %zu KB, indice %zu KB\n", BENCH_ROWS, csv.text.size() / 1024,
+         SD.files[JOB_IDX_PATH].size() / 1024);
+  printf("  ricerca su indice: %.1f letture, %.1f seek, %.0f byte, %.1f us su PC\n", idxReads,
+         idxSeeks, idxBytes, idxUs);
+  printf("  scansione CSV:     %.0f letture, %.0f KB, %.0f us su PC\n", scanReads,
+         scanBytes / 1024, scanUs);
+}
+
+// Voci con chiave che inizia per prefix, contate una per una
+int searchCountLinear(const char* prefix) {
+  int n = 0;
+  size_t plen = strlen(prefix);
+  for (int i = 0; i < jobDir.count; i++) {
+    if (strncmp(jobDir.entries[i].key, prefix, plen) == 0) n++;
+  }
+  return n;
+}
+
+void benchSearch() {
+  using clock = std::chrono::steady_clock;
+  SD.files.clear();
+  SD.dirs.clear();
+  SynthCsv csv = csvBuild(220001, SEARCH_JOBS, 2500);
+  SD.files[CSV_PATH] = csv.text;
+  auto t0 = clock::now();
+  jobDirBuild();
+  double buildMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+  CHECK(jobDir.count == SEARCH_JOBS);
+
+  // Query digitate lettera per lettera: il cliente di una scheda a caso
+  std::mt19937 rng(3);
+  int keystrokes = 0, bad = 0;
+  double totUs = 0, maxUs = 0;
+  xSemaphoreTake(jobDirMutex, portMAX_DELAY);
+  for (int q = 0; q < SEARCH_QUERIES; q++) {
+    const char* key = jobDir.entries[rng() % jobDir.count].key;
+    char typed[JOB_KEY_LEN + 1];
+    for (size_t n = 1; n <= strlen(key); n++) {
+      memcpy(typed, key, n);
+      typed[n] = '\0';
+      int lo;
+      auto k0 = clock::now();
+      int found = jobDirSearch(typed, lo);
+      double us = std::chrono::duration<double, std::micro>(clock::now() - k0).count();
+      totUs += us;
+      maxUs = max(maxUs, us);
+      keystrokes++;
+      if (found < 1) bad++;
+      if (q < SEARCH_CHECKED && found != searchCountLinear(typed)) bad++;
+      for (int i = 0; i < found && i < 3; i++) {
+        if (strncmp(jobDir.entries[jobDir.byName[lo + i]].key, typed, n) != 0) bad++;
+      }
+    }
+  }
+  xSemaphoreGive(jobDirMutex);
+  CHECK(bad == 0);
+  CHECK(maxUs < SEARCH_MAX_US);
+
+  int steps = 0;
+  while ((1 << steps) <= SEARCH_JOBS) steps++;
+  printf("ricerca cliente: %d schede (indice in %.0f ms su PC), %d tasti\n", SEARCH_JOBS, buildMs,
+         keystrokes);
+  printf("  per tasto: %.2f us medi, %.1f us max su PC; 2 ricerche binarie da %d passi\n",
+         totUs / keystrokes, maxUs, steps);
+}
+
+int main() {
+  SD.files.clear();
+  storageInit();
+  jobDirMutex = xSemaphoreCreateMutex();
+
+  checkLimit();
+  SD.files.clear();
+  SD.dirs.clear();
+  checkBuild();
+  bench();
+  benchSearch();
+  return hostResult("test_index");
+}
@@ -0,0 +1,244 @@
+// Etichetta: testo in buffer fissi, nessuna allocazione per etichetta.
+//
+// malloc/calloc/realloc passano da --wrap del linker, new/delete sono
+// sostituiti qui: tutti contano mentre counting è attivo. Render e invio
+// di ogni etichetta delle schede di prova devono contare zero.
+// Poi i bordi UTF-8: troncamenti al limite di un buffer o di una riga non
+// lasciano mai un carattere multibyte a metà. Infine ogni etichetta delle
+// schede di prova, byte per byte, contro quella della v1.6.9.
+
+#include "label_env.h"
+#include "golden_v169.h"
+
+#include <new>
+
+// ===== CONTEGGIO ALLOCAZIONI =====
+extern "C" void* __real_malloc(size_t n);
+extern "C" void* __real_calloc(size_t n, size_t size);
+extern "C" void* __real_realloc(void* p, size_t n);
+
+bool counting = false;
+long allocs = 0;
+
+extern "C" void* __wrap_malloc(size_t n) {
+  if (counting) allocs++;
+  return __real_malloc(n);
+}
+
+extern "C" void* __wrap_calloc(size_t n, size_t size) {
+  if (counting) allocs++;
+  return __real_calloc(n, size);
+}
+
+extern "C" void* __wrap_realloc(void* p, size_t n) {
+  if (counting) allocs++;
+  return __real_realloc(p, n);
+}
+
+void* operator new(size_t n) {
+  if (counting) allocs++;
+  void* p = __real_malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// ===== UTF-8 =====
+bool utf8Valid(const uint8_t* s, size_t n) {
+  for (size_t i = 0; i < n;) {
+    uint8_t c = s[i];
+    int more = c < 0x80 ? 0 : (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : (c & 0xF8) == 0xF0 ? 3 : -1;
+    if (more < 0 || i + more >= n) return false;
+    for (int k = 1; k <= more; k++) {
+      if ((s[i + k] & 0xC0) != 0x80) return false;
+    }
+    i += more + 1;
+  }
+  return true;
+}
+
+bool utf8Valid(const char* s) { return utf8Valid((const uint8_t*)s, strlen(s)); }
+
+// Riga del cliente nello stream: dopo il numero, fino a \r\n
+std::string clienteLine(const LabelStream& l) {
+  constexpr auto& dopo = Etichetta50x30::dopoNumero;
+  const uint8_t* end = l.bytes + l.len;
+  const uint8_t* p = std::search(l.bytes, end, dopo.data, dopo.data + dopo.size);
+  if (p == end) return "";
+  p += dopo.size;
+  const uint8_t crlf[] = {'\r', '\n'};
+  const uint8_t* q = std::search(p, end, crlf, crlf + 2);
+  return std::string((const char*)p, q - p);
+}
+
+// ===== TEST =====
+LabelStream label;  // Come in printEtichetta, ma fuori dallo stack del test
+
+void checkNoAlloc() {
+  std::vector<Scheda> schede = schedeProva();
+
+  // Il conteggio funziona: new (std::string lunga) e malloc
+  counting = true;
+  { std::string probe(100, 'x'); }
+  void* volatile probe = malloc(16);  // volatile: la coppia malloc/free non sparisce
+  free(probe);
+  counting = false;
+  CHECK(allocs == 2);
+
+  int labels = 0;
+  allocs = 0;
+  counting = true;
+  for (const Scheda& s : schede) {
+    int tot = max(1, s.numAttrezzi);
+    for (int i = 0; i < tot; i++) {
+      renderEtichetta(label, s, i, tot);
+      labels++;
+    }
+    char data[12];
+    formatDate(s.data, data, sizeof(data));
+  }
+  counting = false;
+  printf("etichette: %d renderizzate, %ld allocazioni\n", labels, allocs);
+  CHECK(allocs == 0);
+
+  // Invio alla stampante (con le pause del formato: qualche centinaio di ms)
+  renderEtichetta(label, schede[1], 1, schede[1].numAttrezzi);
+  printerSerial.clear();
+  allocs = 0;
+  counting = true;
+  markPrintTrigger(false);
+  replayLabel(label, false);
+  counting = false;
+  CHECK(allocs == 0);
+  CHECK(printerSerial.len == label.len);
+  CHECK(memcmp(printerSerial.bytes, label.bytes, label.len) == 0);
+  CHECK(printerSerial.flushes == (unsigned long)label.numPauses + 1);
+}
+
+// Limite del buffer dentro caratteri di 1, 2, 3 e 4 byte
+void checkAppendEdges() {
+  const char* src = "aÈ€\xF0\x9F\x98\x80" "bÈ€\xF0\x9F\x98\x80";
+  for (size_t cap = 1; cap <= strlen(src) + 2; cap++) {
+    char dst[32] = "";
+    appendStr(dst, cap, src);
+    CHECK(strlen(dst) < cap);
+    CHECK(strncmp(dst, src, strlen(dst)) == 0);
+    CHECK(utf8Valid(dst));
+    // Il troncamento toglie solo il carattere che non ci sta
+    CHECK(strlen(dst) + 4 >= min(cap - 1, strlen(src)));
+  }
+
+  // Accodato a un buffer già pieno a metà
+  for (size_t cap = 4; cap <= 12; cap++) {
+    char dst[16] = "ab";
+    appendStr(dst, cap, "ÈÈÈÈÈ");
+    CHECK(strlen(dst) < cap);
+    CHECK(utf8Valid(dst));
+  }
+}
+
+void checkTruncEdges() {
+  char dst[4 * 32 + 1];
+  std::string e40;
+  for (int i = 0; i < 40; i++) e40 += "È";
+
+  // Oltre il limite: maxChars - 1 caratteri e il punto
+  for (int maxChars = 2; maxChars <= 32; maxChars++) {
+    dst[0] = '\0';
+    appendTrunc(dst, sizeof(dst), e40.c_str(), maxChars);
+    CHECK(utf8Valid(dst));
+    CHECK(utf8Len(dst) == maxChars);
+    CHECK(dst[strlen(dst) - 1] == '.');
+  }
+
+  // Esattamente al limite: invariato
+  std::string e32 = e40.substr(0, 2 * 32);
+  dst[0] = '\0';
+  appendTrunc(dst, sizeof(dst), e32.c_str(), 32);
+  CHECK(e32 == dst);
+
+  // Caratteri da 4 byte con il buffer della riga che finisce prima
+  std::string emoji;
+  for (int i = 0; i < 40; i++) emoji += "\xF0\x9F\x98\x80";
+  char small[4 * 5 + 2];
+  small[0] = '\0';
+  appendTrunc(small, sizeof(small), emoji.c_str(), 32);
+  CHECK(utf8Valid(small));
+  CHECK(strlen(small) < sizeof(small));
+
+  CHECK(utf8Prefix("ÈÈ", 5) == 4);
+  CHECK(utf8Prefix("aÈb", 2) == 3);
+}
+
+// Righe dell'etichetta: cliente entro 32 caratteri, con e senza DDT
+void checkLabelLines() {
+  std::string e15;
+  for (int i = 0; i < 15; i++) e15 += "È";
+  Scheda s = schedaBase("26/0030", "2026-03-01", (e15 + "A").c_str(), "", "", false);
+  renderEtichetta(label, s, 0, 1);
+  std::string riga = clienteLine(label);
+  CHECK(riga == e15 + "A");
+
+  s.ddt = true;
+  renderEtichetta(label, s, 0, 1);
+  riga = clienteLine(label);
+  CHECK(utf8Valid(riga.c_str()));
+  CHECK(utf8Len(riga.c_str()) == 22);  // 15 + "A" entro 26, poi " - DDT"
+
+  // 27 caratteri in 31 byte: con DDT il taglio a 25 cade tra due "È"
+  s = schedaBase("26/0031", "2026-03-01", "COSTRUZIONI TAGLIAMENTO ÈÈÈÈ", "", "", true);
+  renderEtichetta(label, s, 0, 1);
+  riga = clienteLine(label);
+  CHECK(riga == "COSTRUZIONI TAGLIAMENTO È. - DDT");
+  CHECK(utf8Len(riga.c_str()) == Etichetta50x30::maxLine);
+
+  for (const Scheda& p : schedeProva()) {
+    int tot = max(1, p.numAttrezzi);
+    for (int i = 0; i < tot; i++) {
+      renderEtichetta(label, p, i, tot);
+      CHECK(utf8Valid(label.bytes, label.len));
+      CHECK(label.len < LABEL_MAX_BYTES);
+      riga = clienteLine(label);
+      CHECK(utf8Len(riga.c_str()) <= Etichetta50x30::maxLine);
+    }
+  }
+}
+
+// Stessi byte della v1.6.9: le pause diventano flush + delay, non byte
+void checkGolden() {
+  std::vector<Scheda> schede = schedeProva();
+  int checked = 0;
+  for (const GoldenLabel& g : kGolden) {
+    const Scheda* s = NULL;
+    for (const Scheda& p : schede) {
+      if (strcmp(p.numero, g.numero) == 0) s = &p;
+    }
+    CHECK(s != NULL);
+    if (!s) continue;
+    renderEtichetta(label, *s, g.idx, g.tot);
+    size_t n = 0;
+    while (n < label.len && n < g.len && label.bytes[n] == g.bytes[n]) n++;
+    if (n != label.len || n != g.len) {
+      fprintf(stderr, "%s (%d/%d): diverso dal byte %zu (%u contro %zu byte)\n", g.numero,
+              g.idx + 1, g.tot, n, (unsigned)label.len, g.len);
+      CHECK(false);
+    }
+    checked++;
+  }
+  CHECK(checked == (int)(sizeof(kGolden) / sizeof(kGolden[0])));
+  printf("etichette v1.6.9: %d confrontate\n", checked);
+}
+
+int main() {
+  checkNoAlloc();
+  checkAppendEdges();
+  checkTruncEdges();
+  checkLabelLines();
+  checkGolden();
+  return hostResult("test_label");
+}
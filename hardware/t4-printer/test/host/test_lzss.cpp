@@ -0,0 +1,134 @@
+// LZSS (include/lzss.h): andata e ritorno, limiti, dati troncati.
+//
+// Oltre ai controlli riporta rapporto di compressione e tempi su un CSV
+// sintetico con la forma di /riparazioni.csv, o sul file passato come
+// argomento (un export vero del foglio):
+//   ./build/test_lzss riparazioni.csv
+
+#include "host.h"
+#include "lzss.h"
+
+#include <chrono>
+#include <random>
+
+lzss::Workspace workspace;
+
+// Blocco compresso e decompresso con il lettore a byte usato da CsvSource
+size_t roundTrip(const uint8_t* in, size_t n, size_t* zOut = NULL) {
+  static uint8_t z[lzss::kMaxOut + 16];
+  static uint8_t back[lzss::kBlock];
+  memset(z + lzss::kMaxOut, 0xA5, 16);
+  size_t zn = lzss::compress(in, n, z, workspace);
+  CHECK(zn <= lzss::kMaxOut);
+  for (int i = 0; i < 16; i++) CHECK(z[lzss::kMaxOut + i] == 0xA5);  // Nessuna scrittura oltre
+  if (zOut) *zOut = zn;
+
+  size_t pos = 0;
+  size_t got = lzss::decompress([&] { return pos < zn ? (int)z[pos++] : -1; }, back, n);
+  CHECK(got == n);
+  CHECK(memcmp(in, back, n) == 0);
+
+  // Troncato a ogni lunghezza: mai oltre il buffer, mai più byte del dovuto
+  if (n <= 300) {
+    for (size_t cut = 0; cut < zn; cut++) {
+      pos = 0;
+      size_t part = lzss::decompress([&] { return pos < cut ? (int)z[pos++] : -1; }, back, n);
+      CHECK(part < n || cut == zn);
+      CHECK(memcmp(in, back, part) == 0);
+    }
+  }
+  return got;
+}
+
+// Righe con la forma del foglio: numero, data, cliente, attrezzi, note
+std::string syntheticCsv(size_t rows) {
+  static const char* const kClienti[] = {"ROSSI MARIO", "BIANCHI SRL", "EDILVENETA SNC",
+                                         "VERDI GIUSEPPE", "COSTRUZIONI DAL BEN"};
+  static const char* const kMarche[] = {"HILTI", "MAKITA", "BOSCH", "STIHL", "HUSQVARNA"};
+  std::mt19937 rng(42);
+  std::string csv = "Numero,Data consegna,Cliente,Indirizzo,Telefono,Marca,Dotazione,Note,DDT\n";
+  char line[256];
+  for (size_t i = 0; i < rows; i++) {
+    snprintf(line, sizeof(line), "%02d/%04d,%02d/%02d/20%02d,%s,VIA ROMA %u,04%08u,%s,%s,%s,%s\n",
+             22 + (int)(i / 2000), (int)(i % 2000) + 1, 1 + (int)(rng() % 28),
+             1 + (int)(rng() % 12), 22 + (int)(i / 2000), kClienti[rng() % 5],
+             (unsigned)(rng() % 200), (unsigned)(rng() % 100000000), kMarche[rng() % 5],
+             rng() % 2 ? "CAVO + VALIGETTA" : "", rng() % 3 ? "" : "NON PARTE, CONTROLLARE SPAZZOLE",
+             rng() % 4 ? "FALSE" : "TRUE");
+    csv += line;
+  }
+  return csv;
+}
+
+// Rapporto e tempi a blocchi, come CsvSource su SD
+void report(const char* name, const std::string& data) {
+  using clock = std::chrono::steady_clock;
+  size_t raw = data.size();
+  size_t zTot = 0;
+  double compressUs = 0, decompressUs = 0;
+  static uint8_t z[lzss::kMaxOut];
+  static uint8_t back[lzss::kBlock];
+
+  for (size_t off = 0; off < raw; off += lzss::kBlock) {
+    size_t n = std::min(lzss::kBlock, raw - off);
+    const uint8_t* in = (const uint8_t*)data.data() + off;
+    auto t0 = clock::now();
+    size_t zn = lzss::compress(in, n, z, workspace);
+    auto t1 = clock::now();
+    size_t pos = 0;
+    size_t got = lzss::decompress([&] { return pos < zn ? (int)z[pos++] : -1; }, back, n);
+    auto t2 = clock::now();
+    CHECK(got == n && memcmp(in, back, n) == 0);
+    zTot += std::min(zn, n);  // Blocchi che non si riducono restano in chiaro
+    compressUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+    decompressUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+  }
+  printf("lzss %s: %zu -> %zu byte (%.1f%%), compressione %.1f MB/s, decompressione %.1f MB/s\n",
+         name, raw, zTot, raw ? 100.0 * zTot / raw : 0.0, raw / compressUs, raw / decompressUs);
+}
+
+int main(int argc, char** argv) {
+  std::mt19937 rng(1);
+  static uint8_t buf[lzss::kBlock];
+
+  // Casi limite
+  roundTrip(buf, 0);
+  buf[0] = 'x';
+  roundTrip(buf, 1);
+  memset(buf, 'a', sizeof(buf));
+  size_t zn = 0;
+  roundTrip(buf, lzss::kBlock, &zn);
+  CHECK(zn < lzss::kBlock / 8);  // Ripetizioni: solo riferimenti lunghi
+
+  // Incomprimibile: tutto letterale, esattamente il caso peggiore
+  for (size_t i = 0; i < sizeof(buf); i++) buf[i] = rng();
+  roundTrip(buf, lzss::kBlock, &zn);
+  CHECK(zn <= lzss::kMaxOut);
+
+  // Periodi vicini alla distanza massima (4095) e lunghezze a caso
+  for (int period : {3, 17, 255, 256, 4094, 4095}) {
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = i % period ? (uint8_t)(i % period) : rng();
+    roundTrip(buf, lzss::kBlock);
+  }
+  std::string csv = syntheticCsv(6000);
+  for (int k = 0; k < 2000; k++) {
+    size_t n = rng() % (lzss::kBlock + 1);
+    size_t off = rng() % (csv.size() - n);
+    roundTrip((const uint8_t*)csv.data() + off, n);
+  }
+
+  report("CSV sintetico", csv);
+  if (argc > 1) {
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) {
+      fprintf(stderr, "non riesco ad aprire %s\n", argv[1]);
+      return 1;
+    }
+    std::string data;
+    char chunk[4096];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), f)) > 0;) data.append(chunk, n);
+    fclose(f);
+    report(argv[1], data);
+  }
+  return hostResult("test_lzss");
+}
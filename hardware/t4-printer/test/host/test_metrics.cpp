@@ -0,0 +1,93 @@
+// Metriche (include/metrics.h): bucket, percentili e registrazione da più task.
+//
+// Quattro thread registrano latenze e contatori insieme mentre un quinto
+// stampa come METRICS dalla console: nessun aggiornamento perso e, a
+// registrazioni ferme, i bucket tornano con count. Da eseguire anche sotto
+// ThreadSanitizer (make tsan).
+
+#include "host.h"
+
+#define WRITERS 4
+#define RECORDS 100000
+
+// Stampa su una stringa, con le overload di Print usate da metrics::print
+struct Out {
+  std::string text;
+  void print(const char* s) { text += s; }
+  void print(unsigned long v) { text += std::to_string(v); }
+  void print(long v) { text += std::to_string(v); }
+  void print(double v, int digits) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", digits, v);
+    text += buf;
+  }
+  void println() { text += "\n"; }
+  template <typename T>
+  void println(T v) {
+    print(v);
+    println();
+  }
+};
+
+int main() {
+  // Bucket: [2^b, 2^(b+1)), lo 0 e l'1 nel primo
+  CHECK(metrics::Histogram::bucketOf(0) == 0);
+  CHECK(metrics::Histogram::bucketOf(1) == 0);
+  CHECK(metrics::Histogram::bucketOf(2) == 1);
+  CHECK(metrics::Histogram::bucketOf(1023) == 9);
+  CHECK(metrics::Histogram::bucketOf(1024) == 10);
+  CHECK(metrics::Histogram::bucketOf(UINT32_MAX) == 31);
+
+  // Percentili: limite del bucket, mai oltre il massimo visto
+  metrics::Histogram h;
+  CHECK(h.percentile(50) == 0);
+  for (int i = 0; i < 90; i++) h.record(100);  // Bucket 6: [64, 128)
+  for (int i = 0; i < 10; i++) h.record(5000);
+  CHECK(h.percentile(50) == 127);
+  CHECK(h.percentile(90) == 127);
+  CHECK(h.percentile(99) == 5000);
+  CHECK(h.maxUs == 5000);
+
+  // Registrazione concorrente, con letture nel mezzo
+  metrics::Histogram lat;
+  metrics::Counter ops;
+  metrics::Gauge depth;
+  const metrics::Entry kAll[] = {{"lat", &lat}, {"ops", &ops}, {"depth", &depth}};
+  std::atomic<bool> stop(false);
+  long prints = 0;
+  std::thread reader([&] {
+    while (!stop) {
+      Out out;
+      metrics::print(out, kAll, 3);
+      CHECK(out.text.compare(0, 5, "lat: ") == 0);
+      prints++;
+    }
+  });
+  std::thread writers[WRITERS];
+  for (int t = 0; t < WRITERS; t++) {
+    writers[t] = std::thread([&, t] {
+      for (uint32_t i = 0; i < RECORDS; i++) {
+        lat.record(t == 0 ? 20000000 : i % 5000);
+        ops.add();
+        depth.set((int32_t)i - t);
+      }
+    });
+  }
+  for (int t = 0; t < WRITERS; t++) writers[t].join();
+  stop = true;
+  reader.join();
+
+  uint32_t total = 0;
+  for (int b = 0; b < metrics::kBuckets; b++) total += lat.buckets[b];
+  CHECK(lat.count == WRITERS * RECORDS);
+  CHECK(total == lat.count);
+  CHECK(ops.get() == WRITERS * RECORDS);
+  CHECK(lat.maxUs == 20000000);
+  CHECK(lat.percentile(100) == 20000000);
+
+  Out out;
+  metrics::print(out, kAll, 3);
+  printf("metrics: %d registrazioni, %ld stampe concorrenti\n%s", WRITERS * RECORDS, prints,
+         out.text.c_str());
+  return hostResult("test_metrics");
+}
@@ -0,0 +1,75 @@
+// Snapshot della lista schede: parse e letture concorrenti.
+//
+// Un thread fa da pollTask (schedeClaim, riempie, schedePublish) mentre due
+// thread fanno da loop/UI e scorrono la lista con SchedeRef. Ogni lista
+// pubblicata è coerente (tutte le voci della stessa generazione, quante
+// dice count): un lettore non deve mai vederne una a metà. Da eseguire
+// anche sotto ThreadSanitizer (make tsan).
+
+#include "host.h"
+
+#define MAX_SCHEDE 50
+struct Scheda {
+  char numero[12];
+  int parse;  // Parse che ha scritto la voce
+};
+
+#include "snapshot.inc"
+
+#define PARSES 20000
+#define READERS 2
+
+std::atomic<bool> stop(false);
+
+// Lettore: conta le liste incoerenti
+long reader() {
+  long bad = 0;
+  long seen = 0;
+  uint32_t lastGen = 0;
+  while (!stop) {
+    SchedeRef schede;
+    if (schede.gen() < lastGen) bad++;  // Mai una lista più vecchia della precedente
+    lastGen = schede.gen();
+    if (schede.count() == 0) continue;
+    int p = schede[0].parse;
+    if (schede.count() != p % MAX_SCHEDE + 1) bad++;
+    for (int i = 0; i < schede.count(); i++) {
+      if (schede[i].parse != p || atoi(schede[i].numero) != p) bad++;
+    }
+    seen++;
+  }
+  return seen > 0 ? bad : -1;
+}
+
+int main() {
+  schedeInit();
+
+  long bad[READERS];
+  std::thread readers[READERS];
+  for (int r = 0; r < READERS; r++) readers[r] = std::thread([&bad, r] { bad[r] = reader(); });
+
+  for (int p = 1; p <= PARSES; p++) {
+    SchedeSnapshot* snap = schedeClaim();
+    CHECK(snap != NULL);
+    int n = p % MAX_SCHEDE + 1;
+    for (int i = 0; i < n; i++) {
+      snap->items[i].parse = p;
+      snprintf(snap->items[i].numero, sizeof(snap->items[i].numero), "%d", p);
+    }
+    snap->count = n;
+    schedePublish(snap);
+  }
+  stop = true;
+  for (int r = 0; r < READERS; r++) {
+    readers[r].join();
+    CHECK(bad[r] == 0);
+  }
+
+  // A lettori fermi: un buffer pubblicato (ref della lista) e uno libero
+  SchedeRef last;
+  CHECK(last.gen() == PARSES);
+  CHECK(last.snap->refs == 2);
+
+  printf("snapshot: %d parse, %u attese di un buffer libero\n", PARSES, schedeClaimWaits);
+  return hostResult("test_snapshot");
+}
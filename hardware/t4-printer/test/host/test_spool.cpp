@@ -0,0 +1,207 @@
+// Spool di stampa: calo di corrente a ogni punto di scrittura.
+//
+// Una sessione di stampa (con un job rimasto a metà dal giro prima) gira
+// sul codice vero di src/main.cpp con la SD finta. Per ogni unità di
+// scrittura la corrente manca lì; al riavvio lo spool deve restituire
+// esattamente i job aperti, con le etichette confermate segnate e al più
+// l'ultima in volo da ristampare. Lo stesso vale se la corrente manca di
+// nuovo durante la ripresa (riscrittura del log).
+
+#include "host.h"
+#include "fake_fs.h"
+
+bool sdOK = true;
+metrics::Histogram mSdOp;
+
+#include "storage.inc"
+#include "spool.inc"
+
+#include <map>
+#include <set>
+
+// Cosa è sicuramente su SD secondo chi ha chiamato lo spool
+struct ModelJob {
+  bool done = false;
+  uint8_t labels = 0;  // Etichette confermate
+};
+
+struct Model {
+  std::map<uint32_t, ModelJob> jobs;
+  // Operazione interrotta dal calo: il suo record può esserci o no
+  char inflight = 0;  // 'J', 'L', 'D' o 0
+  uint32_t inflightSeq = 0;
+  int inflightLabel = -1;
+};
+
+// Spegnimento: la RAM si perde, la SD resta com'è
+void powerOff() {
+  spoolFile.close();
+  spoolMutex = NULL;
+  spoolNextSeq = 1;
+}
+
+// Avvio: come setup() + spoolResume(), senza ristampare
+int boot(SpoolJob* open) {
+  spoolInit();
+  xSemaphoreTake(spoolMutex, portMAX_DELAY);
+  int n = spoolScan(open, SPOOL_MAX_OPEN);
+  spoolRewrite(open, n);
+  xSemaphoreGive(spoolMutex);
+  return n;
+}
+
+// Un'operazione dello spool; false se durante la chiamata è mancata la corrente
+template <typename F>
+bool step(Model& m, char kind, uint32_t seq, int label, F op) {
+  if (SD.cut) return false;
+  op();
+  if (!SD.cut) return true;
+  m.inflight = kind;
+  m.inflightSeq = seq;
+  m.inflightLabel = label;
+  return false;
+}
+
+// Sessione: job 99 lasciato a metà (etichetta 0 fatta) dal giro prima,
+// poi tre job multi-etichetta che si accavallano e uno scartato
+void session(Model& m, uint32_t seq99) {
+  static SpoolJob open[SPOOL_MAX_OPEN];
+  if (!step(m, 'B', 0, -1, [&] { boot(open); })) return;
+
+  // Il modello si aggiorna solo se il record è arrivato intero
+  auto begin = [&](const char* numero, uint8_t pause, uint32_t& seq) {
+    seq = spoolNextSeq;
+    if (!step(m, 'J', seq, -1, [&] { spoolBegin(numero, pause); })) return false;
+    m.jobs[seq];
+    return true;
+  };
+  auto label = [&](uint32_t seq, int idx) {
+    if (!step(m, 'L', seq, idx, [&] { spoolLabel(seq, idx); })) return false;
+    m.jobs[seq].labels |= 1 << idx;
+    return true;
+  };
+  auto done = [&](uint32_t seq) {
+    if (!step(m, 'D', seq, -1, [&] { spoolDone(seq); })) return false;
+    m.jobs[seq].done = true;
+    return true;
+  };
+
+  uint32_t a = 0, b = 0, c = 0, d = 0;
+  if (!label(seq99, 1)) return;
+  if (!begin("26/0001", 8, a)) return;
+  if (!begin("26/0002", 8, b)) return;
+  if (!label(seq99, 2) || !done(seq99)) return;
+  if (!label(a, 0) || !label(a, 1) || !label(a, 2) || !done(a)) return;
+  if (!begin("26/0003", 3, c)) return;
+  if (!label(b, 0) || !done(b)) return;
+  if (!label(c, 0) || !label(c, 1) || !done(c)) return;
+  if (!begin("26/0004", 8, d) || !done(d)) return;
+}
+
+// Prima della sessione: job 99 aperto con un'etichetta, job 98 chiuso
+uint32_t seedSpool(Model& m) {
+  SD.files.clear();
+  SD.powerOn();
+  spoolInit();
+  uint32_t seq99 = spoolBegin("26/0099", 8);
+  spoolLabel(seq99, 0);
+  uint32_t seq98 = spoolBegin("26/0098", 8);
+  spoolDone(seq98);
+  powerOff();
+
+  m = Model();
+  m.jobs[seq99].labels = 1;
+  m.jobs[seq98].done = true;
+  return seq99;
+}
+
+// Stato ripreso al riavvio contro il modello
+void verify(const Model& m, const SpoolJob* open, int n) {
+  std::set<uint32_t> seen;
+  for (int i = 0; i < n; i++) {
+    uint32_t seq = open[i].seq;
+    CHECK(seen.insert(seq).second);  // Nessun job doppio
+    auto it = m.jobs.find(seq);
+    bool inflightBegin = m.inflight == 'J' && m.inflightSeq == seq;
+    CHECK(it != m.jobs.end() || inflightBegin);
+    if (it == m.jobs.end()) {
+      CHECK(open[i].doneMask == 0);
+      continue;
+    }
+    const ModelJob& j = it->second;
+    bool inflightDone = m.inflight == 'D' && m.inflightSeq == seq;
+    CHECK(!j.done || inflightDone);  // Un job chiuso non risorge
+
+    // Le etichette confermate restano fatte; in più solo quella in volo
+    uint8_t allowed = j.labels;
+    if (m.inflight == 'L' && m.inflightSeq == seq) allowed |= 1 << m.inflightLabel;
+    CHECK((open[i].doneMask & j.labels) == j.labels);
+    CHECK((open[i].doneMask & ~allowed) == 0);
+  }
+
+  // Nessun job aperto perso
+  for (const auto& kv : m.jobs) {
+    bool inflightDone = m.inflight == 'D' && m.inflightSeq == kv.first;
+    if (!kv.second.done && !inflightDone) CHECK(seen.count(kv.first) == 1);
+  }
+}
+
+// Dopo la ripresa il log resta usabile: un job nuovo non riusa numeri
+// e chiudendo tutto il riavvio successivo non trova niente
+void verifyContinues(const SpoolJob* open, int n) {
+  uint32_t seq = spoolBegin("26/0100", 8);
+  for (int i = 0; i < n; i++) CHECK(open[i].seq != seq);
+  for (int i = 0; i < n; i++) spoolDone(open[i].seq);
+  spoolDone(seq);
+  powerOff();
+
+  static SpoolJob again[SPOOL_MAX_OPEN];
+  CHECK(boot(again) == 0);
+  powerOff();
+}
+
+int main() {
+  Model m;
+  static SpoolJob open[SPOOL_MAX_OPEN];
+
+  // Giro completo: quante unità di scrittura fa la sessione
+  uint32_t seq99 = seedSpool(m);
+  SD.powerOn();
+  session(m, seq99);
+  unsigned long total = SD.spent;
+  powerOff();
+
+  unsigned long scenarios = 0;
+  for (unsigned long cutAt = 0; cutAt <= total; cutAt++) {
+    seq99 = seedSpool(m);
+    SD.powerOn(cutAt);
+    session(m, seq99);
+    powerOff();
+    if (m.inflight == 'B') m.inflight = 0;  // Calo durante l'avvio: nessun record nuovo
+    std::map<std::string, std::string> afterCut = SD.files;
+
+    // Riavvio senza intoppi
+    SD.powerOn();
+    int n = boot(open);
+    verify(m, open, n);
+    unsigned long resumeWrites = SD.spent;
+    verifyContinues(open, n);
+    scenarios++;
+
+    // Di nuovo senza corrente durante la ripresa, poi un avvio pulito
+    for (unsigned long cut2 = 0; cut2 < resumeWrites; cut2++) {
+      SD.files = afterCut;
+      SD.powerOn(cut2);
+      boot(open);
+      powerOff();
+      SD.powerOn();
+      n = boot(open);
+      verify(m, open, n);
+      verifyContinues(open, n);
+      scenarios++;
+    }
+  }
+
+  printf("spool: %lu punti di scrittura, %lu scenari\n", total + 1, scenarios);
+  return hostResult("test_spool");
+}
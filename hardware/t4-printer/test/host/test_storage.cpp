@@ -0,0 +1,99 @@
+// Task storage: più task che usano la SD insieme.
+//
+// Quattro produttori (thread, come pollTask/loop/LogTask) mescolano append
+// asincrone sullo stesso file, anche più lunghe di una richiesta, e blocchi
+// storageRun che fanno leggi-modifica-scrivi su un contatore. Il codice
+// vero di src/main.cpp gira sulla SD finta, che segna ogni accesso
+// sovrapposto. Alla fine: nessuna sovrapposizione, ogni riga intera e in
+// ordine per produttore, nessun incremento perso, e dentro un blocco
+// storageRun le append accodate prima dallo stesso task sono già su SD.
+
+#include "host.h"
+#include "fake_fs.h"
+
+metrics::Histogram mSdOp;
+
+#include "storage.inc"
+
+#define PRODUCERS 4
+#define ITERATIONS 1500
+#define RUN_EVERY 10
+
+const char* const kLogPath = "/log.bin";
+
+// Riga: "P<t> <i> <n> " + n volte la lettera del produttore + "\n"
+int lineLen(int t, int i) { return (i * 37 + t * 11) % 420; }
+
+void producer(int t) {
+  char line[512];
+  for (int i = 0; i < ITERATIONS; i++) {
+    int n = lineLen(t, i);
+    int h = snprintf(line, sizeof(line), "P%d %d %d ", t, i, n);
+    memset(line + h, 'a' + t, n);
+    line[h + n] = '\n';
+    storageAppend(ST_LOG, kLogPath, (const uint8_t*)line, h + n + 1);
+
+    if (i % RUN_EVERY == 0) {
+      char mine[32];
+      snprintf(mine, sizeof(mine), "P%d %d ", t, i);
+      storageRun(ST_CSV, [&] {
+        // FIFO: l'append appena accodata è già nel file (verso la fine)
+        CHECK(SD.exists(kLogPath) && SD.files[kLogPath].rfind(mine) != std::string::npos);
+
+        File f = SD.open("/counter", FILE_READ);
+        int v = f ? atoi(f.readStringUntil('\n').c_str()) : 0;
+        f.close();
+        f = SD.open("/counter", FILE_WRITE);
+        char num[16];
+        int len = snprintf(num, sizeof(num), "%d\n", v + 1);
+        f.write((const uint8_t*)num, len);
+        f.close();
+      });
+    }
+  }
+}
+
+int main() {
+  SD.files.clear();
+  storageInit();
+
+  std::thread threads[PRODUCERS];
+  for (int t = 0; t < PRODUCERS; t++) threads[t] = std::thread(producer, t);
+  for (int t = 0; t < PRODUCERS; t++) threads[t].join();
+  storageRun(ST_CONFIG, [] {});  // Le append ancora in coda vanno su SD
+
+  CHECK(SD.overlaps == 0);
+  CHECK(storageAppendErrors == 0);
+
+  int runs = PRODUCERS * ((ITERATIONS + RUN_EVERY - 1) / RUN_EVERY);
+  CHECK(atoi(SD.files["/counter"].c_str()) == runs);
+
+  // Ogni riga intera, e per ogni produttore 0, 1, 2, ... senza buchi
+  const std::string& log = SD.files[kLogPath];
+  int next[PRODUCERS] = {0};
+  int lines = 0, bad = 0;
+  size_t pos = 0;
+  while (pos < log.size()) {
+    size_t end = log.find('\n', pos);
+    if (end == std::string::npos) end = log.size();
+    std::string line = log.substr(pos, end - pos);
+    pos = end + 1;
+    lines++;
+
+    int t = -1, i = -1, n = -1, h = 0;
+    bool ok = sscanf(line.c_str(), "P%d %d %d %n", &t, &i, &n, &h) == 3 && t >= 0 &&
+              t < PRODUCERS && i == next[t] && n == lineLen(t, i) && (int)line.size() == h + n &&
+              line.find_first_not_of((char)('a' + t), h) == std::string::npos;
+    if (!ok) {
+      if (bad++ < 5) fprintf(stderr, "riga %d corrotta: %.60s\n", lines, line.c_str());
+      continue;
+    }
+    next[t]++;
+  }
+  CHECK(bad == 0);
+  for (int t = 0; t < PRODUCERS; t++) CHECK(next[t] == ITERATIONS);
+
+  printf("storage: %d righe, %d blocchi storageRun, %lu scritture su SD per %lu append\n", lines,
+         runs, (unsigned long)storageWrites, (unsigned long)storageAppends);
+  return hostResult("test_storage");
+}
@@ -0,0 +1,188 @@
+// Stato di sincronizzazione: riavvio nel mezzo di una raffica di schede.
+//
+// Il dispositivo ha stampato tutto fino a 26/0010; sul server arrivano
+// insieme 26/0011..26/0015. Il polling veloce stampa la più recente, poi
+// il CSV sincronizzato porta le altre ad autoPrint. Per ogni punto della
+// sequenza si riavvia lì: NVS (codice vero di src/main.cpp), history
+// salvata e spool restano, la RAM no. Dopo l'avvio ogni scheda della
+// raffica deve essere uscita almeno una volta (al più due: quella a metà
+// fra stampa e history salvata) e nessuna scheda vecchia ristampata.
+
+#include "host.h"
+
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+// NVS finta: sopravvive ai riavvii
+std::map<std::string, uint32_t> nvs;
+
+class Preferences {
+ public:
+  bool begin(const char* ns, bool readOnly) {
+    ns_ = ns;
+    return true;
+  }
+  bool isKey(const char* key) { return nvs.count(ns_ + "." + key) > 0; }
+  uint32_t getUInt(const char* key, uint32_t def) {
+    auto it = nvs.find(ns_ + "." + key);
+    return it == nvs.end() ? def : it->second;
+  }
+  size_t putUInt(const char* key, uint32_t v) {
+    nvs[ns_ + "." + key] = v;
+    return 4;
+  }
+
+ private:
+  std::string ns_;
+};
+
+#define MAX_SCHEDE 50
+struct Scheda {
+  char numero[12];
+};
+
+#include "snapshot.inc"
+#include "numero.inc"
+
+// ===== HISTORY E STAMPANTE (modello) =====
+std::set<int> historyDisk;  // Salvata (sopravvive)
+std::set<int> historyRam;   // Set in RAM, come printedTest()
+std::vector<int> historyPending;
+std::set<int> spool;        // Job accodati e non ancora stampati (sopravvive)
+std::map<int, int> printed; // Etichette uscite davvero, per scheda
+unsigned long lastKnownTimestamp = 0;
+volatile bool newSchedeReady = false;
+
+void syncUpdateSeen();
+
+bool isAlreadyPrinted(const char* numero) { return historyRam.count(packNumero(numero)) > 0; }
+
+// Come addToHistory() del firmware
+void addToHistory(const char* numero) {
+  int id = packNumero(numero);
+  if (!historyRam.insert(id).second) return;
+  historyPending.push_back(id);
+  syncUpdateSeen();
+}
+
+void savePrintHistory() {
+  historyDisk.insert(historyPending.begin(), historyPending.end());
+  historyPending.clear();
+}
+
+#include "sync.inc"
+
+void enqueue(int id) { spool.insert(id); }
+
+void printOne(int id) {
+  if (spool.erase(id)) printed[id]++;
+}
+
+// CSV scaricato e pubblicato (lista dalla più recente, come parseCSV)
+void publish(int lastId) {
+  SchedeSnapshot* snap = schedeClaim();
+  int n = 0;
+  for (int id = lastId; id > 260000 && n < MAX_SCHEDE; id--) {
+    unpackNumero(id, snap->items[n++].numero, sizeof(Scheda::numero));
+  }
+  snap->count = n;
+  schedePublish(snap);
+}
+
+// Come autoPrintNewSchede(): accoda e segna, poi salva la history
+std::vector<std::function<void()>> autoPrintSteps() {
+  std::vector<std::function<void()>> steps;
+  for (int id = 260015; id >= 260011; id--) {
+    steps.push_back([id] {
+      char numero[12];
+      unpackNumero(id, numero, sizeof(numero));
+      if (isAlreadyPrinted(numero)) return;
+      enqueue(id);
+      addToHistory(numero);
+    });
+  }
+  steps.push_back([] { savePrintHistory(); });
+  return steps;
+}
+
+void autoPrint() {
+  for (auto& step : autoPrintSteps()) step();
+}
+
+// Stato iniziale: primo avvio con 26/0001..26/0010, tutte segnate
+void firstBoot() {
+  nvs.clear();
+  historyDisk.clear();
+  historyRam.clear();
+  historyPending.clear();
+  spool.clear();
+  printed.clear();
+  syncMutex = NULL;
+  syncStateLoad();
+  publish(260010);
+  SchedeRef schede;
+  for (int i = 0; i < schede.count(); i++) addToHistory(schede[i].numero);
+  syncUpdateSeen();
+  savePrintHistory();
+  syncSaveTimestamp(1000);
+}
+
+// Riavvio: come setup() con rete, poi il loop e il task di stampa
+void reboot() {
+  historyRam = historyDisk;
+  historyPending.clear();
+  syncState = {0, -1, 0};
+  syncStateValid = false;
+  syncMutex = NULL;
+  newSchedeReady = false;
+
+  syncStateLoad();
+  publish(260015);          // CSV scaricato all'avvio: la raffica c'è
+  std::set<int> resume = spool;
+  for (int id : resume) printOne(id);  // spoolResume
+  CHECK(syncStateValid);
+  syncCatchUp();
+  if (newSchedeReady) autoPrint();
+  std::set<int> queued = spool;
+  for (int id : queued) printOne(id);
+}
+
+int main() {
+  schedeInit();
+
+  // La raffica: polling veloce, stampa, sincronizzazione CSV, autoPrint
+  std::vector<std::function<void()>> burst;
+  burst.push_back([] { enqueue(260015); });
+  burst.push_back([] { addToHistory("26/0015"); });
+  burst.push_back([] { savePrintHistory(); });
+  burst.push_back([] { syncSaveTimestamp(2000); });
+  burst.push_back([] { printOne(260015); });
+  burst.push_back([] {
+    publish(260015);
+    syncSaveGeneration();
+  });
+  for (auto& step : autoPrintSteps()) burst.push_back(step);
+  for (int id = 260014; id >= 260011; id--) burst.push_back([id] { printOne(id); });
+
+  for (size_t cut = 0; cut <= burst.size(); cut++) {
+    firstBoot();
+    for (size_t i = 0; i < cut; i++) burst[i]();
+    reboot();
+
+    for (int id = 260001; id <= 260010; id++) CHECK(printed[id] == 0);
+    for (int id = 260011; id <= 260015; id++) {
+      if (printed[id] < 1 || printed[id] > 2) {
+        fprintf(stderr, "riavvio al passo %zu: 26/%04d stampata %d volte\n", cut, id % 10000,
+                printed[id]);
+      }
+      CHECK(printed[id] >= 1);
+      CHECK(printed[id] <= 2);
+    }
+    CHECK(syncState.lastSeen == 260015);
+  }
+
+  printf("sync: %zu punti di riavvio\n", burst.size() + 1);
+  return hostResult("test_sync");
+}